@@ -16,6 +16,8 @@ data class VideoCacheRequest(
     val cacheDir: String = "",
     /** preload data size */
     val cacheSize: Long = 0,
+    /** preload the mp4 index and this much playback instead, cacheSize is the fallback */
+    val cacheDurationMs: Long = 0,
     /** preload dir max size: when beyond, start LRU */
     val cacheDirMaxSize: Long = 0,
     /** preload dir max file count: when beyond,start LRU */
@@ -36,6 +38,7 @@ data class VideoCacheRequest(
             this.putString("header", "")
             this.putLong("capacity", cacheDirMaxSize)
             this.putLong("cache_max_entries", cacheDirMaxEntries)
+            this.putLong("preload_duration_ms", cacheDurationMs)
         }
     }
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 
+#include <memory>
 #include <mutex>
 
 #define REDPLAYER_NS_BEGIN namespace redPlayer_ns {
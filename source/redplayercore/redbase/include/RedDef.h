@@ -7,6 +7,7 @@
 
 #pragma once
 #include "RedBase.h"
+#include <functional>
 #include <string>
 #include <vector>
 
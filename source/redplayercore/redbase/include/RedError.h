@@ -9,6 +9,7 @@
 
 #include "RedBase.h"
 #include <stdint.h>
+#include <string.h>
 #include <string>
 
 typedef int32_t status_t;
@@ -109,13 +110,13 @@ enum {
   ERROR_INVALID_DATA, // decrypted data ctts invalid errors
 };
 
-enum {
+enum DecoderError {
   DECODER_FALLBACK = 1000,
   DECODER_INIT_ERROR = 1001,
   DECODER_NO_OUTPUT = 1002,
   DECODER_CALLBACK_ERROR_BASE = 2000,
   DECODER_FORMAT_ERROR_BASE = 3000,
-} DecoderError;
+};
 
 // Human readable name of error
 inline std::string StatusToString(status_t status) {
@@ -54,6 +54,7 @@ enum PlayerMsg {
   RED_MSG_ACCURATE_SEEK_COMPLETE = 900, /* arg1 = current position*/
   RED_MSG_SEEK_LOOP_START = 901,        /* arg1 = loop count */
   RED_MSG_URL_CHANGE = 902,
+  RED_MSG_REPRESENTATION_CHANGED = 903, /* arg1 = from, arg2 = to */
 
   RED_MSG_VIDEO_DECODER_OPEN = 10001,
   RED_MSG_VTB_COLOR_PRIMARIES_SMPTE432 = 10002
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+/*
+ * Fixed size binary trace events, kept in one lock free ring per thread and
+ * exported as Chrome trace event json (chrome://tracing, ui.perfetto.dev).
+ * Call sites use the RED_TRACE_* macros, they compile to nothing unless
+ * RED_TRACE is defined (cmake -DRED_TRACE=ON). Compiled in, a site costs one
+ * relaxed load while no trace is running.
+ */
+
+enum RedTraceCategory {
+  RED_TRACE_DEMUX = 0,
+  RED_TRACE_DECODE,
+  RED_TRACE_RENDER,
+  RED_TRACE_AUDIO,
+  RED_TRACE_DOWNLOAD,
+  RED_TRACE_CATEGORIES
+};
+
+/*starts recording. Rings taken from now on hold events_per_thread events,
+ * rounded up to a power of two, 0 picks the default. -1 when tracing is
+ * compiled out*/
+int RedTraceStart(int events_per_thread);
+void RedTraceStop();
+/*writes what the rings still hold of the last start, a full ring has lost
+ * its oldest events. Can run while recording*/
+int RedTraceExport(const char *path);
+
+/*name must be a string literal, only the pointer is kept. id is the player
+ * id, 0 for events of no player*/
+void RedTraceRecord(char phase, int category, const char *name, int id,
+                    int64_t value);
+
+extern std::atomic<bool> gRedTraceEnabled;
+
+/*a flow follows one video frame from demux through decode to render*/
+static inline int64_t RedTraceFlowId(int id, int serial, int64_t pts) {
+  return (static_cast<int64_t>(id & 0xffff) << 48) |
+         (static_cast<int64_t>(serial & 0xffff) << 32) |
+         (pts & 0xffffffffLL);
+}
+
+#ifdef RED_TRACE
+
+static inline bool RedTraceEnabled() {
+  return gRedTraceEnabled.load(std::memory_order_relaxed);
+}
+
+class RedTraceScope {
+public:
+  RedTraceScope(int category, const char *name, int id)
+      : mCategory(category), mId(id) {
+    if (RedTraceEnabled()) {
+      mName = name;
+      RedTraceRecord('B', category, name, id, 0);
+    }
+  }
+  ~RedTraceScope() {
+    if (mName) {
+      RedTraceRecord('E', mCategory, mName, mId, 0);
+    }
+  }
+  RedTraceScope(const RedTraceScope &) = delete;
+  RedTraceScope &operator=(const RedTraceScope &) = delete;
+
+private:
+  const char *mName{nullptr};
+  int mCategory;
+  int mId;
+};
+
+#define RED_TRACE_CONCAT_(a, b) a##b
+#define RED_TRACE_CONCAT(a, b) RED_TRACE_CONCAT_(a, b)
+#define RED_TRACE_SCOPE(category, name, id)                                    \
+  RedTraceScope RED_TRACE_CONCAT(red_trace_scope_, __LINE__)(category, name,  \
+                                                             id)
+#define RED_TRACE_EVENT(phase, category, name, id, value)                      \
+  do {                                                                         \
+    if (RedTraceEnabled()) {                                                   \
+      RedTraceRecord(phase, category, name, id, value);                        \
+    }                                                                          \
+  } while (false)
+
+#else
+
+static constexpr bool RedTraceEnabled() { return false; }
+
+#define RED_TRACE_SCOPE(category, name, id)                                    \
+  do {                                                                         \
+  } while (false)
+#define RED_TRACE_EVENT(phase, category, name, id, value)                      \
+  do {                                                                         \
+  } while (false)
+
+#endif
+
+#define RED_TRACE_COUNTER(category, name, id, value)                           \
+  RED_TRACE_EVENT('C', category, name, id, value)
+#define RED_TRACE_INSTANT(category, name, id)                                  \
+  RED_TRACE_EVENT('i', category, name, id, 0)
+/*flow events attach to the scope open on their thread*/
+#define RED_TRACE_FLOW_BEGIN(category, name, id, flow)                         \
+  RED_TRACE_EVENT('s', category, name, id, flow)
+#define RED_TRACE_FLOW_STEP(category, name, id, flow)                          \
+  RED_TRACE_EVENT('t', category, name, id, flow)
+#define RED_TRACE_FLOW_END(category, name, id, flow)                           \
+  RED_TRACE_EVENT('f', category, name, id, flow)
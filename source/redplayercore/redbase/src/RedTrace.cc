@@ -0,0 +1,288 @@
+#include "RedTrace.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+
+#define TRACE_DEFAULT_EVENTS (1 << 14)
+#define TRACE_MIN_EVENTS (1 << 8)
+#define TRACE_MAX_EVENTS (1 << 20)
+#define TRACE_MAX_THREADS 0xffff
+#define TRACE_NAME_SIZE 16
+
+std::atomic<bool> gRedTraceEnabled{false};
+
+namespace {
+
+struct TraceEvent {
+  int64_t ts_us;
+  const char *name;
+  int64_t value;
+  int32_t id;
+  uint16_t thread; // index into the thread table
+  char phase;
+  uint8_t category;
+};
+static_assert(sizeof(TraceEvent) == 32, "trace event layout");
+
+/*written by the owning thread only, readers copy and then drop what the
+ * writer may have overwritten meanwhile. A ring outlives its thread and is
+ * handed to the next new one, so there are never more rings than threads
+ * alive at once, and events of exited threads stay exportable*/
+struct TraceRing {
+  TraceEvent *events{nullptr};
+  uint64_t mask{0};
+  std::atomic<uint64_t> head{0};
+  std::atomic<bool> owned{true};
+  TraceRing *next{nullptr};
+};
+
+struct TraceThread {
+  int64_t tid;
+  char name[TRACE_NAME_SIZE];
+};
+
+std::atomic<TraceRing *> gRings{nullptr};
+std::atomic<int> gEventsPerThread{TRACE_DEFAULT_EVENTS};
+std::atomic<int64_t> gStartUs{0};
+// taken once per thread and by export, never on the event path
+std::mutex gThreadLock;
+std::vector<TraceThread> gThreads;
+
+const char *kCategoryNames[RED_TRACE_CATEGORIES] = {"demux", "decode", "render",
+                                                    "audio", "download"};
+
+int64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+TraceThread currentThread() {
+  TraceThread thread;
+  memset(&thread, 0, sizeof(thread));
+#if defined(__APPLE__)
+  uint64_t tid = 0;
+  pthread_threadid_np(NULL, &tid);
+  thread.tid = static_cast<int64_t>(tid);
+  pthread_getname_np(pthread_self(), thread.name, TRACE_NAME_SIZE);
+#else
+  thread.tid = static_cast<int64_t>(syscall(SYS_gettid));
+#if defined(__linux__)
+  prctl(PR_GET_NAME, thread.name, 0, 0, 0);
+#endif
+#endif
+  thread.name[TRACE_NAME_SIZE - 1] = '\0';
+  return thread;
+}
+
+uint16_t registerThread() {
+  TraceThread thread = currentThread();
+  std::lock_guard<std::mutex> lck(gThreadLock);
+  if (gThreads.size() >= TRACE_MAX_THREADS) {
+    return TRACE_MAX_THREADS - 1;
+  }
+  gThreads.push_back(thread);
+  return static_cast<uint16_t>(gThreads.size() - 1);
+}
+
+TraceRing *claimRing() {
+  for (TraceRing *ring = gRings.load(std::memory_order_acquire); ring;
+       ring = ring->next) {
+    bool owned = false;
+    if (!ring->owned.load(std::memory_order_relaxed) &&
+        ring->owned.compare_exchange_strong(owned, true,
+                                            std::memory_order_acq_rel)) {
+      return ring;
+    }
+  }
+  int size = gEventsPerThread.load(std::memory_order_relaxed);
+  TraceRing *ring = new TraceRing;
+  ring->events = new TraceEvent[size];
+  ring->mask = static_cast<uint64_t>(size - 1);
+  ring->next = gRings.load(std::memory_order_relaxed);
+  while (!gRings.compare_exchange_weak(ring->next, ring,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+  }
+  return ring;
+}
+
+/*hands the ring on when the thread exits*/
+struct ThreadState {
+  TraceRing *ring{nullptr};
+  uint16_t thread{0};
+  ~ThreadState() {
+    if (ring) {
+      ring->owned.store(false, std::memory_order_release);
+    }
+  }
+};
+thread_local ThreadState tState;
+
+void collect(TraceRing *ring, int64_t start_us,
+             std::vector<TraceEvent> &out) {
+  uint64_t capacity = ring->mask + 1;
+  uint64_t head = ring->head.load(std::memory_order_acquire);
+  uint64_t from = head > capacity ? head - capacity : 0;
+  size_t base = out.size();
+  for (uint64_t i = from; i < head; i++) {
+    out.push_back(ring->events[i & ring->mask]);
+  }
+  // the slot of the event in flight and all before it may be new by now
+  uint64_t now = ring->head.load(std::memory_order_acquire);
+  uint64_t valid = now + 1 > capacity ? now + 1 - capacity : 0;
+  size_t drop = valid > from ? std::min<uint64_t>(valid - from, head - from)
+                             : 0;
+  out.erase(out.begin() + base, out.begin() + base + drop);
+  out.erase(std::remove_if(out.begin() + base, out.end(),
+                           [start_us](const TraceEvent &e) {
+                             return e.ts_us < start_us;
+                           }),
+            out.end());
+}
+
+void writeEscaped(FILE *fp, const char *s) {
+  for (; *s; s++) {
+    unsigned char c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\') {
+      fprintf(fp, "\\%c", c);
+    } else if (c < 0x20) {
+      fprintf(fp, "\\u%04x", c);
+    } else {
+      fputc(c, fp);
+    }
+  }
+}
+
+} // namespace
+
+int RedTraceStart(int events_per_thread) {
+#ifdef RED_TRACE
+  int size = TRACE_DEFAULT_EVENTS;
+  if (events_per_thread > 0) {
+    size = TRACE_MIN_EVENTS;
+    while (size < events_per_thread && size < TRACE_MAX_EVENTS) {
+      size <<= 1;
+    }
+  }
+  gEventsPerThread.store(size, std::memory_order_relaxed);
+  gStartUs.store(nowUs(), std::memory_order_relaxed);
+  gRedTraceEnabled.store(true, std::memory_order_release);
+  return 0;
+#else
+  (void)events_per_thread;
+  return -1;
+#endif
+}
+
+void RedTraceStop() {
+  gRedTraceEnabled.store(false, std::memory_order_release);
+}
+
+void RedTraceRecord(char phase, int category, const char *name, int id,
+                    int64_t value) {
+  ThreadState &state = tState;
+  if (!state.ring) {
+    state.thread = registerThread();
+    state.ring = claimRing();
+  }
+  TraceRing *ring = state.ring;
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  TraceEvent &e = ring->events[head & ring->mask];
+  e.ts_us = nowUs();
+  e.name = name;
+  e.value = value;
+  e.id = id;
+  e.thread = state.thread;
+  e.phase = phase;
+  e.category = static_cast<uint8_t>(category);
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+int RedTraceExport(const char *path) {
+  int64_t start_us = gStartUs.load(std::memory_order_relaxed);
+  std::vector<TraceEvent> events;
+  for (TraceRing *ring = gRings.load(std::memory_order_acquire); ring;
+       ring = ring->next) {
+    collect(ring, start_us, events);
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const TraceEvent &a, const TraceEvent &b) {
+                     return a.ts_us < b.ts_us;
+                   });
+  std::vector<TraceThread> threads;
+  {
+    std::lock_guard<std::mutex> lck(gThreadLock);
+    threads = gThreads;
+  }
+
+  FILE *fp = fopen(path, "w");
+  if (!fp) {
+    return -1;
+  }
+  // players show up as processes, each with the threads it used
+  fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  const char *sep = "";
+  std::set<int32_t> pids;
+  std::set<std::pair<int32_t, uint16_t>> pid_threads;
+  for (const TraceEvent &e : events) {
+    if (pids.insert(e.id).second) {
+      fprintf(fp,
+              "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d"
+              ",\"args\":{\"name\":\"%s %d\"}}",
+              sep, e.id, e.id > 0 ? "player" : "shared", e.id);
+      sep = ",\n";
+    }
+    if (e.thread < threads.size() &&
+        pid_threads.insert({e.id, e.thread}).second) {
+      fprintf(fp,
+              "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d"
+              ",\"tid\":%" PRId64 ",\"args\":{\"name\":\"",
+              sep, e.id, threads[e.thread].tid);
+      writeEscaped(fp, threads[e.thread].name);
+      fprintf(fp, "\"}}");
+      sep = ",\n";
+    }
+  }
+  for (const TraceEvent &e : events) {
+    bool flow = e.phase == 's' || e.phase == 't' || e.phase == 'f';
+    if (flow && e.value == 0) {
+      continue;
+    }
+    int64_t tid = e.thread < threads.size() ? threads[e.thread].tid : 0;
+    fprintf(fp, "%s{\"name\":\"", sep);
+    writeEscaped(fp, e.name);
+    fprintf(fp,
+            "\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%" PRId64
+            ",\"pid\":%d,\"tid\":%" PRId64,
+            e.category < RED_TRACE_CATEGORIES ? kCategoryNames[e.category]
+                                              : "other",
+            e.phase, e.ts_us - start_us, e.id, tid);
+    if (e.phase == 'C') {
+      fprintf(fp, ",\"args\":{\"value\":%" PRId64 "}", e.value);
+    } else if (e.phase == 'i') {
+      fprintf(fp, ",\"s\":\"t\"");
+    } else if (flow) {
+      fprintf(fp, ",\"id\":\"0x%" PRIx64 "\"%s", static_cast<uint64_t>(e.value),
+              e.phase == 'f' ? ",\"bp\":\"e\"" : "");
+    }
+    fprintf(fp, "}");
+    sep = ",\n";
+  }
+  fprintf(fp, "\n]}\n");
+  return fclose(fp) == 0 ? 0 : -1;
+}
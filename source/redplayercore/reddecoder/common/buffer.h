@@ -76,6 +76,7 @@ enum class VideoPacketFormat {
 
 enum class DecodeFlag {
   kDoNotOutputFrame = 1 << 0,
+  kKeyFrame = 1 << 1,
 };
 
 struct VideoPacketMeta {
@@ -147,6 +148,12 @@ enum class VideoDiscard {
   kVDISCARD_ALL = 6,      ///< discard all
 };
 
+enum class VideoThreadType {
+  kFrame = 1,         ///< decode several frames in parallel
+  kSlice = 2,         ///< decode slices of one frame in parallel
+  kFrameAndSlice = 3, ///< frame threads where the codec has them
+};
+
 struct VideoSampleAspectRatio {
   int num = 0;
   int den = 0;
@@ -181,6 +188,12 @@ struct VideoFormatDescMeta {
   VideoDiscard skip_frame = VideoDiscard::kDISCARD_NONE;
   VideoDiscard skip_loop_filter = VideoDiscard::kDISCARD_NONE;
   VideoDiscard skip_idct = VideoDiscard::kDISCARD_NONE;
+  VideoThreadType thread_type = VideoThreadType::kSlice;
+  // 0 picks a count from the cpu cores and the resolution
+  int thread_count = 0;
+  // frame threads hold back thread_count - 1 frames, so decode slice threaded
+  // until the first frame is out and switch at the next key packet
+  bool low_delay_start = false;
 
   VideoSampleAspectRatio sample_aspect_ratio;
 };
@@ -1,6 +1,8 @@
 #include "reddecoder/video/video_common/format_convert_helper.h"
 
+#include <limits.h>
 #include <memory>
+#include <string.h>
 
 int FormatConvertHelper::convert_hevc_nal_units(
     const uint8_t *p_buf, size_t i_buf_size, uint8_t *p_out_buf,
@@ -1,9 +1,41 @@
 #include "reddecoder/video/video_decoder/ffmpeg_video_decoder.h"
 
+#include <algorithm>
+
 #include "reddecoder/common/logger.h"
 
+extern "C" {
+#include "libavutil/cpu.h"
+}
+
 namespace reddecoder {
 
+// about one thread per 0.25 megapixel, small videos don't gain from more
+static int pick_thread_count(int width, int height) {
+  int64_t pixels = static_cast<int64_t>(width) * height;
+  int wanted = 8;
+  if (pixels <= 640 * 360) {
+    wanted = 2;
+  } else if (pixels <= 1280 * 720) {
+    wanted = 4;
+  } else if (pixels <= 1920 * 1088) {
+    wanted = 6;
+  }
+  return std::max(1, std::min(wanted, av_cpu_count()));
+}
+
+static int transfer_thread_type_to_ffmpeg(VideoThreadType type) {
+  switch (type) {
+  case VideoThreadType::kFrame:
+    return FF_THREAD_FRAME;
+  case VideoThreadType::kFrameAndSlice:
+    return FF_THREAD_FRAME | FF_THREAD_SLICE;
+  case VideoThreadType::kSlice:
+  default:
+    return FF_THREAD_SLICE;
+  }
+}
+
 static void release_av_frame(FFmpegBufferContext *context) {
   if (context && context->av_frame) {
     AVFrame *frame = reinterpret_cast<AVFrame *>(context->av_frame);
@@ -75,9 +107,102 @@ VideoCodecError FFmpegVideoDecoder::init(const Buffer *buffer) {
 
 VideoCodecError FFmpegVideoDecoder::release() {
   codec_context_.reset();
+  frame_threads_pending_ = false;
+  frame_out_ = false;
+  return VideoCodecError::kNoError;
+}
+
+VideoCodecError FFmpegVideoDecoder::open_codec(int thread_type) {
+  AVCodec *codec;
+  codec = avcodec_find_decoder(codec_context_->codec_id);
+  if (!codec) {
+    release();
+    return VideoCodecError::kInitError;
+  }
+
+  int ret = 0;
+  if ((ret = avcodec_close(codec_context_.get())) < 0) {
+    release();
+    return VideoCodecError::kInitError;
+  }
+
+  codec_context_->thread_type = thread_type;
+  AVDictionary *opts = NULL;
+  av_dict_set(&opts, "refcounted_frames", "1", 0);
+
+  if ((ret = avcodec_open2(codec_context_.get(), codec, &opts)) < 0) {
+    av_dict_free(&opts);
+    release();
+    return VideoCodecError::kInitError;
+  }
+  av_dict_free(&opts);
   return VideoCodecError::kNoError;
 }
 
+// The key packet about to be sent needs nothing decoded before it, so drain
+// what the slice threaded decoder holds and reopen it with frame threads.
+VideoCodecError FFmpegVideoDecoder::switch_to_frame_threads() {
+  frame_threads_pending_ = false;
+  if (avcodec_send_packet(codec_context_.get(), NULL) >= 0) {
+    while (true) {
+      AVFrame *frame = av_frame_alloc();
+      if (avcodec_receive_frame(codec_context_.get(), frame) < 0) {
+        av_frame_free(&frame);
+        break;
+      }
+      output_frame(frame);
+    }
+  }
+  AV_LOGI(DEC_TAG, "[reddecoder] %s, thread_type %d thread_count %d\n",
+          __FUNCTION__, thread_type_, codec_context_->thread_count);
+  return open_codec(thread_type_);
+}
+
+void FFmpegVideoDecoder::output_frame(AVFrame *frame) {
+  size_t buffer_size = 1;
+  std::unique_ptr<Buffer> output_buffer =
+      std::make_unique<Buffer>(BufferType::kVideoFrame, buffer_size);
+
+  VideoFrameMeta *meta = output_buffer->get_video_frame_meta();
+  meta->width = frame->width;
+  meta->height = frame->height;
+  meta->yStride = frame->linesize[0];
+  meta->uStride = frame->linesize[1];
+  meta->vStride = frame->linesize[2];
+
+  meta->yBuffer = frame->data[0];
+  meta->uBuffer = frame->data[1];
+  meta->vBuffer = frame->data[2];
+
+  meta->buffer_context = reinterpret_cast<void *>(new FFmpegBufferContext{
+      .av_frame = frame,
+      .release_av_frame = release_av_frame,
+  });
+
+  switch (frame->format) {
+  case AV_PIX_FMT_YUVJ420P:
+    meta->pixel_format = PixelFormat::kYUVJ420P;
+    break;
+  case AV_PIX_FMT_YUV420P10LE:
+    meta->pixel_format = PixelFormat::kYUV420P10LE;
+    break;
+  case AV_PIX_FMT_YUV420P:
+    meta->pixel_format = PixelFormat::kYUV420;
+    break;
+  default:
+    meta->pixel_format = PixelFormat::kYUV420;
+    AV_LOGW(DEC_TAG, "[reddecoder] %s, unexpected frame format %d\n",
+            __FUNCTION__, frame->format);
+    break;
+  }
+
+  meta->pts_ms = frame->best_effort_timestamp;
+  meta->dts_ms = frame->pkt_dts;
+
+  frame_out_ = true;
+  video_decoded_callback_->on_decoded_frame(std::move(output_buffer));
+}
+
 VideoCodecError FFmpegVideoDecoder::flush() {
   is_drain_state_ = false;
   if (codec_context_) {
@@ -95,51 +220,21 @@ VideoCodecError FFmpegVideoDecoder::decode(const Buffer *buffer) {
     return VideoCodecError::kInvalidParameter;
   }
 
+  if (frame_threads_pending_ && frame_out_ && !is_drain_state_ &&
+      buffer->get_size() > 0 &&
+      (buffer->get_video_packet_meta()->decode_flags &
+       static_cast<uint32_t>(DecodeFlag::kKeyFrame))) {
+    VideoCodecError err = switch_to_frame_threads();
+    if (err != VideoCodecError::kNoError) {
+      return err;
+    }
+  }
+
   AVFrame *frame = av_frame_alloc();
   int ret = avcodec_receive_frame(codec_context_.get(), frame);
 
   if (ret >= 0) {
-    size_t buffer_size = 1;
-    std::unique_ptr<Buffer> output_buffer =
-        std::make_unique<Buffer>(BufferType::kVideoFrame, buffer_size);
-
-    VideoFrameMeta *meta = output_buffer->get_video_frame_meta();
-    meta->width = frame->width;
-    meta->height = frame->height;
-    meta->yStride = frame->linesize[0];
-    meta->uStride = frame->linesize[1];
-    meta->vStride = frame->linesize[2];
-
-    meta->yBuffer = frame->data[0];
-    meta->uBuffer = frame->data[1];
-    meta->vBuffer = frame->data[2];
-
-    meta->buffer_context = reinterpret_cast<void *>(new FFmpegBufferContext{
-        .av_frame = frame,
-        .release_av_frame = release_av_frame,
-    });
-
-    switch (frame->format) {
-    case AV_PIX_FMT_YUVJ420P:
-      meta->pixel_format = PixelFormat::kYUVJ420P;
-      break;
-    case AV_PIX_FMT_YUV420P10LE:
-      meta->pixel_format = PixelFormat::kYUV420P10LE;
-      break;
-    case AV_PIX_FMT_YUV420P:
-      meta->pixel_format = PixelFormat::kYUV420;
-      break;
-    default:
-      meta->pixel_format = PixelFormat::kYUV420;
-      AV_LOGW(DEC_TAG, "[reddecoder] %s, unexpected frame format %d\n",
-              __FUNCTION__, frame->format);
-      break;
-    }
-
-    meta->pts_ms = frame->best_effort_timestamp;
-    meta->dts_ms = frame->pkt_dts;
-
-    video_decoded_callback_->on_decoded_frame(std::move(output_buffer));
+    output_frame(frame);
   } else if (ret == AVERROR_EOF) {
     av_frame_unref(frame);
     av_frame_free(&frame);
@@ -209,6 +304,8 @@ FFmpegVideoDecoder::set_video_format_description(const Buffer *buffer) {
     if (item.type == VideoFormatDescType::kExtraData) {
       AV_LOGI(DEC_TAG, "[reddecoder] %s, extradataSize is %zu\n", __FUNCTION__,
               buffer->get_size());
+      // set again when the stream format changes
+      av_freep(&codec_context_->extradata);
       codec_context_->extradata = reinterpret_cast<uint8_t *>(
           av_malloc(buffer->get_size() + AV_INPUT_BUFFER_PADDING_SIZE));
       codec_context_->extradata_size = buffer->get_size();
@@ -231,29 +328,25 @@ FFmpegVideoDecoder::set_video_format_description(const Buffer *buffer) {
               __FUNCTION__, codec_context_->skip_frame,
               codec_context_->skip_loop_filter, codec_context_->skip_idct);
 
-      AVCodec *codec;
-      codec = avcodec_find_decoder(codec_context_->codec_id);
-      if (!codec) {
-        release();
-        return VideoCodecError::kInitError;
-      }
-
-      int ret = 0;
-      if ((ret = avcodec_close(codec_context_.get())) < 0) {
-        release();
-        return VideoCodecError::kInitError;
-      }
-
-      AVDictionary *opts = NULL;
-      av_dict_set(&opts, "threads", "auto", 0);
-      av_dict_set(&opts, "refcounted_frames", "1", 0);
-
-      if ((ret = avcodec_open2(codec_context_.get(), codec, &opts)) < 0) {
-        av_dict_free(&opts);
-        release();
-        return VideoCodecError::kInitError;
+      thread_type_ = transfer_thread_type_to_ffmpeg(meta->thread_type);
+      codec_context_->thread_count =
+          meta->thread_count > 0
+              ? meta->thread_count
+              : pick_thread_count(meta->width, meta->height);
+      frame_threads_pending_ = meta->low_delay_start &&
+                               (thread_type_ & FF_THREAD_FRAME) &&
+                               codec_context_->thread_count > 1;
+      frame_out_ = false;
+      AV_LOGI(DEC_TAG,
+              "[reddecoder] %s, thread_type %d thread_count %d low_delay %d\n",
+              __FUNCTION__, thread_type_, codec_context_->thread_count,
+              frame_threads_pending_);
+
+      VideoCodecError err = open_codec(
+          frame_threads_pending_ ? FF_THREAD_SLICE : thread_type_);
+      if (err != VideoCodecError::kNoError) {
+        return err;
       }
-      av_dict_free(&opts);
     }
   }
   return VideoCodecError::kNoError;
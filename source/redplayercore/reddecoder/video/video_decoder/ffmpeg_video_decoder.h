@@ -33,6 +33,16 @@ public:
   AVDiscard transfer_discard_opt_to_ffmpeg(VideoDiscard opt);
   std::unique_ptr<AVCodecContext, AVCodecContextReleaser> codec_context_;
   bool is_drain_state_ = false;
+
+private:
+  VideoCodecError open_codec(int thread_type);
+  VideoCodecError switch_to_frame_threads();
+  void output_frame(AVFrame *frame);
+
+  // FF_THREAD_* bits to run with once the low delay start is over
+  int thread_type_ = FF_THREAD_SLICE;
+  bool frame_threads_pending_ = false;
+  bool frame_out_ = false;
 };
 
 } // namespace reddecoder
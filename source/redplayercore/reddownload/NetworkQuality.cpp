@@ -44,7 +44,8 @@ void NetworkQuality::addIndicator(
   // TODO: more strategies
   if (indicator->exception != NQException::NONE) {
     AV_LOGI(NQ_TAG, "%s tcpRTT:%d httpRTT:%d exception:%d\n", __FUNCTION__,
-            indicator->tcpRTT, indicator->httpRTT, indicator->exception);
+            indicator->tcpRTT, indicator->httpRTT,
+            static_cast<int>(indicator->exception));
     _indicator.map.clear();
     return;
   }
@@ -104,7 +105,8 @@ std::shared_ptr<NQInfo> NetworkQuality::getNetInfo() {
     info->level = getLevel(tcpRTT, httpRTT);
     info->downloadSpeed = downloadSpeed;
     AV_LOGI(NQ_TAG, "%s level:%d tcpRTT:%.2f httpRTT:%.2f downloadSpeed:%.2f\n",
-            __FUNCTION__, info->level, tcpRTT, httpRTT, downloadSpeed);
+            __FUNCTION__, static_cast<int>(info->level), tcpRTT, httpRTT,
+            downloadSpeed);
   }
   return info;
 }
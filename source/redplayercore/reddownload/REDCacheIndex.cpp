@@ -0,0 +1,197 @@
+#include "REDCacheIndex.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "RedLog.h"
+#define LOG_TAG "RedCacheIndex"
+
+static size_t index_length(uint32_t capacity) {
+  return sizeof(REDCacheIndexHeader) +
+         static_cast<size_t>(capacity) * sizeof(REDCacheIndexRecord);
+}
+
+REDCacheIndex::~REDCacheIndex() { close(); }
+
+int REDCacheIndex::open(const std::string &path, bool truncate) {
+  close();
+  mfd = ::open(path.c_str(), O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+  if (mfd < 0) {
+    AV_LOGW(LOG_TAG, "REDCache - %s open %s error(%s)!\n", __FUNCTION__,
+            path.c_str(), strerror(errno));
+    return -1;
+  }
+  struct stat statbuf;
+  if (fstat(mfd, &statbuf) != 0) {
+    close();
+    return -1;
+  }
+
+  bool valid = false;
+  if (statbuf.st_size >= static_cast<off_t>(sizeof(REDCacheIndexHeader))) {
+    REDCacheIndexHeader header;
+    if (pread(mfd, &header, sizeof(header), 0) ==
+            static_cast<ssize_t>(sizeof(header)) &&
+        header.magic == CACHE_INDEX_MAGIC &&
+        header.version == CACHE_INDEX_VERSION &&
+        header.header_size == sizeof(REDCacheIndexHeader) &&
+        header.record_size == sizeof(REDCacheIndexRecord) &&
+        header.entry_count <= header.entry_capacity &&
+        statbuf.st_size >=
+            static_cast<off_t>(index_length(header.entry_capacity))) {
+      valid = map(index_length(header.entry_capacity)) == 0;
+    }
+  }
+  if (!valid) {
+    if (statbuf.st_size > 0) {
+      AV_LOGW(LOG_TAG, "REDCache - %s drop invalid index %s\n", __FUNCTION__,
+              path.c_str());
+    }
+    size_t length = index_length(CACHE_INDEX_INIT_ENTRIES);
+    if (ftruncate(mfd, 0) != 0 ||
+        ftruncate(mfd, static_cast<off_t>(length)) != 0 || map(length) != 0) {
+      AV_LOGW(LOG_TAG, "REDCache - %s init %s error(%s)!\n", __FUNCTION__,
+              path.c_str(), strerror(errno));
+      close();
+      return -1;
+    }
+    memset(mheader, 0, sizeof(REDCacheIndexHeader));
+    mheader->magic = CACHE_INDEX_MAGIC;
+    mheader->version = CACHE_INDEX_VERSION;
+    mheader->header_size = sizeof(REDCacheIndexHeader);
+    mheader->record_size = sizeof(REDCacheIndexRecord);
+    mheader->entry_capacity = CACHE_INDEX_INIT_ENTRIES;
+    mheader->file_size = -1;
+  }
+
+  mslots.clear();
+  mslots.reserve(mheader->entry_count);
+  for (uint32_t i = 0; i < mheader->entry_count; ++i) {
+    mslots[mrecords[i].logical_pos] = i;
+  }
+  return 0;
+}
+
+void REDCacheIndex::close() {
+  if (mbase != nullptr) {
+    munmap(mbase, mlength);
+  }
+  if (mfd >= 0) {
+    ::close(mfd);
+  }
+  mfd = -1;
+  mlength = 0;
+  mbase = nullptr;
+  mheader = nullptr;
+  mrecords = nullptr;
+  mslots.clear();
+}
+
+int REDCacheIndex::map(size_t length) {
+  void *addr =
+      mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, mfd, 0);
+  if (addr == MAP_FAILED) {
+    return -1;
+  }
+  mbase = reinterpret_cast<uint8_t *>(addr);
+  mlength = length;
+  mheader = reinterpret_cast<REDCacheIndexHeader *>(mbase);
+  mrecords = reinterpret_cast<REDCacheIndexRecord *>(
+      mbase + sizeof(REDCacheIndexHeader));
+  return 0;
+}
+
+int REDCacheIndex::grow() {
+  uint32_t capacity = mheader->entry_capacity * 2;
+  size_t length = index_length(capacity);
+  munmap(mbase, mlength);
+  mbase = nullptr;
+  mheader = nullptr;
+  mrecords = nullptr;
+  if (ftruncate(mfd, static_cast<off_t>(length)) != 0 || map(length) != 0) {
+    AV_LOGW(LOG_TAG, "REDCache - %s to %u entries error(%s)!\n", __FUNCTION__,
+            capacity, strerror(errno));
+    close();
+    return -1;
+  }
+  mheader->entry_capacity = capacity;
+  return 0;
+}
+
+int REDCacheIndex::put(uint64_t logical_pos, uint64_t physical_pos,
+                       uint32_t data_amount) {
+  if (!is_open())
+    return -1;
+  REDCacheIndexRecord *record = nullptr;
+  auto slotIter = mslots.find(logical_pos);
+  if (slotIter != mslots.end()) {
+    record = &mrecords[slotIter->second];
+  } else {
+    if (mheader->entry_count >= mheader->entry_capacity && grow() != 0)
+      return -1;
+    // the slot may hold a record remove() left behind, it is written in full
+    // before the count takes it in, so a kill in between never exposes it
+    uint32_t slot = mheader->entry_count;
+    record = &mrecords[slot];
+    record->logical_pos = logical_pos;
+    record->physical_pos = physical_pos;
+    record->data_amount = data_amount;
+    record->reserved = 0;
+    mslots[logical_pos] = slot;
+    __atomic_store_n(&mheader->entry_count, slot + 1, __ATOMIC_RELEASE);
+    return 0;
+  }
+  record->physical_pos = physical_pos;
+  record->data_amount = data_amount;
+  return 0;
+}
+
+void REDCacheIndex::remove(uint64_t logical_pos) {
+  if (!is_open())
+    return;
+  auto slotIter = mslots.find(logical_pos);
+  if (slotIter == mslots.end())
+    return;
+  uint32_t slot = slotIter->second;
+  uint32_t last = mheader->entry_count - 1;
+  mslots.erase(slotIter);
+  if (slot != last) {
+    mrecords[slot] = mrecords[last];
+    mslots[mrecords[slot].logical_pos] = slot;
+  }
+  mheader->entry_count = last;
+}
+
+void REDCacheIndex::clear() {
+  if (!is_open())
+    return;
+  mheader->entry_count = 0;
+  mslots.clear();
+}
+
+void REDCacheIndex::set_meta(int64_t file_size, int64_t cache_size,
+                             int period_size) {
+  if (!is_open())
+    return;
+  mheader->file_size = file_size;
+  mheader->cache_size = cache_size;
+  mheader->period_size = period_size;
+}
+
+bool REDCacheIndex::is_valid_file(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  REDCacheIndexHeader header;
+  bool valid = pread(fd, &header, sizeof(header), 0) ==
+                   static_cast<ssize_t>(sizeof(header)) &&
+               header.magic == CACHE_INDEX_MAGIC &&
+               header.version == CACHE_INDEX_VERSION &&
+               header.entry_count > 0;
+  ::close(fd);
+  return valid;
+}
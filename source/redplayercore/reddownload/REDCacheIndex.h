@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "REDnocopyable.h"
+
+#define CACHE_INDEX_SUFFIX "-idx"
+#define CACHE_MAP_SUFFIX "-map" // legacy text map, migrated on first load
+#define CACHE_KEYFRAME_SUFFIX "-kfi" // seek index the player keeps alongside
+#define CACHE_DNS_FILE "reddns.json" // REDDnsCache table, not a cached file
+#define CACHE_INDEX_MAGIC 0x49434452 // "RDCI"
+#define CACHE_INDEX_VERSION 1
+#define CACHE_INDEX_INIT_ENTRIES 64
+
+struct REDCacheIndexHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t record_size;
+  uint32_t entry_count;
+  uint32_t entry_capacity;
+  int64_t file_size;
+  int64_t cache_size;
+  int32_t period_size;
+  uint8_t reserved[20];
+};
+
+struct REDCacheIndexRecord {
+  uint64_t logical_pos;
+  uint64_t physical_pos;
+  uint32_t data_amount;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(REDCacheIndexHeader) == 64, "cache index header size");
+static_assert(sizeof(REDCacheIndexRecord) == 24, "cache index record size");
+
+/*fixed-record binary index of one cached file, mmapped so that records can be
+ * appended or updated in place*/
+class REDCacheIndex : private REDnocopyable {
+public:
+  REDCacheIndex() = default;
+  ~REDCacheIndex();
+
+  /*map the index file, truncate drops all records*/
+  int open(const std::string &path, bool truncate = false);
+  void close();
+  bool is_open() const { return mheader != nullptr; }
+
+  /*valid after open*/
+  const REDCacheIndexHeader *header() const { return mheader; }
+  const REDCacheIndexRecord *records() const { return mrecords; }
+  uint32_t count() const { return mheader ? mheader->entry_count : 0; }
+
+  /*append or update the record keyed by logical_pos*/
+  int put(uint64_t logical_pos, uint64_t physical_pos, uint32_t data_amount);
+  void remove(uint64_t logical_pos);
+  void clear();
+  void set_meta(int64_t file_size, int64_t cache_size, int period_size);
+
+  /*cheap check used by the directory scan, does not map the file*/
+  static bool is_valid_file(const std::string &path);
+
+private:
+  int map(size_t length);
+  int grow();
+
+  int mfd{-1};
+  size_t mlength{0};
+  uint8_t *mbase{nullptr};
+  REDCacheIndexHeader *mheader{nullptr};
+  REDCacheIndexRecord *mrecords{nullptr};
+  std::unordered_map<uint64_t, uint32_t> mslots; // logical_pos -> record slot
+};
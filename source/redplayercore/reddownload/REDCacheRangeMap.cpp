@@ -0,0 +1,115 @@
+#include "REDCacheRangeMap.h"
+
+#include <algorithm>
+
+std::vector<REDCacheInfo>::iterator
+REDCacheRangeMap::lower_bound(std::uint64_t logical_pos) {
+  return std::lower_bound(mshards.begin(), mshards.end(), logical_pos,
+                          [](const REDCacheInfo &info, std::uint64_t pos) {
+                            return info.logical_pos < pos;
+                          });
+}
+
+const REDCacheInfo *REDCacheRangeMap::find(std::uint64_t logical_pos) const {
+  auto iter = const_cast<REDCacheRangeMap *>(this)->lower_bound(logical_pos);
+  if (iter == mshards.end() || iter->logical_pos != logical_pos)
+    return nullptr;
+  return &*iter;
+}
+
+void REDCacheRangeMap::put(const REDCacheInfo &info) {
+  std::uint64_t end = info.logical_pos + info.data_amount;
+  // shards mostly arrive in playback order
+  if (mshards.empty() || mshards.back().logical_pos < info.logical_pos) {
+    mshards.push_back(info);
+  } else {
+    auto iter = lower_bound(info.logical_pos);
+    if (iter != mshards.end() && iter->logical_pos == info.logical_pos) {
+      std::uint64_t old_end = iter->logical_pos + iter->data_amount;
+      *iter = info;
+      if (end < old_end) {
+        split_run(info.logical_pos);
+        return;
+      }
+    } else {
+      mshards.insert(iter, info);
+    }
+  }
+  if (info.data_amount > 0)
+    add_run(info.logical_pos, end);
+}
+
+void REDCacheRangeMap::erase(std::uint64_t logical_pos) {
+  auto iter = lower_bound(logical_pos);
+  if (iter == mshards.end() || iter->logical_pos != logical_pos)
+    return;
+  std::uint64_t end = iter->logical_pos + iter->data_amount;
+  mshards.erase(iter);
+  if (end > logical_pos)
+    split_run(logical_pos);
+}
+
+void REDCacheRangeMap::clear() {
+  mshards.clear();
+  mruns.clear();
+}
+
+std::vector<REDCacheRangeMap::Run>::iterator
+REDCacheRangeMap::run_at(std::uint64_t offset) {
+  // first run ending at or after offset
+  return std::lower_bound(
+      mruns.begin(), mruns.end(), offset,
+      [](const Run &run, std::uint64_t pos) { return run.second < pos; });
+}
+
+void REDCacheRangeMap::add_run(std::uint64_t start, std::uint64_t end) {
+  auto first = run_at(start);
+  auto last = first;
+  while (last != mruns.end() && last->first <= end) {
+    start = std::min(start, last->first);
+    end = std::max(end, last->second);
+    ++last;
+  }
+  if (first == last) {
+    mruns.insert(first, Run(start, end));
+    return;
+  }
+  *first = Run(start, end);
+  mruns.erase(first + 1, last);
+}
+
+void REDCacheRangeMap::split_run(std::uint64_t start) {
+  auto run = run_at(start);
+  if (run == mruns.end() || run->first > start)
+    return;
+  Run old = *run;
+  mruns.erase(run);
+  // the shards that are left inside the old run, merged again
+  auto iter = lower_bound(old.first);
+  for (; iter != mshards.end() && iter->logical_pos < old.second; ++iter) {
+    if (iter->data_amount > 0)
+      add_run(iter->logical_pos, iter->logical_pos + iter->data_amount);
+  }
+}
+
+const REDCacheRangeMap::Run *
+REDCacheRangeMap::find_run(std::uint64_t offset) const {
+  // last run starting at or before offset
+  auto iter = std::upper_bound(
+      mruns.begin(), mruns.end(), offset,
+      [](std::uint64_t pos, const Run &run) { return pos < run.first; });
+  if (iter == mruns.begin())
+    return nullptr;
+  --iter;
+  return offset < iter->second ? &*iter : nullptr;
+}
+
+std::uint64_t REDCacheRangeMap::contiguous_size(std::uint64_t offset) const {
+  const Run *run = find_run(offset);
+  return run != nullptr ? run->second - offset : 0;
+}
+
+std::uint64_t REDCacheRangeMap::next_hole(std::uint64_t offset) const {
+  const Run *run = find_run(offset);
+  return run != nullptr ? run->second : offset;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct REDCacheInfo {
+  std::uint32_t data_amount;
+  std::uint64_t physical_pos;
+  std::uint64_t logical_pos;
+  REDCacheInfo() : data_amount(0), physical_pos(0), logical_pos(0) {}
+  REDCacheInfo(std::uint64_t start_pos_, std::uint32_t data_amount_)
+      : data_amount(data_amount_), physical_pos(0), logical_pos(start_pos_) {}
+  REDCacheInfo(std::uint64_t start_pos_, std::uint32_t data_amount_,
+               std::uint64_t physical_pos_)
+      : data_amount(data_amount_), physical_pos(physical_pos_),
+        logical_pos(start_pos_) {}
+};
+
+/*shards of one cached file, kept by value and sorted by logical_pos, with
+ * the byte runs they cover kept merged as they change. shards mostly arrive
+ * in order and grow in place, which costs a lookup and touches only the
+ * neighbouring runs*/
+class REDCacheRangeMap {
+public:
+  typedef std::vector<REDCacheInfo>::const_iterator const_iterator;
+  typedef std::pair<std::uint64_t, std::uint64_t> Run;
+
+  /*shard starting exactly at logical_pos, nullptr if absent*/
+  const REDCacheInfo *find(std::uint64_t logical_pos) const;
+  /*insert or replace the shard keyed by info.logical_pos*/
+  void put(const REDCacheInfo &info);
+  void erase(std::uint64_t logical_pos);
+  void clear();
+  void reserve(size_t count) { mshards.reserve(count); }
+  size_t size() const { return mshards.size(); }
+  bool empty() const { return mshards.empty(); }
+  const_iterator begin() const { return mshards.begin(); }
+  const_iterator end() const { return mshards.end(); }
+
+  /*bytes cached contiguously from offset, 0 if offset is not cached*/
+  std::uint64_t contiguous_size(std::uint64_t offset) const;
+  /*first uncached byte at or after offset*/
+  std::uint64_t next_hole(std::uint64_t offset) const;
+
+private:
+  std::vector<REDCacheInfo>::iterator lower_bound(std::uint64_t logical_pos);
+  std::vector<Run>::iterator run_at(std::uint64_t offset);
+  const Run *find_run(std::uint64_t offset) const;
+  /*join [start, end) with the runs it touches*/
+  void add_run(std::uint64_t start, std::uint64_t end);
+  /*rebuild the run holding start from its shards, after a shard there
+   * shrank or went away*/
+  void split_run(std::uint64_t start);
+
+  std::vector<REDCacheInfo> mshards;
+  /*[start, end) of contiguous cached bytes*/
+  std::vector<Run> mruns;
+};
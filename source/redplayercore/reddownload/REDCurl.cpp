@@ -9,12 +9,17 @@
 #include <string>
 
 #include "NetworkQuality.h"
+#include "REDCurlMulti.h"
 #include "REDURLParser.h"
 #include "RedBase.h"
 #include "RedLog.h"
+#include "RedTrace.h"
 #include "dnscache/REDDnsCache.h"
+#include "dnscache/REDHappyEyeballs.h"
 #include "utility/Utility.h"
 #define MAX_RETRY 5
+#define SPEED_SAMPLE_BYTES (512 * 1024)
+#define SPEED_SAMPLE_MIN_US 200000
 #define LOG_TAG "RedCurl"
 using namespace std;
 
@@ -129,6 +134,7 @@ int RedCurl::sockopt_callback(void *clientp, curl_socket_t curlfd,
               thiz, actualBufferSize);
       break;
     }
+    return CURL_SOCKOPT_OK;
   }
   return CURL_SOCKOPT_OK;
 }
@@ -148,7 +154,10 @@ curl_socket_t RedCurl::opensocket_callback(void *clientp, curlsocktype purpose,
 
 RedCurl::RedCurl(Source source, int range_size) : RedDownloadBase(source, 0) {
   std::call_once(globalCurlInitOnceFlag, [&] { se = new RedCurl(0); });
-  multi_handle = curl_multi_init();
+  m_shared_multi = RedDownloadConfig::getinstance()->get_config_value(
+                       CURL_SHARED_MULTI_KEY) > 0;
+  if (!m_shared_multi)
+    multi_handle = curl_multi_init();
   mcurl = nullptr;
   bpause.store(false);
   m_pause_timeout.store(false);
@@ -161,6 +170,8 @@ RedCurl::RedCurl(Source source, int range_size) : RedDownloadBase(source, 0) {
   m_range_size = range_size;
   m_callback_dns = RedDownloadConfig::getinstance()->get_config_value(
                        CALLBACK_DNS_INFO_KEY) > 0;
+  m_happy_eyeballs = RedDownloadConfig::getinstance()->get_config_value(
+                         HAPPY_EYEBALLS_KEY) > 0;
 }
 
 RedCurl::~RedCurl() {
@@ -195,14 +206,55 @@ bool RedCurl::destroyCurl() {
     curl_slist_free_all(mheaderList);
     mheaderList = nullptr;
   }
-  if (multi_handle != nullptr && mcurl != nullptr) {
-    curl_multi_remove_handle(multi_handle, mcurl);
+  if ((multi_handle != nullptr || m_shared_multi) && mcurl != nullptr) {
+    removeHandle();
     curl_easy_cleanup(mcurl);
   }
   mcurl = nullptr;
   // AV_LOGI(LOG_TAG, "RedCurl %p %s end\n", this, __FUNCTION__);
   return true;
 }
+
+void RedCurl::addHandle() {
+  if (m_shared_multi) {
+    REDCurlMulti::getinstance()->add_handle(mcurl);
+  } else {
+    curl_multi_add_handle(multi_handle, mcurl);
+  }
+}
+
+void RedCurl::removeHandle() {
+  if (m_shared_multi) {
+    REDCurlMulti::getinstance()->remove_handle(mcurl);
+  } else {
+    curl_multi_remove_handle(multi_handle, mcurl);
+  }
+}
+
+int RedCurl::performMulti(int timeout_ms) {
+  int still_running = 0;
+  if (m_shared_multi) {
+    m_shared_msg.msg = CURLMSG_NONE;
+    still_running =
+        REDCurlMulti::getinstance()->wait(mcurl, timeout_ms, &m_shared_msg);
+    m_shared_msg_read = m_shared_msg.msg != CURLMSG_DONE;
+    return still_running;
+  }
+  curl_multi_perform(multi_handle, &still_running);
+  int numfds;
+  curl_multi_wait(multi_handle, NULL, 0, timeout_ms, &numfds);
+  return still_running;
+}
+
+CURLMsg *RedCurl::readMessage(int *msgs) {
+  if (!m_shared_multi)
+    return curl_multi_info_read(multi_handle, msgs);
+  *msgs = 0;
+  if (m_shared_msg_read)
+    return nullptr;
+  m_shared_msg_read = true;
+  return &m_shared_msg;
+}
 void RedCurl::readdns(RedDownLoadPara *downpara) {
   mdownpara = downpara;
   max_retry = 1; // read dns no need for retry
@@ -369,6 +421,10 @@ bool RedCurl::initCurl() {
     AV_LOGI(LOG_TAG, "RedCurl %p %s tcp_buffer:%d bytes\n", this, __FUNCTION__,
             opt.tcp_buffer);
   }
+  if (m_happy_eyeballs) {
+    curl_easy_setopt(mcurl, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS,
+                     static_cast<long>(HAPPY_EYEBALLS_ATTEMPT_DELAY_MS));
+  }
   if (m_callback_dns) {
     curl_easy_setopt(mcurl, CURLOPT_OPENSOCKETFUNCTION, opensocket_callback);
     curl_easy_setopt(mcurl, CURLOPT_OPENSOCKETDATA, this);
@@ -441,7 +497,8 @@ void RedCurl::updateCurl() {
     }
   }
   m_starttime = CurrentTimeUs();
-  curl_multi_remove_handle(multi_handle, mcurl);
+  m_sample_starttime = 0;
+  removeHandle();
   mserial = static_cast<int>(mdownpara->serial);
   std::string range("");
 
@@ -483,6 +540,15 @@ void RedCurl::updateCurl() {
     mhostname = hostname;
     string ipaddr = REDDnsCache::getinstance()->GetIpAddr(mhostname);
     mcuripaddr = ipaddr;
+    if (m_happy_eyeballs) {
+      // curl races the candidates itself, in the order they come in
+      vector<string> candidates = REDDnsCache::getinstance()->GetIpCandidates(
+          mhostname, HAPPY_EYEBALLS_MAX_CANDIDATES);
+      if (!candidates.empty()) {
+        ipaddr = ResolveAddrList(candidates);
+        mcuripaddr = candidates[0];
+      }
+    }
     if (!ipaddr.empty()) {
       mdownloadStatus->errorcode = 0;
       hostinfo += ipaddr;
@@ -497,7 +563,7 @@ void RedCurl::updateCurl() {
             hostinfo.c_str(), ipaddr.c_str());
   }
 
-  curl_multi_add_handle(multi_handle, mcurl);
+  addHandle();
   if (mfilelength > 0)
     mdownpara->filesize = mfilelength;
 
@@ -565,11 +631,8 @@ void RedCurl::tcpCallback(int errcode) {
 }
 
 bool RedCurl::PerformCurl(int &curlres) {
-  int still_running = 0;
-  curl_multi_perform(multi_handle, &still_running);
-  int numfds;
   int err = 0;
-  curl_multi_wait(multi_handle, NULL, 0, 100, &numfds);
+  int still_running = performMulti(100);
   if (bpause.load() && m_pause_timeout.load()) {
     {
       std::unique_lock<std::mutex> locker(m_mutexCurl);
@@ -603,7 +666,7 @@ bool RedCurl::PerformCurl(int &curlres) {
     CURLcode CURLResult = CURLE_OK;
     CURLMsg *msg;
     double downloadsize = 0;
-    while ((msg = curl_multi_info_read(multi_handle, &msgs))) {
+    while ((msg = readMessage(&msgs))) {
       if (msg->msg == CURLMSG_DONE) {
         if ((msg->data.result == CURLE_OK) || mdownpara->preload_finished) {
           curl_easy_getinfo(msg->easy_handle, CURLINFO_SIZE_DOWNLOAD,
@@ -670,7 +733,7 @@ bool RedCurl::PerformCurl(int &curlres) {
               curlres = ERROR_TCP_CONNECT_TIMEOUT;
             }
             reportNetworkQuality();
-            curl_multi_remove_handle(multi_handle, mcurl);
+            removeHandle();
             removeShareHandle();
             goto failed;
           } else if (msg->data.result == CURLE_COULDNT_RESOLVE_HOST) {
@@ -678,14 +741,14 @@ bool RedCurl::PerformCurl(int &curlres) {
             dnsCallback(nullptr, DnsStatus::Fail);
             curlres = ERROR_DNS_PARSE_FAIL;
             reportNetworkQuality();
-            curl_multi_remove_handle(multi_handle, mcurl);
+            removeHandle();
             removeShareHandle();
             goto failed;
           } else if (httperr != 0) {
             AV_LOGI(LOG_TAG, "RedCurl %p %s, result http error %" PRId64 "\n", this,
                     __FUNCTION__, httpCode);
             reportNetworkQuality();
-            curl_multi_remove_handle(multi_handle, mcurl);
+            removeHandle();
             removeShareHandle();
             curlres = httperr;
             goto failed;
@@ -717,13 +780,13 @@ bool RedCurl::PerformCurl(int &curlres) {
                     this, __FUNCTION__, mdownpara, range.c_str(),
                     mdownpara->downloadsize, mdownpara->range_end);
           }
-          curl_multi_remove_handle(multi_handle, mcurl);
+          removeHandle();
           curl_easy_setopt(mcurl, CURLOPT_RANGE, range.c_str());
           if (mretrycount == (max_retry / 2)) {
             removeShareHandle();
           }
           usleep(100000);
-          curl_multi_add_handle(multi_handle, mcurl);
+          addHandle();
           // should add time to block
           return true;
         }
@@ -835,8 +898,38 @@ int RedCurl::rundownload(RedDownLoadPara *downpara) {
   return err;
 }
 
+void RedCurl::sampleSpeed(size_t bytes, int64_t blocked_us) {
+  if (!mdownpara || !mdownpara->mdatacb || !mdownpara->mopt ||
+      mdownpara->mopt->PreDownLoadSize > 0) {
+    return; // preload reports once its transfer is done
+  }
+  int64_t now = CurrentTimeUs();
+  if (m_sample_starttime == 0) {
+    // the first bytes carry the connect and the first byte latency
+    m_sample_starttime = now;
+    m_sample_blocked = 0;
+    m_sample_bytes = 0;
+    return;
+  }
+  m_sample_blocked += blocked_us;
+  m_sample_bytes += bytes;
+  int64_t duration = now - m_sample_starttime - m_sample_blocked;
+  if (m_sample_bytes < SPEED_SAMPLE_BYTES ||
+      now - m_sample_starttime < SPEED_SAMPLE_MIN_US || duration <= 0) {
+    return;
+  }
+  int64_t downloadspeed = m_sample_bytes * 1000000 * 8 / duration;
+  mdownpara->mdatacb->DownloadCallBack(RED_SPEED_CALL_BACK, nullptr, nullptr,
+                                       m_sample_bytes, downloadspeed);
+  m_sample_starttime = now;
+  m_sample_blocked = 0;
+  m_sample_bytes = 0;
+}
+
 size_t RedCurl::writefunc(uint8_t *buffer, size_t size, size_t nmemb,
                           void *userdata) {
+  RED_TRACE_SCOPE(RED_TRACE_DOWNLOAD, "curl_write", 0);
+  RED_TRACE_COUNTER(RED_TRACE_DOWNLOAD, "download_bytes", 0, size * nmemb);
   if (userdata == nullptr) {
     AV_LOGW(LOG_TAG, "%s, invalid userdata\n", __FUNCTION__);
     return size * nmemb - 1;
@@ -864,9 +957,11 @@ size_t RedCurl::writefunc(uint8_t *buffer, size_t size, size_t nmemb,
       thiz->mdownloadStatus->httpcode = static_cast<int>(httpCode);
     }
     thiz->mdownloadStatus->downloadsize += (size * nmemb);
+    int64_t write_start = CurrentTimeUs();
     size_t ret = thiz->mdownpara->mdatacb->WriteData(
         buffer, size * nmemb, reinterpret_cast<void *>(thiz->mdownpara),
         thiz->mserial, 0);
+    thiz->sampleSpeed(size * nmemb, CurrentTimeUs() - write_start);
     if (thiz != nullptr && thiz->bpause.load()) {
       AV_LOGW(LOG_TAG, "RedCurl %p %s, abort\n", thiz, __FUNCTION__);
       return size * nmemb - 1;
@@ -994,7 +1089,7 @@ int RedCurl::getheadinfo() {
   curl_easy_setopt(mcurl, CURLOPT_NOBODY, 1L);
   // curl_easy_setopt(mcurl, CURLOPT_CUSTOMREQUEST, "GET");
   // curl_easy_setopt(mcurl, CURLOPT_RANGE, "0-");
-  curl_multi_add_handle(multi_handle, mcurl);
+  addHandle();
   if (mdownpara->mopt != nullptr && mdownpara->mdatacb != nullptr) {
     mdownpara->mdatacb->DownloadCallBack(RED_EVENT_WILL_HTTP_OPEN, nullptr,
                                          nullptr, 0, 0);
@@ -1005,16 +1100,13 @@ int RedCurl::getheadinfo() {
   int64_t httpCode = 0;
   int retry_count = 0;
   while (!bpause.load()) {
-    int still_running = 0;
     // CURLMcode code    = CURLM_OK;
-    curl_multi_perform(multi_handle, &still_running);
-    int numfds;
-    curl_multi_wait(multi_handle, NULL, 0, 100, &numfds);
+    int still_running = performMulti(100);
     if (!still_running) {
       int msgs;
       CURLMsg *msg;
 
-      while ((msg = curl_multi_info_read(multi_handle, &msgs))) {
+      while ((msg = readMessage(&msgs))) {
         if (msg->msg == CURLMSG_DONE) {
           if (msg->data.result == CURLE_OK ||
               msg->data.result == CURLE_WRITE_ERROR) {
@@ -1052,8 +1144,8 @@ int RedCurl::getheadinfo() {
                msg->data.result == CURLE_COULDNT_RESOLVE_PROXY ||
                msg->data.result == CURLE_COULDNT_RESOLVE_HOST)) {
             ++retry_count;
-            curl_multi_remove_handle(multi_handle, mcurl);
-            curl_multi_add_handle(multi_handle, mcurl);
+            removeHandle();
+            addHandle();
           } else if (msg->data.result != CURLE_OK) {
             AV_LOGW(LOG_TAG, "RedCurl %p unkonwn error %d, reutrn\n", this,
                     msg->data.result);
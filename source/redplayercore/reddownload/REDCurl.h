@@ -54,6 +54,11 @@ private:
   bool initCurl();
   bool PerformCurl(int &curlres);
   bool destroyCurl();
+  /*route multi calls to the own or the shared multi handle*/
+  void addHandle();
+  void removeHandle();
+  int performMulti(int timeout_ms);
+  CURLMsg *readMessage(int *msgs);
   void updateCurl();
   void removeShareHandle();
   int getheadinfo();
@@ -67,6 +72,9 @@ private:
   bool mBDummy = false;
   int max_retry{0};
   CURLM *multi_handle = nullptr;
+  bool m_shared_multi{false};
+  CURLMsg m_shared_msg{};
+  bool m_shared_msg_read{true};
   CURL *mcurl = nullptr;
   struct curl_slist *mheaderList{nullptr};
   struct curl_slist *mhost{nullptr};
@@ -84,6 +92,10 @@ private:
   int m_range_size{0};
   std::atomic_int64_t m_starttime{0};
   std::atomic_int64_t m_endtime{0};
+  // playback speed samples, time blocked in the cache is left out
+  int64_t m_sample_starttime{0};
+  int64_t m_sample_blocked{0};
+  int64_t m_sample_bytes{0};
   char m_curldebuginfo[MAX_CURL_DEBUG_LEN]{0};
   std::mutex m_mutex_infinite_range;
   std::condition_variable m_con_infinite_range;
@@ -91,9 +103,11 @@ private:
   bool m_continue_infinite_range{false};
   bool m_is_report_http_open{false};
   bool m_callback_dns{false};
+  bool m_happy_eyeballs{false};
   DnsStatus m_dns_status{DnsStatus::Waiting};
   CURLcode m_curlcode{CURLE_OK};
   std::atomic_bool m_is_read_dns{false};
 
+  void sampleSpeed(size_t bytes, int64_t blocked_us);
   int filldata_by_range_size(RedDownLoadPara *downpara, size_t size);
 };
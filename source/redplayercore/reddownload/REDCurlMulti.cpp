@@ -0,0 +1,274 @@
+#include "REDCurlMulti.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "RedLog.h"
+#define LOG_TAG "RedCurlMulti"
+#define CURL_MULTI_IDLE_MS 1000
+
+static std::once_flag RedCurlMultiOnceFlag;
+static REDCurlMulti *gcurlmulti = nullptr;
+
+REDCurlMulti *REDCurlMulti::getinstance() {
+  std::call_once(RedCurlMultiOnceFlag,
+                 [&] { gcurlmulti = new (std::nothrow) REDCurlMulti(); });
+  return gcurlmulti;
+}
+
+REDCurlMulti::REDCurlMulti() {
+  mmulti = curl_multi_init();
+  curl_multi_setopt(mmulti, CURLMOPT_SOCKETFUNCTION, &REDCurlMulti::socket_cb);
+  curl_multi_setopt(mmulti, CURLMOPT_SOCKETDATA, this);
+  curl_multi_setopt(mmulti, CURLMOPT_TIMERFUNCTION, &REDCurlMulti::timer_cb);
+  curl_multi_setopt(mmulti, CURLMOPT_TIMERDATA, this);
+  if (pipe(mwakefd) == 0) {
+    for (int fd : mwakefd) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+  } else {
+    // the loop still runs, a new handle waits for the idle poll to time out
+    AV_LOGE(LOG_TAG, "%s, pipe failed, errno %d\n", __FUNCTION__, errno);
+    mwakefd[0] = mwakefd[1] = -1;
+  }
+  mthread = new std::thread(
+      std::bind(&REDCurlMulti::run_loop, this, "REDCurlMultiThread"));
+}
+
+REDCurlMulti::~REDCurlMulti() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    mabort = true;
+  }
+  wakeup();
+  if (mthread != nullptr && mthread->joinable()) {
+    mthread->join();
+    delete mthread;
+    mthread = nullptr;
+  }
+  curl_multi_cleanup(mmulti);
+  for (int fd : mwakefd) {
+    if (fd >= 0)
+      close(fd);
+  }
+}
+
+void REDCurlMulti::wakeup() {
+  if (mwakefd[1] < 0)
+    return;
+  char c = 0;
+  // a full pipe already wakes the loop
+  ssize_t ret = write(mwakefd[1], &c, 1);
+  (void)ret;
+}
+
+void REDCurlMulti::add_handle(CURL *easy) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto transfer = std::make_shared<Transfer>();
+  mtransfers[easy] = transfer;
+  if (mabort) {
+    // nothing drives the handle any more, fail it at the first wait
+    transfer->done = true;
+    transfer->result = CURLE_ABORTED_BY_CALLBACK;
+    return;
+  }
+  mpending.emplace_back(easy, true);
+  ++mqueued;
+  wakeup();
+}
+
+void REDCurlMulti::remove_handle(CURL *easy) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (mtransfers.erase(easy) == 0)
+    return;
+  mpending.emplace_back(easy, false);
+  uint64_t serial = ++mqueued;
+  if (std::this_thread::get_id() == mloopid || mstopped) {
+    // called back from inside the loop, nothing else touches the multi handle
+    apply_pending();
+    return;
+  }
+  wakeup();
+  m_cond.wait(lock, [&] { return mapplied >= serial || mstopped; });
+  if (mapplied < serial)
+    apply_pending();
+}
+
+int REDCurlMulti::wait(CURL *easy, int timeout_ms, CURLMsg *msg) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  auto iter = mtransfers.find(easy);
+  if (iter == mtransfers.end())
+    return 0;
+  std::shared_ptr<Transfer> transfer = iter->second;
+  if (!transfer->done) {
+    // like curl_multi_wait, return on activity of this transfer's socket so
+    // that synchronous readers pick up data as soon as it is written
+    uint64_t activity = transfer->activity;
+    transfer->cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] {
+      return transfer->done || transfer->activity != activity;
+    });
+    if (!transfer->done)
+      return 1;
+  }
+  if (!transfer->reported) {
+    transfer->reported = true;
+    msg->msg = CURLMSG_DONE;
+    msg->easy_handle = easy;
+    msg->data.result = transfer->result;
+  }
+  return 0;
+}
+
+void REDCurlMulti::apply_pending() {
+  for (auto &op : mpending) {
+    if (op.second) {
+      curl_multi_add_handle(mmulti, op.first);
+    } else {
+      curl_multi_remove_handle(mmulti, op.first);
+    }
+  }
+  mpending.clear();
+  mapplied = mqueued;
+  m_cond.notify_all();
+}
+
+int REDCurlMulti::socket_cb(CURL *easy, curl_socket_t fd, int what,
+                            void *userp, void *socketp) {
+  REDCurlMulti *thiz = reinterpret_cast<REDCurlMulti *>(userp);
+  if (what == CURL_POLL_REMOVE) {
+    thiz->msockets.erase(fd);
+  } else {
+    Socket &socket = thiz->msockets[fd];
+    socket.what = what;
+    socket.easy = easy;
+  }
+  return 0;
+}
+
+int REDCurlMulti::timer_cb(CURLM *multi, long timeout_ms, void *userp) {
+  REDCurlMulti *thiz = reinterpret_cast<REDCurlMulti *>(userp);
+  thiz->mtimer = timeout_ms >= 0;
+  if (thiz->mtimer) {
+    thiz->mdeadline = std::chrono::steady_clock::now() +
+                      std::chrono::milliseconds(timeout_ms);
+  }
+  return 0;
+}
+
+void REDCurlMulti::socket_action(curl_socket_t fd, int flags) {
+  int running = 0;
+  curl_multi_socket_action(mmulti, fd, flags, &running);
+}
+
+void REDCurlMulti::run_loop(std::string thread_name) {
+#ifdef __APPLE__
+  pthread_setname_np(thread_name.c_str());
+#elif __ANDROID__
+  pthread_setname_np(pthread_self(), thread_name.c_str());
+#elif __HARMONY__
+  pthread_setname_np(pthread_self(), thread_name.c_str());
+#elif __HEADLESS__
+  // the kernel keeps 15 characters of a thread name
+  pthread_setname_np(pthread_self(), thread_name.substr(0, 15).c_str());
+#endif
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    mloopid = std::this_thread::get_id();
+  }
+  AV_LOGI(LOG_TAG, "%s start\n", __FUNCTION__);
+  std::vector<struct pollfd> fds;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!mpending.empty())
+        apply_pending();
+      if (mabort)
+        break;
+    }
+    fds.clear();
+    fds.push_back({mwakefd[0], POLLIN, 0});
+    for (auto &socket : msockets) {
+      short events = 0;
+      if (socket.second.what & CURL_POLL_IN)
+        events |= POLLIN;
+      if (socket.second.what & CURL_POLL_OUT)
+        events |= POLLOUT;
+      fds.push_back({socket.first, events, 0});
+    }
+    int timeout_ms = CURL_MULTI_IDLE_MS;
+    if (mtimer) {
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      mdeadline - std::chrono::steady_clock::now())
+                      .count();
+      timeout_ms = static_cast<int>(
+          std::max<int64_t>(0, std::min<int64_t>(left, timeout_ms)));
+    }
+    int ready = poll(fds.data(), fds.size(), timeout_ms);
+    if (ready < 0 && errno != EINTR)
+      AV_LOGE(LOG_TAG, "%s, poll failed, errno %d\n", __FUNCTION__, errno);
+
+    // transfers call back into RedCurl from here, m_mutex must not be held
+    mactive.clear();
+    if (ready > 0 && (fds[0].revents & POLLIN)) {
+      char buf[64];
+      while (read(mwakefd[0], buf, sizeof(buf)) > 0) {
+      }
+    }
+    for (size_t i = 1; ready > 0 && i < fds.size(); i++) {
+      if (fds[i].revents == 0)
+        continue;
+      int flags = 0;
+      if (fds[i].revents & POLLIN)
+        flags |= CURL_CSELECT_IN;
+      if (fds[i].revents & POLLOUT)
+        flags |= CURL_CSELECT_OUT;
+      if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+        flags |= CURL_CSELECT_ERR;
+      // an earlier action may have closed it
+      auto iter = msockets.find(fds[i].fd);
+      if (iter == msockets.end())
+        continue;
+      mactive.push_back(iter->second.easy);
+      socket_action(fds[i].fd, flags);
+    }
+    if (mtimer && std::chrono::steady_clock::now() >= mdeadline) {
+      mtimer = false;
+      socket_action(CURL_SOCKET_TIMEOUT, 0);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int msgs = 0;
+    CURLMsg *msg = nullptr;
+    while ((msg = curl_multi_info_read(mmulti, &msgs)) != nullptr) {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+      auto iter = mtransfers.find(msg->easy_handle);
+      if (iter == mtransfers.end())
+        continue;
+      iter->second->done = true;
+      iter->second->result = msg->data.result;
+      iter->second->cond.notify_one();
+    }
+    // wake only the transfers whose sockets saw traffic
+    for (CURL *easy : mactive) {
+      auto iter = mtransfers.find(easy);
+      if (iter == mtransfers.end())
+        continue;
+      ++iter->second->activity;
+      iter->second->cond.notify_one();
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    mstopped = true;
+    m_cond.notify_all();
+  }
+  AV_LOGI(LOG_TAG, "%s exit\n", __FUNCTION__);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "curl/curl.h"
+
+/*one multi handle shared by all RedCurl transfers when CURL_SHARED_MULTI_KEY
+ * is set, driven by a single thread with curl_multi_socket_action so
+ * connections are reused across transfers*/
+class REDCurlMulti {
+public:
+  static REDCurlMulti *getinstance();
+  ~REDCurlMulti();
+
+  /*queue the easy handle on the shared multi handle*/
+  void add_handle(CURL *easy);
+  /*detach the easy handle, returns once the loop no longer drives it*/
+  void remove_handle(CURL *easy);
+  /*wait up to timeout_ms for the transfer, returns 1 while it is running;
+   * its CURLMSG_DONE is handed out once through msg, like info_read*/
+  int wait(CURL *easy, int timeout_ms, CURLMsg *msg);
+
+private:
+  REDCurlMulti();
+  void run_loop(std::string thread_name);
+  void apply_pending();
+  void wakeup();
+  void socket_action(curl_socket_t fd, int flags);
+  static int socket_cb(CURL *easy, curl_socket_t fd, int what, void *userp,
+                       void *socketp);
+  static int timer_cb(CURLM *multi, long timeout_ms, void *userp);
+
+  struct Transfer {
+    bool done{false};
+    bool reported{false};
+    CURLcode result{CURLE_OK};
+    uint64_t activity{0};
+    std::condition_variable cond; // only the thread of this transfer waits
+  };
+
+  struct Socket {
+    int what{CURL_POLL_NONE};
+    CURL *easy{nullptr};
+  };
+
+  CURLM *mmulti{nullptr};
+  std::thread *mthread{nullptr};
+  std::thread::id mloopid;
+  int mwakefd[2]{-1, -1};
+  std::mutex m_mutex;
+  std::condition_variable m_cond; // pending ops applied or the loop stopped
+  bool mabort{false};
+  bool mstopped{false}; // the loop has exited, callers apply their own ops
+  std::unordered_map<CURL *, std::shared_ptr<Transfer>> mtransfers;
+  std::vector<std::pair<CURL *, bool>> mpending; // easy, add or remove
+  uint64_t mqueued{0};
+  uint64_t mapplied{0};
+  // owned by the loop thread, only touched from inside the multi calls
+  std::unordered_map<curl_socket_t, Socket> msockets;
+  bool mtimer{false};
+  std::chrono::steady_clock::time_point mdeadline;
+  std::vector<CURL *> mactive; // transfers with socket activity this round
+};
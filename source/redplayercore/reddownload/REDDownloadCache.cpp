@@ -3,6 +3,7 @@
 #include "RedBase.h"
 #include "RedDownloadConfig.h"
 #include "RedLog.h"
+#include "RedTrace.h"
 #include "dnscache/REDDnsCache.h"
 #include "time.h"
 #include <inttypes.h>
@@ -12,6 +13,7 @@
 
 #define MAX_SIZE_PER_READ 50 * 1024
 #define MAX_MBUF_SIZE 1024 * 1024 * 10
+#define PRELOAD_FALLBACK_SIZE (512 * 1024) // duration mode on no mp4
 using namespace std;
 
 int64_t RedDownloadCache::uid = 0;
@@ -52,6 +54,14 @@ int64_t RedDownloadCache::GetUid() { return muid; }
 RedDownloadCache::~RedDownloadCache() {
   Close();
   mtask = nullptr;
+  if (mprefetcher != nullptr) {
+    delete mprefetcher;
+    mprefetcher = nullptr;
+  }
+  if (mmp4index != nullptr) {
+    delete mmp4index;
+    mmp4index = nullptr;
+  }
   if (mbuf != nullptr)
     free(mbuf);
   mbuf = nullptr;
@@ -85,6 +95,8 @@ void RedDownloadCache::Close() {
     babort = true;
   }
   m_cachecond.notify_one();
+  if (mprefetcher != nullptr)
+    mprefetcher->stop();
   if (bload.load())
     loadtofile();
   if (mfc != nullptr && mbuf != nullptr) {
@@ -106,6 +118,8 @@ void RedDownloadCache::Stop() {
     babort = true;
     mfilesize = -1;
     m_cachecond.notify_one();
+    if (mprefetcher != nullptr)
+      mprefetcher->stop();
   }
   if (mtask != nullptr)
     mtask->stop();
@@ -201,6 +215,9 @@ size_t RedDownloadCache::loadfromfile(int64_t offset, bool needdownload) {
   if (mbuf) {
     memset(mbuf, 0, mrangesize + mbuf_extra_size);
   }
+  if (needdownload) {
+    PrefetchShards();
+  }
   if (moption != nullptr && moption->loadfile) {
     len = min(mfc->get_cache_file(muri, moption->cache_file_dir, mbuf,
                                   mloadfilepos, mrangesize),
@@ -238,6 +255,25 @@ size_t RedDownloadCache::loadfromfile(int64_t offset, bool needdownload) {
   return len;
 }
 
+void RedDownloadCache::PrefetchShards() {
+  if (mprefetcher == nullptr) {
+    int maxconn =
+        RedDownloadConfig::getinstance()->get_config_value(PARALLEL_SHARD_KEY);
+    // the file cache holds the fetched shards, so it has to be on; encrypted
+    // ranges are decrypted in WriteData and cannot be fetched around it
+    if (maxconn <= 0 || moption == nullptr || !moption->loadfile ||
+        !moption->readasync || moption->islive || mpreloadsize > 0 ||
+        moption->DownLoadType == DOWNLOADADS ||
+        mtokenInfo.cipherType != CipherType::NONE || mfilesize <= 0 ||
+        mrangesize <= 0)
+      return;
+    mprefetcher = new REDShardPrefetcher(muri, *moption, mrangesize, maxconn);
+    AV_LOGI(LOG_TAG, "%p %s, up to %d connections\n", this, __FUNCTION__,
+            maxconn);
+  }
+  mprefetcher->prefetch(mrealurl, mloadfilepos + mrangesize, mfilesize);
+}
+
 bool RedDownloadCache::CreateTask() {
   mthreadpool = REDThreadPool::getinstance();
   // mtask       = mthreadpool->get_task(murl);
@@ -257,7 +293,7 @@ bool RedDownloadCache::CreateTask() {
   mdownloadpara->mdownloadcb = mdownloadcb;
   mdownloadpara->range_start = mloadfilepos + mbufwpos;
   if (mpreloadsize > 0) {
-    mdownloadpara->range_end = mloadfilepos + mpreloadsize - 1;
+    mdownloadpara->range_end = mpreloadsize - 1;
   } else if (moption->DownLoadType == DOWNLOADADS) {
     mdownloadpara->range_end = 0;
   } else {
@@ -298,7 +334,7 @@ bool RedDownloadCache::updateTask() {
     }
     mdownloadpara->range_start = mloadfilepos + mbufwpos;
     if (mpreloadsize > 0) {
-      mdownloadpara->range_end = mloadfilepos + mpreloadsize - 1;
+      mdownloadpara->range_end = mpreloadsize - 1;
     } else if (moption->DownLoadType == DOWNLOADADS) {
       mdownloadpara->range_end = 0;
     } else {
@@ -783,11 +819,15 @@ bool RedDownloadCache::setOpt(DownLoadOpt *opt) {
     moption->readasync = opt->readasync;
     moption->loadfile = opt->loadfile;
     moption->PreDownLoadSize = opt->PreDownLoadSize;
+    moption->PreDownLoadDurationMs = opt->PreDownLoadDurationMs;
     delete opt;
     opt = nullptr;
   } else {
     moption = opt;
   }
+  if (moption->PreDownLoadDurationMs > 0 && moption->PreDownLoadSize <= 0) {
+    moption->PreDownLoadSize = PRELOAD_FALLBACK_SIZE;
+  }
   if (moption->cache_file_dir.empty())
     return false;
   if (moption->cache_file_dir.back() != '/') {
@@ -810,14 +850,38 @@ bool RedDownloadCache::Compareurl(const std::string &url) {
 }
 
 int RedDownloadCache::PreLoad(int64_t nbytes) {
-  if ((nbytes > mdownloadsize ||
+  // the cached total over-counts the prefix when shards are not contiguous,
+  // resume from the first uncached byte instead
+  int64_t preloadpos = mdownloadsize;
+  if (mfc != nullptr && moption->loadfile && mdownloadsize > 0) {
+    preloadpos = min(mdownloadsize,
+                     mfc->get_next_hole(muri, moption->cache_file_dir, 0));
+  }
+  if (mmp4index == nullptr && moption->PreDownLoadDurationMs > 0 &&
+      mfc != nullptr && moption->loadfile && !moption->islive &&
+      moption->DownLoadType != DOWNLOADADS) {
+    mmp4index = new REDMp4Index(moption->PreDownLoadDurationMs);
+  }
+  if (mmp4index != nullptr) {
+    // the first range of the moov and the samples, the rest follows in
+    // PreloadNextRange as each one completes
+    REDMp4Index::Range range{0, 0};
+    if (PlanPreloadRange(range)) {
+      preloadpos = range.first;
+      nbytes = range.second;
+    } else {
+      nbytes = 0;
+    }
+  }
+  if ((nbytes > preloadpos ||
        (moption->DownLoadType == DOWNLOADADS && nbytes <= 0)) &&
-      (mfilesize <= 0 || mfilesize > mdownloadsize)) {
+      (mfilesize <= 0 || mfilesize > preloadpos)) {
     AV_LOGW(LOG_TAG,
-            "%p %s, size %" PRId64 ", download size %" PRId64 ", need load\n",
-            this, __FUNCTION__, nbytes, mdownloadsize);
+            "%p %s, size %" PRId64 ", download size %" PRId64
+            ", cached prefix %" PRId64 ", need load\n",
+            this, __FUNCTION__, nbytes, mdownloadsize, preloadpos);
     mpreloadsize = nbytes;
-    loadfromfile(mdownloadsize);
+    loadfromfile(preloadpos);
     neednotify = true;
   } else {
     UrlParser up(murl);
@@ -841,6 +905,59 @@ int RedDownloadCache::PreLoad(int64_t nbytes) {
   return 0;
 }
 
+bool RedDownloadCache::PlanPreloadRange(REDMp4Index::Range &range) {
+  std::vector<uint8_t> shard;
+  auto read = [this, &shard](int64_t offset, uint8_t *buf, int size) {
+    // the file cache hands out whole shards
+    int done = 0;
+    while (done < size) {
+      int64_t pos = offset + done;
+      int64_t shardpos = pos / mrangesize * mrangesize;
+      if (shard.empty())
+        shard.resize(mrangesize + mbuf_extra_size);
+      int len = mfc->get_cache_file(muri, moption->cache_file_dir, shard.data(),
+                                    shardpos, mrangesize);
+      if (len <= pos - shardpos)
+        break;
+      int n = static_cast<int>(
+          min<int64_t>(len - (pos - shardpos), size - done));
+      memcpy(buf + done, shard.data() + (pos - shardpos), n);
+      done += n;
+    }
+    return done;
+  };
+  auto hole = [this](int64_t offset) {
+    return mfc->get_next_hole(muri, moption->cache_file_dir, offset);
+  };
+  if (!mmp4index->nextrange(read, hole, mfilesize, moption->PreDownLoadSize,
+                            range))
+    return false;
+  if (range == mpreloadrange) {
+    AV_LOGW(LOG_TAG, "%p %s, %" PRId64 "-%" PRId64 " was not cached, stop\n",
+            this, __FUNCTION__, range.first, range.second);
+    return false;
+  }
+  AV_LOGI(LOG_TAG, "%p %s, %s %" PRId64 "-%" PRId64 "\n", this, __FUNCTION__,
+          mmp4index->ready()         ? "samples"
+          : mmp4index->unsupported() ? "bytes"
+                                     : "boxes",
+          range.first, range.second);
+  mpreloadrange = range;
+  return true;
+}
+
+bool RedDownloadCache::PreloadNextRange() {
+  std::unique_lock<std::recursive_mutex> lock(m_mutex);
+  REDMp4Index::Range range{0, 0};
+  if (babort || bpause || mmp4index == nullptr || mdownloadpara == nullptr ||
+      !PlanPreloadRange(range))
+    return false;
+  mpreloadsize = range.second;
+  mdownloadpara->preload_finished = false;
+  loadfromfile(range.first);
+  return true;
+}
+
 void RedDownloadCache::ReadDns() {
   RedDownLoadPara *downpara = new RedDownLoadPara;
   if (m_datacallback_crash)
@@ -864,6 +981,7 @@ void RedDownloadCache::ReadDns() {
 }
 
 int RedDownloadCache::Read(uint8_t *buf, size_t nbyte) {
+  RED_TRACE_SCOPE(RED_TRACE_DOWNLOAD, "cache_read", 0);
   int leftsize = static_cast<int>(nbyte);
   int ret;
   if (mfilesize > 0)
@@ -882,8 +1000,6 @@ int RedDownloadCache::Read(uint8_t *buf, size_t nbyte) {
         (moption->readasync || (mpreloadsize > 0 && mdownloadpara != nullptr &&
                                 !mdownloadpara->preload_finished))) {
       ret = ReadAsync(buf, leftsize);
-      if (ret == 0)
-        usleep(10000);
     } else {
       ret = Readsync(buf, leftsize);
     }
@@ -994,6 +1110,19 @@ int RedDownloadCache::ReadAsync(uint8_t *buf, size_t nbyte) {
   int readsize = 0;
   int retry_count =
       RedDownloadConfig::getinstance()->get_config_value(RETRY_COUNT);
+  if (!bload.load() && mprefetcher != nullptr) {
+    // the shard may be on its way through a prefetch connection, fetching it
+    // again would race that transfer, so wait for it to land or fail
+    int64_t shardpos = mlogicalpos / mrangesize * mrangesize;
+    bool inflight = true;
+    while (inflight) {
+      lock.unlock();
+      inflight = !mprefetcher->waitshard(shardpos, SHARD_PREFETCH_POLL_MS);
+      lock.lock();
+      if (babort || (inflight && InterruptCallBack()))
+        return 0;
+    }
+  }
   if (!bload.load()) {
     if (loadfromfile(mlogicalpos) < 0)
       return ERROR(EIO);
@@ -1003,7 +1132,11 @@ int RedDownloadCache::ReadAsync(uint8_t *buf, size_t nbyte) {
     int lastwpos = mbufwpos;
     while (mbufwpos <= mbufrpos) {
       int64_t currentime = CurrentTimeUs();
-      m_cachecond.wait_for(lock, std::chrono::milliseconds(10));
+      // WriteData notifies on every chunk, the timeout only paces the
+      // interrupt callback which cannot signal us
+      m_cachecond.wait_for(lock, std::chrono::milliseconds(10), [this] {
+        return mbufwpos > mbufrpos || merrcode != 0 || babort;
+      });
       if (babort || InterruptCallBack()) {
         return 0;
       } else if (merrcode == EOF) {
@@ -1042,9 +1175,12 @@ int RedDownloadCache::ReadAsync(uint8_t *buf, size_t nbyte) {
     mbufrpos += readsize;
     mlogicalpos += readsize;
     return readsize;
-  } else {
-    loadtofile();
   }
+  // crossed the shard, persist it and let Read() come back for the next one
+  // right away
+  loadtofile();
+  if (bload.load())
+    m_cachecond.wait_for(lock, std::chrono::milliseconds(10));
   return 0;
 }
 
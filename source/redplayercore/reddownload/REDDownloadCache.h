@@ -14,6 +14,8 @@
 #include "REDDownloadTask.h"
 #include "REDDownloaderFactory.h"
 #include "REDFileManager.h"
+#include "REDMp4Index.h"
+#include "REDShardPrefetcher.h"
 #include "REDThreadPool.h"
 #include "REDURLParser.h"
 #include "utility/Cipher.h"
@@ -52,12 +54,17 @@ private:
   void DownloadCallBack(int what, void *arg1, void *arg2, int64_t arg3,
                         int64_t arg4);
   int InterruptCallBack();
+  bool PreloadNextRange() override;
   size_t loadfromfile(int64_t offset, bool needdownload = true);
   size_t loadtofile(bool data_error = false);
   bool CreateTask();
   bool updateTask();
   void updatepara();
   int PreLoad(int64_t nbytes);
+  /*next range of a duration preload, false if all of it is cached*/
+  bool PlanPreloadRange(REDMp4Index::Range &range);
+  /*queue the shards after the loaded one on the prefetcher, if enabled*/
+  void PrefetchShards();
   void SortUrlList();
 
   std::string murl;
@@ -83,6 +90,9 @@ private:
 
   REDThreadPool *mthreadpool = nullptr;
   std::shared_ptr<REDDownLoadTask> mtask;
+  REDShardPrefetcher *mprefetcher{nullptr};
+  REDMp4Index *mmp4index{nullptr}; // set in duration preload mode
+  REDMp4Index::Range mpreloadrange{0, 0};
   DownLoadListen *mdownloadcb = nullptr;
   DownLoadOpt *moption = nullptr;
   RedDownLoadPara *mdownloadpara = nullptr;
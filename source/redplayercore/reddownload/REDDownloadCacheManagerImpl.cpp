@@ -37,20 +37,21 @@ RedDownloadCacheManagerImpl::RedDownloadCacheManagerImpl() {
 }
 
 RedDownloadCacheManagerImpl::~RedDownloadCacheManagerImpl() {
-  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unique_lock<std::shared_mutex> lock(m_mutex);
   if (mveccache.size() > 0)
     mveccache.clear();
   if (mvecprecache.size() > 0)
     mvecprecache.clear();
   if (mvecadscache.size() > 0)
     mvecadscache.clear();
+  mcachebyuid.clear();
 
   REDFileManager::delInstance();
   // AV_LOGW(LOG_TAG, "%s destroy\n", __FUNCTION__);
 }
 
 void RedDownloadCacheManagerImpl::Global_init(DownLoadOpt *opt) {
-  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unique_lock<std::shared_mutex> lock(m_mutex);
   // AV_LOGW(LOG_TAG, "%s, init reddownload \n", __FUNCTION__);
   if (opt != nullptr && !opt->cache_file_dir.empty()) {
     if (!minited) {
@@ -61,6 +62,8 @@ void RedDownloadCacheManagerImpl::Global_init(DownLoadOpt *opt) {
             DNS_TIME_INTERVAL);
         if (timeval > 0)
           REDDnsCache::getinstance()->SetTimescale(timeval * 1000);
+        // the last session's table serves until the first refresh
+        REDDnsCache::getinstance()->Load(opt->cache_file_dir);
         REDDnsCache::getinstance()->run();
       }
       REDThreadPool *redpool = REDThreadPool::getinstance();
@@ -142,7 +145,7 @@ std::string RedDownloadCacheManagerImpl::GetUrlMd5Path(const std::string &url) {
 int64_t RedDownloadCacheManagerImpl::Open(const std::string &url,
                                           DownLoadListen *callback,
                                           DownLoadOpt *opt) {
-  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unique_lock<std::shared_mutex> lock(m_mutex);
   if (url.empty() || (strncmp(url.c_str(), "http", 4) != 0) || !opt) {
     return -1;
   }
@@ -167,6 +170,9 @@ int64_t RedDownloadCacheManagerImpl::Open(const std::string &url,
     AV_LOGW(LOG_TAG, "%s, null reddownload for open\n", __FUNCTION__);
     return ERROR(ENOMEM);
   }
+  // the session is already listed, keep it locked until it is opened so that
+  // lookups never compare against a half set url and Stop or a later open
+  // never closes it midway
   reddownload->setOpt(opt);
   return reddownload->Open(url, callback);
 }
@@ -261,11 +267,13 @@ bool RedDownloadCacheManager::setOpt(const std::string &url, const string &key,
     return true;
 }*/
 void RedDownloadCacheManagerImpl::Stop(const std::string &url, int64_t uid) {
-  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unique_lock<std::shared_mutex> lock(m_mutex);
   if (url.empty()) {
     // stop all precache
     if (RedDownloadConfig::getinstance()->get_config_value(PRELOAD_LRU_KEY) ==
         0) {
+      for (auto &reddownload : mvecprecache)
+        unindexcache(reddownload);
       mvecprecache.clear();
     }
   } else {
@@ -304,13 +312,21 @@ int64_t RedDownloadCacheManagerImpl::Seek(const std::string &url, int64_t uid,
 
 shared_ptr<RedDownloadCache>
 RedDownloadCacheManagerImpl::getcache(const std::string &url, int64_t uid) {
-  std::lock_guard<std::mutex> lock(m_mutex);
+  std::shared_lock<std::shared_mutex> lock(m_mutex);
+  auto entry = mcachebyuid.find(uid);
+  if (entry != mcachebyuid.end() &&
+      (entry->second.url == url || entry->second.cache->Compareurl(url))) {
+    return entry->second.cache;
+  }
   // check cache vector
-  for (auto iter = mveccache.begin(); iter != mveccache.end(); ++iter) {
-    if ((*iter)->Compareurl(url) && (uid == 0 || (*iter)->GetUid() == uid)) {
-      return *iter;
+  if (uid == 0) {
+    for (auto iter = mveccache.begin(); iter != mveccache.end(); ++iter) {
+      if ((*iter)->Compareurl(url)) {
+        return *iter;
+      }
     }
   }
+  // precache is shared by url whatever the uid
   for (auto iter = mvecprecache.begin(); iter != mvecprecache.end(); ++iter) {
     if ((*iter)->Compareurl(url)) {
       return *iter;
@@ -322,10 +338,11 @@ RedDownloadCacheManagerImpl::getcache(const std::string &url, int64_t uid) {
 shared_ptr<RedDownloadCache>
 RedDownloadCacheManagerImpl::movcache(const std::string &url, int64_t uid) {
   shared_ptr<RedDownloadCache> reddownload = nullptr;
-  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unique_lock<std::shared_mutex> lock(m_mutex);
   for (auto iter = mvecprecache.begin(); iter != mvecprecache.end(); ++iter) {
     if ((*iter)->Compareurl(url)) {
       reddownload = *iter;
+      unindexcache(reddownload);
       mvecprecache.erase(iter);
       break;
     }
@@ -334,6 +351,7 @@ RedDownloadCacheManagerImpl::movcache(const std::string &url, int64_t uid) {
   for (auto iter = mveccache.begin(); iter != mveccache.end(); ++iter) {
     if ((*iter)->Compareurl(url) && (*iter)->GetUid() == uid) {
       reddownload = *iter;
+      unindexcache(reddownload);
       mveccache.erase(iter);
       break;
     }
@@ -381,6 +399,8 @@ RedDownloadCacheManagerImpl::addcache(const std::string &url,
   } else if (opt->PreDownLoadSize <= 0) {
     // stop all precache
     REDThreadPool::getinstance()->clear(true);
+    for (auto &precache : mvecprecache)
+      unindexcache(precache);
     for (auto iter = mvecprecache.begin(); iter != mvecprecache.end();) {
       mvecprecache.erase(iter);
       AV_LOGI(LOG_TAG, "%s Close cache of precache\n", __FUNCTION__);
@@ -401,14 +421,17 @@ RedDownloadCacheManagerImpl::addcache(const std::string &url,
     if (mveccache.size() > MAX_CACHE) {
       auto iter = mveccache.begin();
       (*iter)->Close();
+      unindexcache(*iter);
       mveccache.erase(iter);
     }
     mveccache.push_back(reddownload);
+    indexcache(url, reddownload);
   } else {
     for (auto iter = mvecprecache.begin(); iter != mvecprecache.end(); ++iter) {
       if ((*iter)->Compareurl(url)) {
         if (RedDownloadConfig::getinstance()->get_config_value(
                 PRELOAD_LRU_KEY) == 0) {
+          unindexcache(*iter);
           mvecprecache.erase(iter);
           break;
         } else if (RedDownloadConfig::getinstance()->get_config_value(
@@ -438,13 +461,27 @@ RedDownloadCacheManagerImpl::addcache(const std::string &url,
     if (mvecprecache.size() > MAX_CACHE) {
       auto iter = mvecprecache.begin();
       (*iter)->Close();
+      unindexcache(*iter);
       mvecprecache.erase(iter);
     }
     mvecprecache.push_back(reddownload);
+    indexcache(url, reddownload);
   }
   return reddownload;
 }
 
+void RedDownloadCacheManagerImpl::indexcache(
+    const std::string &url, const shared_ptr<RedDownloadCache> &reddownload) {
+  mcachebyuid[reddownload->GetUid()] = {url, reddownload};
+}
+
+void RedDownloadCacheManagerImpl::unindexcache(
+    const shared_ptr<RedDownloadCache> &reddownload) {
+  auto entry = mcachebyuid.find(reddownload->GetUid());
+  if (entry != mcachebyuid.end() && entry->second.cache == reddownload)
+    mcachebyuid.erase(entry);
+}
+
 void RedDownloadCacheManagerImpl::setDownloadCdn(const char *url,
                                                  int download_cdn) {
   // AV_LOGW(LOG_TAG, "%s begin\n", __FUNCTION__);
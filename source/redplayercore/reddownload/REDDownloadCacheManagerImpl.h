@@ -1,5 +1,8 @@
 #pragma once
 
+#include <shared_mutex>
+#include <unordered_map>
+
 #include "REDDownloadCache.h"
 #include "REDDownloadCacheManager.h"
 
@@ -35,11 +38,23 @@ private:
                                         DownLoadOpt *opt);
   shared_ptr<RedDownloadCache> getcache(const std::string &url, int64_t uid);
   shared_ptr<RedDownloadCache> movcache(const std::string &url, int64_t uid);
+  /*keep the uid index in step with mveccache and mvecprecache, called with
+   * m_mutex held exclusively*/
+  void indexcache(const std::string &url,
+                  const shared_ptr<RedDownloadCache> &reddownload);
+  void unindexcache(const shared_ptr<RedDownloadCache> &reddownload);
   vector<std::shared_ptr<RedDownloadCache>> mveccache;
   vector<std::shared_ptr<RedDownloadCache>> mvecprecache;
   vector<std::shared_ptr<RedDownloadCache>> mvecadscache;
+  /*players read and seek by uid, look them up without scanning the vectors;
+   * the opened url is kept to skip parsing it again on every call*/
+  struct CacheEntry {
+    std::string url;
+    std::shared_ptr<RedDownloadCache> cache;
+  };
+  std::unordered_map<int64_t, CacheEntry> mcachebyuid;
   std::deque<std::string> mdequeblacklist;
-  std::mutex m_mutex;
+  std::shared_mutex m_mutex; // shared for lookups, exclusive for changes
   std::mutex m_file_mutex;
   std::mutex m_queue_mutex;
   bool minited;
@@ -132,11 +132,16 @@ public:
   virtual void DownloadCallBack(int what, void *arg1, void *arg2, int64_t arg3,
                                 int64_t arg4) = 0;
   virtual int InterruptCallBack() = 0;
+  /*called once a preload range completed, true if another one was set up
+   * on the same parameters*/
+  virtual bool PreloadNextRange() { return false; }
 };
 
 struct DownLoadOpt {
   int DownLoadType{DOWNLOADNONE};
   int64_t PreDownLoadSize{0};
+  // preload the moov and this much playback, PreDownLoadSize is the fallback
+  int64_t PreDownLoadDurationMs{0};
   string cache_file_dir;
   uint32_t cache_max_entries{20};
   int64_t cache_max_dir_capacity{300 * 1024 * 1024};
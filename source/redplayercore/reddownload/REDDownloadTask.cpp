@@ -3,6 +3,7 @@
 
 #include "RedDownloadConfig.h"
 #include "RedLog.h"
+#include <functional>
 
 #define LOG_TAG "RedDownloadTask"
 
@@ -75,6 +76,21 @@ bool REDDownLoadTask::run() {
   return true;
 }
 
+bool REDDownLoadTask::nextpreload() {
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (babort.load())
+      return false;
+  }
+  // only a range that completed goes on to the next one
+  if (mdownpara == nullptr || !mdownpara->preload_finished)
+    return false;
+  std::shared_ptr<DataCallBack> datacb_guard = mdownpara->mdatacb_weak.lock();
+  DataCallBack *datacb =
+      m_datacallback_crash ? datacb_guard.get() : mdownpara->mdatacb;
+  return datacb != nullptr && datacb->PreloadNextRange();
+}
+
 void REDDownLoadTask::flush() {
   if (downloadhandle != nullptr) {
     downloadhandle->pause(true);
@@ -10,6 +10,9 @@
 #include "REDDownloadListen.h"
 #include "REDDownloader.h"
 #include "REDDownloaderFactory.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 using namespace std;
 
 struct RequsetInfo {
@@ -34,6 +37,8 @@ public:
   bool updatepara();
   bool isnextpara();
   bool iscompelte();
+  /*set up the next range of a staged preload, false when it is done*/
+  bool nextpreload();
   void asynctask();
 
   int filldata(size_t size, bool &need_update_range);
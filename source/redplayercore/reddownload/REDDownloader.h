@@ -3,6 +3,8 @@
 #include <string>
 
 #include "REDDownloadListen.h"
+#include <atomic>
+#include <memory>
 
 #define CURLERROR(e) (-(e)-100000)
 #define ERROR(e) (-(e))
@@ -2,6 +2,8 @@
 
 #include "REDDownloader.h"
 #include "utility/Utility.h"
+#include <atomic>
+#include <memory>
 
 enum ErrorBase {
   OpenError = -11000,
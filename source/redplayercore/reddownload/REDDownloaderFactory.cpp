@@ -6,6 +6,7 @@
 #include "REDCurl.h"
 #include "REDDownloader.h"
 #include "RedLog.h"
+#include <string.h>
 
 #define LOG_TAG "RedDownloaderFactory"
 
@@ -1,11 +1,49 @@
 #include "REDFileCache.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 
+#include <functional>
+
 #include "REDDownloadListen.h"
 #include "RedDownloadConfig.h"
 #include "RedLog.h"
+#include "RedTrace.h"
+#include <string.h>
 #define LOG_TAG "RedFileCache"
+
+static ssize_t pread_full(int fd, std::uint8_t *buf, size_t count,
+                          std::uint64_t offset) {
+  size_t done = 0;
+  while (done < count) {
+    ssize_t ret = pread(fd, buf + done, count - done,
+                        static_cast<off_t>(offset + done));
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret < 0)
+      return -1;
+    if (ret == 0)
+      break;
+    done += ret;
+  }
+  return done;
+}
+
+static ssize_t pwrite_full(int fd, const std::uint8_t *buf, size_t count,
+                           std::uint64_t offset) {
+  size_t done = 0;
+  while (done < count) {
+    ssize_t ret = pwrite(fd, buf + done, count - done,
+                         static_cast<off_t>(offset + done));
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return done > 0 ? done : -1;
+    done += ret;
+  }
+  return done;
+}
 // REDFileCache REDFileCache::mfilecache(MAX_CACHE_ENTRIES);
 
 REDFileCache::REDFileCache(int max_cache_entries_, int64_t max_dir_capacity_)
@@ -16,17 +54,23 @@ REDFileCache::REDFileCache(int max_cache_entries_, int64_t max_dir_capacity_)
 }
 
 REDFileCache::~REDFileCache() {
+  {
+    std::lock_guard<std::mutex> lock(map_mutex);
+    evict_abort = true;
+    evict_cond.notify_all();
+  }
+  if (mevictthread != nullptr && mevictthread->joinable()) {
+    mevictthread->join();
+    delete mevictthread;
+    mevictthread = nullptr;
+  }
   std::lock_guard<std::mutex> lock(path_mutex);
   while (cache_path_head != nullptr) {
     REDCachePath *temp = cache_path_head->next;
-    std::unordered_map<std::uint64_t, REDCacheInfo *>::iterator infoMapIter;
-    infoMapIter = cache_path_head->cache_info_map.begin();
-    while (infoMapIter != cache_path_head->cache_info_map.end()) {
-      delete infoMapIter->second;
-      infoMapIter->second = nullptr;
-      ++infoMapIter;
-    }
     cache_path_head->cache_info_map.clear();
+    if (cache_path_head->mfd >= 0) {
+      close(cache_path_head->mfd);
+    }
     delete cache_path_head;
     cache_path_head = temp;
   }
@@ -68,6 +112,7 @@ void REDFileCache::set_max_cache_entries(std::uint32_t max_entries) {
                                       // init to set max_capacity only once
     return;
   max_cache_entries = max_entries;
+  request_evict();
   // AV_LOGW(LOG_TAG, "REDCache - set max cache entries:%d\n",
   // max_cache_entries);
 }
@@ -77,6 +122,7 @@ void REDFileCache::set_max_dir_capacity(std::int64_t max_capacity) {
   if (inited && (m_cache_type != DOWNLOADKAIPINGADS))
     return;
   max_dir_capacity = max_capacity;
+  request_evict();
   // AV_LOGW(LOG_TAG, "REDCache - set max cache capacity:%" PRId64 "\n",
   // max_dir_capacity);
 }
@@ -92,6 +138,7 @@ void REDFileCache::set_file_size(const std::string &uri, int64_t filesize) {
   std::lock_guard<std::mutex> lock(map_mutex);
   REDCachePath *rcp = search_cache(uri);
   if (rcp != nullptr) {
+    std::lock_guard<std::mutex> io_lock(rcp->mio_mutex);
     rcp->mfilesize = filesize;
   } else {
     AV_LOGW(LOG_TAG, "REDCache - set file size failed\n");
@@ -103,6 +150,7 @@ int64_t REDFileCache::get_file_size(const std::string &uri, int &rangesize) {
   // AV_LOGW(LOG_TAG, "REDCache - %s\n", __FUNCTION__);
   REDCachePath *rcp = search_cache(uri);
   if (rcp != nullptr) {
+    std::lock_guard<std::mutex> io_lock(rcp->mio_mutex);
     if (rcp->mperiodsize > 0)
       rangesize = rcp->mperiodsize;
     return rcp->mfilesize;
@@ -112,6 +160,17 @@ int64_t REDFileCache::get_file_size(const std::string &uri, int &rangesize) {
   }
 }
 
+int REDFileCache::get_period_size(const std::string &uri) {
+  std::lock_guard<std::mutex> lock(map_mutex);
+  REDCachePath *rcp = search_cache(uri);
+  if (rcp != nullptr) {
+    std::lock_guard<std::mutex> io_lock(rcp->mio_mutex);
+    if (rcp->mperiodsize > 0)
+      return rcp->mperiodsize;
+  }
+  return mdownloadcachesize;
+}
+
 int64_t REDFileCache::get_cache_size(const std::string &uri) {
   std::lock_guard<std::mutex> lock(map_mutex);
   // AV_LOGW(LOG_TAG, "REDCache - %s\n", __FUNCTION__);
@@ -127,42 +186,53 @@ int64_t REDFileCache::get_cache_size(const std::string &uri) {
     return 0;
   }
 
+  std::lock_guard<std::mutex> io_lock(cache_path->mio_mutex);
   return cache_path->mcachesize;
 }
 
-void REDFileCache::push_cache(const std::string &uri) {
+int64_t REDFileCache::get_contiguous_size(const std::string &uri,
+                                          std::uint64_t offset) {
+  std::lock_guard<std::mutex> lock(map_mutex);
+  REDCachePath *cache_path = search_cache(uri);
+  if (cache_path == nullptr) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> io_lock(cache_path->mio_mutex);
+  return cache_path->cache_info_map.contiguous_size(offset);
+}
+
+int64_t REDFileCache::get_next_hole(const std::string &uri,
+                                    std::uint64_t offset) {
   std::lock_guard<std::mutex> lock(map_mutex);
+  REDCachePath *cache_path = search_cache(uri);
+  if (cache_path == nullptr) {
+    return offset;
+  }
+  std::lock_guard<std::mutex> io_lock(cache_path->mio_mutex);
+  return cache_path->cache_info_map.next_hole(offset);
+}
+
+REDCachePath *REDFileCache::push_cache(const std::string &uri) {
   std::unordered_map<std::string, REDCachePath *>::iterator mapIter;
   if ((mapIter = cache_path_map.find(uri)) != cache_path_map.end()) {
     // AV_LOGW(LOG_TAG, "REDCache - %s the file - %s exist in chache\n",
     // __FUNCTION__, uri.c_str());
-    REDCachePath *cachePath = cache_path_map[uri];
+    REDCachePath *cachePath = mapIter->second;
     move_to_head(cachePath);
-  } else {
-    // AV_LOGW(LOG_TAG, "REDCache - %s the file - %s does not exist in
-    // cache\n", __FUNCTION__, uri.c_str());
-    const std::string local_path = base_local_path + uri;
-    REDCachePath *cachePath = new REDCachePath(uri, local_path);
-    if (!cachePath) {
-      AV_LOGW(LOG_TAG, "REDCache - new cache path - %s is failed!\n",
-              uri.c_str());
-      return;
-    }
-    cache_path_map[uri] = cachePath;
-    add_to_head(cachePath);
-    if (RedDownloadConfig::getinstance()->get_config_value(FIX_GETDIR_SIZE) >
-        0) {
-      // AV_LOGW(LOG_TAG, "REDCache - %s physical_total_size:%" PRId64
-      // "\n", __FUNCTION__, physical_total_size);
-      if (cache_path_map.size() > max_cache_entries ||
-          physical_total_size > max_dir_capacity) {
-        delete_local_file();
-      }
-    } else if (cache_path_map.size() > max_cache_entries ||
-               get_dir_size(base_local_path) > max_dir_capacity) {
-      delete_local_file();
-    }
+    return cachePath;
+  }
+  // AV_LOGW(LOG_TAG, "REDCache - %s the file - %s does not exist in
+  // cache\n", __FUNCTION__, uri.c_str());
+  const std::string local_path = base_local_path + uri;
+  REDCachePath *cachePath = new REDCachePath(uri, local_path);
+  if (!cachePath) {
+    AV_LOGW(LOG_TAG, "REDCache - new cache path - %s is failed!\n",
+            uri.c_str());
+    return nullptr;
   }
+  cache_path_map[uri] = cachePath;
+  add_to_head(cachePath);
+  return cachePath;
 }
 
 REDCachePath *REDFileCache::search_cache(const std::string &uri) {
@@ -205,24 +275,30 @@ int REDFileCache::GetDirectoryFiles() {
         strcmp(".DS_Store", entry->d_name) == 0) {
       continue;
     }
-    if (strstr(entry->d_name, "-map") != nullptr) {
+    if (strstr(entry->d_name, CACHE_MAP_SUFFIX) != nullptr ||
+        strstr(entry->d_name, CACHE_INDEX_SUFFIX) != nullptr ||
+        strstr(entry->d_name, CACHE_KEYFRAME_SUFFIX) != nullptr ||
+        strncmp(entry->d_name, CACHE_DNS_FILE, strlen(CACHE_DNS_FILE)) == 0) {
       continue;
     }
 
     std::string local_path = base_local_path + entry->d_name;
     lstat(local_path.c_str(), &statbuf);
     if (!S_ISDIR(statbuf.st_mode)) {
-      std::string map_local_path = base_local_path + entry->d_name + "-map";
-      lstat(map_local_path.c_str(), &statbuf);
-      if (statbuf.st_size == 0) {
+      int64_t disk_size = statbuf.st_size;
+      std::string map_local_path = local_path + CACHE_MAP_SUFFIX;
+      if (!REDCacheIndex::is_valid_file(local_path + CACHE_INDEX_SUFFIX) &&
+          (lstat(map_local_path.c_str(), &statbuf) != 0 ||
+           statbuf.st_size == 0)) {
         unlink_files.push_back(local_path);
         continue;
       }
-      push_cache(entry->d_name);
-      REDCachePath *cache_path = search_cache(entry->d_name);
+      std::lock_guard<std::mutex> lock(map_mutex);
+      REDCachePath *cache_path = push_cache(entry->d_name);
       if (cache_path != nullptr) {
+        cache_path->mdisksize = disk_size;
         parse_cache_info(cache_path);
-        physical_total_size += cache_path->mcachesize;
+        physical_total_size += disk_size;
       }
     }
   }
@@ -230,26 +306,17 @@ int REDFileCache::GetDirectoryFiles() {
   for (std::vector<std::string>::iterator it = unlink_files.begin();
        it != unlink_files.end(); ++it) {
     std::string local_path = *it;
-    std::string map_local_path = local_path + "-map";
+    std::string map_local_path = local_path + CACHE_MAP_SUFFIX;
+    std::string index_local_path = local_path + CACHE_INDEX_SUFFIX;
+    std::string keyframe_local_path = local_path + CACHE_KEYFRAME_SUFFIX;
     unlink(local_path.c_str());
     unlink(map_local_path.c_str());
+    unlink(index_local_path.c_str());
+    unlink(keyframe_local_path.c_str());
   }
-  if (RedDownloadConfig::getinstance()->get_config_value(FIX_GETDIR_SIZE) > 0) {
-    while (physical_total_size > max_dir_capacity) {
-      AV_LOGW(LOG_TAG, "REDCache - %s max_dir_capacity:%" PRId64 "\n",
-              __FUNCTION__, max_dir_capacity);
-      if (!delete_local_file()) {
-        break;
-      }
-    }
-  } else {
-    while (get_dir_size(base_local_path) > max_dir_capacity) {
-      AV_LOGW(LOG_TAG, "REDCache - %s max_dir_capacity:%" PRId64 "\n",
-              __FUNCTION__, max_dir_capacity);
-      if (!delete_local_file()) {
-        break;
-      }
-    }
+  {
+    std::lock_guard<std::mutex> lock(map_mutex);
+    request_evict();
   }
   closedir(dp);
   AV_LOGW(LOG_TAG, "REDCache - Get Directory Files Once done, path %s\n",
@@ -258,7 +325,63 @@ int REDFileCache::GetDirectoryFiles() {
 }
 
 int REDFileCache::parse_cache_info(REDCachePath *cache_path) {
-  // AV_LOGW(LOG_TAG, "REDCache - %s\n", __FUNCTION__);
+  std::string map_file_path =
+      base_local_path + cache_path->key_url + CACHE_MAP_SUFFIX;
+  if (access(map_file_path.c_str(), F_OK) == 0) {
+    if (parse_legacy_cache_info(cache_path) != 0)
+      return -1;
+    if (open_cache_index(cache_path, true) == 0) {
+      cache_path->index.set_meta(cache_path->mfilesize, cache_path->mcachesize,
+                                 cache_path->mperiodsize);
+      cache_path->index.close();
+      unlink(map_file_path.c_str());
+      AV_LOGI(LOG_TAG, "REDCache - %s migrated %s to index\n", __FUNCTION__,
+              cache_path->key_url.c_str());
+    }
+    return 0;
+  }
+
+  std::string index_path =
+      base_local_path + cache_path->key_url + CACHE_INDEX_SUFFIX;
+  if (cache_path->index.open(index_path) != 0) {
+    AV_LOGW(LOG_TAG, "REDCache - parse cache info open index failed!\n");
+    return -1;
+  }
+  const REDCacheIndexHeader *header = cache_path->index.header();
+  const REDCacheIndexRecord *records = cache_path->index.records();
+  cache_path->mfilesize = header->file_size;
+  cache_path->mperiodsize = header->period_size;
+  // records are updated in place, so they are newer than the header sizes
+  // when the file was not closed. a kill between a record and its data
+  // leaves one past the end of the data file, those are dropped and the
+  // index is rewritten from the map when it is next opened
+  cache_path->mcachesize = 0;
+  cache_path->cache_info_map.reserve(header->entry_count);
+  uint32_t dropped = 0;
+  for (uint32_t i = 0; i < header->entry_count; ++i) {
+    if (records[i].physical_pos + records[i].data_amount >
+        static_cast<uint64_t>(cache_path->mdisksize)) {
+      dropped++;
+      continue;
+    }
+    cache_path->cache_info_map.put(REDCacheInfo(records[i].logical_pos,
+                                                records[i].data_amount,
+                                                records[i].physical_pos));
+    cache_path->mcachesize += records[i].data_amount;
+  }
+  cache_path->index.close();
+  if (dropped > 0) {
+    AV_LOGW(LOG_TAG, "REDCache - %s %s dropped %u records past %" PRId64 "\n",
+            __FUNCTION__, cache_path->key_url.c_str(), dropped,
+            cache_path->mdisksize);
+  }
+  if (cache_path->mperiodsize == 0) {
+    cache_path->mperiodsize = DOWNLOAD_SHARD_SIZE;
+  }
+  return 0;
+}
+
+int REDFileCache::parse_legacy_cache_info(REDCachePath *cache_path) {
   char string_line[CONFIG_MAX_LINE] = {0};
   char *ptr = nullptr;
   uint64_t str_len = 0;
@@ -273,7 +396,8 @@ int REDFileCache::parse_cache_info(REDCachePath *cache_path) {
   const char *dst_entry_data = "entry_data_amount:";
   const char *dst_entry_physical = "entry_physical_pos:";
 
-  std::string map_file_path = base_local_path + cache_path->key_url + "-map";
+  std::string map_file_path =
+      base_local_path + cache_path->key_url + CACHE_MAP_SUFFIX;
   FILE *fp = fopen(map_file_path.c_str(), "r+");
   if (!fp) {
     AV_LOGW(LOG_TAG, "REDCache - parse cache info open map file failed!\n");
@@ -345,16 +469,10 @@ int REDFileCache::parse_cache_info(REDCachePath *cache_path) {
       }
       entry_physical_pos = static_cast<int>(strtoll(ptr, NULL, 10));
     } else if (strstr(string_line, "entry_info_flush") != nullptr) {
-      REDCacheInfo *cacheInfo = new REDCacheInfo(
-          entry_logical_pos, static_cast<uint32_t>(entry_data_amount),
-          entry_physical_pos);
-      if (cacheInfo == nullptr) {
-        AV_LOGW(LOG_TAG, "REDCache - %s new cache info failed\n", __FUNCTION__);
-        fclose(fp);
-        fp = nullptr;
-        return -1;
-      }
-      cache_path->cache_info_map[entry_logical_pos] = cacheInfo;
+      cache_path->cache_info_map.put(
+          REDCacheInfo(entry_logical_pos,
+                       static_cast<uint32_t>(entry_data_amount),
+                       entry_physical_pos));
     }
   }
   if (cache_path->mperiodsize == 0) {
@@ -368,45 +486,35 @@ int REDFileCache::parse_cache_info(REDCachePath *cache_path) {
 
 int REDFileCache::save_cache_info(REDCachePath *cache_path) {
   // AV_LOGW(LOG_TAG, "REDCache - %s\n", __FUNCTION__);
-  std::string map_file_path = base_local_path + cache_path->key_url + "-map";
-  cache_path->mfd_map = fopen(map_file_path.c_str(), "r+");
-
-  if (cache_path->mfd_map == nullptr) {
-    AV_LOGW(LOG_TAG, "REDCache - %s fopen map file - %s is failed!\n",
-            __FUNCTION__, map_file_path.c_str());
+  if (open_cache_index(cache_path) != 0) {
+    AV_LOGW(LOG_TAG, "REDCache - %s open index - %s is failed!\n",
+            __FUNCTION__, cache_path->key_url.c_str());
     return -1;
   }
-  std::string config("");
-  config += ("total_file_size:" + std::to_string(cache_path->mfilesize) + '\n');
-  config +=
-      ("cache_file_size:" + std::to_string(cache_path->mcachesize) + '\n');
   if (cache_path->mperiodsize == 0) {
     cache_path->mperiodsize = mdownloadcachesize;
   }
-  config +=
-      ("cache_period_size:" + std::to_string(cache_path->mperiodsize) + '\n');
-  std::unordered_map<std::uint64_t, REDCacheInfo *>::iterator infoMapIter;
-  infoMapIter = cache_path->cache_info_map.begin();
-  while (infoMapIter != cache_path->cache_info_map.end()) {
-    config += ("entry_logical_pos:" +
-               std::to_string(infoMapIter->second->logical_pos) + '\n');
-    config += ("entry_data_amount:" +
-               std::to_string(infoMapIter->second->data_amount) + '\n');
-    config += ("entry_physical_pos:" +
-               std::to_string(infoMapIter->second->physical_pos) + '\n');
-    config += "entry_info_flush\n";
-    ++infoMapIter;
-  }
-  size_t size = fwrite(config.c_str(), 1, config.length(), cache_path->mfd_map);
-  if (size != config.length()) {
-    AV_LOGW(LOG_TAG, "REDCache - %s fwrite(%zu) error(%s)!\n", __FUNCTION__,
-            size, strerror(errno));
-    fclose(cache_path->mfd_map);
-    remove(map_file_path.c_str());
-    return -1;
+  cache_path->index.set_meta(cache_path->mfilesize, cache_path->mcachesize,
+                             cache_path->mperiodsize);
+  cache_path->index.close();
+  return 0;
+}
+
+int REDFileCache::open_cache_index(REDCachePath *cache_path, bool truncate) {
+  if (!cache_path->index.is_open()) {
+    std::string index_path =
+        base_local_path + cache_path->key_url + CACHE_INDEX_SUFFIX;
+    if (cache_path->index.open(index_path, truncate) != 0)
+      return -1;
+  }
+  if (cache_path->index.count() != cache_path->cache_info_map.size()) {
+    cache_path->index.clear();
+    for (const REDCacheInfo &info : cache_path->cache_info_map) {
+      if (cache_path->index.put(info.logical_pos, info.physical_pos,
+                                info.data_amount) != 0)
+        return -1;
+    }
   }
-  fclose(cache_path->mfd_map);
-  cache_path->mfd_map = nullptr;
   return 0;
 }
 
@@ -426,7 +534,10 @@ int REDFileCache::recreate_cache_file(REDCachePath *cache_path) {
         strcmp(".DS_Store", entry->d_name) == 0) {
       continue;
     }
-    if (strstr(entry->d_name, "-map") != nullptr) {
+    if (strstr(entry->d_name, CACHE_MAP_SUFFIX) != nullptr ||
+        strstr(entry->d_name, CACHE_INDEX_SUFFIX) != nullptr ||
+        strstr(entry->d_name, CACHE_KEYFRAME_SUFFIX) != nullptr ||
+        strncmp(entry->d_name, CACHE_DNS_FILE, strlen(CACHE_DNS_FILE)) == 0) {
       continue;
     }
 
@@ -435,8 +546,8 @@ int REDFileCache::recreate_cache_file(REDCachePath *cache_path) {
 
     if (!S_ISDIR(statbuf.st_mode)) {
       if (strcmp(cache_path->key_url.c_str(), entry->d_name) == 0) {
-        cache_path->mfd = fopen(cache_path->value_cache_path.c_str(), "r+");
-        if (cache_path->mfd == nullptr) {
+        cache_path->mfd = open(cache_path->value_cache_path.c_str(), O_RDWR);
+        if (cache_path->mfd < 0) {
           AV_LOGW(LOG_TAG, "REDCache - %s open file - %s failed!\n",
                   __FUNCTION__, cache_path->value_cache_path.c_str());
           closedir(dp);
@@ -448,28 +559,23 @@ int REDFileCache::recreate_cache_file(REDCachePath *cache_path) {
     }
   }
 
-  std::unordered_map<std::uint64_t, REDCacheInfo *>::iterator infoMapIter;
-  infoMapIter = cache_path->cache_info_map.begin();
-  while (infoMapIter != cache_path->cache_info_map.end()) {
-    delete infoMapIter->second;
-    infoMapIter->second = nullptr;
-    ++infoMapIter;
-  }
   cache_path->cache_info_map.clear();
-
-  std::string local_map_path = cache_path->value_cache_path + "-map";
-  cache_path->mfd_map = fopen(local_map_path.c_str(), "w+");
-  if (cache_path->mfd_map == nullptr) {
-    AV_LOGW("REDCache - %s recreate file mfd_map failed!\n", __FUNCTION__);
+  cache_path->mcachesize = 0;
+  physical_total_size -= cache_path->mdisksize;
+  cache_path->mdisksize = 0;
+
+  std::string local_map_path = cache_path->value_cache_path + CACHE_MAP_SUFFIX;
+  unlink(local_map_path.c_str());
+  if (open_cache_index(cache_path, true) != 0) {
+    AV_LOGW(LOG_TAG, "REDCache - %s recreate index failed!\n", __FUNCTION__);
     closedir(dp);
     return -1;
   }
-  fclose(cache_path->mfd_map);
-  cache_path->mfd_map = nullptr;
 
-  cache_path->mfd = fopen(cache_path->value_cache_path.c_str(), "w+");
-  if (cache_path->mfd == nullptr) {
-    AV_LOGW("REDCache - %s recreate file mfd failed!\n", __FUNCTION__);
+  cache_path->mfd = open(cache_path->value_cache_path.c_str(),
+                         O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (cache_path->mfd < 0) {
+    AV_LOGW(LOG_TAG, "REDCache - %s recreate file mfd failed!\n", __FUNCTION__);
     closedir(dp);
     return -1;
   }
@@ -497,43 +603,58 @@ int REDFileCache::create_cache_dir(const std::string &path) {
   return 0;
 }
 
-int64_t REDFileCache::get_dir_size(const std::string &path) {
-  DIR *dp;
-  struct dirent *entry;
-  struct stat statbuf;
-  int64_t total_size = 0;
-  std::string local_path = path;
+void REDFileCache::grow_disk_size(REDCachePath *cache_path, int64_t end) {
+  if (end <= cache_path->mdisksize)
+    return;
+  physical_total_size += end - cache_path->mdisksize;
+  cache_path->mdisksize = end;
+}
 
-  if (local_path.back() != '/') {
-    local_path += '/';
-  }
-  if ((dp = opendir(local_path.c_str())) == nullptr) {
-    AV_LOGW(LOG_TAG, "REDCache - %s Cannot open dir: %s; error: %s\n",
-            __FUNCTION__, local_path.c_str(), strerror(errno));
-    return -1;
+void REDFileCache::request_evict() {
+  if (evict_abort || evict_stalled ||
+      (cache_path_map.size() <= max_cache_entries &&
+       physical_total_size <= max_dir_capacity))
+    return;
+  evict_pending = true;
+  if (mevictthread == nullptr) {
+    mevictthread = new std::thread(
+        std::bind(&REDFileCache::evict_loop, this, "REDCacheEvictThread"));
   }
+  evict_cond.notify_one();
+}
 
-  while ((entry = readdir(dp)) != NULL) {
-    if (strcmp(".", entry->d_name) == 0 || strcmp("..", entry->d_name) == 0 ||
-        strcmp(".DS_Store", entry->d_name) == 0) {
-      continue;
-    }
-
-    std::string file_path = local_path + entry->d_name;
-    lstat(file_path.c_str(), &statbuf);
-    // if (S_ISDIR(statbuf.st_mode)) {
-    //     int64_t sub_dir_size = get_dir_size(file_path);
-    //     total_size += sub_dir_size;
-    // } else {
-    //     total_size += statbuf.st_size;
-    // }
-    if (!S_ISDIR(statbuf.st_mode)) {
-      total_size += statbuf.st_size;
+void REDFileCache::evict_loop(std::string thread_name) {
+#ifdef __APPLE__
+  pthread_setname_np(thread_name.c_str());
+#elif __ANDROID__
+  pthread_setname_np(pthread_self(), thread_name.c_str());
+#elif __HARMONY__
+  pthread_setname_np(pthread_self(), thread_name.c_str());
+#endif
+  std::unique_lock<std::mutex> lock(map_mutex);
+  while (!evict_abort) {
+    evict_cond.wait(lock, [this] { return evict_abort || evict_pending; });
+    if (evict_abort)
+      break;
+    evict_pending = false;
+    int64_t low_watermark = max_dir_capacity / 100 * CACHE_EVICT_LOW_WATERMARK;
+    while (!evict_abort && (cache_path_map.size() > max_cache_entries ||
+                            physical_total_size > low_watermark)) {
+      if (!delete_local_file()) {
+        evict_stalled = true;
+        break;
+      }
+      // let the io threads in between two victims
+      lock.unlock();
+      std::this_thread::yield();
+      lock.lock();
     }
+    AV_LOGI(LOG_TAG,
+            "REDCache - %s done, entries %zu, dirsize %" PRId64
+            ", maxdircapacity %" PRId64 "\n",
+            __FUNCTION__, cache_path_map.size(), physical_total_size.load(),
+            max_dir_capacity);
   }
-
-  closedir(dp);
-  return total_size;
 }
 
 bool REDFileCache::delete_local_file(const std::string &uri) {
@@ -545,26 +666,31 @@ bool REDFileCache::delete_local_file(const std::string &uri) {
     tailCachePath = delete_cache_by_uri(uri);
   }
 
-  if (tailCachePath != nullptr && !tailCachePath->mpin) {
+  if (tailCachePath != nullptr && tailCachePath->mref == 0 &&
+      !tailCachePath->mpin) {
     AV_LOGW(LOG_TAG,
             "REDCache - %s delete tail cache - %s, dirsize %" PRId64
             ", cachesize %" PRId64 "\n",
-            __FUNCTION__, tailCachePath->key_url.c_str(), physical_total_size,
+            __FUNCTION__, tailCachePath->key_url.c_str(),
+            physical_total_size.load(),
             tailCachePath->mcachesize);
-    if (tailCachePath->mcachesize > 0) {
-      physical_total_size -= tailCachePath->mcachesize;
-    }
-    std::unordered_map<std::uint64_t, REDCacheInfo *>::iterator infoMapIter;
-    infoMapIter = tailCachePath->cache_info_map.begin();
-    while (infoMapIter != tailCachePath->cache_info_map.end()) {
-      delete infoMapIter->second;
-      ++infoMapIter;
-    }
+    physical_total_size -= tailCachePath->mdisksize;
     tailCachePath->cache_info_map.clear();
     cache_path_map.erase(tailCachePath->key_url);
-    std::string map_local_path = tailCachePath->value_cache_path + "-map";
+    tailCachePath->index.close();
+    if (tailCachePath->mfd >= 0) {
+      close(tailCachePath->mfd);
+    }
+    std::string map_local_path =
+        tailCachePath->value_cache_path + CACHE_MAP_SUFFIX;
+    std::string index_local_path =
+        tailCachePath->value_cache_path + CACHE_INDEX_SUFFIX;
+    std::string keyframe_local_path =
+        tailCachePath->value_cache_path + CACHE_KEYFRAME_SUFFIX;
     unlink(tailCachePath->value_cache_path.c_str());
     unlink(map_local_path.c_str());
+    unlink(index_local_path.c_str());
+    unlink(keyframe_local_path.c_str());
     delete tailCachePath;
     return true;
   }
@@ -574,259 +700,198 @@ bool REDFileCache::delete_local_file(const std::string &uri) {
 int REDFileCache::update_cache_info(const std::string &uri, std::uint8_t *data,
                                     std::int64_t start_pos,
                                     std::uint32_t length) {
-  std::lock_guard<std::mutex> lock(map_mutex);
   // AV_LOGW(LOG_TAG, "REDCache -- %s\n", __FUNCTION__);
   if (uri.empty()) {
     AV_LOGW(LOG_TAG, "REDCache - %s uri is empty!\n", __FUNCTION__);
     return -1;
   }
-  std::unordered_map<std::string, REDCachePath *>::iterator mapIter;
-  if ((mapIter = cache_path_map.find(uri)) != cache_path_map.end()) {
-    REDCachePath *cachePath = cache_path_map[uri];
-    if (!cachePath) {
-      AV_LOGW(LOG_TAG,
-              "REDCache - %s the key_url - %s ,value cachePath is empty!\n",
-              __FUNCTION__, uri.c_str());
+  REDCachePath *cachePath = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(map_mutex);
+    cachePath = search_cache(uri);
+    if (cachePath == nullptr) {
       return -1;
     }
-    if (cachePath->mfd == nullptr) {
-      cachePath->mfd = fopen(cachePath->value_cache_path.c_str(), "r+");
-      if (cachePath->mfd == nullptr) {
-        AV_LOGW(LOG_TAG,
-                "REDCache - %s mfd is null and reopen is failed! "
-                "return !\n",
-                __FUNCTION__);
-        return -1;
-      }
-      AV_LOGW(LOG_TAG, "REDCache - %s mfd is null and reopen !\n",
+    cachePath->mref++;
+  }
+  int ret = write_cache_data(cachePath, data, start_pos, length);
+  release_cache(cachePath);
+  return ret;
+}
+
+int REDFileCache::write_cache_data(REDCachePath *cache_path,
+                                   std::uint8_t *data, std::int64_t start_pos,
+                                   std::uint32_t length) {
+  RED_TRACE_SCOPE(RED_TRACE_DOWNLOAD, "file_write", 0);
+  std::lock_guard<std::mutex> lock(cache_path->mio_mutex);
+  if (cache_path->mfd < 0) {
+    cache_path->mfd = open(cache_path->value_cache_path.c_str(), O_RDWR);
+    if (cache_path->mfd < 0) {
+      AV_LOGW(LOG_TAG,
+              "REDCache - %s mfd is null and reopen is failed! "
+              "return !\n",
               __FUNCTION__);
-      cachePath->mpin = true;
+      return -1;
     }
-    std::unordered_map<std::uint64_t, REDCacheInfo *>::iterator infoMapIter;
-    if ((infoMapIter = cachePath->cache_info_map.find(start_pos)) !=
-        cachePath->cache_info_map.end()) {
-      REDCacheInfo *cacheInfo = infoMapIter->second;
-      if (cacheInfo->data_amount < length) {
-        if (cachePath->mfd == nullptr) {
-          AV_LOGW(LOG_TAG, "REDCache - %s mfd is null, return !\n",
-                  __FUNCTION__);
-          return -1;
-        }
-        if (fseek(cachePath->mfd, static_cast<int64_t>(cacheInfo->physical_pos),
-                  SEEK_SET) != 0) {
-          AV_LOGW(LOG_TAG, "REDCache - %s fseek error(%s)!\n", __FUNCTION__,
-                  strerror(errno));
-          return -1;
-        }
-        if (cachePath->mperiodsize > 0) {
-          size_t size;
-          if ((size = fwrite(data, 1, cachePath->mperiodsize,
-                             cachePath->mfd)) != cachePath->mperiodsize) {
-            AV_LOGW(LOG_TAG, "REDCache - %s fwrite(%zu) error(%s)!\n",
-                    __FUNCTION__, size, strerror(errno));
-            delete cacheInfo;
-            cachePath->cache_info_map.erase(infoMapIter);
-            return -1;
-          }
-        } else {
-          size_t size;
-          if ((size = fwrite(data, 1, mdownloadcachesize, cachePath->mfd)) !=
-              mdownloadcachesize) {
-            AV_LOGW(LOG_TAG, "REDCache - %s fwrite(%zu) error(%s)!\n",
-                    __FUNCTION__, size, strerror(errno));
-            delete cacheInfo;
-            cachePath->cache_info_map.erase(infoMapIter);
-            return -1;
-          }
-        }
-        cachePath->mcachesize =
-            cachePath->mcachesize - cacheInfo->data_amount + length;
-        physical_total_size += length - cacheInfo->data_amount;
-        cacheInfo->data_amount = length;
-        // AV_LOGI(LOG_TAG, "REDCache - %s(fix) pos:%lld, len:%lld\n",
-        // __FUNCTION__, cacheInfo->physical_pos, length);
-      } else {
-        // AV_LOGI(LOG_TAG, "REDCache - %s(fix) data_amount %lld >= len
-        // %lld\n", __FUNCTION__, cacheInfo->data_amount, length);
-      }
+    AV_LOGW(LOG_TAG, "REDCache - %s mfd is null and reopen !\n", __FUNCTION__);
+    cache_path->mpin = true;
+  }
+  if (open_cache_index(cache_path) != 0) {
+    AV_LOGW(LOG_TAG, "REDCache - %s open index failed!\n", __FUNCTION__);
+  }
+
+  size_t shard_size = cache_path->mperiodsize > 0 ? cache_path->mperiodsize
+                                                  : mdownloadcachesize;
+  REDCacheInfo cacheInfo;
+  const REDCacheInfo *cachedInfo = cache_path->cache_info_map.find(start_pos);
+  if (cachedInfo != nullptr) {
+    cacheInfo = *cachedInfo;
+    if (cacheInfo.data_amount >= length) {
+      // AV_LOGI(LOG_TAG, "REDCache - %s(fix) data_amount %lld >= len
+      // %lld\n", __FUNCTION__, cacheInfo->data_amount, length);
       return 0;
-    } else {
-      if ((infoMapIter = cachePath->cache_info_map.find(start_pos)) !=
-          cachePath->cache_info_map.end()) {
-        REDCacheInfo *cacheInfo = cachePath->cache_info_map[start_pos];
-        if (cacheInfo->data_amount < length) {
-          cachePath->mcachesize =
-              cachePath->mcachesize - cacheInfo->data_amount + length;
-          physical_total_size += length - cacheInfo->data_amount;
-          cacheInfo->data_amount = length;
-          if (cachePath->mfd == nullptr) {
-            AV_LOGW(LOG_TAG, "REDCache - %s mfd is null, return !\n",
-                    __FUNCTION__);
-            return -1;
-          }
-          fseek(cachePath->mfd, static_cast<int64_t>(cacheInfo->physical_pos),
-                SEEK_SET);
-          // int ret = 0;
-          if (cachePath->mperiodsize > 0) {
-            fwrite(data, 1, cachePath->mperiodsize, cachePath->mfd);
-          } else {
-            fwrite(data, 1, mdownloadcachesize, cachePath->mfd);
-          }
-          AV_LOGW(LOG_TAG, "REDCache - %s pos:%" PRIu64 ", len:%" PRIu32 "\n",
-                  __FUNCTION__, cacheInfo->physical_pos, length);
-        } else {
-          AV_LOGW(LOG_TAG,
-                  "REDCache - %s data_amount %" PRIu32 " >= len %" PRIu32 "\n",
-                  __FUNCTION__, cacheInfo->data_amount, length);
-        }
-        return 0;
-      } else {
-        REDCacheInfo *cacheInfo = new REDCacheInfo(start_pos, length);
-        if (cacheInfo != nullptr) {
-          cachePath->cache_info_map[start_pos] = cacheInfo;
-          cachePath->mcachesize += length;
-          physical_total_size += length;
-          // cacheInfo->logical_pos = start_pos;
-          std::uint64_t fd_pos = 0;
-
-          if (cachePath->mfd == nullptr) {
-            AV_LOGW(LOG_TAG,
-                    "REDCache - %s mfd null with start pos ,return !\n",
-                    __FUNCTION__);
-            return -1;
-          }
-          fseek(cachePath->mfd, 0, SEEK_END);
-          fd_pos = ftell(cachePath->mfd);
-          if (cachePath->mperiodsize > 0) {
-            cacheInfo->physical_pos =
-                (fd_pos / cachePath->mperiodsize) * cachePath->mperiodsize;
-            fwrite(data, 1, cachePath->mperiodsize, cachePath->mfd);
-          } else {
-            cacheInfo->physical_pos =
-                (fd_pos / mdownloadcachesize) * mdownloadcachesize;
-            fwrite(data, 1, mdownloadcachesize, cachePath->mfd);
-          }
-          // int ret = 0;
-          AV_LOGW(LOG_TAG,
-                  "REDCache - %s new pos:%" PRIu64 ", len:%" PRIu32
-                  ", fd_pos:%" PRIu64 "\n",
-                  __FUNCTION__, cacheInfo->physical_pos, length, fd_pos);
-          return 0;
-        }
-        AV_LOGW(LOG_TAG,
-                "REDCache - %s new cache info with the key_range - %" PRId64
-                "failed!\n",
-                __FUNCTION__, start_pos);
-      }
     }
+  } else {
+    off_t fd_pos = lseek(cache_path->mfd, 0, SEEK_END);
+    if (fd_pos < 0) {
+      AV_LOGW(LOG_TAG, "REDCache - %s lseek error(%s)!\n", __FUNCTION__,
+              strerror(errno));
+      return -1;
+    }
+    cacheInfo = REDCacheInfo(start_pos, 0, (fd_pos / shard_size) * shard_size);
   }
 
-  return -1;
+  ssize_t size = pwrite_full(cache_path->mfd, data, shard_size,
+                             cacheInfo.physical_pos);
+  if (size != static_cast<ssize_t>(shard_size)) {
+    AV_LOGW(LOG_TAG, "REDCache - %s pwrite(%zd) error(%s)!\n", __FUNCTION__,
+            size, strerror(errno));
+    if (cachedInfo != nullptr) {
+      cache_path->index.remove(start_pos);
+      cache_path->mcachesize -= cacheInfo.data_amount;
+      cache_path->cache_info_map.erase(start_pos);
+    }
+    return -1;
+  }
+  if (cachedInfo == nullptr) {
+    AV_LOGW(LOG_TAG, "REDCache - %s new pos:%" PRIu64 ", len:%" PRIu32 "\n",
+            __FUNCTION__, cacheInfo.physical_pos, length);
+  }
+  cache_path->mcachesize +=
+      static_cast<int64_t>(length) - cacheInfo.data_amount;
+  cacheInfo.data_amount = length;
+  cache_path->cache_info_map.put(cacheInfo);
+  grow_disk_size(cache_path, cacheInfo.physical_pos + shard_size);
+  cache_path->index.put(cacheInfo.logical_pos, cacheInfo.physical_pos,
+                        cacheInfo.data_amount);
+  return 0;
 }
 
 int REDFileCache::get_cache_file(const std::string &uri, std::uint8_t *data,
                                  std::uint64_t offset, int bufsize) {
-  std::lock_guard<std::mutex> lock(map_mutex);
-  uint32_t amount_data = 0;
-  std::unordered_map<std::string, REDCachePath *>::iterator mapIter;
   REDCachePath *cachePath = nullptr;
-  if ((mapIter = cache_path_map.find(uri)) != cache_path_map.end()) {
-    cachePath = cache_path_map[uri];
-    // AV_LOGW(LOG_TAG, "REDCache - %s cachePath->mpin is:%d\n",
-    // __FUNCTION__, cachePath->mpin);
-    cachePath->mpin = true;
-    move_to_head(cachePath);
-    std::uint64_t key_range;
-    if (cachePath->mperiodsize > 0) {
-      key_range = (offset / cachePath->mperiodsize) * cachePath->mperiodsize;
-    } else {
-      key_range = (offset / mdownloadcachesize) * mdownloadcachesize;
-    }
-    if (cachePath->mfd == nullptr) {
-      cachePath->mfd = fopen(cachePath->value_cache_path.c_str(), "r+");
-      if (cachePath->mfd == nullptr) {
-        int ret = recreate_cache_file(cachePath);
-        if (ret != 0) {
-          AV_LOGW(LOG_TAG, "REDCache - %s recreate cache file failed!\n",
-                  __FUNCTION__);
-          return -1;
-        }
-      }
-    }
-
-    std::unordered_map<std::uint64_t, REDCacheInfo *>::iterator infoMapIter;
-    if ((infoMapIter = cachePath->cache_info_map.find(key_range)) !=
-        cachePath->cache_info_map.end()) {
-      amount_data = cachePath->cache_info_map[key_range]->data_amount;
-      std::uint64_t seek_pos =
-          cachePath->cache_info_map[key_range]->physical_pos;
-      int ret = fseek(cachePath->mfd, static_cast<int64_t>(seek_pos), SEEK_SET);
-      if (ret != 0) {
-        AV_LOGW(LOG_TAG,
-                "REDCache - %s fseek to seek_pos:%" PRIu64 "is failed!\n",
-                __FUNCTION__, seek_pos);
-        return -1;
-      }
+  bool created = false;
+  {
+    std::lock_guard<std::mutex> lock(map_mutex);
+    std::unordered_map<std::string, REDCachePath *>::iterator mapIter;
+    if ((mapIter = cache_path_map.find(uri)) != cache_path_map.end()) {
+      cachePath = mapIter->second;
+      move_to_head(cachePath);
     } else {
-      int ret = fseek(cachePath->mfd, 0, SEEK_END);
-      if (ret != 0) {
-        AV_LOGW(LOG_TAG, "REDCache - %s fseek to end is failed!\n",
-                __FUNCTION__);
+      // AV_LOGW(LOG_TAG, "REDCache - %s add new file - %s\n", __FUNCTION__,
+      // uri.c_str());
+      const std::string local_path = base_local_path + uri;
+      cachePath = new REDCachePath(uri, local_path);
+      if (!cachePath) {
+        AV_LOGW(LOG_TAG, "%s REDCache new cache path - %s is failed!\n",
+                __FUNCTION__, uri.c_str());
         return -1;
       }
+      cache_path_map[uri] = cachePath;
+      add_to_head(cachePath);
+      created = true;
     }
-  } else {
-    // AV_LOGW(LOG_TAG, "REDCache - %s add new file - %s\n", __FUNCTION__,
-    // uri.c_str());
-    const std::string local_path = base_local_path + uri;
-    const std::string loacl_path_map = base_local_path + uri + "-map";
-    cachePath = new REDCachePath(uri, local_path);
-    if (!cachePath) {
-      AV_LOGW(LOG_TAG, "%s REDCache new cache path - %s is failed!\n",
-              __FUNCTION__, uri.c_str());
+    cachePath->mref++;
+    request_evict();
+  }
+  int ret = read_cache_data(cachePath, data, offset, created);
+  release_cache(cachePath);
+  return ret;
+}
+
+int REDFileCache::read_cache_data(REDCachePath *cache_path,
+                                  std::uint8_t *data, std::uint64_t offset,
+                                  bool created) {
+  RED_TRACE_SCOPE(RED_TRACE_DOWNLOAD, "file_read", 0);
+  std::lock_guard<std::mutex> lock(cache_path->mio_mutex);
+  // AV_LOGW(LOG_TAG, "REDCache - %s cachePath->mpin is:%d\n",
+  // __FUNCTION__, cache_path->mpin);
+  cache_path->mpin = true;
+  if (created) {
+    if (open_cache_index(cache_path, true) != 0) {
+      AV_LOGW(LOG_TAG, "REDCache - %s open index failed!\n", __FUNCTION__);
       return -1;
     }
-    cache_path_map[uri] = cachePath;
-    cachePath->mpin = true;
-    add_to_head(cachePath);
-    cachePath->mfd_map = fopen(loacl_path_map.c_str(), "w+");
-    if (cachePath->mfd_map == nullptr) {
-      AV_LOGW("REDCache - %s fopen mfd_map failed!\n", __FUNCTION__);
+    cache_path->mfd = open(cache_path->value_cache_path.c_str(),
+                           O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (cache_path->mfd < 0) {
+      AV_LOGW(LOG_TAG, "REDCache - %s open mfd failed!\n", __FUNCTION__);
       return -1;
     }
-    fclose(cachePath->mfd_map);
-    cachePath->mfd_map = nullptr;
+    return 0;
+  }
 
-    cachePath->mfd = fopen(local_path.c_str(), "w+");
-    if (cachePath->mfd == nullptr) {
-      AV_LOGW("REDCache - %s fopen mfd failed!\n", __FUNCTION__);
-      return -1;
+  if (cache_path->mfd < 0) {
+    cache_path->mfd = open(cache_path->value_cache_path.c_str(), O_RDWR);
+    if (cache_path->mfd < 0) {
+      int ret = recreate_cache_file(cache_path);
+      if (ret != 0) {
+        AV_LOGW(LOG_TAG, "REDCache - %s recreate cache file failed!\n",
+                __FUNCTION__);
+        return -1;
+      }
     }
   }
-  while (cache_path_map.size() > max_cache_entries ||
-         physical_total_size > max_dir_capacity) {
-    // AV_LOGW(LOG_TAG, "REDCache - %s cache_path_map size:%d
-    // max_cache_entries:%d, dirsize %" PRId64 ", maxdircpacity %" PRId64
-    // "\n",
-    //     __FUNCTION__, cache_path_map.size(), max_cache_entries,
-    //     physical_total_size, max_dir_capacity);
-    if (!delete_local_file()) {
-      break;
-    }
+  if (open_cache_index(cache_path) != 0) {
+    AV_LOGW(LOG_TAG, "REDCache - %s open index failed!\n", __FUNCTION__);
   }
-  if (cachePath != nullptr && cachePath->mfd != nullptr && amount_data > 0) {
-    size_t readsize = fread(data, 1, amount_data, cachePath->mfd);
-    if (readsize < 0) {
-      AV_LOGW(LOG_TAG,
-              "REDCache - %s fread file is failed! amountdata %d, "
-              "readsize %zu\n",
-              __FUNCTION__, amount_data, readsize);
-      return -1;
-    }
+
+  std::uint64_t shard_size = cache_path->mperiodsize > 0
+                                 ? cache_path->mperiodsize
+                                 : mdownloadcachesize;
+  std::uint64_t key_range = (offset / shard_size) * shard_size;
+  const REDCacheInfo *cacheInfo = cache_path->cache_info_map.find(key_range);
+  if (cacheInfo == nullptr) {
+    return 0;
+  }
+  uint32_t amount_data = cacheInfo->data_amount;
+  ssize_t readsize = pread_full(cache_path->mfd, data, amount_data,
+                                cacheInfo->physical_pos);
+  if (readsize < 0) {
+    AV_LOGW(LOG_TAG,
+            "REDCache - %s pread file is failed! amountdata %d, "
+            "error(%s)\n",
+            __FUNCTION__, amount_data, strerror(errno));
+    return -1;
+  }
+#ifdef POSIX_FADV_WILLNEED
+  // playback reads shards in order, warm up the next one
+  cacheInfo = cache_path->cache_info_map.find(key_range + shard_size);
+  if (cacheInfo != nullptr) {
+    posix_fadvise(cache_path->mfd, static_cast<off_t>(cacheInfo->physical_pos),
+                  cacheInfo->data_amount, POSIX_FADV_WILLNEED);
   }
+#endif
   return amount_data;
 }
 
+void REDFileCache::release_cache(REDCachePath *cache_path) {
+  std::lock_guard<std::mutex> lock(map_mutex);
+  if (--cache_path->mref == 0 && !cache_path->mpin)
+    evict_stalled = false;
+  request_evict();
+}
+
 void REDFileCache::close_cache_file(const std::string &uri) {
   std::lock_guard<std::mutex> lock(map_mutex);
   // AV_LOGW(LOG_TAG, "REDCache - %s\n", __FUNCTION__);
@@ -837,18 +902,19 @@ void REDFileCache::close_cache_file(const std::string &uri) {
     return;
   }
 
+  std::lock_guard<std::mutex> io_lock(cache_path->mio_mutex);
   save_cache_info(cache_path);
-  if (cache_path->mfd_map != nullptr) {
-    fclose(cache_path->mfd_map);
-    cache_path->mfd_map = nullptr;
-  }
 
-  if (cache_path->mfd != nullptr) {
-    fclose(cache_path->mfd);
-    cache_path->mfd = nullptr;
+  if (cache_path->mfd >= 0) {
+    close(cache_path->mfd);
+    cache_path->mfd = -1;
     cache_path->mpin = false;
     // AV_LOGW(LOG_TAG, "REDCache - %s mpin = false uri = %s\n",
     // __FUNCTION__, uri.c_str());
+    if (cache_path->mref == 0) {
+      evict_stalled = false;
+      request_evict();
+    }
   }
   // AV_LOGW(LOG_TAG, "REDCache - %s mpin is:%d uri = %s\n", __FUNCTION__,
   // cache_path->mpin, uri.c_str());
@@ -896,15 +962,16 @@ REDCachePath *REDFileCache::delete_tail_cache() {
   REDCachePath *tail_path = cache_path_tail->prev;
   for (int i = 0; i < cache_path_map.size(); ++i) {
     if (!tail_path) {
-      AV_LOGW("REDCache - %s tail_path is nullptr!\n", __FUNCTION__);
+      AV_LOGW(LOG_TAG, "REDCache - %s tail_path is nullptr!\n", __FUNCTION__);
       return nullptr;
     }
     if (!tail_path->prev || !tail_path->next) {
-      AV_LOGW("REDCache - %s tail_path->prev:%p, tail_path->next:%p\n",
+      AV_LOGW(LOG_TAG,
+              "REDCache - %s tail_path->prev:%p, tail_path->next:%p\n",
               __FUNCTION__, tail_path->prev, tail_path->next);
       return nullptr;
     }
-    if (!tail_path->mpin) {
+    if (tail_path->mref == 0 && !tail_path->mpin) {
       tail_path->prev->next = tail_path->next;
       tail_path->next->prev = tail_path->prev;
       return tail_path;
@@ -925,15 +992,16 @@ REDCachePath *REDFileCache::delete_cache_by_uri(const std::string uri) {
   REDCachePath *tail_path = cache_path_tail->prev;
   for (int i = 0; i < cache_path_map.size(); ++i) {
     if (!tail_path) {
-      AV_LOGW("REDCache - %s tail_path is nullptr!\n", __FUNCTION__);
+      AV_LOGW(LOG_TAG, "REDCache - %s tail_path is nullptr!\n", __FUNCTION__);
       return nullptr;
     }
     if (!tail_path->prev || !tail_path->next) {
-      AV_LOGW("REDCache - %s tail_path->prev:%p, tail_path->next:%p\n",
+      AV_LOGW(LOG_TAG,
+              "REDCache - %s tail_path->prev:%p, tail_path->next:%p\n",
               __FUNCTION__, tail_path->prev, tail_path->next);
       return nullptr;
     }
-    if (!tail_path->mpin &&
+    if (tail_path->mref == 0 && !tail_path->mpin &&
         tail_path->key_url == uri) { // todo(renwei) make sure of this condition
       tail_path->prev->next = tail_path->next;
       tail_path->next->prev = tail_path->prev;
@@ -5,53 +5,52 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include "REDCacheIndex.h"
+#include "REDCacheRangeMap.h"
+
 #define DOWNLOAD_SHARD_SIZE (1024 * 1024)
 #define MAX_CACHE_ENTRIES 10
 #define CONFIG_MAX_LINE 1024
 #define CACHE_MAX_DIR_CAPACITY (60 * 1024 * 1024)
+#define CACHE_EVICT_LOW_WATERMARK 90 // percent of max_dir_capacity
 using namespace std;
 
-struct REDCacheInfo {
-  std::uint32_t data_amount;
-  std::uint64_t physical_pos;
-  std::uint64_t logical_pos;
-  REDCacheInfo() : data_amount(0), physical_pos(0), logical_pos(0) {}
-  REDCacheInfo(std::uint64_t start_pos_, std::uint32_t data_amount_)
-      : data_amount(data_amount_), physical_pos(0), logical_pos(start_pos_) {}
-  REDCacheInfo(std::uint64_t start_pos_, std::uint32_t data_amount_,
-               std::uint64_t physical_pos_)
-      : data_amount(data_amount_), physical_pos(physical_pos_),
-        logical_pos(start_pos_) {}
-};
-
 struct REDCachePath {
   std::string key_url;
   std::string value_cache_path;
   REDCachePath *next;
   REDCachePath *prev;
   bool mpin; // file is in use
-  FILE *mfd;
-  FILE *mfd_map;
+  int mref;  // in-flight io, guarded by map_mutex
+  int mfd;   // local data file, -1 when closed
   int64_t mfilesize;
   int64_t mcachesize;
+  int64_t mdisksize; // bytes of the local data file
   int mperiodsize;
-  std::unordered_map<std::uint64_t, REDCacheInfo *> cache_info_map;
+  REDCacheRangeMap cache_info_map;
+  REDCacheIndex index;
+  /*guards the fields above while mref is held, taken after map_mutex*/
+  std::mutex mio_mutex;
   REDCachePath()
-      : next(nullptr), prev(nullptr), mpin(false), mfd(nullptr),
-        mfd_map(nullptr), mfilesize(-1), mcachesize(0), mperiodsize(0) {}
+      : next(nullptr), prev(nullptr), mpin(false), mref(0), mfd(-1),
+        mfilesize(-1), mcachesize(0), mdisksize(0), mperiodsize(0) {}
   REDCachePath(const std::string &url, const std::string &path)
       : key_url(url), value_cache_path(path), next(nullptr), prev(nullptr),
-        mpin(false), mfd(nullptr), mfd_map(nullptr), mfilesize(-1),
-        mcachesize(0), mperiodsize(0) {}
-  REDCachePath(const std::string &url, const std::string &path, FILE *fd)
+        mpin(false), mref(0), mfd(-1), mfilesize(-1), mcachesize(0),
+        mdisksize(0), mperiodsize(0) {}
+  REDCachePath(const std::string &url, const std::string &path, int fd)
       : key_url(url), value_cache_path(path), next(nullptr), prev(nullptr),
-        mpin(false), mfd(fd), mfd_map(nullptr), mfilesize(-1), mcachesize(0),
-        mperiodsize(0) {}
+        mpin(false), mref(0), mfd(fd), mfilesize(-1), mcachesize(0),
+        mdisksize(0), mperiodsize(0) {}
 };
 
 class REDFileCache {
@@ -77,8 +76,13 @@ public:
   /*set or get total file size*/
   void set_file_size(const std::string &uri, int64_t filesize);
   int64_t get_file_size(const std::string &uri, int &rangesize);
+  /*bytes update_cache_info writes for every shard of the file*/
+  int get_period_size(const std::string &uri);
   /*get the file cache size*/
   int64_t get_cache_size(const std::string &uri);
+  /*bytes cached contiguously from offset, and the first uncached byte*/
+  int64_t get_contiguous_size(const std::string &uri, std::uint64_t offset);
+  int64_t get_next_hole(const std::string &uri, std::uint64_t offset);
   void close_cache_file(const std::string &uri);
 
   void get_all_cache_files(const std::string &dirpath, char ***cached_file,
@@ -89,7 +93,7 @@ public:
 private:
   bool inited{false};
   int mdownloadcachesize{DOWNLOAD_SHARD_SIZE};
-  std::int64_t physical_total_size{0};
+  std::atomic<std::int64_t> physical_total_size{0};
 
 private:
   std::string base_local_path;
@@ -103,6 +107,17 @@ private:
   REDCachePath *cache_path_tail;
   std::mutex map_mutex;
   std::mutex path_mutex;
+
+  /*background eviction, runs on its own thread under map_mutex*/
+  std::thread *mevictthread{nullptr};
+  std::condition_variable evict_cond;
+  bool evict_pending{false};
+  bool evict_abort{false};
+  // over budget with every entry in use, waits for one to be released
+  bool evict_stalled{false};
+  void request_evict();
+  void evict_loop(std::string thread_name);
+
   void cache_path_init();
   void add_to_head(REDCachePath *path);
   void move_to_head(REDCachePath *path);
@@ -111,19 +126,30 @@ private:
 
   /*find the REDCachePath with the uri*/
   REDCachePath *search_cache(const std::string &uri);
-  /*add the file(video) to cachepathmap, when GetDirectoryFiles*/
-  void push_cache(const std::string &uri);
-  /*parse the localmapfile and load the file info to infomap, when
-   * GetDirectoryFiles*/
+  /*add the file(video) to cachepathmap, when GetDirectoryFiles, called with
+   * map_mutex held*/
+  REDCachePath *push_cache(const std::string &uri);
+  /*load the binary index to infomap, when GetDirectoryFiles*/
   int parse_cache_info(REDCachePath *cache_path);
-  /*save the file(video) info to map, when the file closed*/
+  /*parse the legacy text map file, the caller migrates it to the index*/
+  int parse_legacy_cache_info(REDCachePath *cache_path);
+  /*save the file(video) info to index, when the file closed*/
   int save_cache_info(REDCachePath *cache_path);
+  /*map the index of an opened file, rebuild it if it lags the infomap*/
+  int open_cache_index(REDCachePath *cache_path, bool truncate = false);
   /*clear local cache after GetDirectoryFiles(), need recreate cache file*/
   int recreate_cache_file(REDCachePath *cache_path);
   /*create local cache dir, if its null*/
   int create_cache_dir(const std::string &path);
-  /*calculate the size of the directory */
-  int64_t get_dir_size(const std::string &path);
+  /*account the data file growing to end bytes, with mio_mutex held*/
+  void grow_disk_size(REDCachePath *cache_path, int64_t end);
+  /*shard io on a referenced entry, runs under its mio_mutex only*/
+  int write_cache_data(REDCachePath *cache_path, std::uint8_t *data,
+                       std::int64_t start_pos, std::uint32_t length);
+  int read_cache_data(REDCachePath *cache_path, std::uint8_t *data,
+                      std::uint64_t offset, bool created);
+  /*drop the io reference taken under map_mutex*/
+  void release_cache(REDCachePath *cache_path);
   /*unlink(delete) the localfile and localmapfile*/
   bool delete_local_file(const std::string &uri = "");
 };
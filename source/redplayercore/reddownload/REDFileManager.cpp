@@ -106,6 +106,14 @@ int64_t REDFileManager::get_file_size(const std::string &uri,
   }
   return -1;
 }
+int REDFileManager::get_period_size(const std::string &uri,
+                                   const std::string &dirpath) {
+  std::shared_ptr<REDFileCache> filecache = getfilecache(dirpath);
+  if (filecache != nullptr) {
+    return filecache->get_period_size(uri);
+  }
+  return -1;
+}
 /*get the file cache size*/
 int64_t REDFileManager::get_cache_size(const std::string &uri,
                                        const std::string &dirpath) {
@@ -126,6 +134,26 @@ int64_t REDFileManager::get_cache_size(const std::string &uri,
   return 0;
 }
 
+int64_t REDFileManager::get_contiguous_size(const std::string &uri,
+                                            const std::string &dirpath,
+                                            std::uint64_t offset) {
+  std::shared_ptr<REDFileCache> filecache = getfilecache(dirpath);
+  if (filecache != nullptr) {
+    return filecache->get_contiguous_size(uri, offset);
+  }
+  return 0;
+}
+
+int64_t REDFileManager::get_next_hole(const std::string &uri,
+                                      const std::string &dirpath,
+                                      std::uint64_t offset) {
+  std::shared_ptr<REDFileCache> filecache = getfilecache(dirpath);
+  if (filecache != nullptr) {
+    return filecache->get_next_hole(uri, offset);
+  }
+  return offset;
+}
+
 void REDFileManager::close_cache_file(const std::string &uri,
                                       const std::string &dirpath) {
   std::shared_ptr<REDFileCache> filecache = getfilecache(dirpath);
@@ -36,8 +36,15 @@ public:
                      int64_t filesize);
   int64_t get_file_size(const std::string &uri, const std::string &dirpath,
                         int &rangesize);
+  /*bytes update_cache_info writes for every shard of the file*/
+  int get_period_size(const std::string &uri, const std::string &dirpath);
   /*get the file cache size*/
   int64_t get_cache_size(const std::string &uri, const std::string &dirpath);
+  /*bytes cached contiguously from offset, and the first uncached byte*/
+  int64_t get_contiguous_size(const std::string &uri,
+                              const std::string &dirpath, std::uint64_t offset);
+  int64_t get_next_hole(const std::string &uri, const std::string &dirpath,
+                        std::uint64_t offset);
   void close_cache_file(const std::string &uri, const std::string &dirpath);
 
   void get_all_cache_files(const std::string &dirpath, char ***cached_file,
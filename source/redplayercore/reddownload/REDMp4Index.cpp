@@ -0,0 +1,360 @@
+#include "REDMp4Index.h"
+
+#include <algorithm>
+
+#define MP4_TAG(a, b, c, d)                                                    \
+  ((static_cast<uint32_t>(a) << 24) | (static_cast<uint32_t>(b) << 16) |       \
+   (static_cast<uint32_t>(c) << 8) | static_cast<uint32_t>(d))
+
+using namespace std;
+
+namespace {
+
+uint32_t rb32(const uint8_t *p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+uint64_t rb64(const uint8_t *p) {
+  return (static_cast<uint64_t>(rb32(p)) << 32) | rb32(p + 4);
+}
+
+struct Box {
+  uint32_t type;
+  int64_t size;
+  int header;
+};
+
+/*the box at data inside a parent with avail bytes left, false if it does
+ * not fit*/
+bool readbox(const uint8_t *data, int64_t avail, Box &box) {
+  if (avail < 8)
+    return false;
+  int64_t size = rb32(data);
+  box.type = rb32(data + 4);
+  box.header = 8;
+  if (size == 1) {
+    if (avail < 16)
+      return false;
+    uint64_t large = rb64(data + 8);
+    size = large > static_cast<uint64_t>(avail) ? avail + 1 : large;
+    box.header = 16;
+  } else if (size == 0) {
+    size = avail;
+  }
+  if (size < box.header || size > avail)
+    return false;
+  box.size = size;
+  return true;
+}
+
+bool istoplevel(uint32_t type) {
+  switch (type) {
+  case MP4_TAG('f', 't', 'y', 'p'):
+  case MP4_TAG('m', 'o', 'o', 'v'):
+  case MP4_TAG('m', 'd', 'a', 't'):
+  case MP4_TAG('f', 'r', 'e', 'e'):
+  case MP4_TAG('s', 'k', 'i', 'p'):
+  case MP4_TAG('w', 'i', 'd', 'e'):
+  case MP4_TAG('p', 'd', 'i', 'n'):
+  case MP4_TAG('u', 'u', 'i', 'd'):
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+struct REDMp4Index::Track {
+  uint32_t handler{0};
+  uint32_t timescale{0};
+  vector<pair<uint32_t, uint32_t>> stts; // sample count, delta
+  vector<pair<uint32_t, uint32_t>> stsc; // first chunk, samples per chunk
+  uint32_t samplesize{0};                // all samples, 0 if sizes has them
+  uint32_t samplecount{0};
+  vector<uint32_t> sizes;
+  vector<uint64_t> chunks;
+
+  int64_t size(uint32_t sample) const {
+    if (samplesize > 0)
+      return samplesize;
+    return sample < sizes.size() ? sizes[sample] : 0;
+  }
+  bool valid() const {
+    return (handler == MP4_TAG('v', 'i', 'd', 'e') ||
+            handler == MP4_TAG('s', 'o', 'u', 'n')) &&
+           timescale > 0 && samplecount > 0 && !stsc.empty() &&
+           !chunks.empty() && (samplesize > 0 || sizes.size() >= samplecount);
+  }
+};
+
+REDMp4Index::REDMp4Index(int64_t duration_ms) : mduration_ms(duration_ms) {}
+
+bool REDMp4Index::nextrange(const Reader &read, const HoleFinder &hole,
+                            int64_t filesize, int64_t fallback_size,
+                            Range &range) {
+  if (mstate == kNeedData) {
+    Range need{0, 0};
+    mstate = walk(read, filesize, need);
+    if (mstate == kNeedData) {
+      int64_t start = max(need.first, hole(need.first));
+      if (start < need.second) {
+        range = {start, need.second};
+        return true;
+      }
+      // cached but not readable, asking for it again would not help
+      mstate = kUnsupported;
+    }
+  }
+  if (mstate == kReady) {
+    for (const Range &r : mranges) {
+      int64_t end = filesize > 0 ? min(r.second, filesize) : r.second;
+      int64_t start = max(r.first, hole(r.first));
+      if (start < end) {
+        range = {start, end};
+        return true;
+      }
+    }
+    return false;
+  }
+  int64_t end = filesize > 0 ? min(fallback_size, filesize) : fallback_size;
+  int64_t start = hole(0);
+  if (start < end) {
+    range = {start, end};
+    return true;
+  }
+  return false;
+}
+
+bool REDMp4Index::parse(const Reader &read, int64_t filesize) {
+  Range need{0, 0};
+  mstate = walk(read, filesize, need);
+  if (mstate == kNeedData)
+    mstate = kUnsupported;
+  return mstate == kReady;
+}
+
+REDMp4Index::State REDMp4Index::walk(const Reader &read, int64_t filesize,
+                                     Range &range) {
+  while (filesize <= 0 || mpos < filesize) {
+    if (mmoov.second > mmoov.first) {
+      int64_t size = mmoov.second - mmoov.first;
+      vector<uint8_t> moov(size);
+      if (read(mmoov.first, moov.data(), static_cast<int>(size)) < size) {
+        range = mmoov;
+        return kNeedData;
+      }
+      return parsemoov(moov.data(), size) ? kReady : kUnsupported;
+    }
+
+    uint8_t header[16];
+    int len = read(mpos, header, sizeof(header));
+    if (len < 8 || (rb32(header) == 1 && len < 16)) {
+      if (filesize > 0 && mpos + len >= filesize)
+        return kUnsupported; // truncated
+      // after the mdat the moov is most likely all that is left
+      int64_t end = mpos + MP4_PROBE_SIZE;
+      if (mpastmdat && filesize > 0 && filesize - mpos <= MP4_TAIL_SIZE)
+        end = filesize;
+      range = {mpos, filesize > 0 ? min(end, filesize) : end};
+      return kNeedData;
+    }
+    uint32_t type = rb32(header + 4);
+    int64_t size = rb32(header);
+    int64_t header_size = 8;
+    if (size == 1) {
+      size = static_cast<int64_t>(rb64(header + 8));
+      header_size = 16;
+    } else if (size == 0) {
+      if (filesize <= 0)
+        return kUnsupported;
+      size = filesize - mpos;
+    }
+    if (size < header_size || (mpos == 0 && !istoplevel(type)))
+      return kUnsupported;
+
+    switch (type) {
+    case MP4_TAG('m', 'o', 'o', 'v'):
+      if (size > MP4_MAX_MOOV_SIZE)
+        return kUnsupported;
+      mmoov = {mpos, mpos + size};
+      continue;
+    case MP4_TAG('m', 'o', 'o', 'f'):
+    case MP4_TAG('s', 't', 'y', 'p'):
+    case MP4_TAG('s', 'i', 'd', 'x'):
+      return kUnsupported; // fragmented, the samples are not in the moov
+    case MP4_TAG('m', 'd', 'a', 't'):
+      mpastmdat = true;
+      break;
+    default:
+      break;
+    }
+    mpos += size;
+  }
+  return kUnsupported; // no moov
+}
+
+bool REDMp4Index::parsemoov(const uint8_t *data, int64_t size) {
+  Box box;
+  if (!readbox(data, size, box))
+    return false;
+  vector<Track> tracks;
+  for (int64_t pos = box.header; pos + 8 <= size; pos += box.size) {
+    if (!readbox(data + pos, size - pos, box))
+      return false;
+    if (box.type == MP4_TAG('m', 'v', 'e', 'x'))
+      return false; // fragmented
+    if (box.type != MP4_TAG('t', 'r', 'a', 'k'))
+      continue;
+    Track track;
+    if (parsetrak(data + pos + box.header, box.size - box.header, track) &&
+        track.valid())
+      tracks.push_back(std::move(track));
+  }
+  if (tracks.empty())
+    return false;
+
+  vector<Range> ranges;
+  for (const Track &track : tracks) {
+    addranges(track, ranges);
+    if (mfirstsample.second == mfirstsample.first ||
+        track.handler == MP4_TAG('v', 'i', 'd', 'e')) {
+      int64_t start = static_cast<int64_t>(track.chunks[0]);
+      mfirstsample = {start, start + track.size(0)};
+    }
+  }
+  sort(ranges.begin(), ranges.end());
+  for (const Range &r : ranges) {
+    if (r.second <= r.first)
+      continue;
+    if (!mranges.empty() &&
+        r.first <= mranges.back().second + MP4_RANGE_MERGE_GAP) {
+      mranges.back().second = max(mranges.back().second, r.second);
+    } else {
+      mranges.push_back(r);
+    }
+  }
+  return true;
+}
+
+bool REDMp4Index::parsetrak(const uint8_t *data, int64_t size, Track &track) {
+  Box box;
+  for (int64_t pos = 0; pos + 8 <= size; pos += box.size) {
+    if (!readbox(data + pos, size - pos, box))
+      return false;
+    const uint8_t *p = data + pos + box.header;
+    int64_t len = box.size - box.header;
+    switch (box.type) {
+    case MP4_TAG('m', 'd', 'i', 'a'):
+    case MP4_TAG('m', 'i', 'n', 'f'):
+    case MP4_TAG('s', 't', 'b', 'l'):
+      if (!parsetrak(p, len, track))
+        return false;
+      break;
+    case MP4_TAG('m', 'd', 'h', 'd'):
+      if (len >= 24)
+        track.timescale = rb32(p + (p[0] == 1 ? 20 : 12));
+      break;
+    case MP4_TAG('h', 'd', 'l', 'r'):
+      if (len >= 12)
+        track.handler = rb32(p + 8);
+      break;
+    case MP4_TAG('s', 't', 't', 's'): {
+      uint32_t n = len >= 8 ? rb32(p + 4) : 0;
+      if (n > (len - 8) / 8)
+        return false;
+      for (uint32_t i = 0; i < n; i++)
+        track.stts.push_back({rb32(p + 8 + i * 8), rb32(p + 12 + i * 8)});
+    } break;
+    case MP4_TAG('s', 't', 's', 'c'): {
+      uint32_t n = len >= 8 ? rb32(p + 4) : 0;
+      if (n > (len - 8) / 12)
+        return false;
+      for (uint32_t i = 0; i < n; i++)
+        track.stsc.push_back({rb32(p + 8 + i * 12), rb32(p + 12 + i * 12)});
+    } break;
+    case MP4_TAG('s', 't', 's', 'z'):
+      if (len < 12)
+        return false;
+      track.samplesize = rb32(p + 4);
+      track.samplecount = rb32(p + 8);
+      if (track.samplesize == 0) {
+        if (track.samplecount > (len - 12) / 4)
+          return false;
+        track.sizes.resize(track.samplecount);
+        for (uint32_t i = 0; i < track.samplecount; i++)
+          track.sizes[i] = rb32(p + 12 + i * 4);
+      }
+      break;
+    case MP4_TAG('s', 't', 'z', '2'): {
+      if (len < 12)
+        return false;
+      int bits = p[7];
+      track.samplecount = rb32(p + 8);
+      if ((bits != 4 && bits != 8 && bits != 16) ||
+          track.samplecount > (len - 12) * 8 / bits)
+        return false;
+      track.sizes.resize(track.samplecount);
+      for (uint32_t i = 0; i < track.samplecount; i++) {
+        const uint8_t *e = p + 12 + i * bits / 8;
+        if (bits == 16)
+          track.sizes[i] = (e[0] << 8) | e[1];
+        else if (bits == 8)
+          track.sizes[i] = e[0];
+        else
+          track.sizes[i] = (i & 1) ? (e[0] & 0x0f) : (e[0] >> 4);
+      }
+    } break;
+    case MP4_TAG('s', 't', 'c', 'o'):
+    case MP4_TAG('c', 'o', '6', '4'): {
+      int entry = box.type == MP4_TAG('c', 'o', '6', '4') ? 8 : 4;
+      uint32_t n = len >= 8 ? rb32(p + 4) : 0;
+      if (n > (len - 8) / entry)
+        return false;
+      track.chunks.resize(n);
+      for (uint32_t i = 0; i < n; i++)
+        track.chunks[i] =
+            entry == 8 ? rb64(p + 8 + i * 8) : rb32(p + 8 + i * 4);
+    } break;
+    default:
+      break;
+    }
+  }
+  return true;
+}
+
+void REDMp4Index::addranges(const Track &track, vector<Range> &ranges) {
+  // samples decoded before the duration ends, at least the first one
+  uint64_t limit = static_cast<uint64_t>(mduration_ms) * track.timescale / 1000;
+  uint64_t dts = 0;
+  uint64_t needed = 0;
+  for (const auto &e : track.stts) {
+    if (dts >= limit)
+      break;
+    uint64_t n = e.first;
+    if (e.second > 0)
+      n = min<uint64_t>(n, (limit - dts + e.second - 1) / e.second);
+    needed += n;
+    dts += n * e.second;
+  }
+  needed = max<uint64_t>(min<uint64_t>(needed, track.samplecount), 1);
+
+  // stsc runs from its first chunk to the first chunk of the next entry
+  uint32_t sample = 0;
+  for (size_t i = 0; i < track.stsc.size() && sample < needed; i++) {
+    uint64_t last = i + 1 < track.stsc.size() ? track.stsc[i + 1].first
+                                              : track.chunks.size() + 1;
+    last = min<uint64_t>(last, track.chunks.size() + 1);
+    for (uint64_t chunk = max<uint32_t>(track.stsc[i].first, 1);
+         chunk < last && sample < needed; chunk++) {
+      int64_t start = static_cast<int64_t>(track.chunks[chunk - 1]);
+      int64_t bytes = 0;
+      for (uint32_t s = 0; s < track.stsc[i].second && sample < needed;
+           s++, sample++)
+        bytes += track.size(sample);
+      ranges.push_back({start, start + bytes});
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#define MP4_PROBE_SIZE (64 * 1024) // box headers are looked for in this much
+#define MP4_TAIL_SIZE (4 * 1024 * 1024) // a trailing moov comes with the rest
+#define MP4_MAX_MOOV_SIZE (32 * 1024 * 1024)
+#define MP4_RANGE_MERGE_GAP (32 * 1024)
+
+/*walks the top level boxes of an mp4 as its bytes get cached, finds ftyp and
+ * moov wherever they are, and turns the sample tables into the byte ranges
+ * that hold the first seconds of every audio and video track*/
+class REDMp4Index {
+public:
+  typedef std::pair<int64_t, int64_t> Range; // [start, end)
+  /*copies cached bytes at offset, returns fewer where the cache has a hole*/
+  typedef std::function<int(int64_t offset, uint8_t *buf, int size)> Reader;
+  /*first uncached byte at or after offset*/
+  typedef std::function<int64_t(int64_t offset)> HoleFinder;
+
+  explicit REDMp4Index(int64_t duration_ms);
+
+  /*the next range to fetch, false once the moov and the samples of the
+   * duration are cached. What does not parse as a progressive mp4 falls
+   * back to [0, fallback_size)*/
+  bool nextrange(const Reader &read, const HoleFinder &hole, int64_t filesize,
+                 int64_t fallback_size, Range &range);
+  /*parses a fully readable file, the benches use it to find what playback
+   * needs. false if it is no progressive mp4*/
+  bool parse(const Reader &read, int64_t filesize);
+
+  bool ready() const { return mstate == kReady; }
+  bool unsupported() const { return mstate == kUnsupported; }
+  Range moov() const { return mmoov; }
+  /*sample ranges of the duration, sorted and merged*/
+  const std::vector<Range> &ranges() const { return mranges; }
+  /*bytes the first video sample, or the first sample of any track, is in*/
+  Range firstsample() const { return mfirstsample; }
+
+private:
+  enum State { kNeedData, kReady, kUnsupported };
+  struct Track;
+
+  /*kNeedData with range set while boxes or the moov are not cached yet*/
+  State walk(const Reader &read, int64_t filesize, Range &range);
+  bool parsemoov(const uint8_t *data, int64_t size);
+  bool parsetrak(const uint8_t *data, int64_t size, Track &track);
+  void addranges(const Track &track, std::vector<Range> &ranges);
+
+  int64_t mduration_ms;
+  State mstate{kNeedData};
+  int64_t mpos{0}; // top level box the walk is at
+  bool mpastmdat{false};
+  Range mmoov{0, 0};
+  Range mfirstsample{0, 0};
+  std::vector<Range> mranges;
+};
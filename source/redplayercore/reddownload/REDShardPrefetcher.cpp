@@ -0,0 +1,269 @@
+#include "REDShardPrefetcher.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include "REDDownloaderFactory.h"
+#include "REDFileManager.h"
+#include "RedBase.h"
+#include "RedLog.h"
+
+#define LOG_TAG "RedShardPrefetcher"
+
+using namespace std;
+
+namespace {
+/*collects one shard, sized to the full shard since the file cache always
+ * writes whole shards of its period, checked before each write*/
+class PrefetchSink : public DataCallBack {
+public:
+  explicit PrefetchSink(int shardsize) : mdata(shardsize, 0) {}
+  void reset(int len) {
+    mlen = len;
+    msize = 0;
+    moverflow = false;
+    merrcode = 0;
+  }
+  size_t WriteData(uint8_t *ptr, size_t size, void *userdata, int serial,
+                   int err_code) override {
+    if (err_code != 0) {
+      merrcode = err_code;
+      return size;
+    }
+    if (msize + size > static_cast<size_t>(mlen)) {
+      // the server ignored the range, never cache it
+      moverflow = true;
+      return size - 1;
+    }
+    memcpy(mdata.data() + msize, ptr, size);
+    msize += size;
+    RedDownLoadPara *para = reinterpret_cast<RedDownLoadPara *>(userdata);
+    if (para != nullptr)
+      para->downloadsize += size;
+    return size;
+  }
+  void DownloadCallBack(int what, void *arg1, void *arg2, int64_t arg3,
+                        int64_t arg4) override {}
+  int InterruptCallBack() override { return 0; }
+  bool complete() const {
+    return !moverflow && merrcode == 0 && msize == static_cast<size_t>(mlen);
+  }
+
+  std::vector<uint8_t> mdata;
+  int mlen{0};
+  size_t msize{0};
+  bool moverflow{false};
+  int merrcode{0};
+};
+} // namespace
+
+REDShardPrefetcher::REDShardPrefetcher(const std::string &uri,
+                                       const DownLoadOpt &opt, int shardsize,
+                                       int maxconn)
+    : muri(uri), mopt(opt), mshardsize(shardsize) {
+  mmaxconn = min(max(maxconn, 1), SHARD_PREFETCH_MAX_CONN);
+  mconn = min(mmaxconn, SHARD_PREFETCH_INIT_CONN);
+  // plain ranged transfers on the workers, never a preload
+  mopt.PreDownLoadSize = 0;
+  mopt.DownLoadType = DOWNLOADDATA;
+  mopt.readasync = true;
+  mopt.islive = false;
+  mopt.cdn_player_size = 0;
+  for (int i = 0; i < mmaxconn; i++) {
+    mthreads.push_back(new std::thread(std::bind(
+        &REDShardPrefetcher::worker_loop, this, "REDShardPrefetch")));
+  }
+}
+
+REDShardPrefetcher::~REDShardPrefetcher() { stop(); }
+
+void REDShardPrefetcher::stop() {
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    babort = true;
+    mqueue.clear();
+    for (auto handle : mhandles)
+      handle->pause(false);
+    m_cond.notify_all();
+    m_donecond.notify_all();
+  }
+  for (auto thread : mthreads) {
+    if (thread->joinable())
+      thread->join();
+    delete thread;
+  }
+  mthreads.clear();
+}
+
+int REDShardPrefetcher::getconnections() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  return mconn;
+}
+
+bool REDShardPrefetcher::iscached(int64_t pos, int len) {
+  return REDFileManager::getInstance()->get_contiguous_size(
+             muri, mopt.cache_file_dir, pos) >= len;
+}
+
+void REDShardPrefetcher::prefetch(const std::string &url, int64_t pos,
+                                  int64_t filesize) {
+  if (filesize <= 0 || url.empty())
+    return;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (babort)
+    return;
+  murl = url;
+  mfilesize = filesize;
+  mqueue.clear();
+  for (int64_t shard = pos; shard < filesize &&
+                            static_cast<int>(mqueue.size()) + mbusy < mconn;
+       shard += mshardsize) {
+    int len = static_cast<int>(min<int64_t>(mshardsize, filesize - shard));
+    if (minflight.count(shard) > 0 || iscached(shard, len))
+      continue;
+    mqueue.push_back(shard);
+  }
+  if (!mqueue.empty())
+    m_cond.notify_all();
+}
+
+bool REDShardPrefetcher::waitshard(int64_t pos, int timeout_ms) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  return m_donecond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] {
+    return babort || minflight.count(pos) == 0;
+  });
+}
+
+void REDShardPrefetcher::updateconnections(int len) {
+  mroundbytes += len;
+  if (++mroundshards < mconn)
+    return;
+  int64_t duration = CurrentTimeUs() - mroundstart;
+  int64_t rate = duration > 0 ? mroundbytes * 1000000 / duration : 0;
+  int conn = mconn;
+  if (mlastrate > 0 && rate * 10 < mlastrate * 9) {
+    // the last step did not pay off or the network got worse, step back
+    conn = mlastconn < mconn ? mlastconn : mconn - 1;
+  } else if (mlastrate == 0 || rate * 10 > mlastrate * 11) {
+    conn = mconn + 1;
+  }
+  conn = min(max(conn, 1), mmaxconn);
+  if (conn != mconn) {
+    AV_LOGI(LOG_TAG, "%p %s, rate %" PRId64 " B/s, connections %d -> %d\n",
+            this, __FUNCTION__, rate, mconn, conn);
+  }
+  mlastrate = rate;
+  mlastconn = mconn;
+  mconn = conn;
+  mroundstart = 0;
+  mroundbytes = 0;
+  mroundshards = 0;
+}
+
+void REDShardPrefetcher::worker_loop(std::string thread_name) {
+#ifdef __APPLE__
+  pthread_setname_np(thread_name.c_str());
+#elif __ANDROID__
+  pthread_setname_np(pthread_self(), thread_name.c_str());
+#elif __HARMONY__
+  pthread_setname_np(pthread_self(), thread_name.c_str());
+#endif
+
+  // RedCurl keeps pointing at the para and the sink after a transfer, both
+  // live as long as the handle
+  PrefetchSink sink(mshardsize);
+  RedDownLoadPara para;
+  RedDownLoad *handle = nullptr;
+  while (true) {
+    int64_t pos = 0;
+    int len = 0;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [&] {
+        return babort || (!mqueue.empty() && mbusy < mconn);
+      });
+      if (babort)
+        break;
+      pos = mqueue.front();
+      mqueue.pop_front();
+      len = static_cast<int>(min<int64_t>(mshardsize, mfilesize - pos));
+      para.url = murl;
+      minflight.insert(pos);
+      mbusy++;
+      if (mroundstart == 0)
+        mroundstart = CurrentTimeUs();
+    }
+
+    sink.reset(len);
+    para.cdn_url = para.url;
+    para.range_start = pos;
+    para.range_end = pos + len - 1;
+    para.downloadsize = pos;
+    para.filesize = mfilesize;
+    para.rangesize = mshardsize;
+    para.mdatacb = &sink;
+    para.mopt = &mopt;
+    if (handle == nullptr) {
+      handle = RedDownLoadFactory::create(&para);
+      std::unique_lock<std::mutex> lock(m_mutex);
+      if (handle != nullptr)
+        mhandles.push_back(handle);
+      if (babort && handle != nullptr)
+        handle->pause(false);
+    }
+    if (handle != nullptr)
+      handle->rundownload(&para);
+
+    bool complete = handle != nullptr && sink.complete();
+    // the file cache writes every shard in chunks of the entry's period,
+    // which is only the sink size while both agree
+    bool mismatch = complete && REDFileManager::getInstance()->get_period_size(
+                                    muri, mopt.cache_file_dir) != mshardsize;
+    if (complete && !mismatch) {
+      REDFileManager::getInstance()->update_cache_info(
+          muri, mopt.cache_file_dir, sink.mdata.data(), pos, len);
+    } else if (!complete) {
+      AV_LOGW(LOG_TAG,
+              "%p %s, shard %" PRId64 " failed, size %zu/%d, error %d\n",
+              this, __FUNCTION__, pos, sink.msize, len, sink.merrcode);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    minflight.erase(pos);
+    mbusy--;
+    if (mismatch) {
+      AV_LOGW(LOG_TAG, "%p %s, cache shards are not %d bytes, stop\n", this,
+              __FUNCTION__, mshardsize);
+      babort = true;
+      mqueue.clear();
+    } else if (complete) {
+      updateconnections(len);
+    } else if (sink.moverflow) {
+      AV_LOGW(LOG_TAG, "%p %s, range not honored, stop prefetching\n", this,
+              __FUNCTION__);
+      babort = true;
+      mqueue.clear();
+    } else if (!babort) {
+      // let the reader fetch it and back off to one connection
+      mconn = 1;
+      mlastrate = 0;
+      mroundstart = 0;
+      mroundbytes = 0;
+      mroundshards = 0;
+    }
+    m_donecond.notify_all();
+    m_cond.notify_all();
+  }
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (handle != nullptr) {
+    mhandles.erase(std::remove(mhandles.begin(), mhandles.end(), handle),
+                   mhandles.end());
+    lock.unlock();
+    delete handle;
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "REDDownloadListen.h"
+#include "REDDownloader.h"
+
+#define SHARD_PREFETCH_MAX_CONN 4
+#define SHARD_PREFETCH_INIT_CONN 2
+#define SHARD_PREFETCH_POLL_MS 100 // reader interrupt checks while waiting
+
+/*fetches the shards ahead of the reader on their own connections and stores
+ * them in the file cache, where loadfromfile picks them up in order. the
+ * number of connections follows the throughput measured per round of shards*/
+class REDShardPrefetcher {
+public:
+  REDShardPrefetcher(const std::string &uri, const DownLoadOpt &opt,
+                     int shardsize, int maxconn);
+  ~REDShardPrefetcher();
+
+  /*queue the uncached shards from pos on, replacing the queued ones*/
+  void prefetch(const std::string &url, int64_t pos, int64_t filesize);
+  /*wait while the shard at pos is in flight, true once it left the flight,
+   * false on timeout with the shard still in flight*/
+  bool waitshard(int64_t pos, int timeout_ms);
+  /*abort the transfers and join the workers*/
+  void stop();
+  int getconnections();
+
+private:
+  void worker_loop(std::string thread_name);
+  /*account a finished shard, called with m_mutex held*/
+  void updateconnections(int len);
+  bool iscached(int64_t pos, int len);
+
+  std::string muri;
+  DownLoadOpt mopt;
+  int mshardsize;
+  int mmaxconn;
+  int mconn; // adaptive, connections in use and shards queued ahead
+  int mbusy{0};
+  std::string murl;
+  int64_t mfilesize{-1};
+  bool babort{false};
+  std::deque<int64_t> mqueue;
+  std::set<int64_t> minflight;
+  std::vector<RedDownLoad *> mhandles; // in flight, paused by stop()
+  std::vector<std::thread *> mthreads;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::condition_variable m_donecond;
+
+  /*one round is mconn shards, its rate decides the next mconn*/
+  int64_t mroundstart{0};
+  int64_t mroundbytes{0};
+  int mroundshards{0};
+  int64_t mlastrate{0}; // bytes per second
+  int mlastconn{0};
+};
@@ -3,6 +3,7 @@
 #include "REDURLParser.h"
 #include "RedDownloadConfig.h"
 #include "RedLog.h"
+#include "RedTrace.h"
 
 #define LOG_TAG "RedThreadPool"
 
@@ -65,8 +66,15 @@ void REDThreadPool::thread_loop(std::string thread_name) {
     taskptr task = take_task();
     if (task == nullptr)
       continue;
-    bool ret = task->run();
-    AV_LOGW(LOG_TAG, "preload task %p complete %d\n", task.get(), ret);
+    bool ret = false;
+    {
+      RED_TRACE_SCOPE(RED_TRACE_DOWNLOAD, "preload_task", 0);
+      ret = task->run();
+      // a staged preload goes on with its next range on the same handle
+      while (m_pool_start && task->nextpreload())
+        ret = task->run();
+    }
+    AV_LOGD(LOG_TAG, "preload task %p complete %d\n", task.get(), ret);
   }
 }
 
@@ -80,7 +88,7 @@ std::shared_ptr<REDDownLoadTask> REDThreadPool::take_task() {
   if (!mprequeue.empty() && m_pool_start) {
     task = mprequeue.front();
     mprequeue.pop_front();
-    AV_LOGW(LOG_TAG, "take_task %p  size %zu in waiting queue\n", task.get(),
+    AV_LOGD(LOG_TAG, "take_task %p  size %zu in waiting queue\n", task.get(),
             mprequeue.size());
   }
 
@@ -13,6 +13,8 @@
 #include <vector>
 
 #include "REDDownloadTask.h"
+#include <condition_variable>
+#include <mutex>
 using namespace std;
 
 class REDThreadPool {
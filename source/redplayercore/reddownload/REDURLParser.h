@@ -4,8 +4,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <iostream>
 #include <list>
+#include <memory>
 #include <string>
 
 using namespace std;
@@ -1,4 +1,5 @@
 #include "RedDownloadConfig.h"
+#include <limits.h>
 
 std::once_flag RedDownloadConfig::redDownloadConfigOnceFlag;
 RedDownloadConfig *RedDownloadConfig::redDownloadConfigInstance = nullptr;
@@ -32,6 +33,9 @@ RedDownloadConfig::RedDownloadConfig() {
       {SHAREDNS_LIVE_KEY, 0},
       {IP_DOWNGRADE_KEY, 0},
       {RANGE_SIZE_ONLY_CDN_KEY, 0},
+      {CURL_SHARED_MULTI_KEY, 0},
+      {PARALLEL_SHARD_KEY, 0},
+      {HAPPY_EYEBALLS_KEY, 0},
   };
   internal_config_map_ = {};
 }
@@ -29,6 +29,9 @@
 #define IP_DOWNGRADE_KEY "ip_downgrade_live"
 #define ENABLE_KUAISHOU_LOG "enable_kuaishou_log"
 #define RANGE_SIZE_ONLY_CDN_KEY "range_size_only_cdn"
+#define CURL_SHARED_MULTI_KEY "curl_shared_multi"
+#define PARALLEL_SHARD_KEY "parallel_shard_fetch"
+#define HAPPY_EYEBALLS_KEY "happy_eyeballs"
 // Internal
 
 class RedDownloadConfig final {
@@ -5,8 +5,10 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <fstream>
 #include <json.hpp>
 
+#include "REDCacheIndex.h"
 #include "REDURLParser.h"
 #include "RedDownloadConfig.h"
 #include "RedLog.h"
@@ -20,6 +22,14 @@ using Json = nlohmann::json;
 static std::once_flag RedDnsCacheOnceFlag;
 REDDnsCache *REDDnsCache::minstance = nullptr;
 
+static time_t ExpiresOf(int ttl) {
+  return time(nullptr) + (ttl > 0 ? ttl : DNS_CACHE_DEFAULT_TTL_S);
+}
+
+static bool TooStale(time_t expires, time_t now) {
+  return expires > 0 && expires + DNS_CACHE_MAX_STALE_S < now;
+}
+
 REDDnsCache *REDDnsCache::getinstance() {
   std::call_once(RedDnsCacheOnceFlag,
                  [&] { minstance = new (std::nothrow) REDDnsCache(); });
@@ -222,6 +232,7 @@ void REDDnsCache::UpdateAddr(string hostname, string curip, int64_t speed,
           iter->speed = speed;
         iter->usecounts++;
         if (err == 0) {
+          // a known address keeps the expiry of its dns answer
           iter->successcounts++;
           iter->bvalid = true;
         }
@@ -241,6 +252,7 @@ void REDDnsCache::UpdateAddr(string hostname, string curip, int64_t speed,
         ipaddrinfo.speed = speed;
       ipaddrinfo.usecounts++;
       ipaddrinfo.successcounts++;
+      ipaddrinfo.expires = ExpiresOf(0);
       hostdata->vecipinfo.push_back(ipaddrinfo);
     }
   } else if (err == 0) {
@@ -256,6 +268,7 @@ void REDDnsCache::UpdateAddr(string hostname, string curip, int64_t speed,
       ipaddrinfo.speed = speed;
     ipaddrinfo.usecounts++;
     ipaddrinfo.successcounts++;
+    ipaddrinfo.expires = ExpiresOf(0);
     HostData *hostdata = new HostData;
     hostdata->userdata = new UserData(hostname, reinterpret_cast<void *>(this));
     hostdata->vecipinfo.push_back(ipaddrinfo);
@@ -264,6 +277,12 @@ void REDDnsCache::UpdateAddr(string hostname, string curip, int64_t speed,
   if (err) {
     m_cond.notify_all();
   }
+  bool save = !mcachefile.empty() &&
+              time(nullptr) - mlastsave >= DNS_CACHE_SAVE_INTERVAL_S;
+  lock.unlock();
+  if (save) {
+    Save();
+  }
 }
 
 string REDDnsCache::GetIpAddr(string hostname) {
@@ -272,6 +291,7 @@ string REDDnsCache::GetIpAddr(string hostname) {
   double maxscore = 0;
   int64_t maxspeed = 0;
   int minrtt = INT_MAX;
+  time_t now = time(nullptr);
   if (RedDownloadConfig::getinstance()->get_config_value(FORCE_USE_IPV6) > 0) {
     string ipaddr4;
     double maxscorev4 = 0;
@@ -287,7 +307,7 @@ string REDDnsCache::GetIpAddr(string hostname) {
       HostData *hostdata = infoMapIter->second;
       vector<IpAddrInfo>::iterator iter = hostdata->vecipinfo.begin();
       for (; iter != hostdata->vecipinfo.end(); ++iter) {
-        if (!iter->bvalid)
+        if (!iter->bvalid || TooStale(iter->expires, now))
           continue;
         if (iter->family == AF_INET6) {
           double score =
@@ -334,7 +354,7 @@ string REDDnsCache::GetIpAddr(string hostname) {
       HostData *hostdata = infoMapIter->second;
       vector<IpAddrInfo>::iterator iter = hostdata->vecipinfo.begin();
       for (; iter != hostdata->vecipinfo.end(); ++iter) {
-        if (!iter->bvalid)
+        if (!iter->bvalid || TooStale(iter->expires, now))
           continue;
         double score =
             static_cast<double>(iter->successcounts) / (iter->usecounts);
@@ -356,6 +376,157 @@ string REDDnsCache::GetIpAddr(string hostname) {
   return ipaddr;
 }
 
+bool REDDnsCache::BetterAddr(const IpAddrInfo &a, const IpAddrInfo &b) {
+  double scorea = static_cast<double>(a.successcounts) / a.usecounts;
+  double scoreb = static_cast<double>(b.successcounts) / b.usecounts;
+  if (scorea != scoreb)
+    return scorea > scoreb;
+  if (a.speed != b.speed)
+    return a.speed > b.speed;
+  return a.rtt < b.rtt;
+}
+
+vector<string> REDDnsCache::GetIpCandidates(string hostname, size_t count) {
+  vector<IpAddrInfo> v4, v6;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto infoMapIter = mdnscache.find(hostname);
+    if (infoMapIter == mdnscache.end())
+      return {};
+    time_t now = time(nullptr);
+    for (auto &info : infoMapIter->second->vecipinfo) {
+      if (!info.bvalid || TooStale(info.expires, now))
+        continue;
+      (info.family == AF_INET6 ? v6 : v4).push_back(info);
+    }
+  }
+  std::stable_sort(v4.begin(), v4.end(), BetterAddr);
+  std::stable_sort(v6.begin(), v6.end(), BetterAddr);
+  // RFC 8305 section 4, one address of the preferred family first
+  bool v6first = !v6.empty() && (v4.empty() || !BetterAddr(v4[0], v6[0]));
+  if (RedDownloadConfig::getinstance()->get_config_value(FORCE_USE_IPV6) > 0)
+    v6first = !v6.empty();
+  vector<IpAddrInfo> &first = v6first ? v6 : v4;
+  vector<IpAddrInfo> &second = v6first ? v4 : v6;
+  vector<string> ips;
+  for (size_t i = 0; ips.size() < count && i < max(v4.size(), v6.size());
+       i++) {
+    if (i < first.size())
+      ips.push_back(first[i].ipaddr);
+    if (i < second.size() && ips.size() < count)
+      ips.push_back(second[i].ipaddr);
+  }
+  return ips;
+}
+
+void REDDnsCache::Load(string dir) {
+  if (dir.empty())
+    return;
+  if (dir.back() != '/')
+    dir += '/';
+  std::ifstream in(dir + CACHE_DNS_FILE);
+  Json json;
+  try {
+    if (in)
+      json = Json::parse(in);
+  } catch (Json::exception &e) {
+    AV_LOGW(LOG_TAG, "%s, catch json exception, %s\n", __FUNCTION__, e.what());
+  }
+  std::unique_lock<std::mutex> lock(m_mutex);
+  mcachefile = dir + CACHE_DNS_FILE;
+  if (!json.is_object() ||
+      json.value("version", 0) != DNS_CACHE_FILE_VERSION ||
+      !json["hosts"].is_object()) {
+    return;
+  }
+  time_t now = time(nullptr);
+  int loaded = 0;
+  try {
+    for (auto &host : json["hosts"].items()) {
+      HostData *hostdata = mdnscache[host.key()];
+      if (hostdata == nullptr) {
+        hostdata = new HostData;
+        hostdata->userdata =
+            new UserData(host.key(), reinterpret_cast<void *>(this));
+        mdnscache[host.key()] = hostdata;
+      }
+      for (auto &entry : host.value()) {
+        IpAddrInfo info;
+        info.ipaddr = entry.value("ip", "");
+        info.expires = entry.value("expires", static_cast<time_t>(0));
+        if (info.ipaddr.empty() || TooStale(info.expires, now))
+          continue;
+        info.family = GetIpFamily(info.ipaddr);
+        info.successcounts = entry.value("success", 1);
+        info.usecounts = max<int64_t>(entry.value("use", 1), 1);
+        info.speed = entry.value("speed", 0);
+        info.rtt = entry.value("rtt", MAX_DNSCACHE_RTT_DURATION);
+        info.bvalid = entry.value("valid", false);
+        auto iter = std::find_if(
+            hostdata->vecipinfo.begin(), hostdata->vecipinfo.end(),
+            [&](const IpAddrInfo &i) { return i.ipaddr == info.ipaddr; });
+        if (iter == hostdata->vecipinfo.end()) {
+          hostdata->vecipinfo.push_back(info);
+          loaded++;
+        }
+      }
+    }
+  } catch (Json::exception &e) {
+    AV_LOGW(LOG_TAG, "%s, catch json exception, %s\n", __FUNCTION__, e.what());
+  }
+  AV_LOGI(LOG_TAG, "%s, %d addresses from %s\n", __FUNCTION__, loaded,
+          mcachefile.c_str());
+}
+
+string REDDnsCache::Serialize() {
+  Json hosts = Json::object();
+  time_t now = time(nullptr);
+  for (auto &mapinter : mdnscache) {
+    Json entries = Json::array();
+    for (auto &info : mapinter.second->vecipinfo) {
+      if (TooStale(info.expires, now))
+        continue;
+      entries.push_back({{"ip", info.ipaddr},
+                         {"expires", info.expires},
+                         {"success", info.successcounts},
+                         {"use", info.usecounts},
+                         {"speed", info.speed},
+                         {"rtt", info.rtt},
+                         {"valid", info.bvalid}});
+    }
+    if (!entries.empty())
+      hosts[mapinter.first] = entries;
+  }
+  Json json = {{"version", DNS_CACHE_FILE_VERSION}, {"hosts", hosts}};
+  return json.dump();
+}
+
+void REDDnsCache::Save() {
+  string path, data;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (mcachefile.empty())
+      return;
+    path = mcachefile;
+    data = Serialize();
+    mlastsave = time(nullptr);
+  }
+  // a crash while writing leaves the old table in place
+  std::lock_guard<std::mutex> lock(m_save_mutex);
+  string tmppath = path + ".tmp";
+  FILE *file = fopen(tmppath.c_str(), "w");
+  if (file == nullptr) {
+    AV_LOGW(LOG_TAG, "%s, open %s failed\n", __FUNCTION__, tmppath.c_str());
+    return;
+  }
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(tmppath.c_str(), path.c_str()) != 0) {
+    AV_LOGW(LOG_TAG, "%s, write %s failed\n", __FUNCTION__, path.c_str());
+    unlink(tmppath.c_str());
+  }
+}
+
 void REDDnsCache::run() {
   {
     std::unique_lock<std::mutex> lock(m_mutex);
@@ -379,6 +550,7 @@ void REDDnsCache::RunLoop(std::string thread_name) {
   AV_LOGW(LOG_TAG, "run thread %p begin!\n", this);
   do {
     ParseDns();
+    Save();
     {
       std::unique_lock<std::mutex> lock(m_mutex);
       if (babort)
@@ -516,18 +688,32 @@ void REDDnsCache::ParseDnsCares(vector<string> &hostnames) {
   } else {
     AV_LOGE(LOG_TAG, "%s, ares get dnsserver failed!\n", __FUNCTION__);
   }
+#elif defined(__HEADLESS__)
+  // the linux benches point c-ares at a local stand-in, other platforms keep
+  // the system servers
+  string dnsservers;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    dnsservers = mdnsderverip;
+  }
+  if (!dnsservers.empty() &&
+      ares_set_servers_ports_csv(channel, dnsservers.c_str()) != ARES_SUCCESS) {
+    ares_destroy(channel);
+    return;
+  }
 #endif
   ares_set_socket_functions(channel, &REDDnsCache::default_functions, nullptr);
+  // getaddrinfo asks for both families and keeps the ttl of each answer
+  struct ares_addrinfo_hints hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
   for (auto hostname : hostnames) {
     UserData *userdata = mdnscache[hostname]->userdata;
     // userdata->hostname = hostname.c_str();
     userdata->cacheptr = reinterpret_cast<void *>(this);
-    ares_gethostbyname(channel, hostname.c_str(), AF_INET,
-                       &REDDnsCache::Cares_Cb,
-                       reinterpret_cast<void *>(userdata));
-    ares_gethostbyname(channel, hostname.c_str(), AF_INET6,
-                       &REDDnsCache::Cares_Cb,
-                       reinterpret_cast<void *>(userdata));
+    ares_getaddrinfo(channel, hostname.c_str(), nullptr, &hints,
+                     &REDDnsCache::Cares_Cb,
+                     reinterpret_cast<void *>(userdata));
   }
   int count = 1;
   int nfds = 0;
@@ -636,13 +822,16 @@ void REDDnsCache::ResetPing() {
 }
 
 void REDDnsCache::Cares_Cb(void *userdata, int status, int timeout,
-                           struct hostent *addrinfo) {
-  if (userdata == NULL)
+                           struct ares_addrinfo *addrinfo) {
+  if (userdata == NULL) {
+    ares_freeaddrinfo(addrinfo);
     return;
+  }
   UserData *data = reinterpret_cast<UserData *>(userdata);
   REDDnsCache *thiz = reinterpret_cast<REDDnsCache *>(data->cacheptr);
   if (status == ARES_SUCCESS) {
     thiz->PreParePing(data->hostname, addrinfo);
+    ares_freeaddrinfo(addrinfo);
   } else {
     AV_LOGW(LOG_TAG, "%s cares parse hostname %s failed, ret %d!\n",
             __FUNCTION__, data->hostname.c_str(), status);
@@ -733,33 +922,41 @@ void REDDnsCache::GetHttpDns(vector<string> &hostnames) { // TODO: add ttl
   return;
 }
 
-void REDDnsCache::PreParePing(string hostname, struct hostent *addrinfo) {
+void REDDnsCache::PreParePing(string hostname,
+                              struct ares_addrinfo *addrinfo) {
   if (addrinfo == NULL || hostname.empty())
     return;
-  char **pptr = addrinfo->h_addr_list;
-  for (; *pptr != NULL; pptr++) {
+  struct ares_addrinfo_node *node = addrinfo->nodes;
+  for (; node != NULL; node = node->ai_next) {
     char ip[96] = {0};
-    inet_ntop(addrinfo->h_addrtype, *pptr, ip, sizeof(ip));
+    if (node->ai_family == AF_INET) {
+      struct sockaddr_in *in4 = (struct sockaddr_in *)node->ai_addr;
+      inet_ntop(AF_INET, &in4->sin_addr, ip, sizeof(ip));
+    } else if (node->ai_family == AF_INET6) {
+      struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)node->ai_addr;
+      inet_ntop(AF_INET6, &in6->sin6_addr, ip, sizeof(ip));
+    }
     if (strlen(ip) > 0) {
       if (RedDownloadConfig::getinstance()->get_config_value(PARSE_NO_PING) >
           0) {
         PingFdInfo fdinfo;
-        fdinfo.family = addrinfo->h_addrtype;
+        fdinfo.family = node->ai_family;
         fdinfo.ipaddr = ip;
         fdinfo.count = 1;
+        fdinfo.ttl = node->ai_ttl;
         vector<string> hostnames;
         hostnames.push_back(hostname);
         fdinfo.hostnames = hostnames;
         PushAddrInfo(&fdinfo, 0);
       } else {
-        PreParePingSingle(hostname, ip, addrinfo->h_addrtype);
+        PreParePingSingle(hostname, ip, node->ai_family, node->ai_ttl);
       }
     }
   }
 }
 
 void REDDnsCache::PreParePingSingle(string hostname, const char *ip,
-                                    int family) {
+                                    int family, int ttl) {
   auto iter = mfdinfo.begin();
   for (; iter != mfdinfo.end(); ++iter) {
     if (strcmp(iter->ipaddr.c_str(), ip) == 0) {
@@ -777,6 +974,7 @@ void REDDnsCache::PreParePingSingle(string hostname, const char *ip,
     fdinfo.family = family;
     fdinfo.fd = fd;
     fdinfo.count = 1;
+    fdinfo.ttl = ttl;
     struct timeval time_cur;
     gettimeofday(&time_cur, NULL);
     fdinfo.lasttime = time_cur.tv_sec;
@@ -835,6 +1033,7 @@ void REDDnsCache::PushAddrInfo(PingFdInfo *fdinfo, int rtt) {
       if (ipiter->ipaddr == fdinfo->ipaddr) {
         ipiter->rtt =
             (rtt + ipiter->rtt * (fdinfo->count - 1)) / (fdinfo->count);
+        ipiter->expires = ExpiresOf(fdinfo->ttl);
         if (rtt < MAX_DNSCACHE_RTT_DURATION && rtt >= 0) {
           ipiter->bvalid = true;
         }
@@ -849,6 +1048,7 @@ void REDDnsCache::PushAddrInfo(PingFdInfo *fdinfo, int rtt) {
       ipaddrinfo.ipaddr = fdinfo->ipaddr;
       ipaddrinfo.family = fdinfo->family;
       ipaddrinfo.rtt = rtt;
+      ipaddrinfo.expires = ExpiresOf(fdinfo->ttl);
       if (rtt < MAX_DNSCACHE_RTT_DURATION && rtt >= 0) {
         ipaddrinfo.bvalid = true;
       }
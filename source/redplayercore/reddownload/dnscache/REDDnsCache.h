@@ -29,6 +29,13 @@ extern "C" {
 
 #include "REDDownloadListen.h"
 #include "REDPing.h"
+#include <condition_variable>
+#include <mutex>
+
+#define DNS_CACHE_FILE_VERSION 1
+#define DNS_CACHE_DEFAULT_TTL_S 600 // httpdns answers carry none
+#define DNS_CACHE_MAX_STALE_S 86400 // served stale while a refresh runs
+#define DNS_CACHE_SAVE_INTERVAL_S 60
 using namespace std;
 struct UserData {
   string hostname;
@@ -49,13 +56,19 @@ public:
   void UpdateAddr(string hostname, string curip, int64_t speed, int err);
   void run();
   string GetIpAddr(string hostname);
+  /*the best addresses of the host to race, families interleaved starting
+   * with the preferred one*/
+  vector<string> GetIpCandidates(string hostname, size_t count);
   string GetValidHost();
+  /*reads the table saved in dir, later saves go there too*/
+  void Load(string dir);
+  void Save();
 
 private:
   REDDnsCache();
   static REDDnsCache *minstance;
   static void Cares_Cb(void *userdata, int status, int timeout,
-                       struct hostent *addrinfo);
+                       struct ares_addrinfo *addrinfo);
   bool babort;
   int mtimescale; // ms
   std::thread *mthread = nullptr;
@@ -69,6 +82,7 @@ private:
     int64_t speed{0};
     bool bvalid{false};
     int rtt{MAX_DNSCACHE_RTT_DURATION};
+    time_t expires{0}; // ttl end, in seconds since epoch
   };
   struct HostData {
     UserData *userdata{nullptr};
@@ -81,6 +95,7 @@ private:
     int fd{0};
     int count{0};
     time_t lasttime{0};
+    int ttl{0};
   };
   vector<PingFdInfo> mfdinfo;
   unordered_map<string, HostData *> mdnscache;
@@ -88,6 +103,9 @@ private:
   string mdnsderverip;
   DownLoadListen *mdownloadcb;
   int mhttpdns{0};
+  string mcachefile;
+  time_t mlastsave{0};
+  std::mutex m_save_mutex;
   const char *httpdnsServer = "https://gslb.xiaohongshu.com/domain?domains=";
 
 private:
@@ -102,8 +120,11 @@ private:
   void ClearFdInfo();
   void RecvPingInfo(int fd, PingFdInfo *fdinfo);
   void PushAddrInfo(PingFdInfo *fdinfo, int rtt);
-  void PreParePing(string hostname, struct hostent *addrinfo);
-  void PreParePingSingle(string hostname, const char *ip, int family);
+  void PreParePing(string hostname, struct ares_addrinfo *addrinfo);
+  void PreParePingSingle(string hostname, const char *ip, int family,
+                         int ttl = 0);
+  static bool BetterAddr(const IpAddrInfo &a, const IpAddrInfo &b);
+  string Serialize();
   string GetHostDnsServerIp();
   void ResetPing();
   int Add_fds(fd_set *readers, fd_set *writers);
@@ -0,0 +1,15 @@
+#include "REDHappyEyeballs.h"
+
+std::string ResolveAddrList(const std::vector<std::string> &ips) {
+  std::string list;
+  for (const std::string &ip : ips) {
+    if (!list.empty())
+      list += ",";
+    // an IPv6 address is bracketed, its colons would end the entry
+    if (ip.find(':') != std::string::npos)
+      list += "[" + ip + "]";
+    else
+      list += ip;
+  }
+  return list;
+}
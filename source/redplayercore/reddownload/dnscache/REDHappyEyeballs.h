@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#define HAPPY_EYEBALLS_ATTEMPT_DELAY_MS 250 // RFC 8305 recommended value
+#define HAPPY_EYEBALLS_MAX_CANDIDATES 4
+
+/*the address list of a CURLOPT_RESOLVE entry. curl connects to the first
+ * address, starts the other family HAPPY_EYEBALLS_ATTEMPT_DELAY_MS later and
+ * moves on to the next address of a family when one fails or times out*/
+std::string ResolveAddrList(const std::vector<std::string> &ips);
@@ -121,9 +121,6 @@ int RecvPing(int sockfd, const char *ip, int family, int &seqnum) {
   }
   struct sockaddr_in from;
   struct sockaddr_in6 from6;
-  struct timeval timeo;
-  timeo.tv_sec = 5000 / 1000;
-  timeo.tv_usec = 5000 % 1000;
   pid_t pid;
   pid = getpid();
   // AV_LOGW(LOG_TAG,"%s, ip %s, pid %d, family %d, fd %d\n", __FUNCTION__,
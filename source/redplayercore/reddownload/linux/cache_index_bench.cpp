@@ -0,0 +1,190 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "REDFileManager.h"
+#include "RedLog.h"
+
+#define BENCH_PERIOD_SIZE 4096
+
+namespace {
+
+int64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string entryUri(int i) {
+  char uri[32];
+  snprintf(uri, sizeof(uri), "bench%05d", i);
+  return uri;
+}
+
+/*entries of records shards each, every shard holds record_bytes*/
+bool populate(const std::string &dir, int entries, int records,
+              int record_bytes) {
+  REDFileManager *fm = REDFileManager::getInstance();
+  fm->set_dir_capacity(dir, entries * 2, INT64_MAX, BENCH_PERIOD_SIZE);
+  // a shard is always written whole
+  std::vector<uint8_t> data(BENCH_PERIOD_SIZE, 0x5a);
+  for (int i = 0; i < entries; i++) {
+    std::string uri = entryUri(i);
+    // the first lookup creates the entry
+    if (fm->get_cache_file(uri, dir, data.data(), 0, BENCH_PERIOD_SIZE) < 0)
+      return false;
+    for (int r = 0; r < records; r++) {
+      if (fm->update_cache_info(uri, dir, data.data(),
+                                static_cast<int64_t>(r) * BENCH_PERIOD_SIZE,
+                                record_bytes) < 0)
+        return false;
+    }
+    fm->set_file_size(uri, dir,
+                      static_cast<int64_t>(records) * BENCH_PERIOD_SIZE);
+    fm->close_cache_file(uri, dir);
+  }
+  return true;
+}
+
+/*scan the directory the way the first open after a cold start does, then
+ * look every entry up, returns the scan time or -1 on a wrong total*/
+int64_t load(const std::string &dir, int entries, int64_t expected) {
+  REDFileManager *fm = REDFileManager::getInstance();
+  int64_t begin = nowUs();
+  fm->set_dir_capacity(dir, entries * 2, INT64_MAX, BENCH_PERIOD_SIZE);
+  int64_t scan_us = nowUs() - begin;
+  int64_t total = 0;
+  for (int i = 0; i < entries; i++)
+    total += fm->get_cache_size(entryUri(i), dir);
+  return total == expected ? scan_us : -1;
+}
+
+/*the file cache is a process wide singleton, every run needs a new process*/
+int64_t runChild(const std::function<int64_t()> &func) {
+  int fd[2];
+  if (pipe(fd) != 0)
+    return -1;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fd[0]);
+    int64_t v = func();
+    ssize_t n = write(fd[1], &v, sizeof(v));
+    _exit(n == sizeof(v) ? 0 : 1);
+  }
+  close(fd[1]);
+  int64_t v = -1;
+  if (pid <= 0 || read(fd[0], &v, sizeof(v)) != sizeof(v))
+    v = -1;
+  close(fd[0]);
+  if (pid > 0)
+    waitpid(pid, nullptr, 0);
+  return v;
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  time of the cold start scan of a cache directory, each run in\n"
+          "  a new process on a directory written by this build\n"
+          "  -e <n>    cache entries, default 1000\n"
+          "  -r <n>    shard records per entry, default 16\n"
+          "  -b <n>    bytes per shard, up to 4096, default 1024\n"
+          "  -n <n>    runs, default 20\n"
+          "  -d <dir>  directory, default a new one under /tmp\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int entries = 1000;
+  int records = 16;
+  int record_bytes = 1024;
+  int runs = 20;
+  std::string dir;
+  int opt;
+  while ((opt = getopt(argc, argv, "e:r:b:n:d:h")) != -1) {
+    switch (opt) {
+    case 'e':
+      entries = atoi(optarg);
+      break;
+    case 'r':
+      records = atoi(optarg);
+      break;
+    case 'b':
+      record_bytes = atoi(optarg);
+      break;
+    case 'n':
+      runs = atoi(optarg);
+      break;
+    case 'd':
+      dir = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (entries <= 0 || records <= 0 || record_bytes <= 0 ||
+      record_bytes > BENCH_PERIOD_SIZE || runs <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  bool own_dir = dir.empty();
+  if (own_dir) {
+    char dir_template[] = "/tmp/cache_index_bench.XXXXXX";
+    if (!mkdtemp(dir_template)) {
+      fprintf(stderr, "mkdtemp failed\n");
+      return 1;
+    }
+    dir = dir_template;
+  }
+  if (dir.back() != '/')
+    dir += '/';
+
+  RedLogSetLevel(AV_LEVEL_ERROR);
+  if (runChild([&] {
+        return populate(dir, entries, records, record_bytes) ? 0 : -1;
+      }) != 0) {
+    fprintf(stderr, "populating %s failed\n", dir.c_str());
+    return 1;
+  }
+  int64_t expected = static_cast<int64_t>(entries) * records * record_bytes;
+  std::vector<int64_t> times;
+  int failed = 0;
+  for (int i = 0; i < runs; i++) {
+    int64_t us = runChild([&] { return load(dir, entries, expected); });
+    if (us < 0)
+      failed++;
+    else
+      times.push_back(us);
+  }
+  std::sort(times.begin(), times.end());
+  printf("{\"entries\":%d,\"records\":%d,\"runs\":%d,\"failed\":%d,"
+         "\"median_us\":%" PRId64 ",\"min_us\":%" PRId64 ",\"max_us\":%" PRId64
+         "}\n",
+         entries, records, runs, failed,
+         times.empty() ? -1 : times[times.size() / 2],
+         times.empty() ? -1 : times.front(), times.empty() ? -1 : times.back());
+  if (own_dir) {
+    std::string cmd = "rm -rf '" + dir + "'";
+    if (system(cmd.c_str()) != 0)
+      fprintf(stderr, "removing %s failed\n", dir.c_str());
+  }
+  return failed > 0 ? 1 : 0;
+}
+
+#endif
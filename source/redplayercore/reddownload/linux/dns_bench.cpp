@@ -0,0 +1,555 @@
+#if defined(__HEADLESS__)
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "REDCacheIndex.h"
+#include "RedDownloadConfig.h"
+#include "RedLog.h"
+#include "dnscache/REDDnsCache.h"
+#include "curl/curl.h"
+#include "dnscache/REDHappyEyeballs.h"
+
+#define BENCH_HOST "bench.test"
+#define BENCH_TTL_S 300
+#define PROBE_TIMEOUT_MS 300
+#define MAX_ATTEMPTS 3
+
+namespace {
+
+/*what the server stand-in does for connects to an address: accept them,
+ * refuse them, or drop the SYNs by keeping the accept queue full*/
+enum class Mode { Ok, Refuse, Drop };
+
+struct BenchAddr {
+  const char *ip;
+  Mode before; // while the saved table was recorded
+  int64_t speed_before;
+  Mode now;
+};
+
+struct Scenario {
+  const char *name;
+  std::vector<BenchAddr> addrs;
+};
+
+struct Trial {
+  int64_t connect_ms{-1};
+  int attempts{0};
+  char ip[64]{0};
+};
+
+int64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool isV6(const char *ip) { return strchr(ip, ':') != nullptr; }
+
+bool SockaddrFromIp(const std::string &ip, int port, sockaddr_storage *addr,
+                    socklen_t *len) {
+  memset(addr, 0, sizeof(*addr));
+  sockaddr_in *in4 = reinterpret_cast<sockaddr_in *>(addr);
+  sockaddr_in6 *in6 = reinterpret_cast<sockaddr_in6 *>(addr);
+  if (inet_pton(AF_INET, ip.c_str(), &in4->sin_addr) == 1) {
+    in4->sin_family = AF_INET;
+    in4->sin_port = htons(port);
+    *len = sizeof(sockaddr_in);
+  } else if (inet_pton(AF_INET6, ip.c_str(), &in6->sin6_addr) == 1) {
+    in6->sin6_family = AF_INET6;
+    in6->sin6_port = htons(port);
+    *len = sizeof(sockaddr_in6);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/*listeners of all addresses on one port, and the answers of the resolver*/
+class StandIn {
+public:
+  ~StandIn() { stop(); }
+
+  bool start(int dns_delay_ms) {
+    mDnsDelayMs = dns_delay_ms;
+    mDnsFd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (mDnsFd < 0 ||
+        bind(mDnsFd, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+        getsockname(mDnsFd, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+      return false;
+    }
+    mDnsPort = ntohs(addr.sin_port);
+    mRunning = true;
+    mDnsThread = std::thread(&StandIn::dnsLoop, this);
+    mAcceptThread = std::thread(&StandIn::acceptLoop, this);
+    return true;
+  }
+
+  void stop() {
+    if (!mRunning.exchange(false))
+      return;
+    mDnsThread.join();
+    mAcceptThread.join();
+    closeListeners();
+    close(mDnsFd);
+  }
+
+  /*the addresses the resolver answers and how each takes connects*/
+  bool setup(const Scenario &scenario, bool before) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    closeListeners();
+    mIps.clear();
+    // a new port, the last one may still have connections closing
+    if ((mPort = freePort()) <= 0)
+      return false;
+    for (const BenchAddr &a : scenario.addrs) {
+      mIps.push_back(a.ip);
+      Mode mode = before ? a.before : a.now;
+      if (mode == Mode::Refuse)
+        continue;
+      sockaddr_storage addr;
+      socklen_t len = 0;
+      SockaddrFromIp(a.ip, mPort, &addr, &len);
+      int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+      int one = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      if (addr.ss_family == AF_INET6)
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &one, sizeof(one));
+      if (bind(fd, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+          listen(fd, mode == Mode::Drop ? 0 : 128) != 0) {
+        fprintf(stderr, "listen on %s failed: %s\n", a.ip, strerror(errno));
+        close(fd);
+        return false;
+      }
+      if (mode == Mode::Ok) {
+        mAccepting.push_back(fd);
+        continue;
+      }
+      // one connection nobody accepts fills a backlog of 0
+      int filler = socket(addr.ss_family, SOCK_STREAM, 0);
+      if (connect(filler, reinterpret_cast<sockaddr *>(&addr), len) != 0) {
+        fprintf(stderr, "fill %s failed\n", a.ip);
+        return false;
+      }
+      mDropping.push_back(fd);
+      mDropping.push_back(filler);
+    }
+    return true;
+  }
+
+  int port() const { return mPort; }
+  int dnsPort() const { return mDnsPort; }
+
+private:
+  static int freePort() {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int port = -1;
+    if (fd >= 0 && bind(fd, reinterpret_cast<sockaddr *>(&addr), len) == 0 &&
+        getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) == 0) {
+      port = ntohs(addr.sin_port);
+    }
+    if (fd >= 0)
+      close(fd);
+    return port;
+  }
+
+  void closeListeners() {
+    for (int fd : mAccepting)
+      close(fd);
+    for (int fd : mDropping)
+      close(fd);
+    mAccepting.clear();
+    mDropping.clear();
+  }
+
+  void acceptLoop() {
+    while (mRunning) {
+      std::vector<pollfd> fds;
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (int fd : mAccepting)
+          fds.push_back({fd, POLLIN, 0});
+      }
+      if (fds.empty() || poll(fds.data(), fds.size(), 20) <= 0) {
+        if (fds.empty())
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(mMutex);
+      for (pollfd &p : fds) {
+        if (!(p.revents & POLLIN) ||
+            std::find(mAccepting.begin(), mAccepting.end(), p.fd) ==
+                mAccepting.end())
+          continue;
+        int fd = accept(p.fd, nullptr, nullptr);
+        if (fd >= 0)
+          close(fd);
+      }
+    }
+  }
+
+  void dnsLoop() {
+    while (mRunning) {
+      pollfd p = {mDnsFd, POLLIN, 0};
+      if (poll(&p, 1, 20) <= 0)
+        continue;
+      uint8_t query[512];
+      sockaddr_storage from;
+      socklen_t fromlen = sizeof(from);
+      ssize_t n = recvfrom(mDnsFd, query, sizeof(query), 0,
+                           reinterpret_cast<sockaddr *>(&from), &fromlen);
+      if (n < 17)
+        continue;
+      std::vector<uint8_t> answer = answerOf(query, n);
+      if (answer.empty())
+        continue;
+      // a slow resolver, every query answered after the delay
+      std::thread([this, answer, from, fromlen] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(mDnsDelayMs));
+        sendto(mDnsFd, answer.data(), answer.size(), 0,
+               reinterpret_cast<const sockaddr *>(&from), fromlen);
+      }).detach();
+    }
+  }
+
+  std::vector<uint8_t> answerOf(const uint8_t *query, ssize_t n) {
+    size_t pos = 12;
+    while (pos < static_cast<size_t>(n) && query[pos] != 0)
+      pos += query[pos] + 1;
+    if (pos + 5 > static_cast<size_t>(n))
+      return {};
+    int qtype = (query[pos + 1] << 8) | query[pos + 2];
+    size_t question_end = pos + 5;
+    std::vector<uint8_t> answer(query, query + question_end);
+    answer[2] = 0x81; // response, recursion desired and available
+    answer[3] = 0x80;
+    answer[10] = answer[11] = 0; // no additional records
+    answer[8] = answer[9] = 0;
+    int count = 0;
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const std::string &ip : mIps) {
+      bool v6 = isV6(ip.c_str());
+      if ((qtype == 28) != v6)
+        continue;
+      uint8_t rdata[16];
+      inet_pton(v6 ? AF_INET6 : AF_INET, ip.c_str(), rdata);
+      int rdlen = v6 ? 16 : 4;
+      const uint8_t record[] = {0xc0, 0x0c, 0, static_cast<uint8_t>(qtype),
+                                0, 1, 0, 0,
+                                (BENCH_TTL_S >> 8) & 0xff, BENCH_TTL_S & 0xff,
+                                0, static_cast<uint8_t>(rdlen)};
+      answer.insert(answer.end(), record, record + sizeof(record));
+      answer.insert(answer.end(), rdata, rdata + rdlen);
+      count++;
+    }
+    answer[6] = 0;
+    answer[7] = static_cast<uint8_t>(count);
+    return answer;
+  }
+
+  std::atomic_bool mRunning{false};
+  std::mutex mMutex;
+  std::vector<std::string> mIps;
+  std::vector<int> mAccepting;
+  std::vector<int> mDropping;
+  std::thread mDnsThread;
+  std::thread mAcceptThread;
+  int mDnsFd{-1};
+  int mDnsPort{0};
+  int mPort{0};
+  int mDnsDelayMs{0};
+};
+
+/*a connect the way RedCurl makes it, the addresses handed to curl with
+ * CURLOPT_RESOLVE, returns whether one connected and which in ip*/
+bool curlConnect(const std::string &addrs, int port, int timeout_ms,
+                 std::string *ip) {
+  std::string host = std::string(BENCH_HOST) + ":" + std::to_string(port);
+  std::string url = "http://" + host + "/";
+  struct curl_slist *resolve =
+      curl_slist_append(nullptr, (host + ":" + addrs).c_str());
+  CURL *curl = curl_easy_init();
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_RESOLVE, resolve);
+  curl_easy_setopt(curl, CURLOPT_CONNECT_ONLY, 1L);
+  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS,
+                   static_cast<long>(timeout_ms));
+  curl_easy_setopt(curl, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS,
+                   static_cast<long>(HAPPY_EYEBALLS_ATTEMPT_DELAY_MS));
+  bool connected = curl_easy_perform(curl) == CURLE_OK;
+  char *primary = nullptr;
+  curl_easy_getinfo(curl, CURLINFO_PRIMARY_IP, &primary);
+  if (connected && primary != nullptr)
+    *ip = primary;
+  curl_easy_cleanup(curl);
+  curl_slist_free_all(resolve);
+  return connected;
+}
+
+/*what RedCurl does on a cold or warm start: wait for the table, connect to
+ * the one address GetIpAddr picks or let curl race the candidates, and
+ * report the outcome back so a retry picks another address*/
+Trial runTrial(const StandIn &standin, const std::string &dir, bool warm,
+               bool race, int timeout_ms) {
+  Trial trial;
+  int64_t start = nowMs();
+  REDDnsCache *cache = REDDnsCache::getinstance();
+  cache->SetHostDnsServerIp("127.0.0.1:" + std::to_string(standin.dnsPort()));
+  cache->AddHost(BENCH_HOST);
+  if (warm)
+    cache->Load(dir);
+  cache->run();
+  while (cache->GetIpCandidates(BENCH_HOST, 1).empty()) {
+    if (nowMs() - start > 10000)
+      return trial;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+    trial.attempts++;
+    std::string ip = cache->GetIpAddr(BENCH_HOST);
+    std::string addrs = ip;
+    if (race) {
+      addrs = ResolveAddrList(
+          cache->GetIpCandidates(BENCH_HOST, HAPPY_EYEBALLS_MAX_CANDIDATES));
+    }
+    bool connected = curlConnect(addrs, standin.port(), timeout_ms, &ip);
+    cache->UpdateAddr(BENCH_HOST, ip, 0, connected ? 0 : 1);
+    if (connected) {
+      trial.connect_ms = nowMs() - start;
+      snprintf(trial.ip, sizeof(trial.ip), "%s", ip.c_str());
+      break;
+    }
+  }
+  return trial;
+}
+
+/*a session under the before modes, its stats are what gets saved*/
+void recordTable(const StandIn &standin, const Scenario &scenario,
+                 const std::string &dir) {
+  REDDnsCache *cache = REDDnsCache::getinstance();
+  cache->SetHostDnsServerIp("127.0.0.1:" + std::to_string(standin.dnsPort()));
+  cache->AddHost(BENCH_HOST);
+  cache->Load(dir);
+  cache->run();
+  int64_t start = nowMs();
+  while (cache->GetIpCandidates(BENCH_HOST, 1).empty() &&
+         nowMs() - start < 10000) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  for (const BenchAddr &a : scenario.addrs) {
+    std::string ip;
+    bool connected = curlConnect(ResolveAddrList({a.ip}), standin.port(),
+                                 PROBE_TIMEOUT_MS, &ip);
+    cache->UpdateAddr(BENCH_HOST, a.ip, connected ? a.speed_before : 0,
+                      connected ? 0 : 1);
+  }
+  cache->Save();
+}
+
+/*every trial in a fresh process, the dns cache is a singleton*/
+bool runChild(const std::function<Trial()> &func, Trial &trial) {
+  int fd[2];
+  if (pipe(fd) != 0)
+    return false;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fd[0]);
+    Trial t = func();
+    ssize_t n = write(fd[1], &t, sizeof(t));
+    _exit(n == sizeof(t) ? 0 : 1);
+  }
+  close(fd[1]);
+  bool ok = pid > 0 && read(fd[0], &trial, sizeof(trial)) == sizeof(trial);
+  close(fd[0]);
+  if (pid > 0)
+    waitpid(pid, nullptr, 0);
+  return ok;
+}
+
+bool copyFile(const std::string &from, const std::string &to) {
+  std::ifstream in(from, std::ios::binary);
+  std::ofstream out(to, std::ios::binary);
+  out << in.rdbuf();
+  return in && out;
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  connect time of cold and warm starts with one address or\n"
+          "  racing, against a local resolver and listeners that accept,\n"
+          "  refuse or drop the connects of each address\n"
+          "  -n <n>    trials per case, default 3\n"
+          "  -d <ms>   resolver delay, default 150\n"
+          "  -t <ms>   connect timeout, default 3000\n"
+          "  -o <file> write the json lines to file instead of stdout\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int trials = 3;
+  int dns_delay_ms = 150;
+  int timeout_ms = 3000;
+  const char *out_path = nullptr;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:d:t:o:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      trials = atoi(optarg);
+      break;
+    case 'd':
+      dns_delay_ms = atoi(optarg);
+      break;
+    case 't':
+      timeout_ms = atoi(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (trials <= 0 || timeout_ms <= 0 || dns_delay_ms < 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "open %s failed\n", out_path);
+    return 1;
+  }
+
+  RedLogSetLevel(AV_LEVEL_ERROR);
+  RedDownloadConfig::getinstance()->set_config(USE_DNS_CACHE, 1);
+  RedDownloadConfig::getinstance()->set_config(PARSE_NO_PING, 1);
+
+  const std::vector<Scenario> scenarios = {
+      {"v6_dead",
+       {{"::1", Mode::Drop, 0, Mode::Drop},
+        {"127.0.0.1", Mode::Ok, 1000000, Mode::Ok}}},
+      {"all_ok",
+       {{"::1", Mode::Ok, 1000000, Mode::Ok},
+        {"127.0.0.1", Mode::Ok, 1000000, Mode::Ok}}},
+      {"best_went_dead",
+       {{"127.0.0.2", Mode::Ok, 8000000, Mode::Drop},
+        {"::1", Mode::Ok, 1000000, Mode::Ok},
+        {"127.0.0.1", Mode::Ok, 1000000, Mode::Ok}}},
+  };
+
+  StandIn standin;
+  if (!standin.start(dns_delay_ms)) {
+    fprintf(stderr, "stand-in failed\n");
+    return 1;
+  }
+  char dir_template[] = "/tmp/dns_bench.XXXXXX";
+  std::string dir = mkdtemp(dir_template) ? dir_template : "";
+  if (dir.empty()) {
+    fprintf(stderr, "mkdtemp failed\n");
+    return 1;
+  }
+  std::string table = dir + "/table.json";
+  std::string trial_dir = dir + "/trial";
+  mkdir(trial_dir.c_str(), 0755);
+  std::string trial_file = trial_dir + "/" + CACHE_DNS_FILE;
+
+  int failures = 0;
+  for (const Scenario &scenario : scenarios) {
+    unlink(trial_file.c_str());
+    Trial unused;
+    if (!standin.setup(scenario, true) ||
+        !runChild(
+            [&] {
+              recordTable(standin, scenario, trial_dir);
+              return Trial();
+            },
+            unused) ||
+        !copyFile(trial_file, table) || !standin.setup(scenario, false)) {
+      fprintf(stderr, "%s: recording the table failed\n", scenario.name);
+      failures++;
+      continue;
+    }
+    for (int warm = 0; warm < 2; warm++) {
+      for (int race = 0; race < 2; race++) {
+        std::vector<int64_t> times;
+        int failed = 0, attempts = 0;
+        std::string ip;
+        for (int i = 0; i < trials; i++) {
+          unlink(trial_file.c_str());
+          if (warm)
+            copyFile(table, trial_file);
+          Trial trial;
+          if (!runChild(
+                  [&] {
+                    return runTrial(standin, trial_dir, warm, race,
+                                    timeout_ms);
+                  },
+                  trial) ||
+              trial.connect_ms < 0) {
+            failed++;
+            continue;
+          }
+          times.push_back(trial.connect_ms);
+          attempts += trial.attempts;
+          ip = trial.ip;
+        }
+        std::sort(times.begin(), times.end());
+        fprintf(out,
+                "{\"scenario\":\"%s\",\"start\":\"%s\",\"connect\":\"%s\","
+                "\"trials\":%d,\"failed\":%d,\"median_ms\":%" PRId64
+                ",\"max_ms\":%" PRId64 ",\"attempts\":%.2f,\"ip\":\"%s\"}\n",
+                scenario.name, warm ? "warm" : "cold", race ? "race" : "single",
+                trials, failed, times.empty() ? -1 : times[times.size() / 2],
+                times.empty() ? -1 : times.back(),
+                times.empty() ? 0.0
+                              : static_cast<double>(attempts) / times.size(),
+                ip.c_str());
+        fflush(out);
+      }
+    }
+  }
+  standin.stop();
+  unlink(trial_file.c_str());
+  unlink(table.c_str());
+  rmdir(trial_dir.c_str());
+  rmdir(dir.c_str());
+  if (out != stdout)
+    fclose(out);
+  return failures > 0 ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,206 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "REDFileManager.h"
+#include "RedLog.h"
+
+#define BENCH_SHARD_SIZE (64 * 1024)
+
+namespace {
+
+int64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint8_t patternAt(int entry, int64_t pos) {
+  return static_cast<uint8_t>(entry * 31 + pos * 7 + (pos >> 12));
+}
+
+struct ReaderStats {
+  std::vector<int64_t> latencies_us;
+  int64_t bytes{0};
+  int errors{0};
+};
+
+std::string playUri(int i) { return "play" + std::to_string(i); }
+
+/*cached videos the players read back*/
+bool populate(const std::string &dir, int entries, int shards) {
+  REDFileManager *fm = REDFileManager::getInstance();
+  std::vector<uint8_t> data(BENCH_SHARD_SIZE);
+  for (int e = 0; e < entries; e++) {
+    std::string uri = playUri(e);
+    if (fm->get_cache_file(uri, dir, data.data(), 0, BENCH_SHARD_SIZE) < 0)
+      return false;
+    for (int s = 0; s < shards; s++) {
+      int64_t pos = static_cast<int64_t>(s) * BENCH_SHARD_SIZE;
+      for (int i = 0; i < BENCH_SHARD_SIZE; i++)
+        data[i] = patternAt(e, pos + i);
+      if (fm->update_cache_info(uri, dir, data.data(), pos,
+                                BENCH_SHARD_SIZE) != 0)
+        return false;
+    }
+    fm->set_file_size(uri, dir,
+                      static_cast<int64_t>(shards) * BENCH_SHARD_SIZE);
+    fm->close_cache_file(uri, dir);
+  }
+  return true;
+}
+
+/*a player reading its video shard by shard from the cache, over and over*/
+void readLoop(const std::string &dir, int entry, int shards,
+              const std::atomic<bool> &running, ReaderStats &stats) {
+  REDFileManager *fm = REDFileManager::getInstance();
+  std::vector<uint8_t> buf(BENCH_SHARD_SIZE);
+  std::string uri = playUri(entry);
+  for (int s = 0; running; s = (s + 1) % shards) {
+    int64_t pos = static_cast<int64_t>(s) * BENCH_SHARD_SIZE;
+    int64_t begin = nowUs();
+    int n = fm->get_cache_file(uri, dir, buf.data(), pos, BENCH_SHARD_SIZE);
+    stats.latencies_us.push_back(nowUs() - begin);
+    if (n != BENCH_SHARD_SIZE || buf[n - 1] != patternAt(entry, pos + n - 1)) {
+      stats.errors++;
+      continue;
+    }
+    stats.bytes += n;
+  }
+}
+
+/*a preloader writing new videos into the cache and dropping them again so
+ * that the directory does not grow*/
+void writeLoop(const std::string &dir, int id, int shards,
+               const std::atomic<bool> &running, std::atomic<int64_t> &bytes) {
+  REDFileManager *fm = REDFileManager::getInstance();
+  std::vector<uint8_t> data(BENCH_SHARD_SIZE, static_cast<uint8_t>(id));
+  for (int n = 0; running; n++) {
+    std::string uri = "pre" + std::to_string(id) + "_" + std::to_string(n);
+    if (fm->get_cache_file(uri, dir, data.data(), 0, BENCH_SHARD_SIZE) < 0)
+      return;
+    for (int s = 0; s < shards && running; s++) {
+      if (fm->update_cache_info(uri, dir, data.data(),
+                                static_cast<int64_t>(s) * BENCH_SHARD_SIZE,
+                                BENCH_SHARD_SIZE) == 0)
+        bytes += BENCH_SHARD_SIZE;
+    }
+    fm->close_cache_file(uri, dir);
+    fm->delete_cache(dir, uri);
+  }
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  players read cached videos while preloaders write new ones,\n"
+          "  all through one file cache: read latency and throughput\n"
+          "  -r <n>    readers, default 4\n"
+          "  -w <n>    writers, default 4\n"
+          "  -s <n>    64 KB shards per video, default 32\n"
+          "  -t <ms>   duration, default 3000\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int readers = 4;
+  int writers = 4;
+  int shards = 32;
+  int duration_ms = 3000;
+  int opt;
+  while ((opt = getopt(argc, argv, "r:w:s:t:h")) != -1) {
+    switch (opt) {
+    case 'r':
+      readers = atoi(optarg);
+      break;
+    case 'w':
+      writers = atoi(optarg);
+      break;
+    case 's':
+      shards = atoi(optarg);
+      break;
+    case 't':
+      duration_ms = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (readers <= 0 || writers < 0 || shards <= 0 || duration_ms <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  char dir_template[] = "/tmp/file_cache_bench.XXXXXX";
+  if (!mkdtemp(dir_template)) {
+    fprintf(stderr, "mkdtemp failed\n");
+    return 1;
+  }
+  std::string dir = std::string(dir_template) + "/";
+
+  RedLogSetLevel(AV_LEVEL_ERROR);
+  REDFileManager::getInstance()->set_dir_capacity(dir, 1 << 20, INT64_MAX,
+                                                  BENCH_SHARD_SIZE);
+  if (!populate(dir, readers, shards)) {
+    fprintf(stderr, "populating %s failed\n", dir.c_str());
+    return 1;
+  }
+
+  std::atomic<bool> running{true};
+  std::atomic<int64_t> written{0};
+  std::vector<ReaderStats> stats(readers);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < writers; i++)
+    threads.emplace_back(writeLoop, std::cref(dir), i, shards,
+                         std::cref(running), std::ref(written));
+  for (int i = 0; i < readers; i++)
+    threads.emplace_back(readLoop, std::cref(dir), i, shards,
+                         std::cref(running), std::ref(stats[i]));
+  std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+  running = false;
+  for (std::thread &t : threads)
+    t.join();
+
+  std::vector<int64_t> latencies;
+  int64_t read = 0;
+  int errors = 0;
+  for (ReaderStats &s : stats) {
+    latencies.insert(latencies.end(), s.latencies_us.begin(),
+                     s.latencies_us.end());
+    read += s.bytes;
+    errors += s.errors;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    return latencies.empty()
+               ? -1
+               : latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+  };
+  double seconds = duration_ms / 1000.0;
+  printf("{\"readers\":%d,\"writers\":%d,\"read_mbps\":%.1f,"
+         "\"write_mbps\":%.1f,\"p50_us\":%" PRId64 ",\"p99_us\":%" PRId64
+         ",\"max_us\":%" PRId64 ",\"errors\":%d}\n",
+         readers, writers, read / seconds / (1 << 20),
+         written.load() / seconds / (1 << 20), percentile(0.5),
+         percentile(0.99), percentile(1.0), errors);
+
+  std::string cmd = "rm -rf '" + std::string(dir_template) + "'";
+  if (system(cmd.c_str()) != 0)
+    fprintf(stderr, "removing %s failed\n", dir_template);
+  return errors > 0 ? 1 : 0;
+}
+
+#endif
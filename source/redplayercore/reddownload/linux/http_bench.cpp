@@ -0,0 +1,495 @@
+#if defined(__HEADLESS__)
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RedDownloadConfig.h"
+#include "RedLog.h"
+#include "wrapper/reddownload_datasource_wrapper.h"
+
+#define READ_CHUNK (32 * 1024)
+#define SEND_CHUNK (16 * 1024)
+#define PRELOAD_TIMEOUT_MS 20000
+
+namespace {
+
+struct Trial {
+  int64_t ttfb_us{-1};    // open of the play url to its first byte
+  int64_t play_ms{-1};    // open of the play url to its last byte
+  int64_t preload_ms{-1}; // all preloads cached
+  int peak_threads{0};
+  int64_t cpu_ms{0};
+  bool corrupt{false};
+};
+
+int64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint8_t patternAt(int64_t pos) {
+  return static_cast<uint8_t>(pos * 7 + (pos >> 12));
+}
+
+/*a keep-alive HTTP/1.1 server with Range support for files of the same
+ * size, every request waits latency_ms before the answer and the body goes
+ * out at rate_kbps per connection if set*/
+class Server {
+public:
+  Server(int64_t size, int latency_ms, int rate_kbps)
+      : mSize(size), mLatencyMs(latency_ms), mRateKbps(rate_kbps) {}
+
+  ~Server() { stop(); }
+
+  /*forks, the threads of the server stay out of the measured process*/
+  bool start() {
+    void *shared = mmap(nullptr, sizeof(std::atomic<int64_t>),
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1,
+                        0);
+    if (shared == MAP_FAILED)
+      return false;
+    mAccepted = new (shared) std::atomic<int64_t>(0);
+    mFd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (mFd < 0 ||
+        bind(mFd, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+        listen(mFd, 128) != 0 ||
+        getsockname(mFd, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+      return false;
+    }
+    mPort = ntohs(addr.sin_port);
+    fflush(stdout);
+    mPid = fork();
+    if (mPid == 0) {
+      signal(SIGPIPE, SIG_IGN);
+      acceptLoop();
+      _exit(0);
+    }
+    close(mFd);
+    return mPid > 0;
+  }
+
+  void stop() {
+    if (mPid <= 0)
+      return;
+    kill(mPid, SIGKILL);
+    waitpid(mPid, nullptr, 0);
+    mPid = -1;
+  }
+
+  int port() const { return mPort; }
+  int64_t accepted() const { return mAccepted ? mAccepted->load() : 0; }
+
+private:
+  void acceptLoop() {
+    while (true) {
+      int fd = accept(mFd, nullptr, nullptr);
+      if (fd < 0)
+        continue;
+      mAccepted->fetch_add(1);
+      std::thread(&Server::serve, this, fd).detach();
+    }
+  }
+
+  void serve(int fd) {
+    std::string req;
+    char buf[4096];
+    while (true) {
+      size_t end;
+      while ((end = req.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+          close(fd);
+          return;
+        }
+        req.append(buf, n);
+      }
+      std::string head = req.substr(0, end);
+      req.erase(0, end + 4);
+      if (!answer(fd, head))
+        break;
+    }
+    close(fd);
+  }
+
+  bool answer(int fd, const std::string &head) {
+    int64_t start = 0, last = mSize - 1;
+    bool ranged = false;
+    size_t pos = head.find("Range: bytes=");
+    if (pos == std::string::npos)
+      pos = head.find("range: bytes=");
+    if (pos != std::string::npos) {
+      const char *spec = head.c_str() + pos + strlen("Range: bytes=");
+      char *next = nullptr;
+      start = strtoll(spec, &next, 10);
+      if (next && *next == '-' && isdigit(static_cast<unsigned char>(next[1])))
+        last = std::min<int64_t>(strtoll(next + 1, nullptr, 10), mSize - 1);
+      ranged = true;
+    }
+    bool head_only = head.compare(0, 5, "HEAD ") == 0;
+    if (mLatencyMs > 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(mLatencyMs));
+    char header[512];
+    int n;
+    if (start >= mSize) {
+      n = snprintf(header, sizeof(header),
+                   "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                   "Content-Range: bytes */%" PRId64 "\r\n"
+                   "Content-Length: 0\r\n\r\n",
+                   mSize);
+      return send(fd, header, n, 0) == n;
+    }
+    if (ranged) {
+      n = snprintf(header, sizeof(header),
+                   "HTTP/1.1 206 Partial Content\r\n"
+                   "Content-Type: video/mp4\r\n"
+                   "Content-Range: bytes %" PRId64 "-%" PRId64 "/%" PRId64
+                   "\r\nContent-Length: %" PRId64 "\r\n\r\n",
+                   start, last, mSize, last - start + 1);
+    } else {
+      n = snprintf(header, sizeof(header),
+                   "HTTP/1.1 200 OK\r\n"
+                   "Content-Type: video/mp4\r\n"
+                   "Content-Length: %" PRId64 "\r\n\r\n",
+                   mSize);
+    }
+    if (send(fd, header, n, MSG_NOSIGNAL) != n)
+      return false;
+    if (head_only)
+      return true;
+    uint8_t body[SEND_CHUNK];
+    int64_t begin = nowUs();
+    for (int64_t off = start; off <= last;) {
+      int len = static_cast<int>(std::min<int64_t>(SEND_CHUNK, last - off + 1));
+      for (int i = 0; i < len; i++)
+        body[i] = patternAt(off + i);
+      if (send(fd, body, len, MSG_NOSIGNAL) != len)
+        return false;
+      off += len;
+      if (mRateKbps > 0) {
+        int64_t due = begin + (off - start) * 1000 / mRateKbps;
+        int64_t wait = due - nowUs();
+        if (wait > 0)
+          std::this_thread::sleep_for(std::chrono::microseconds(wait));
+      }
+    }
+    return true;
+  }
+
+  int64_t mSize;
+  int mLatencyMs;
+  int mRateKbps;
+  int mFd{-1};
+  int mPort{0};
+  pid_t mPid{-1};
+  std::atomic<int64_t> *mAccepted{nullptr};
+};
+
+int threadCount() {
+  std::ifstream in("/proc/self/status");
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 8, "Threads:") == 0)
+      return atoi(line.c_str() + 8);
+  }
+  return 0;
+}
+
+int64_t cpuMs() {
+  rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000 +
+         (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000;
+}
+
+void appCb(void *, int, void *, void *) {}
+
+/*a feed page: the current video starts, once it shows its first frame the
+ * next videos are preloaded while it keeps loading to the end. Opening a play
+ * stops the running preloads, so they cannot start first*/
+Trial runTrial(int port, const std::string &dir, int64_t size, int preloads,
+               int64_t preload_size, int pool_size, bool shared_multi) {
+  Trial trial;
+  RedLogSetLevel(AV_LEVEL_ERROR);
+  reddownload_global_config_set(CURL_SHARED_MULTI_KEY, shared_multi);
+  DownLoadOptWrapper init;
+  reddownload_datasource_wrapper_opt_reset(&init);
+  init.cache_file_dir = dir.c_str();
+  init.threadpool_size = pool_size;
+  reddownload_datasource_wrapper_init(&init);
+
+  std::atomic<bool> sampling{true};
+  std::atomic<int> peak{threadCount()};
+  std::thread sampler([&] {
+    while (sampling) {
+      // the sampler itself is not part of the download
+      peak = std::max(peak.load(), threadCount() - 1);
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+  });
+  int64_t cpu_start = cpuMs();
+
+  DownLoadCbWrapper cb{};
+  cb.appcb = appCb;
+  std::string play =
+      "http://127.0.0.1:" + std::to_string(port) + "/play.mp4";
+  DownLoadOptWrapper opt;
+  reddownload_datasource_wrapper_opt_reset(&opt);
+  opt.cache_file_dir = dir.c_str();
+  opt.threadpool_size = pool_size;
+  int64_t open_us = nowUs();
+  int64_t uid = reddownload_datasource_wrapper_open(play.c_str(), &cb, &opt);
+  std::vector<uint8_t> buf(READ_CHUNK);
+  std::vector<std::string> urls;
+  int64_t preload_us = 0;
+  int64_t pos = 0;
+  while (uid >= 0 && pos < size) {
+    int n = reddownload_datasource_wrapper_read(play.c_str(), uid, buf.data(),
+                                                READ_CHUNK);
+    if (n <= 0)
+      break;
+    for (int i = 0; i < n && !trial.corrupt; i++)
+      trial.corrupt = buf[i] != patternAt(pos + i);
+    pos += n;
+    if (trial.ttfb_us >= 0)
+      continue;
+    trial.ttfb_us = nowUs() - open_us;
+    preload_us = nowUs();
+    for (int i = 0; i < preloads; i++) {
+      urls.push_back("http://127.0.0.1:" + std::to_string(port) + "/pre" +
+                     std::to_string(i) + ".mp4");
+      DownLoadOptWrapper pre;
+      reddownload_datasource_wrapper_opt_reset(&pre);
+      pre.DownLoadType = 2; // DOWNLOADPRE
+      pre.PreDownLoadSize = preload_size;
+      pre.cache_file_dir = dir.c_str();
+      reddownload_datasource_wrapper_open(urls.back().c_str(), &cb, &pre);
+    }
+  }
+  if (pos == size)
+    trial.play_ms = (nowUs() - open_us) / 1000;
+
+  int64_t deadline = nowUs() + PRELOAD_TIMEOUT_MS * 1000;
+  bool cached = false;
+  while (!cached && nowUs() < deadline) {
+    cached = true;
+    for (const std::string &url : urls)
+      cached = cached &&
+               reddownload_datasource_wrapper_cache_size(url.c_str()) >=
+                   preload_size;
+    if (!cached)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  if (cached)
+    trial.preload_ms = (nowUs() - preload_us) / 1000;
+  reddownload_datasource_wrapper_close(play.c_str(), uid);
+  for (const std::string &url : urls)
+    reddownload_datasource_wrapper_close(url.c_str(), 0);
+
+  trial.cpu_ms = cpuMs() - cpu_start;
+  sampling = false;
+  sampler.join();
+  trial.peak_threads = peak;
+  return trial;
+}
+
+bool runChild(const std::function<Trial()> &func, Trial &trial) {
+  int fd[2];
+  if (pipe(fd) != 0)
+    return false;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fd[0]);
+    Trial t = func();
+    ssize_t n = write(fd[1], &t, sizeof(t));
+    _exit(n == sizeof(t) ? 0 : 1);
+  }
+  close(fd[1]);
+  bool ok = pid > 0 && read(fd[0], &trial, sizeof(trial)) == sizeof(trial);
+  close(fd[0]);
+  if (pid > 0)
+    waitpid(pid, nullptr, 0);
+  return ok;
+}
+
+void removeDir(const std::string &dir) {
+  std::string cmd = "rm -rf '" + dir + "'";
+  if (system(cmd.c_str()) != 0)
+    fprintf(stderr, "removing %s failed\n", dir.c_str());
+}
+
+int64_t median(std::vector<int64_t> v) {
+  if (v.empty())
+    return -1;
+  std::sort(v.begin(), v.end());
+  return v[v.size() / 2];
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  one play and a number of preloads from a cold cache against a\n"
+          "  local HTTP server, with one multi handle per transfer and with\n"
+          "  the shared one: time to first byte, play and preload time,\n"
+          "  peak threads and CPU of the process\n"
+          "  -n <n>    trials per case, default 5\n"
+          "  -p <n>    preloads, default 8\n"
+          "  -s <kb>   size of every file, default 4096\n"
+          "  -P <kb>   preload size, default 512\n"
+          "  -t <n>    download thread pool size, default 1\n"
+          "  -l <ms>   server latency per request, default 20\n"
+          "  -r <kbps> bytes per ms and connection, 0 unpaced, default 0\n"
+          "  -m <0|1>  only run without or with the shared multi\n"
+          "  -o <file> write the json lines to file instead of stdout\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int trials = 5;
+  int preloads = 8;
+  int64_t size = 4096 * 1024;
+  int64_t preload_size = 512 * 1024;
+  int pool_size = 1;
+  int latency_ms = 20;
+  int rate_kbps = 0;
+  int only_multi = -1;
+  const char *out_path = nullptr;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:p:s:P:t:l:r:m:o:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      trials = atoi(optarg);
+      break;
+    case 'p':
+      preloads = atoi(optarg);
+      break;
+    case 's':
+      size = atoll(optarg) * 1024;
+      break;
+    case 'P':
+      preload_size = atoll(optarg) * 1024;
+      break;
+    case 't':
+      pool_size = atoi(optarg);
+      break;
+    case 'l':
+      latency_ms = atoi(optarg);
+      break;
+    case 'r':
+      rate_kbps = atoi(optarg);
+      break;
+    case 'm':
+      only_multi = atoi(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (trials <= 0 || preloads < 0 || size <= 0 || preload_size <= 0 ||
+      preload_size > size || pool_size <= 0 || latency_ms < 0 ||
+      rate_kbps < 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "open %s failed\n", out_path);
+    return 1;
+  }
+
+  Server server(size, latency_ms, rate_kbps);
+  if (!server.start()) {
+    fprintf(stderr, "server failed\n");
+    return 1;
+  }
+  char dir_template[] = "/tmp/http_bench.XXXXXX";
+  std::string root = mkdtemp(dir_template) ? dir_template : "";
+  if (root.empty()) {
+    fprintf(stderr, "mkdtemp failed\n");
+    return 1;
+  }
+
+  int failures = 0;
+  for (int multi = 0; multi < 2; multi++) {
+    if (only_multi >= 0 && multi != only_multi)
+      continue;
+    std::vector<int64_t> ttfb, play, preload, threads, cpu, conns;
+    int failed = 0;
+    for (int i = 0; i < trials; i++) {
+      // a cold cache every time, and a fresh process for the singletons
+      std::string dir = root + "/" + std::to_string(i);
+      mkdir(dir.c_str(), 0755);
+      Trial trial;
+      int64_t accepted = server.accepted();
+      if (!runChild(
+              [&] {
+                return runTrial(server.port(), dir, size, preloads,
+                                preload_size, pool_size, multi);
+              },
+              trial) ||
+          trial.ttfb_us < 0 || trial.play_ms < 0 || trial.preload_ms < 0 ||
+          trial.corrupt) {
+        failed++;
+      } else {
+        ttfb.push_back(trial.ttfb_us);
+        play.push_back(trial.play_ms);
+        preload.push_back(trial.preload_ms);
+        threads.push_back(trial.peak_threads);
+        cpu.push_back(trial.cpu_ms);
+        conns.push_back(server.accepted() - accepted);
+      }
+      removeDir(dir);
+    }
+    fprintf(out,
+            "{\"multi\":\"%s\",\"pool\":%d,\"preloads\":%d,\"trials\":%d,"
+            "\"failed\":%d,\"ttfb_us\":%" PRId64 ",\"play_ms\":%" PRId64
+            ",\"preload_ms\":%" PRId64 ",\"peak_threads\":%" PRId64
+            ",\"cpu_ms\":%" PRId64 ",\"connections\":%" PRId64 "}\n",
+            multi ? "shared" : "per_transfer", pool_size, preloads, trials,
+            failed, median(ttfb), median(play), median(preload),
+            median(threads), median(cpu), median(conns));
+    fflush(out);
+    failures += failed;
+  }
+  server.stop();
+  removeDir(root);
+  if (out != stdout)
+    fclose(out);
+  return failures > 0 ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,195 @@
+#if defined(__HEADLESS__)
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RedLog.h"
+#include "wrapper/reddownload_datasource_wrapper.h"
+
+#define AVSEEK_SIZE 0x10000
+
+namespace {
+
+struct Session {
+  std::string url;
+  int64_t uid{-1};
+};
+
+int64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/*a server that takes the connections and never answers, the sessions stay
+ * open without moving any data*/
+int listenSilent(int &port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+      listen(fd, 128) != 0 ||
+      getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  port = ntohs(addr.sin_port);
+  return fd;
+}
+
+void appCb(void *, int, void *, void *) {}
+
+Session openSession(const std::string &base, const std::string &dir,
+                    const std::string &name, bool preload) {
+  DownLoadCbWrapper cb{};
+  cb.appcb = appCb;
+  DownLoadOptWrapper opt;
+  reddownload_datasource_wrapper_opt_reset(&opt);
+  opt.cache_file_dir = dir.c_str();
+  if (preload) {
+    opt.DownLoadType = 2; // DOWNLOADPRE
+    opt.PreDownLoadSize = 1024 * 1024;
+  }
+  Session s;
+  s.url = base + name;
+  s.uid = reddownload_datasource_wrapper_open(s.url.c_str(), &cb, &opt);
+  return s;
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  players each look their own session up by url and uid, the\n"
+          "  way every read and seek does, while another thread keeps\n"
+          "  opening and closing preloads: total time of the lookups\n"
+          "  -p <n>    playing sessions, default 11\n"
+          "  -r <n>    preloading sessions, default 5\n"
+          "  -l <n>    lookups per session, default 200000\n"
+          "  -c <0|1>  open and close preloads meanwhile, default 1\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int plays = 11;
+  int preloads = 5;
+  int lookups = 200000;
+  int churn = 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "p:r:l:c:h")) != -1) {
+    switch (opt) {
+    case 'p':
+      plays = atoi(optarg);
+      break;
+    case 'r':
+      preloads = atoi(optarg);
+      break;
+    case 'l':
+      lookups = atoi(optarg);
+      break;
+    case 'c':
+      churn = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (plays <= 0 || preloads < 0 || lookups <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  int port = 0;
+  int server = listenSilent(port);
+  char dir_template[] = "/tmp/session_lookup_bench.XXXXXX";
+  if (server < 0 || !mkdtemp(dir_template)) {
+    fprintf(stderr, "setting up the server or the directory failed\n");
+    return 1;
+  }
+  std::string dir = std::string(dir_template) + "/";
+  std::string base = "http://127.0.0.1:" + std::to_string(port) + "/";
+
+  RedLogSetLevel(AV_LEVEL_ERROR);
+  DownLoadOptWrapper init;
+  reddownload_datasource_wrapper_opt_reset(&init);
+  init.cache_file_dir = dir.c_str();
+  reddownload_datasource_wrapper_init(&init);
+
+  // opening a play stops the preloads, so they come last
+  std::vector<Session> sessions;
+  for (int i = 0; i < plays; i++)
+    sessions.push_back(
+        openSession(base, dir, "play" + std::to_string(i) + ".mp4", false));
+  for (int i = 0; i < preloads; i++)
+    sessions.push_back(
+        openSession(base, dir, "pre" + std::to_string(i) + ".mp4", true));
+  for (const Session &s : sessions) {
+    if (s.uid < 0) {
+      fprintf(stderr, "opening %s failed\n", s.url.c_str());
+      return 1;
+    }
+  }
+
+  std::atomic<bool> running{true};
+  std::atomic<int> misses{0};
+  int opens = 0;
+  std::thread churner([&] {
+    for (int n = 0; churn && running; n++) {
+      Session s =
+          openSession(base, dir, "churn" + std::to_string(n) + ".mp4", true);
+      reddownload_datasource_wrapper_close(s.url.c_str(), 0);
+      opens++;
+    }
+  });
+  std::vector<std::thread> players;
+  int64_t begin = nowUs();
+  for (const Session &s : sessions) {
+    players.emplace_back([&, s] {
+      for (int i = 0; i < lookups; i++) {
+        // a session answers with its size, unknown here, without touching
+        // the network, a missing one hands the offset back
+        if (reddownload_datasource_wrapper_seek(s.url.c_str(), s.uid, 1,
+                                                AVSEEK_SIZE) == 1)
+          misses++;
+      }
+    });
+  }
+  for (std::thread &t : players)
+    t.join();
+  int64_t elapsed_us = nowUs() - begin;
+  running = false;
+  churner.join();
+
+  printf("{\"sessions\":%zu,\"lookups\":%d,\"total_ms\":%" PRId64
+         ",\"ns_per_lookup\":%" PRId64 ",\"opens\":%d,\"misses\":%d}\n",
+         sessions.size(), lookups, elapsed_us / 1000,
+         elapsed_us * 1000 / (static_cast<int64_t>(lookups) * sessions.size()),
+         opens, misses.load());
+  fflush(stdout);
+
+  for (const Session &s : sessions)
+    reddownload_datasource_wrapper_close(s.url.c_str(), s.uid);
+  close(server);
+  std::string cmd = "rm -rf '" + std::string(dir_template) + "'";
+  if (system(cmd.c_str()) != 0)
+    fprintf(stderr, "removing %s failed\n", dir_template);
+  return misses > 0 ? 1 : 0;
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include "reddownload_datasource_wrapper.h"
 
 #include "NetworkQuality.h"
+#include "REDCacheIndex.h"
 #include "REDDownloadCacheManager.h"
 #include "REDDownloader.h"
 #include "RedLog.h"
@@ -90,9 +91,10 @@ public:
       if (arg1_w && arg1) {
         RedDnsInfo *data = reinterpret_cast<RedDnsInfo *>(arg1);
         if (!data->domain.empty())
-          strlcpy(arg1_w->domain, data->domain.c_str(), sizeof(arg1_w->domain));
+          snprintf(arg1_w->domain, sizeof(arg1_w->domain), "%s",
+                   data->domain.c_str());
         if (!data->ip.empty())
-          strlcpy(arg1_w->ip, data->ip.c_str(), sizeof(arg1_w->ip));
+          snprintf(arg1_w->ip, sizeof(arg1_w->ip), "%s", data->ip.c_str());
         arg1_w->family = data->family;
         arg1_w->port = data->port;
         arg1_w->status = data->status;
@@ -109,9 +111,10 @@ public:
       if (arg1_w && arg1) {
         RedDnsInfo *data = reinterpret_cast<RedDnsInfo *>(arg1);
         if (!data->domain.empty())
-          strlcpy(arg1_w->domain, data->domain.c_str(), sizeof(arg1_w->domain));
+          snprintf(arg1_w->domain, sizeof(arg1_w->domain), "%s",
+                   data->domain.c_str());
         if (!data->ip.empty())
-          strlcpy(arg1_w->ip, data->ip.c_str(), sizeof(arg1_w->ip));
+          snprintf(arg1_w->ip, sizeof(arg1_w->ip), "%s", data->ip.c_str());
         arg1_w->family = data->family;
         arg1_w->port = data->port;
         arg1_w->status = data->status;
@@ -332,6 +335,7 @@ void reddownload_datasource_wrapper_opt_reset(DownLoadOptWrapper *opt) {
     return;
   }
   opt->PreDownLoadSize = -1;
+  opt->PreDownLoadDurationMs = -1;
   opt->cache_file_dir = nullptr;
   opt->cache_max_dir_capacity = -1;
   opt->cache_max_entries = 0;
@@ -387,6 +391,9 @@ void wrapper_to_downloadopt(DownLoadOpt *mop, DownLoadOptWrapper *opt) {
   if (opt->PreDownLoadSize > 0) {
     mop->PreDownLoadSize = opt->PreDownLoadSize;
   }
+  if (opt->PreDownLoadDurationMs > 0) {
+    mop->PreDownLoadDurationMs = opt->PreDownLoadDurationMs;
+  }
   if (opt->cache_file_dir) {
     mop->cache_file_dir = opt->cache_file_dir;
   }
@@ -547,6 +554,18 @@ int reddownload_get_cache_file_path(const char *path, const char *url,
   return 0;
 }
 
+int reddownload_get_keyframe_index_path(const char *path, const char *url,
+                                        char **file_path) {
+  if ((path == nullptr) || (url == nullptr) || (file_path == nullptr)) {
+    return -1;
+  }
+  std::string index_path =
+      RedDownloadCacheManager::getinstance()->GetCacheFilePath(path, url) +
+      CACHE_KEYFRAME_SUFFIX;
+  *file_path = strdup(index_path.c_str());
+  return 0;
+}
+
 int reddownload_get_key(const char *url, char **file_key) {
   if (url == nullptr || file_key == nullptr) {
     return -1;
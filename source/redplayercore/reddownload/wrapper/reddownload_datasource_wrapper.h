@@ -104,6 +104,7 @@ typedef struct DownLoadCbWrapper_ {
 typedef struct DownLoadOptWrapper_ {
   int DownLoadType;
   int64_t PreDownLoadSize;
+  int64_t PreDownLoadDurationMs; // moov and this much playback instead
   const char *cache_file_dir;
   int64_t cache_max_dir_capacity;
   uint32_t cache_max_entries;
@@ -158,6 +159,10 @@ int64_t reddownload_datasource_wrapper_cache_size_by_uri(const char *path,
                                                          int is_full_url);
 int reddownload_get_cache_file_path(const char *path, const char *url,
                                     char **file_path);
+/*where the player keeps the keyframe index of the cache entry, removed with
+ * the entry*/
+int reddownload_get_keyframe_index_path(const char *path, const char *url,
+                                        char **file_path);
 void reddownload_get_all_cached_file(const char *dirpath, char ***cached_file,
                                      int *cached_file_len);
 int reddownload_delete_cache(const char *dirpath, const char *uri,
@@ -434,6 +434,14 @@ RED_ERR CRedPlayer::getAudioCodecInfo(std::string &codec_info) {
   return mRedCore->getAudioCodecInfo(codec_info);
 }
 
+RED_ERR CRedPlayer::getPipelineStats(std::string &stats_json) {
+  return mRedCore->getPipelineStats(stats_json);
+}
+
+RED_ERR CRedPlayer::getPoolStats(std::string &stats_json) {
+  return mRedCore->getPoolStats(stats_json);
+}
+
 RED_ERR CRedPlayer::getPlayUrl(std::string &url) {
   if (playUrlReady.load()) {
     url = mRedCore->mVideoState->play_url;
@@ -707,8 +715,8 @@ void CRedPlayer::checkInputIsJson(const std::string &url) {
   if (player_config) {
     int64_t is_input_json = player_config->GetInt64("is-input-json", 0);
     if (is_input_json > 0) {
-      std::unique_ptr<RedAdaptiveStrategy> strategy = nullptr;
-      strategy = std::make_unique<RedAdaptiveStrategy>(
+      sp<RedAdaptiveStrategy> strategy = nullptr;
+      strategy = std::make_shared<RedAdaptiveStrategy>(
           redstrategycenter::adaptive::logic::AbstractAdaptationLogic::
               LogicType::Adaptive);
       if (strategy) {
@@ -716,10 +724,13 @@ void CRedPlayer::checkInputIsJson(const std::string &url) {
         strategy->setReddownloadUrlCachedFunc(
             reddownload_datasource_wrapper_cache_size);
         sp<RedDict> format_config = mRedCore->getConfig(cfgTypeFormat);
-        mDataSource =
-            strategy->getInitialUrlList(strategy->getInitialRepresentation());
+        int representation = strategy->getInitialRepresentation();
+        mDataSource = strategy->getInitialUrlList(representation);
         mRedCore->mVideoState->play_url =
-            strategy->getInitialUrl(strategy->getInitialRepresentation());
+            strategy->getInitialUrl(representation);
+        if (player_config->GetInt64("adaptive-switch", 0) > 0) {
+          mRedCore->setAdaptiveStrategy(strategy, std::max(representation, 0));
+        }
       }
     }
   }
@@ -79,6 +79,8 @@ public:
 
   RED_ERR getVideoCodecInfo(std::string &codec_info);
   RED_ERR getAudioCodecInfo(std::string &codec_info);
+  RED_ERR getPipelineStats(std::string &stats_json);
+  RED_ERR getPoolStats(std::string &stats_json);
   RED_ERR getPlayUrl(std::string &url);
   int getPlayerState();
 
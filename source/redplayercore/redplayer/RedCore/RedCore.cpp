@@ -8,6 +8,7 @@
 #include "RedCore/RedCore.h"
 #include "RedCore/module/sourcer/format/redioapplication.h"
 #include "RedMsg.h"
+#include "RedStrategyCenter.h"
 #include "wrapper/reddownload_datasource_wrapper.h"
 #include <sys/socket.h>
 
@@ -45,6 +46,12 @@ static int app_func_event(RedApplicationContext *h, int message, void *data) {
     }
   } else if (message == RED_CTRL_DID_TCP_OPEN_W) {
     state->stat.tcp_read_sampler.reset(RED_TCP_READ_SAMPLE_RANGE);
+  } else if (message == REDIOAPP_EVENT_DOWNLOAD_SPEED) {
+    // playback downloads feed the bandwidth the adaptive switch works from
+    RedIOAppSpeedEvent *event = reinterpret_cast<RedIOAppSpeedEvent *>(data);
+    redstrategycenter::RedStrategyCenter::GetInstance()->updateDownloadRate(
+        event->size, event->speed, event->cur_time);
+    return 0;
   } else if (message == RED_EVENT_CACHE_STATISTIC_W) {
     RedCacheStatisticWrapper *statistic =
         reinterpret_cast<RedCacheStatisticWrapper *>(data);
@@ -182,6 +189,14 @@ void CRedCore::setDataSourceFd(int64_t fd) {
   mUrl = url;
 }
 
+void CRedCore::setAdaptiveStrategy(const sp<AdaptiveStrategy> &strategy,
+                                   int index) {
+  auto source_controller = mRedSourceController;
+  if (source_controller) {
+    source_controller->setAdaptiveStrategy(strategy, index);
+  }
+}
+
 RED_ERR CRedCore::prepareAsync() {
   PlayerConfig *player_config = mGeneralConfig->playerConfig->get();
   auto source_controller = mRedSourceController;
@@ -190,6 +205,9 @@ RED_ERR CRedCore::prepareAsync() {
   }
 
   PerformConfigs();
+  mVideoState->pipeline.reset();
+  mVideoState->pipeline.setEnabled(player_config->pipeline_stats);
+  mVideoState->pipeline.markPrepareStart();
   bool enable_reddownload =
       ((mUrl.substr(0, 5) == "http:") || (mUrl.substr(0, 6) == "https:")) &&
       (mUrl.find(".m3u") == std::string::npos);
@@ -252,7 +270,7 @@ RED_ERR CRedCore::getCurrentPosition(int64_t &pos_ms) {
     pos_ms = mMetaData->duration / 1000;
     return OK;
   } else if (source_controller &&
-             getMasterClockSerial(mVideoState) ==
+             getMasterClockSerial(mVideoState) >=
                  source_controller->getSerial() &&
              !mSeeking.load()) {
     double pos = getMasterClock(mVideoState);
@@ -994,6 +1012,16 @@ RED_ERR CRedCore::getAudioCodecInfo(std::string &codec_info) {
   return OK;
 }
 
+RED_ERR CRedCore::getPipelineStats(std::string &stats_json) {
+  stats_json = mVideoState->pipeline.toJson();
+  return OK;
+}
+
+RED_ERR CRedCore::getPoolStats(std::string &stats_json) {
+  stats_json = mVideoState->pools.toJson();
+  return OK;
+}
+
 void CRedCore::checkHighFps() {
   PlayerConfig *player_config = mGeneralConfig->playerConfig->get();
   int video_index = -1;
@@ -40,6 +40,9 @@ public:
 
   void setDataSource(std::string url);
   void setDataSourceFd(int64_t fd);
+  /*lets the read thread switch representations of a json playlist, index
+   * is the one the data source was set to*/
+  void setAdaptiveStrategy(const sp<AdaptiveStrategy> &strategy, int index);
   RED_ERR prepareAsync();
   RED_ERR start();
   RED_ERR startFrom(int64_t msec);
@@ -67,6 +70,8 @@ public:
   sp<RedDict> getConfig(int config_type);
   RED_ERR getVideoCodecInfo(std::string &codec_info);
   RED_ERR getAudioCodecInfo(std::string &codec_info);
+  RED_ERR getPipelineStats(std::string &stats_json);
+  RED_ERR getPoolStats(std::string &stats_json);
 #if defined(__ANDROID__) || defined(__HARMONY__)
   RED_ERR setVideoSurface(const sp<RedNativeWindow> &surface);
   void getWidth(int32_t &width);
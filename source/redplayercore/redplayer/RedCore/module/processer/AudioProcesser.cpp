@@ -7,6 +7,7 @@
 
 #include "AudioProcesser.h"
 #include "RedMsg.h"
+#include "RedTrace.h"
 #include "base/RedConfig.h"
 #include "reddecoder/audio/audio_decoder/audio_decoder_factory.h"
 
@@ -95,7 +96,8 @@ reddecoder::AudioCodecError CAudioProcesser::on_decoded_frame(
     std::unique_ptr<reddecoder::Buffer> decoded_frame) {
 
   auto meta = decoded_frame->get_audio_frame_meta();
-  std::unique_ptr<CGlobalBuffer> buffer(new CGlobalBuffer());
+  std::unique_ptr<CGlobalBuffer> buffer(
+      new (mVideoState->pools.buffers) CGlobalBuffer());
   if (!buffer) {
     return reddecoder::AudioCodecError::kInitError;
   }
@@ -112,9 +114,13 @@ reddecoder::AudioCodecError CAudioProcesser::on_decoded_frame(
   buffer->sample_rate = meta->sample_rate ? meta->sample_rate : 44100;
   buffer->format = meta->sample_format;
   buffer->serial = mSerial;
+  if (mVideoState->pipeline.enabled()) {
+    buffer->decoded_time_us = CurrentTimeUs();
+  }
 
   if (meta->buffer_context) {
-    auto buffer_context = new CGlobalBuffer::FFmpegBufferContext();
+    auto buffer_context = new (mVideoState->pools.buffer_contexts)
+        CGlobalBuffer::FFmpegBufferContext();
     auto od_buffer_context =
         ((reddecoder::FFmpegBufferContext *)meta->buffer_context);
     buffer_context->av_frame = od_buffer_context->av_frame;
@@ -154,6 +160,7 @@ RED_ERR CAudioProcesser::DecoderTransmit(AVPacket *pkt) {
   RED_ERR ret = OK;
   if (!mAudioDecoder)
     return ME_ERROR;
+  RED_TRACE_SCOPE(RED_TRACE_DECODE, "audio_decode", mID);
 
   reddecoder::Buffer buffer(reddecoder::BufferType::kAudioPacket, pkt->data,
                             pkt->size, false);
@@ -222,7 +229,8 @@ RED_ERR CAudioProcesser::ResetDecoderFormat() {
   }
   if (!mAudioDecoder)
     return ME_ERROR;
-  auto track_info = mMetaData->track_info[mMetaData->audio_index];
+  const sp<MetaData> &format = mFormat ? mFormat : mMetaData;
+  auto track_info = format->track_info[mMetaData->audio_index];
   reddecoder::AudioCodecConfig config;
   config.channels = track_info.channels;
   config.sample_rate = track_info.sample_rate;
@@ -395,7 +403,8 @@ void CAudioProcesser::release() {
 void CAudioProcesser::ThreadFunc() {
 #if defined(__APPLE__)
   pthread_setname_np("audiodec");
-#elif defined(__ANDROID__) || defined(__HARMONY__)
+#elif defined(__ANDROID__) || defined(__HARMONY__) ||                          \
+    defined(__HEADLESS__)
   pthread_setname_np(pthread_self(), "audiodec");
 #endif
   PlayerConfig *player_config = mGeneralConfig->playerConfig->get();
@@ -411,6 +420,11 @@ void CAudioProcesser::ThreadFunc() {
     }
     if (pkt->IsFlushPacket()) {
       PerformFlush();
+      if (pkt->GetFormat()) {
+        // packets of another representation follow
+        mFormat = pkt->GetFormat();
+        ResetDecoderFormat();
+      }
       continue;
     } else if (pkt->IsEofPacket()) {
       AV_LOGI_ID(TAG, mID, "EOF!\n");
@@ -430,7 +444,14 @@ void CAudioProcesser::ThreadFunc() {
       continue;
     }
     mVideoState->auddec_finished = false;
+    int64_t decode_start_us = 0;
+    if (mVideoState->pipeline.enabled()) {
+      mVideoState->pipeline.recordSince(STAGE_AUDIO_PACKET_WAIT,
+                                        pkt->GetDemuxTime());
+      decode_start_us = CurrentTimeUs();
+    }
     DecoderTransmit(pkt->GetAVPacket());
+    mVideoState->pipeline.recordSince(STAGE_AUDIO_DECODE, decode_start_us);
   }
   AV_LOGD_ID(TAG, mID, "Audio Processer thread exit.");
 }
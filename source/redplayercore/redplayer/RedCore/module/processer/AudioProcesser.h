@@ -79,6 +79,7 @@ private:
   sp<CoreGeneralConfig> mGeneralConfig;
   sp<CRedSourceController> mRedSourceController;
   sp<MetaData> mMetaData;
+  sp<MetaData> mFormat; // of the representation spliced in last, if any
   sp<VideoState> mVideoState;
   std::unique_ptr<reddecoder::AudioDecoder> mAudioDecoder;
   std::unique_ptr<FrameQueue> mFrameQueue;
@@ -8,6 +8,7 @@
 #include "VideoProcesser.h"
 #include "RedMsg.h"
 #include "RedProp.h"
+#include "RedTrace.h"
 #include "base/RedConfig.h"
 
 #define TAG "VideoProcesser"
@@ -197,6 +198,7 @@ RED_ERR CVideoProcesser::DecoderTransmit(AVPacket *pkt) {
   RED_ERR ret = OK;
   if (!mVideoDecoder)
     return ME_ERROR;
+  RED_TRACE_SCOPE(RED_TRACE_DECODE, "video_decode", mID);
 
   if (!mPendingPkt || !mBuffer) {
     mBuffer.reset();
@@ -206,6 +208,10 @@ RED_ERR CVideoProcesser::DecoderTransmit(AVPacket *pkt) {
     mBuffer->get_video_packet_meta()->dts_ms = pkt->dts;
     mBuffer->get_video_packet_meta()->format =
         reddecoder::VideoPacketFormat::kFollowExtradataFormat;
+    if (pkt->flags & AV_PKT_FLAG_KEY) {
+      mBuffer->get_video_packet_meta()->decode_flags |=
+          static_cast<uint32_t>(reddecoder::DecodeFlag::kKeyFrame);
+    }
   } else {
     mBuffer->get_video_packet_meta()->format =
         reddecoder::VideoPacketFormat::kAnnexb;
@@ -265,7 +271,8 @@ reddecoder::VideoCodecError CVideoProcesser::on_decoded_frame(
   }
 
   auto meta = decoded_frame->get_video_frame_meta();
-  std::unique_ptr<CGlobalBuffer> buffer(new CGlobalBuffer());
+  std::unique_ptr<CGlobalBuffer> buffer(
+      new (mVideoState->pools.buffers) CGlobalBuffer());
   if (!buffer) {
     return reddecoder::VideoCodecError::kAllocateBufferError;
   }
@@ -280,6 +287,15 @@ reddecoder::VideoCodecError CVideoProcesser::on_decoded_frame(
       (AVRational){track_info.time_base_num, track_info.time_base_den};
   buffer->pts = meta->pts_ms * av_q2d(tb) * 1000;
   buffer->serial = mSerial;
+  if (mVideoState->pipeline.enabled()) {
+    buffer->demux_time_us = lookupDemuxTime(meta->pts_ms);
+    buffer->decoded_time_us = CurrentTimeUs();
+  }
+  RED_TRACE_SCOPE(RED_TRACE_DECODE, "video_frame_out", mID);
+  if (RedTraceEnabled()) {
+    buffer->flow_id = RedTraceFlowId(mID, mSerial, meta->pts_ms);
+    RED_TRACE_FLOW_STEP(RED_TRACE_DECODE, "video_frame", mID, buffer->flow_id);
+  }
 
   buffer->uBuffer = meta->uBuffer;
   buffer->vBuffer = meta->vBuffer;
@@ -293,7 +309,8 @@ reddecoder::VideoCodecError CVideoProcesser::on_decoded_frame(
   case reddecoder::PixelFormat::kVTBBuffer:
     buffer->pixel_format = CGlobalBuffer::kVTBBuffer;
     if (meta->buffer_context) {
-      auto buffer_context = new CGlobalBuffer::VideoToolBufferContext();
+      auto buffer_context = new (mVideoState->pools.buffer_contexts)
+          CGlobalBuffer::VideoToolBufferContext();
       buffer_context->buffer =
           ((reddecoder::VideoToolBufferContext *)meta->buffer_context)->buffer;
       buffer->opaque = buffer_context;
@@ -304,7 +321,8 @@ reddecoder::VideoCodecError CVideoProcesser::on_decoded_frame(
     buffer->pixel_format = CGlobalBuffer::kMediaCodecBuffer;
 #if defined(__ANDROID__)
     if (meta->buffer_context) {
-      auto buffer_context = new CGlobalBuffer::MediaCodecBufferContext();
+      auto buffer_context = new (mVideoState->pools.buffer_contexts)
+          CGlobalBuffer::MediaCodecBufferContext();
       auto od_buffer_context =
           ((reddecoder::MediaCodecBufferContext *)meta->buffer_context);
       buffer_context->buffer_index = od_buffer_context->buffer_index;
@@ -336,7 +354,8 @@ reddecoder::VideoCodecError CVideoProcesser::on_decoded_frame(
     buffer->pixel_format = CGlobalBuffer::kHarmonyVideoDecoderBuffer;
 #if defined(__HARMONY__)
     if (meta->buffer_context) {
-      auto buffer_context = new CGlobalBuffer::HarmonyMediaBufferContext();
+      auto buffer_context = new (mVideoState->pools.buffer_contexts)
+          CGlobalBuffer::HarmonyMediaBufferContext();
       auto od_buffer_context = ((reddecoder::HarmonyVideoDecoderBufferContext *)
                                     meta->buffer_context);
       buffer_context->buffer_index = od_buffer_context->buffer_index;
@@ -378,7 +397,8 @@ reddecoder::VideoCodecError CVideoProcesser::on_decoded_frame(
       buffer->pixel_format = CGlobalBuffer::kYUV420P10LE;
     }
     if (meta->buffer_context) {
-      auto buffer_context = new CGlobalBuffer::FFmpegBufferContext();
+      auto buffer_context = new (mVideoState->pools.buffer_contexts)
+          CGlobalBuffer::FFmpegBufferContext();
       auto od_buffer_context =
           ((reddecoder::FFmpegBufferContext *)meta->buffer_context);
       buffer_context->av_frame = od_buffer_context->av_frame;
@@ -399,7 +419,7 @@ reddecoder::VideoCodecError CVideoProcesser::on_decoded_frame(
     break;
   default:
     AV_LOGW_ID(TAG, mID, "unsupportted frame format, format=%d\n",
-               meta->pixel_format);
+               static_cast<int>(meta->pixel_format));
     break;
   }
 
@@ -421,6 +441,7 @@ reddecoder::VideoCodecError CVideoProcesser::on_decoded_frame(
         mVideoState->continuous_frame_drops_early = 0;
       } else {
         mVideoState->stat.drop_frame_count++;
+        mVideoState->pipeline.countDroppedFrame(false);
         mVideoState->stat.drop_frame_rate =
             static_cast<float>(mVideoState->stat.drop_frame_count) /
             static_cast<float>(mVideoState->stat.decode_frame_count);
@@ -435,6 +456,14 @@ reddecoder::VideoCodecError CVideoProcesser::on_decoded_frame(
     return reddecoder::VideoCodecError::kNoError;
   }
 
+  // off the render thread, which then only uploads. A failure leaves the
+  // frame to the renderer
+  if (player_config->vdec_convert_10bit &&
+      buffer->pixel_format == CGlobalBuffer::kYUV420P10LE &&
+      !mVideoState->video_render_10bit) {
+    mVideoState->pools.pixel_converter.convertBuffer(*buffer);
+  }
+
   if (mWidth != buffer->width || mHeight != buffer->height) {
     mWidth = buffer->width;
     mHeight = buffer->height;
@@ -523,6 +552,9 @@ RED_ERR CVideoProcesser::PerformFlush() {
     mVideoDecoder->flush();
   }
   mInputPacketCount = 0;
+  for (int i = 0; i < DEMUX_TIME_SLOTS; i++) {
+    mDemuxTimes[i] = DemuxTime();
+  }
   if (mVideoState->pause_req) {
     mVideoState->step_to_next_frame = true;
   }
@@ -550,7 +582,8 @@ RED_ERR CVideoProcesser::ResetDecoderFormat() {
   }
   PlayerConfig *player_config = mGeneralConfig->playerConfig->get();
 
-  auto track_info = mMetaData->track_info[mMetaData->video_index];
+  const sp<MetaData> &format = mFormat ? mFormat : mMetaData;
+  auto track_info = format->track_info[mMetaData->video_index];
   reddecoder::Buffer buffer(reddecoder::BufferType::kVideoFormatDesc,
                             track_info.extra_data, track_info.extra_data_size,
                             false);
@@ -657,6 +690,10 @@ RED_ERR CVideoProcesser::ResetDecoderFormat() {
   }
   buffer_meta->sample_aspect_ratio.den = track_info.sar_den;
   buffer_meta->sample_aspect_ratio.num = track_info.sar_num;
+  buffer_meta->thread_type =
+      static_cast<reddecoder::VideoThreadType>(player_config->vdec_thread_type);
+  buffer_meta->thread_count = player_config->vdec_threads;
+  buffer_meta->low_delay_start = player_config->vdec_low_delay_start;
   mVideoDecoder->set_video_format_description(&buffer);
   mCodecConfigured = true;
   return ret;
@@ -788,6 +825,25 @@ bool CVideoProcesser::checkAccurateSeek(
   return false;
 }
 
+void CVideoProcesser::rememberDemuxTime(AVPacket *pkt, int64_t demux_time_us) {
+  if (!pkt || pkt->pts == AV_NOPTS_VALUE) {
+    return;
+  }
+  DemuxTime &entry = mDemuxTimes[mDemuxTimeIndex];
+  entry.pts = pkt->pts;
+  entry.time_us = demux_time_us;
+  mDemuxTimeIndex = (mDemuxTimeIndex + 1) % DEMUX_TIME_SLOTS;
+}
+
+int64_t CVideoProcesser::lookupDemuxTime(int64_t pts) {
+  for (int i = 0; i < DEMUX_TIME_SLOTS; i++) {
+    if (mDemuxTimes[i].pts == pts) {
+      return mDemuxTimes[i].time_us;
+    }
+  }
+  return 0;
+}
+
 bool CVideoProcesser::pktQueueFrontIsFlush() {
   if (!mRedSourceController)
     return false;
@@ -840,7 +896,8 @@ void CVideoProcesser::release() {
 void CVideoProcesser::ThreadFunc() {
 #if defined(__APPLE__)
   pthread_setname_np("videodec");
-#elif defined(__ANDROID__) || defined(__HARMONY__)
+#elif defined(__ANDROID__) || defined(__HARMONY__) ||                          \
+    defined(__HEADLESS__)
   pthread_setname_np(pthread_self(), "videodec");
 #endif
   PlayerConfig *player_config = mGeneralConfig->playerConfig->get();
@@ -916,8 +973,10 @@ void CVideoProcesser::ThreadFunc() {
 
     std::unique_ptr<RedAvPacket> pkt;
     RED_ERR ret = OK;
+    bool pending = false;
     if (mPendingPkt && !pktQueueFrontIsFlush()) {
       pkt = std::move(mPendingPkt);
+      pending = true;
     } else {
       ret = ReadPacketOrBuffering(pkt);
     }
@@ -931,8 +990,13 @@ void CVideoProcesser::ThreadFunc() {
     if (pkt->IsFlushPacket()) {
       PerformFlush();
       mPendingPkt.reset();
-      if (mVideoState->stat.vdec_type == RED_PROPV_DECODER_VIDEOTOOLBOX &&
-          player_config->vtb_max_error_count) {
+      if (pkt->GetFormat()) {
+        // packets of another representation follow
+        mFormat = pkt->GetFormat();
+        ResetDecoder();
+      } else if (mVideoState->stat.vdec_type ==
+                     RED_PROPV_DECODER_VIDEOTOOLBOX &&
+                 player_config->vtb_max_error_count) {
         ResetDecoder();
       }
       continue;
@@ -986,7 +1050,17 @@ void CVideoProcesser::ThreadFunc() {
       DecodeLastCacheGop();
       mRefreshSession = false;
     }
+    int64_t decode_start_us = 0;
+    if (mVideoState->pipeline.enabled()) {
+      if (!pending) {
+        mVideoState->pipeline.recordSince(STAGE_VIDEO_PACKET_WAIT,
+                                          pkt->GetDemuxTime());
+        rememberDemuxTime(pkt->GetAVPacket(), pkt->GetDemuxTime());
+      }
+      decode_start_us = CurrentTimeUs();
+    }
     ret = DecoderTransmit(pkt->GetAVPacket());
+    mVideoState->pipeline.recordSince(STAGE_VIDEO_DECODE, decode_start_us);
     if (ret == ME_RETRY) {
       mPendingPkt = std::move(pkt);
       continue;
@@ -45,6 +45,8 @@ extern "C" {
 
 REDPLAYER_NS_BEGIN;
 
+#define DEMUX_TIME_SLOTS 32
+
 class CVideoProcesser : public CRedThreadBase,
                         reddecoder::VideoDecodedCallback {
 public:
@@ -87,6 +89,8 @@ private:
                       int obj1_len = 0, int obj2_len = 0);
   bool checkAccurateSeek(const std::unique_ptr<CGlobalBuffer> &buffer);
   bool pktQueueFrontIsFlush();
+  void rememberDemuxTime(AVPacket *pkt, int64_t demux_time_us);
+  int64_t lookupDemuxTime(int64_t pts);
 
 private:
   std::mutex mLock;
@@ -121,7 +125,15 @@ private:
   std::unique_ptr<reddecoder::Buffer> mBuffer;
   std::unique_ptr<reddecoder::VideoDecoder> mVideoDecoder;
   std::list<std::shared_ptr<RedAvPacket>> mPktQueue;
+  // pts -> demux time of the packets in the decoder, for pipeline stats
+  struct DemuxTime {
+    int64_t pts{AV_NOPTS_VALUE};
+    int64_t time_us{0};
+  };
+  DemuxTime mDemuxTimes[DEMUX_TIME_SLOTS];
+  int mDemuxTimeIndex{0};
   sp<MetaData> mMetaData;
+  sp<MetaData> mFormat; // of the representation spliced in last, if any
   sp<VideoState> mVideoState;
   NotifyCallback mNotifyCb;
   SpeedSampler mSpeedSampler;
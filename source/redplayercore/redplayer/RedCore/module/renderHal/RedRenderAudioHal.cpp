@@ -7,10 +7,18 @@
 
 #include "RedCore/module/renderHal/RedRenderAudioHal.h"
 #include "base/RedConfig.h"
+#if defined(__HEADLESS__)
+#include "redrender/audio/null/null_audio_render.h"
+#endif
 
 #include "RedMsg.h"
+#include "RedTrace.h"
 
 #define TAG "RedRenderAudioHal"
+// the producer ring holds at least this many device buffers
+#define PCM_RING_MIN_BUFFERS 4
+// average chunk size the descriptor ring is sized for
+#define PCM_RING_CHUNK_BYTES 512
 
 REDPLAYER_NS_BEGIN;
 
@@ -42,12 +50,74 @@ CRedRenderAudioHal::~CRedRenderAudioHal() {
   mMetaData.reset();
 }
 
-void CRedRenderAudioHal::ThreadFunc() {}
+// base method, the producer: decoded frames in, ready to play pcm out
+void CRedRenderAudioHal::ThreadFunc() {
+#if defined(__APPLE__)
+  pthread_setname_np("audioproducer");
+#elif defined(__ANDROID__) || defined(__HARMONY__) ||                          \
+    defined(__HEADLESS__)
+  pthread_setname_np(pthread_self(), "audioproducer");
+#endif
+
+  std::unique_ptr<CGlobalBuffer> buffer;
+  int size = 0;
+  int written = 0;
+  while (!mAbort) {
+    if (written >= size) {
+      buffer.reset();
+      written = 0;
+      size = ConvertNextFrame(buffer);
+      if (size <= 0) {
+        size = 0;
+        std::unique_lock<std::mutex> lck(mLock);
+        if (!mAbort) {
+          mCond.wait_for(lck, std::chrono::microseconds(mProducerWaitUs));
+        }
+        continue;
+      }
+    }
+    if (buffer->serial != mAudioProcesser->getSerial()) {
+      written = size;
+      continue;
+    }
+    PcmChunkInfo info;
+    info.serial = buffer->serial;
+    info.bytes_per_sec = mBytesPerSec;
+    info.pts = buffer->pts;
+    if (mBytesPerSec > 0) {
+      info.pts += static_cast<double>(written) / mBytesPerSec * 1000;
+    }
+    // a frame bigger than the ring, e.g. slowed down, goes in pieces
+    info.size = std::min(size - written, mPcmRing.capacity() / 2);
+    if (mPcmRing.write(mAudioBuf + written, info)) {
+      written += info.size;
+      continue;
+    }
+    // the callback signals once it has read, the timeout only covers a
+    // signal sent between the failed write and the wait
+    std::unique_lock<std::mutex> lck(mLock);
+    if (!mAbort) {
+      mCond.wait_for(lck, std::chrono::microseconds(mProducerWaitUs));
+    }
+  }
+}
 
 RED_ERR CRedRenderAudioHal::Prepare(sp<MetaData> &metadata) {
   RED_ERR ret = OK;
   mMetaData = metadata;
   mAudioRender = redrender::audio::AudioRenderFactory::CreateAudioRender(mID);
+#if defined(__HEADLESS__)
+  if (mAudioRender && mGeneralConfig) {
+    PlayerConfig *player_config = mGeneralConfig->playerConfig->get();
+    static_cast<redrender::audio::NullAudioRender *>(mAudioRender.get())
+        ->SetFreeRun(player_config && player_config->headless_free_run);
+  }
+#endif
+
+  PlayerConfig *player_config =
+      mGeneralConfig ? mGeneralConfig->playerConfig->get() : nullptr;
+  // decided before the render is opened, its callback may start right away
+  mProducerMode = player_config && player_config->audio_producer;
 
   ret = Init();
   if (ret != OK) {
@@ -59,6 +129,20 @@ RED_ERR CRedRenderAudioHal::Prepare(sp<MetaData> &metadata) {
     soundtouchDestroy(&mSoundTouchHandle);
   }
   mSoundTouchHandle = soundtouchCreate();
+
+  if (mProducerMode && mBytesPerSec > 0) {
+    // twice the device latency, so the callback never waits on a conversion
+    int capacity = std::max(
+        PCM_RING_MIN_BUFFERS * static_cast<int>(mObtained.size),
+        static_cast<int>(mBytesPerSec * mAudioRender->GetLatencySeconds() * 2));
+    mPcmRing.init(capacity, capacity / PCM_RING_CHUNK_BYTES + 1);
+    mProducerWaitUs =
+        static_cast<int64_t>(mObtained.size) * 1000000 / mBytesPerSec / 2;
+    mPcmRingReady.store(true, std::memory_order_release);
+    AV_LOGI_ID(TAG, mID, "audio producer ring %d bytes, wait %" PRId64 "us\n",
+               capacity, mProducerWaitUs);
+    run();
+  }
   return ret;
 }
 
@@ -139,7 +223,8 @@ RED_ERR CRedRenderAudioHal::Init() {
                  "redrender OpenAudio wanted channels:%d, sample_rate:%d, "
                  "channel_layout:%" PRIu64 ", format:%d mBytesPerSec %d\n",
                  mDesired.channels, mDesired.sample_rate,
-                 mDesired.channel_layout, mDesired.format, mBytesPerSec);
+                 mDesired.channel_layout, static_cast<int>(mDesired.format),
+                 mBytesPerSec);
       break;
     }
   }
@@ -176,7 +261,7 @@ RED_ERR CRedRenderAudioHal::Init() {
       "redrender OpenAudio obtained channels:%d, sample_rate:%d, "
       "channel_layout:%" PRIu64 ", format:%d mAudioDelay %f, mBytesPerSec %d\n",
       mObtained.channels, mObtained.sample_rate, mObtained.channel_layout,
-      mObtained.format, mAudioDelay, mBytesPerSec);
+      static_cast<int>(mObtained.format), mAudioDelay, mBytesPerSec);
   return OK;
 }
 
@@ -318,87 +403,165 @@ int CRedRenderAudioHal::ResampleAudioData(
   return resampled_data_size;
 }
 
+/*reads, resamples and time-stretches frames until one yields pcm, which is
+ * left in mAudioBuf. returns its size, <= 0 when there was nothing to play*/
+int CRedRenderAudioHal::ConvertNextFrame(
+    std::unique_ptr<CGlobalBuffer> &buffer) {
+  RED_TRACE_SCOPE(RED_TRACE_AUDIO, "audio_convert", mID);
+  int translate_time = 1;
+  while (!mAbort) {
+    buffer.reset();
+    RED_ERR ret = ReadFrame(buffer);
+    if (ret != OK || !buffer) {
+      return 0;
+    }
+    mVideoState->pipeline.recordSince(STAGE_AUDIO_FRAME_WAIT,
+                                      buffer->decoded_time_us);
+    int resampled_data_size = ResampleAudioData(buffer);
+    if (resampled_data_size <= 0) {
+      AV_LOGW_ID(TAG, mID, "Failed to resample audio data!\n");
+      return 0;
+    }
+
+    if (mPlaybackRate != 1.0f && !mAbort) {
+      int wanted_nb_samples = buffer->nb_samples;
+      int out_count =
+          static_cast<int>(static_cast<int64_t>(wanted_nb_samples) *
+                               mObtained.sample_rate / buffer->sample_rate +
+                           256);
+      int out_size = av_samples_get_buffer_size(
+          nullptr, mObtained.channels, out_count,
+          RedRenderAudioFmtToFfmegAudioFmt(mObtained.format), 0);
+      int bytes_per_sample = av_get_bytes_per_sample(
+          RedRenderAudioFmtToFfmegAudioFmt(mObtained.format));
+      int min_times = 1;
+      if (mPlaybackRate > 0 && mPlaybackRate < 1.0f) {
+        min_times = static_cast<int>(ceil(1.0 / mPlaybackRate));
+      }
+      av_fast_malloc(&mAudioNewBuf, &mAudioNewBufSize,
+                     out_size * translate_time * min_times);
+      // s16 is host order on every target, no need to repack byte by byte
+      memcpy(mAudioNewBuf, mAudioBuf1, resampled_data_size);
+      int ret_len = soundtouchTranslate(
+          mSoundTouchHandle, mAudioNewBuf, static_cast<float>(mPlaybackRate),
+          static_cast<float>(1.0f) / mPlaybackRate, resampled_data_size / 2,
+          bytes_per_sample, mObtained.channels, buffer->sample_rate);
+      if (ret_len <= 0) {
+        translate_time++;
+        continue;
+      }
+      mAudioBuf = reinterpret_cast<uint8_t *>(mAudioNewBuf);
+      resampled_data_size = ret_len;
+    }
+    return resampled_data_size;
+  }
+  return 0;
+}
+
+void CRedRenderAudioHal::ApplyVolumeChange() {
+  if (mVolumeChanged.exchange(false)) {
+    float left_volume = mLeftVolume.load();
+    float right_volume = mRightVolume.load();
+    if (mAudioRender) {
+      AV_LOGI_ID(TAG, mID, "volume changed %f %f\n", left_volume,
+                 right_volume);
+#if defined(__ANDROID__) || defined(__HARMONY__)
+      mAudioRender->SetStereoVolume(left_volume, right_volume);
+#elif defined(__APPLE__)
+      mAudioRender->SetPlaybackVolume((left_volume + right_volume) / 2);
+#endif
+    }
+  }
+}
+
 void CRedRenderAudioHal::GetAudioData(char *data, int &len) {
   if (!data || len <= 0) {
     return;
   }
+  RED_TRACE_SCOPE(RED_TRACE_AUDIO, "audio_callback", mID);
+  RED_TRACE_COUNTER(RED_TRACE_AUDIO, "audio_callback_bytes", mID, len);
+  int64_t start_us = mVideoState->pipeline.enabled() ? CurrentTimeUs() : 0;
+  if (mProducerMode) {
+    ReadPcmRing(data, len);
+  } else {
+    PullAudioData(data, len);
+  }
+  mVideoState->pipeline.recordSince(STAGE_AUDIO_CALLBACK, start_us);
+}
+
+/*producer mode callback, copies what the producer thread converted and
+ * leaves silence on underrun, then wakes the producer. no locks and no
+ * decoder work in here*/
+void CRedRenderAudioHal::ReadPcmRing(char *data, int len) {
+  memset(data, 0, len);
+  if (mAbort || !mPcmRingReady.load(std::memory_order_acquire)) {
+    return;
+  }
+  ApplyVolumeChange();
+
+  uint8_t *out = reinterpret_cast<uint8_t *>(data);
+  int offset = 0;
+  int serial = -1;
+  double current_pts = 0;
+  PcmChunkInfo info;
+  int chunk_offset = 0;
+  while (offset < len && mPcmRing.peek(info, chunk_offset)) {
+    if (info.serial != mAudioProcesser->getSerial()) {
+      while (mPcmRing.peek(info, chunk_offset) &&
+             info.serial != mAudioProcesser->getSerial()) {
+        mPcmRing.skipChunk();
+      }
+      if (mAudioRender) {
+        mAudioRender->FlushAudio();
+      }
+      mCond.notify_one();
+      return;
+    }
+    int write_size =
+        mPcmRing.read(mMute.load() ? nullptr : out + offset, len - offset);
+    offset += write_size;
+    serial = info.serial;
+    current_pts = info.pts;
+    if (info.bytes_per_sec > 0) {
+      current_pts += static_cast<double>(chunk_offset + write_size) /
+                     info.bytes_per_sec * 1000;
+    }
+  }
+  if (offset > 0) {
+    // room for the producer, a notify without waiters stays in user space
+    mCond.notify_one();
+  }
+  if (serial >= 0) {
+    UpdateAudioClock(current_pts, serial);
+  }
+}
+
+void CRedRenderAudioHal::PullAudioData(char *data, int &len) {
   std::unique_lock<std::mutex> lck(mLock);
   int left_size = len;
   int offset = 0;
   double current_pts = 0;
   memset(data, 0, len);
-  int translate_time = 1;
 
   if (mAbort) {
     return;
   }
 
-  if (mVolumeChanged) {
-    mVolumeChanged = false;
-    if (mAudioRender) {
-      AV_LOGI_ID(TAG, mID, "volume changed %f %f\n", mLeftVolume, mRightVolume);
-#if defined(__ANDROID__) || defined(__HARMONY__)
-      mAudioRender->SetStereoVolume(mLeftVolume, mRightVolume);
-#elif defined(__APPLE__)
-      mAudioRender->SetPlaybackVolume((mLeftVolume + mRightVolume) / 2);
-#endif
-    }
-  }
+  ApplyVolumeChange();
 
   while (left_size > 0 && !mAbort) {
     if (mLastReadPos == 0) {
-    reload:
       mAudioBuffer->free();
       mAudioBufSize = 0;
-      RED_ERR ret = OK;
       std::unique_ptr<CGlobalBuffer> buffer;
       lck.unlock();
-      ret = ReadFrame(buffer);
-      if (ret != OK || !buffer) {
+      int data_size = ConvertNextFrame(buffer);
+      if (data_size <= 0) {
         return;
       }
-      int resampled_data_size = ResampleAudioData(buffer);
-      if (resampled_data_size <= 0) {
-        AV_LOGW_ID(TAG, mID, "Failed to resample audio data!\n");
-        return;
-      }
-
-      if (mPlaybackRate != 1.0f && !mAbort) {
-        int wanted_nb_samples = buffer->nb_samples;
-        int out_count =
-            static_cast<int>(static_cast<int64_t>(wanted_nb_samples) *
-                                 mObtained.sample_rate / buffer->sample_rate +
-                             256);
-        int out_size = av_samples_get_buffer_size(
-            nullptr, mObtained.channels, out_count,
-            RedRenderAudioFmtToFfmegAudioFmt(mObtained.format), 0);
-        int bytes_per_sample = av_get_bytes_per_sample(
-            RedRenderAudioFmtToFfmegAudioFmt(mObtained.format));
-        int min_times = 1;
-        if (mPlaybackRate > 0 && mPlaybackRate < 1.0f) {
-          min_times = static_cast<int>(ceil(1.0 / mPlaybackRate));
-        }
-        av_fast_malloc(&mAudioNewBuf, &mAudioNewBufSize,
-                       out_size * translate_time * min_times);
-        for (int i = 0; i < (resampled_data_size / 2); i++) {
-          mAudioNewBuf[i] = (mAudioBuf1[i * 2] | (mAudioBuf1[i * 2 + 1] << 8));
-        }
-        int ret_len = soundtouchTranslate(
-            mSoundTouchHandle, mAudioNewBuf, static_cast<float>(mPlaybackRate),
-            static_cast<float>(1.0f) / mPlaybackRate, resampled_data_size / 2,
-            bytes_per_sample, mObtained.channels, buffer->sample_rate);
-        if (ret_len > 0) {
-          mAudioBuf = reinterpret_cast<uint8_t *>(mAudioNewBuf);
-          resampled_data_size = ret_len;
-        } else {
-          translate_time++;
-          lck.lock();
-          goto reload;
-        }
-      }
       lck.lock();
       mAudioBuffer = std::move(buffer);
-      mAudioBufSize = resampled_data_size;
+      mAudioBufSize = data_size;
     }
 
     if (mAudioBuffer->serial != mAudioProcesser->getSerial()) {
@@ -426,10 +589,14 @@ void CRedRenderAudioHal::GetAudioData(char *data, int &len) {
     mLastReadPos = mLastReadPos == mAudioBufSize ? 0 : mLastReadPos;
   }
   lck.unlock();
+  UpdateAudioClock(current_pts, mAudioBuffer->serial);
+}
+
+void CRedRenderAudioHal::UpdateAudioClock(double current_pts, int serial) {
   if (current_pts > 0) {
     mVideoState->audio_clock->SetClock(current_pts / 1000.0 - mAudioDelay);
-    if (mVideoState->audio_clock->GetClockSerial() != mAudioBuffer->serial) {
-      mVideoState->audio_clock->SetClockSerial(mAudioBuffer->serial);
+    if (mVideoState->audio_clock->GetClockSerial() != serial) {
+      mVideoState->audio_clock->SetClockSerial(serial);
     }
     if (!mVideoState->audio_clock->GetClockAvaliable()) {
       mVideoState->audio_clock->SetClockAvaliable(true);
@@ -437,15 +604,17 @@ void CRedRenderAudioHal::GetAudioData(char *data, int &len) {
   }
   if (!mVideoState->first_audio_frame_rendered) {
     mVideoState->first_audio_frame_rendered = 1;
+    if (mVideoState->video_stream_index < 0) {
+      mVideoState->pipeline.markFirstFrame();
+    }
     notifyListener(RED_MSG_AUDIO_RENDERING_START);
   }
 
-  if (mAudioBuffer->serial >= 0 &&
-      mVideoState->latest_audio_seek_load_serial == mAudioBuffer->serial) {
+  if (serial >= 0 && mVideoState->latest_audio_seek_load_serial == serial) {
     int latest_audio_seek_load_serial =
         mVideoState->latest_audio_seek_load_serial.exchange(
             -1, std::memory_order_seq_cst);
-    if (latest_audio_seek_load_serial == mAudioBuffer->serial) {
+    if (latest_audio_seek_load_serial == serial) {
       if (getMasterSyncType(mVideoState) == CLOCK_AUDIO) {
         notifyListener(RED_MSG_AUDIO_SEEK_RENDERING_START, 1);
       } else {
@@ -482,6 +651,22 @@ void CRedRenderAudioHal::setNotifyCb(NotifyCallback notify_cb) {
 
 void CRedRenderAudioHal::release() {
   AV_LOGD_ID(TAG, mID, "%s start\n", __func__);
+  {
+    std::unique_lock<std::mutex> lck(mThreadLock);
+    if (mReleased) {
+      AV_LOGD_ID(TAG, mID, "%s already released, just return.\n", __func__);
+      return;
+    }
+    mReleased = true;
+  }
+  {
+    std::unique_lock<std::mutex> lck(mLock);
+    mAbort = true;
+    mCond.notify_all();
+  }
+  if (mThread.joinable()) {
+    mThread.join();
+  }
   if (mAudioRender) {
     mAudioRender->CloseAudio();
     mAudioRender->WaitClose();
@@ -500,19 +685,20 @@ void CRedRenderAudioHal::setPlaybackRate(const float rate) {
 }
 
 float CRedRenderAudioHal::getVolume() {
-  return (mLeftVolume + mRightVolume) / 2;
+  return (mLeftVolume.load() + mRightVolume.load()) / 2;
 }
 
 void CRedRenderAudioHal::setVolume(const float left_volume,
                                    const float right_volume) {
   AV_LOGI_ID(TAG, mID, "%s %f %f\n", __func__, left_volume, right_volume);
-  if (std::abs(mLeftVolume - left_volume) < FLT_EPSILON &&
-      std::abs(mRightVolume - right_volume) < FLT_EPSILON) {
+  if (std::abs(mLeftVolume.load() - left_volume) < FLT_EPSILON &&
+      std::abs(mRightVolume.load() - right_volume) < FLT_EPSILON) {
     return;
   }
-  mLeftVolume = std::min(std::max(left_volume, 0.0f), 1.0f);
-  mRightVolume = std::min(std::max(right_volume, 0.0f), 1.0f);
-  mVolumeChanged = true;
+  mLeftVolume.store(std::min(std::max(left_volume, 0.0f), 1.0f));
+  mRightVolume.store(std::min(std::max(right_volume, 0.0f), 1.0f));
+  // published last, the callback reads the volumes after taking the flag
+  mVolumeChanged.store(true);
 }
 
 void CRedRenderAudioHal::setMute(bool mute) {
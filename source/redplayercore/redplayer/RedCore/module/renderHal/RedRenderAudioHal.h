@@ -8,6 +8,7 @@
 #include "SoundTouchHal.h"
 #include "base/RedBuffer.h"
 #include "base/RedClock.h"
+#include "base/RedPcmRing.h"
 #include "base/RedQueue.h"
 #include "redrender/audio/audio_render_factory.h"
 #include <float.h>
@@ -88,6 +89,11 @@ private:
   RED_ERR Init();
   static void AudioDataCb(void *userdata, char *data, int &len);
   void GetAudioData(char *data, int &len);
+  void PullAudioData(char *data, int &len);
+  void ReadPcmRing(char *data, int len);
+  void UpdateAudioClock(double current_pts, int serial);
+  void ApplyVolumeChange();
+  int ConvertNextFrame(std::unique_ptr<CGlobalBuffer> &buffer);
   void notifyListener(uint32_t what, int32_t arg1 = 0, int32_t arg2 = 0,
                       void *obj1 = nullptr, void *obj2 = nullptr,
                       int obj1_len = 0, int obj2_len = 0);
@@ -102,6 +108,7 @@ private:
   sp<CAudioProcesser> mAudioProcesser;
   std::mutex mLock;
   std::mutex mNotifyCbLock;
+  std::mutex mThreadLock;
   std::condition_variable mCond;
   std::unique_ptr<CGlobalBuffer> mAudioBuffer;
   uint8_t *mAudioBuf{nullptr};
@@ -113,15 +120,22 @@ private:
   bool mAbort{false};
   bool mPaused{false};
   bool mPlaybackRateChanged{false};
-  bool mVolumeChanged{false};
+  // set by setVolume, taken by whichever callback runs next
+  std::atomic_bool mVolumeChanged{false};
   bool mFirstFrameDecoded{false};
+  bool mReleased{false};
+  // set when decoded frames are converted on the producer thread
+  bool mProducerMode{false};
+  RedPcmRing mPcmRing;
+  std::atomic_bool mPcmRingReady{false};
+  int64_t mProducerWaitUs{0};
   sp<MetaData> mMetaData;
   sp<CoreGeneralConfig> mGeneralConfig;
   sp<VideoState> mVideoState;
   double mAudioDelay{0.0};
   float mPlaybackRate{1.0};
-  float mLeftVolume{1.0};
-  float mRightVolume{1.0};
+  std::atomic<float> mLeftVolume{1.0};
+  std::atomic<float> mRightVolume{1.0};
   int mLastReadPos{0};
   int mBytesPerSec{0};
   std::atomic_bool mMute{false};
@@ -8,6 +8,7 @@
 #include "RedRenderVideoHal.h"
 #include "RedMsg.h"
 #include "RedProp.h"
+#include "RedTrace.h"
 #include "base/RedConfig.h"
 #include <cfloat>
 
@@ -18,6 +19,7 @@
 #define AV_SYNC_FRAMEDUP_THRESHOLD 0.15
 #define MAX_FRAME_DURATION 10.0
 #define REFRESH_RATE 0.01
+#define PRESENT_MAX_WAIT 0.1 // re-read the master clock at least this often
 
 REDPLAYER_NS_BEGIN;
 
@@ -31,7 +33,6 @@ CRedRenderVideoHal::~CRedRenderVideoHal() {
   mVideoRender.reset();
   mVideoProcesser.reset();
   mMetaData.reset();
-  sws_freeContext(mSwsContext);
 }
 
 RED_ERR CRedRenderVideoHal::Prepare(sp<MetaData> &metadata) {
@@ -113,6 +114,7 @@ UIView *CRedRenderVideoHal::initWithFrame(int type, CGRect cgrect) {
     RedRender::VideoRendererInfo videRendererInfo(
         RedRender::VRClusterTypeAVSBDL);
     mClusterType = RedRender::VRClusterTypeAVSBDL;
+    mVideoState->video_render_10bit = true;
     mVideoRender =
         videoRendererFactory->createVideoRenderer(videRendererInfo, mID);
     break;
@@ -198,6 +200,65 @@ RED_ERR CRedRenderVideoHal::ReadFrame(std::unique_ptr<CGlobalBuffer> &buffer) {
   return mVideoProcesser->getFrame(buffer);
 }
 
+RED_ERR
+CRedRenderVideoHal::WaitForDeadline(std::unique_ptr<CGlobalBuffer> &buffer,
+                                    bool drop_late, bool free_run,
+                                    double &due) {
+  double now = 0.0;
+  while (!mAbort) {
+    if (buffer->serial != mVideoProcesser->getSerial()) {
+      return ME_CLOSED;
+    }
+    double pts = buffer->pts / 1000.0;
+    double master = NAN;
+    if (getMasterSyncType(mVideoState) != CLOCK_VIDEO) {
+      master = getMasterClock(mVideoState);
+      if (std::abs(pts - master) >= AV_NOSYNC_THRESHOLD) {
+        master = NAN;
+      }
+      mVideoState->stat.avdiff = isnan(master) ? 0.0 : pts - master;
+    }
+    now = CurrentTimeUs() / 1000000.0;
+    due = free_run ? now
+                   : mScheduler.schedule(buffer->serial, pts, master, now,
+                                         mVideoState->playback_rate);
+    if (now >= due || mForceRefresh) {
+      break;
+    }
+    double wait = std::min(due - now, PRESENT_MAX_WAIT);
+    std::unique_lock<std::mutex> lck(mLock);
+    if (!mAbort) {
+      mCond.wait_for(lck, std::chrono::microseconds(
+                              static_cast<int64_t>(wait * 1000000)));
+    }
+  }
+  if (mAbort) {
+    return ME_CLOSED;
+  }
+
+  // every queued frame already due makes the ones before it obsolete
+  sp<FrameQueue> queue = mVideoProcesser->frameQueue();
+  size_t late = 0;
+  double pts = 0.0;
+  int serial = 0;
+  while (drop_late && !free_run && now > due && queue &&
+         queue->peek(late, pts, serial) && serial == buffer->serial &&
+         mScheduler.deadline(pts / 1000.0) <= now) {
+    late++;
+  }
+  if (late > 0 && queue->skipFrames(late - 1, buffer) == OK) {
+    AV_LOGI_ID(TAG, mID,
+               "video late drop %zu frames, deadline %f, time %f, next pts "
+               "%f\n",
+               late, due, now, buffer->pts / 1000.0);
+    for (size_t i = 0; i < late; i++) {
+      mVideoState->pipeline.countDroppedFrame(true);
+    }
+    due = mScheduler.deadline(buffer->pts / 1000.0);
+  }
+  return OK;
+}
+
 RED_ERR CRedRenderVideoHal::Init() {
   std::unique_lock<std::mutex> lck(mLock);
 
@@ -207,7 +268,11 @@ RED_ERR CRedRenderVideoHal::Init() {
 
   switch (mVideoState->stat.vdec_type) {
   case RED_PROPV_DECODER_AVCODEC:
+#if defined(__HEADLESS__)
+    mClusterType = RedRender::VRClusterTypeNull;
+#else
     mClusterType = RedRender::VRClusterTypeOpenGL;
+#endif
     break;
   case RED_PROPV_DECODER_MEDIACODEC:
     mClusterType = RedRender::VRClusterTypeMediaCodec;
@@ -257,6 +322,11 @@ RED_ERR CRedRenderVideoHal::Init() {
     mVideoRender =
         videoRendererFactory->createVideoRenderer(videRendererInfo, mID);
   } break;
+  case RedRender::VRClusterTypeNull: {
+    RedRender::VideoRendererInfo videRendererInfo(RedRender::VRClusterTypeNull);
+    mVideoRender =
+        videoRendererFactory->createVideoRenderer(videRendererInfo, mID);
+  } break;
   case RedRender::VRClusterTypeUnknown:
   default:
     AV_LOGE_ID(TAG, mID, "[%s:%d] VideoRendererClusterTypeUnknownWrapper_ .\n",
@@ -294,7 +364,8 @@ RED_ERR CRedRenderVideoHal::UpdateVideoFrameMetaData() {
   switch (mClusterType) {
   case RedRender::VRClusterTypeOpenGL:
   case RedRender::VRClusterTypeMetal:
-  case RedRender::VRClusterTypeAVSBDL: {
+  case RedRender::VRClusterTypeAVSBDL:
+  case RedRender::VRClusterTypeNull: {
     TrackInfo track_info = mMetaData->track_info[mMetaData->video_index];
     mVideoFrameMetaData.frameWidth = track_info.width;
     mVideoFrameMetaData.frameHeight = track_info.height;
@@ -408,6 +479,8 @@ RED_ERR CRedRenderVideoHal::PerformFlush() {
 
 RED_ERR
 CRedRenderVideoHal::RenderFrame(std::unique_ptr<CGlobalBuffer> &buffer) {
+  RED_TRACE_SCOPE(RED_TRACE_RENDER, "video_render", mID);
+  RED_TRACE_FLOW_END(RED_TRACE_RENDER, "video_frame", mID, buffer->flow_id);
   if (ConvertPixelFormat(buffer) != OK) {
     return ME_ERROR;
   }
@@ -502,7 +575,8 @@ CRedRenderVideoHal::RenderFrame(std::unique_ptr<CGlobalBuffer> &buffer) {
 #endif
   case RedRender::VRClusterTypeOpenGL:
   case RedRender::VRClusterTypeMetal:
-  case RedRender::VRClusterTypeAVSBDL: {
+  case RedRender::VRClusterTypeAVSBDL:
+  case RedRender::VRClusterTypeNull: {
     if (buffer->pixel_format == CGlobalBuffer::kYUV420P10LE) {
       mVideoFrameMetaData.pixel_format = RedRender::VRPixelFormatYUV420p10le;
     } else if (buffer->pixel_format == CGlobalBuffer::kVTBBuffer) {
@@ -570,8 +644,12 @@ CRedRenderVideoHal::RenderFrame(std::unique_ptr<CGlobalBuffer> &buffer) {
         mVideoState->latest_video_seek_load_serial.exchange(
             -1, std::memory_order_seq_cst);
     if (latest_video_seek_load_serial == buffer->serial) {
-      mVideoState->stat.latest_seek_load_duration =
-          (CurrentTimeUs() - mVideoState->latest_seek_load_start_at) / 1000;
+      int64_t seek_load_us =
+          CurrentTimeUs() - mVideoState->latest_seek_load_start_at;
+      mVideoState->stat.latest_seek_load_duration = seek_load_us / 1000;
+      mVideoState->pipeline.recordSeek(
+          CurrentTimeUs() - mVideoState->latest_seek_start_at,
+          mVideoState->latest_seek_in_buffer);
       AV_LOGI_ID(TAG, mID,
                  "video seek complete, cost %" PRId64 "ms, serial %d\n",
                  mVideoState->stat.latest_seek_load_duration,
@@ -586,6 +664,7 @@ CRedRenderVideoHal::RenderFrame(std::unique_ptr<CGlobalBuffer> &buffer) {
   mVideoState->stat.vfps = mSpeedSampler.add();
   if (!mVideoState->first_video_frame_rendered) {
     mVideoState->first_video_frame_rendered = 1;
+    mVideoState->pipeline.markFirstFrame();
     notifyListener(RED_MSG_VIDEO_RENDERING_START);
     notifyListener(RED_MSG_VIDEO_START_ON_PLAYING);
   }
@@ -609,47 +688,10 @@ CRedRenderVideoHal::ConvertPixelFormat(std::unique_ptr<CGlobalBuffer> &buffer) {
   if (buffer->pixel_format == CGlobalBuffer::kYUV420P10LE &&
       mClusterType != RedRender::VRClusterTypeAVSBDL) {
     mVideoFrameMetaData.pixel_format = RedRender::VRPixelFormatYUV420p;
-    buffer->pixel_format = CGlobalBuffer::kYUV420;
-
-    AVFrame *src_frame = reinterpret_cast<AVFrame *>(
-        (reinterpret_cast<CGlobalBuffer::FFmpegBufferContext *>(buffer->opaque))
-            ->av_frame);
-    AVFrame *dst_frame = av_frame_alloc();
-    dst_frame->format = AV_PIX_FMT_YUV420P;
-    dst_frame->width = buffer->width;
-    dst_frame->height = buffer->height;
-    av_frame_get_buffer(dst_frame, 32);
-
-    if (!mSwsContext) {
-      AV_LOGI_ID(TAG, mID, "Convert yuv420p10le to yuv420p.\n");
-    }
-    mSwsContext = sws_getCachedContext(
-        mSwsContext, src_frame->width, src_frame->height,
-        (AVPixelFormat)src_frame->format, dst_frame->width, dst_frame->height,
-        (AVPixelFormat)dst_frame->format, SWS_BICUBIC, NULL, NULL, NULL);
-
-    if (!mSwsContext ||
-        !sws_scale(mSwsContext, src_frame->data, src_frame->linesize, 0,
-                   src_frame->height, dst_frame->data, dst_frame->linesize)) {
+    if (mVideoState->pools.pixel_converter.convertBuffer(*buffer) != OK) {
       AV_LOGE_ID(TAG, mID, "Failed to convert pixelformat.\n");
-      av_frame_unref(dst_frame);
-      av_frame_free(&dst_frame);
       return ME_ERROR;
     }
-
-    buffer->width = dst_frame->width;
-    buffer->height = dst_frame->height;
-    buffer->yStride = dst_frame->linesize[0];
-    buffer->uStride = dst_frame->linesize[1];
-    buffer->vStride = dst_frame->linesize[2];
-    buffer->yBuffer = dst_frame->data[0];
-    buffer->uBuffer = dst_frame->data[1];
-    buffer->vBuffer = dst_frame->data[2];
-    (reinterpret_cast<CGlobalBuffer::FFmpegBufferContext *>(buffer->opaque))
-        ->av_frame = reinterpret_cast<void *>(dst_frame);
-
-    av_frame_unref(src_frame);
-    av_frame_free(&src_frame);
   }
   return OK;
 }
@@ -712,6 +754,8 @@ void CRedRenderVideoHal::ThreadFunc() {
 
   PlayerConfig *player_config = mGeneralConfig->playerConfig->get();
   int64_t framedrop = player_config ? player_config->framedrop : 0;
+  bool free_run = player_config && player_config->headless_free_run;
+  bool present_scheduler = player_config && player_config->present_scheduler;
   int64_t prev_check_unsync_time = 0;
   double delay = 0.0;
   double duration = 0.0;
@@ -719,7 +763,8 @@ void CRedRenderVideoHal::ThreadFunc() {
 
 #if defined(__APPLE__)
   pthread_setname_np("videorender");
-#elif defined(__ANDROID__) || defined(__HARMONY__)
+#elif defined(__ANDROID__) || defined(__HARMONY__) ||                          \
+    defined(__HEADLESS__)
   pthread_setname_np(pthread_self(), "videorender");
 #endif
 
@@ -759,6 +804,12 @@ void CRedRenderVideoHal::ThreadFunc() {
     if (in_buffer_->serial != mVideoProcesser->getSerial()) {
       continue;
     }
+    bool stats = mVideoState->pipeline.enabled();
+    int64_t read_us = stats ? CurrentTimeUs() : 0;
+    if (stats && in_buffer_->decoded_time_us > 0) {
+      mVideoState->pipeline.record(STAGE_VIDEO_FRAME_WAIT,
+                                   read_us - in_buffer_->decoded_time_us);
+    }
     while (!mAbort) {
 #if defined(__ANDROID__) || defined(__HARMONY__)
       {
@@ -775,10 +826,49 @@ void CRedRenderVideoHal::ThreadFunc() {
       }
 
       double time = 0.0;
+      double due = 0.0;
+      bool drop_late =
+          framedrop > 0 ||
+          (framedrop && getMasterSyncType(mVideoState) != CLOCK_VIDEO);
+
+      if (present_scheduler) {
+        if (WaitForDeadline(in_buffer_, drop_late, free_run, due) != OK) {
+          break;
+        }
+        duration = ComputeDuration(in_buffer_);
+      } else {
+        duration = ComputeDuration(in_buffer_);
+        delay = ComputeDelay(duration);
+        if (free_run) {
+          delay = 0.0;
+        }
+        time = CurrentTimeUs() / 1000000.0;
 
-      duration = ComputeDuration(in_buffer_);
-      delay = ComputeDelay(duration);
-      time = CurrentTimeUs() / 1000000.0;
+        if (in_buffer_->serial != mSerial) {
+          mFrameTick.time = CurrentTimeUs() / 1000000.0;
+          mSerial = in_buffer_->serial;
+        }
+
+        if (mFrameTick.time <= FLT_EPSILON || time < mFrameTick.time) {
+          mFrameTick.time = time;
+        }
+
+        if (time < mFrameTick.time + delay && !mForceRefresh) {
+          remaining_time =
+              std::min(mFrameTick.time + delay - time, REFRESH_RATE);
+          if (remaining_time * 1000000 > 0) {
+            usleep(remaining_time * 1000000);
+          }
+          continue;
+        }
+
+        mFrameTick.time += delay;
+
+        if (delay > 0 && time - mFrameTick.time > AV_SYNC_THRESHOLD_MAX) {
+          mFrameTick.time = time;
+        }
+        due = mFrameTick.time;
+      }
 
       if (!isnan(mVideoState->stat.avdiff)) {
         if (std::abs(mVideoState->stat.avdiff) > 1.0 &&
@@ -790,29 +880,6 @@ void CRedRenderVideoHal::ThreadFunc() {
         }
       }
 
-      if (in_buffer_->serial != mSerial) {
-        mFrameTick.time = CurrentTimeUs() / 1000000.0;
-        mSerial = in_buffer_->serial;
-      }
-
-      if (mFrameTick.time <= FLT_EPSILON || time < mFrameTick.time) {
-        mFrameTick.time = time;
-      }
-
-      if (time < mFrameTick.time + delay && !mForceRefresh) {
-        remaining_time = std::min(mFrameTick.time + delay - time, REFRESH_RATE);
-        if (remaining_time * 1000000 > 0) {
-          usleep(remaining_time * 1000000);
-        }
-        continue;
-      }
-
-      mFrameTick.time += delay;
-
-      if (delay > 0 && time - mFrameTick.time > AV_SYNC_THRESHOLD_MAX) {
-        mFrameTick.time = time;
-      }
-
       mFrameTick.pts = in_buffer_->pts / 1000.0;
       mFrameTick.serial = in_buffer_->serial;
       mFrameTick.duration = duration;
@@ -823,27 +890,48 @@ void CRedRenderVideoHal::ThreadFunc() {
         mVideoState->video_clock->SetClockAvaliable(true);
       }
 
-      if (mVideoProcesser->frameQueue() &&
+      if (!present_scheduler && mVideoProcesser->frameQueue() &&
           mVideoProcesser->frameQueue()->size() > 0) {
-        if ((framedrop > 0 ||
-             (framedrop && getMasterSyncType(mVideoState) != CLOCK_VIDEO)) &&
-            time > mFrameTick.time + duration) {
+        if (drop_late && time > mFrameTick.time + duration) {
           AV_LOGI_ID(TAG, mID,
                      "video late drop frame pts %f, delay %f, duration %f, "
                      "time %f, mFrameTick.time %f\n",
                      in_buffer_->pts / 1000.0, delay, duration, time,
                      mFrameTick.time);
+          mVideoState->pipeline.countDroppedFrame(true);
           break;
         }
       }
 
+      int64_t render_start_us = CurrentTimeUs();
+      int64_t demux_time_us = in_buffer_->demux_time_us;
+      double pts = in_buffer_->pts / 1000.0;
       RenderFrame(in_buffer_);
+      if (present_scheduler) {
+        mScheduler.advance(pts, render_start_us / 1000000.0);
+      }
+      if (stats && !mPaused) {
+        int64_t now_us = CurrentTimeUs();
+        mVideoState->pipeline.record(STAGE_VIDEO_SYNC_WAIT,
+                                     render_start_us - read_us);
+        mVideoState->pipeline.record(STAGE_VIDEO_RENDER,
+                                     now_us - render_start_us);
+        mVideoState->pipeline.record(
+            STAGE_VIDEO_PRESENT_JITTER,
+            std::abs(render_start_us - static_cast<int64_t>(due * 1000000)));
+        if (demux_time_us > 0) {
+          mVideoState->pipeline.record(STAGE_VIDEO_END_TO_END,
+                                       now_us - demux_time_us);
+        }
+        mVideoState->pipeline.countRenderedFrame();
+      }
       mForceRefresh = false;
       break;
     }
   }
   if (mVideoRender && (mClusterType == RedRender::VRClusterTypeOpenGL ||
-                       mClusterType == RedRender::VRClusterTypeMetal)) {
+                       mClusterType == RedRender::VRClusterTypeMetal ||
+                       mClusterType == RedRender::VRClusterTypeNull)) {
     mVideoRender->close();
     mVideoRender->detachAllFilter();
     mVideoRender->releaseContext();
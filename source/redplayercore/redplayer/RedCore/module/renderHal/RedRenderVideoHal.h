@@ -7,18 +7,11 @@
 #include "RedCore/module/processer/VideoProcesser.h"
 #include "base/RedBuffer.h"
 #include "base/RedClock.h"
+#include "base/RedPresentScheduler.h"
 #include "base/RedQueue.h"
 #include "base/RedSampler.h"
 #include "redrender/video/video_renderer_factory.h"
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-#include "libswscale/swscale.h"
-#ifdef __cplusplus
-}
-#endif
-
 #include <iostream>
 #include <stdint.h>
 #include <unistd.h>
@@ -67,6 +60,8 @@ private:
   double ComputeDelay(double delay);
   double ComputeDuration(std::unique_ptr<CGlobalBuffer> &buffer);
   RED_ERR ReadFrame(std::unique_ptr<CGlobalBuffer> &buffer);
+  RED_ERR WaitForDeadline(std::unique_ptr<CGlobalBuffer> &buffer,
+                          bool drop_late, bool free_run, double &due);
   RED_ERR PerformStart();
   RED_ERR PerformPause();
   RED_ERR PerformStop();
@@ -107,6 +102,7 @@ private:
   NotifyCallback mNotifyCb;
   SpeedSampler mSpeedSampler;
   FrameTick mFrameTick;
+  PresentScheduler mScheduler;
 
   // redrender video
   std::unique_ptr<RedRender::VideoRenderer> mVideoRender{nullptr};
@@ -122,7 +118,6 @@ private:
   bool mSurfaceUpdate{false};
 #endif
   RedRender::VRClusterType mClusterType{RedRender::VRClusterTypeUnknown};
-  SwsContext *mSwsContext{nullptr};
 };
 
 REDPLAYER_NS_END;
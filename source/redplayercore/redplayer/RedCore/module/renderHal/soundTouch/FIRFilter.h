@@ -123,6 +123,31 @@ public:
 #endif // SOUNDTOUCH_ALLOW_MMX
 
 
+#ifdef SOUNDTOUCH_ALLOW_SIMD
+
+/// Class that implements portable SIMD functions exclusive for 16bit integer samples type.
+    class FIRFilterSIMD : public FIRFilter
+    {
+    protected:
+        bool bAvx2;
+        // coefficients packed in 16bit pairs: (c, 0) and (0, c) for the two
+        // stereo channels, (even tap, odd tap) for mono
+        uint *filterCoeffsLeft;
+        uint *filterCoeffsRight;
+        uint *filterCoeffsPairs;
+
+        virtual uint evaluateFilterStereo(short *dest, const short *src, uint numSamples) const;
+        virtual uint evaluateFilterMono(short *dest, const short *src, uint numSamples) const;
+    public:
+        FIRFilterSIMD(bool avx2);
+        ~FIRFilterSIMD();
+
+        virtual void setCoefficients(const short *coeffs, uint newLength, uint uResultDivFactor);
+    };
+
+#endif // SOUNDTOUCH_ALLOW_SIMD
+
+
 #ifdef SOUNDTOUCH_ALLOW_SSE
     /// Class that implements SSE optimized functions exclusive for floating point samples type.
     class FIRFilterSSE : public FIRFilter
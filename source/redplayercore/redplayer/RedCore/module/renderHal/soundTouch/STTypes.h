@@ -147,6 +147,15 @@ namespace soundtouch
             #define SOUNDTOUCH_ALLOW_MMX   1
         #endif
 
+        #if defined(__GNUC__) && \
+            (defined(__x86_64__) || defined(__aarch64__) || defined(__ARM_NEON)) && \
+            (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) && \
+            !defined(SOUNDTOUCH_DISABLE_SIMD_OPTIMIZATIONS)
+            // Allow the portable vector extension routines, 128bit wide on
+            // SSE2 and NEON, 256bit wide on AVX2 capable x86 CPUs
+            #define SOUNDTOUCH_ALLOW_SIMD  1
+        #endif
+
     #else
 
         // floating point samples
@@ -742,7 +742,8 @@ void * TDStretch::operator new(size_t s)
 
 TDStretch * TDStretch::newInstance()
 {
-#if defined(SOUNDTOUCH_ALLOW_MMX) || defined(SOUNDTOUCH_ALLOW_SSE)
+#if defined(SOUNDTOUCH_ALLOW_MMX) || defined(SOUNDTOUCH_ALLOW_SSE) || \
+    defined(SOUNDTOUCH_ALLOW_SIMD)
     uint uExtensions;
 
     uExtensions = detectCPUextensions();
@@ -750,6 +751,15 @@ TDStretch * TDStretch::newInstance()
 
     // Check if MMX/SSE instruction set extensions supported by CPU
 
+#ifdef SOUNDTOUCH_ALLOW_SIMD
+    // vector extension routines, preferred over MMX as they are wider
+    if (uExtensions & (SUPPORT_AVX2 | SUPPORT_SSE2 | SUPPORT_NEON))
+    {
+        return ::new TDStretchSIMD((uExtensions & SUPPORT_AVX2) != 0);
+    }
+    else
+#endif // SOUNDTOUCH_ALLOW_SIMD
+
 #ifdef SOUNDTOUCH_ALLOW_MMX
     // MMX routines available only with integer sample types
     if (uExtensions & SUPPORT_MMX)
@@ -266,6 +266,24 @@ public:
 #endif /// SOUNDTOUCH_ALLOW_MMX
 
 
+#ifdef SOUNDTOUCH_ALLOW_SIMD
+    /// Class that implements portable SIMD routines for 16bit integer samples type,
+    /// written with compiler vector extensions. Runs 256bit wide on AVX2 CPUs.
+    class TDStretchSIMD : public TDStretch
+    {
+    protected:
+        bool bAvx2;
+
+        double calcCrossCorr(const short *mixingPos, const short *compare, double &norm);
+        double calcCrossCorrAccumulate(const short *mixingPos, const short *compare, double &norm);
+        virtual void overlapStereo(short *output, const short *input) const;
+        virtual void overlapMono(short *output, const short *input) const;
+    public:
+        TDStretchSIMD(bool avx2);
+    };
+#endif /// SOUNDTOUCH_ALLOW_SIMD
+
+
 #ifdef SOUNDTOUCH_ALLOW_SSE
     /// Class that implements SSE optimized routines for floating point samples type.
     class TDStretchSSE : public TDStretch
@@ -85,7 +85,14 @@ uint detectCPUextensions(void)
 #if ((defined(__GNUC__) && defined(__x86_64__)) \
     || defined(_M_X64))  \
     && defined(SOUNDTOUCH_ALLOW_X86_OPTIMIZATIONS)
-    return 0x19 & ~_dwDisabledISA;
+    uint res = 0x19;
+
+#if defined(__GNUC__)
+    // AVX2 is not part of the x86_64 baseline, ask the CPU
+    if (__builtin_cpu_supports("avx2")) res = res | SUPPORT_AVX2;
+#endif
+
+    return res & ~_dwDisabledISA;
 
 /// If building for a 32bit system and the user wants optimizations.
 /// Keep the _dwDisabledISA test (2 more operations, could be eliminated).
@@ -126,6 +133,11 @@ uint detectCPUextensions(void)
 
     return res & ~_dwDisabledISA;
 
+#elif defined(SOUNDTOUCH_ALLOW_SIMD)
+
+    // arm builds that allow the SIMD routines have NEON at compile time
+    return SUPPORT_NEON & ~_dwDisabledISA;
+
 #else
 
 /// One of these is true:
@@ -0,0 +1,251 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Vector kernels of the portable SIMD routines, see simd_optimized.cpp.
+///
+/// This file has no include guard on purpose: simd_optimized.cpp includes it
+/// once for the 128bit kernels and once more inside an AVX2 target region for
+/// the 256bit ones. It relies on the types and macros defined there.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// a.lo * b.lo + a.hi * b.hi in each 32bit lane. The unsigned multiply wraps
+// like the int arithmetic of the C routines.
+template <typename V, typename U>
+ST_SIMD_INLINE U maddPairs(const U &a, const U &b)
+{
+    return (U)ST_LO16(V, a) * (U)ST_LO16(V, b) + (U)ST_HI16(V, a) * (U)ST_HI16(V, b);
+}
+
+
+// Sums (a0 * b0 + a1 * b1) >> shift over 'count' samples into 'corr', and
+// the same of a * a into 'norm' if requested
+template <typename V, typename U>
+ST_SIMD_INLINE void crossCorrKernel(const short *pV1, const short *pV2, int count,
+                                    int shift, bool withNorm, long &corr, long &norm)
+{
+    const int lanes = sizeof(V) / sizeof(int);
+    V accu = {0};
+    V normaccu = {0};
+    int i = 0;
+
+    for (; i + 2 * lanes <= count; i += 2 * lanes)
+    {
+        U a, b;
+        memcpy(&a, pV1 + i, sizeof(a));
+        memcpy(&b, pV2 + i, sizeof(b));
+
+        accu += (V)maddPairs<V, U>(a, b) >> shift;
+        if (withNorm)
+        {
+            normaccu += (V)maddPairs<V, U>(a, a) >> shift;
+        }
+    }
+    for (int k = 0; k < lanes; k ++)
+    {
+        corr += accu[k];
+        norm += normaccu[k];
+    }
+    for (; i < count; i += 2)
+    {
+        corr += (pV1[i] * pV2[i] + pV1[i + 1] * pV2[i + 1]) >> shift;
+        if (withNorm)
+        {
+            norm += (pV1[i] * pV1[i] + pV1[i + 1] * pV1[i + 1]) >> shift;
+        }
+    }
+}
+
+
+// Weighted sum of the first and of the second samples of 'in' and 'mid',
+// (in * m1 + mid * m2) / 2^bits, packed back to 16bit pairs. 'weights' holds
+// m1 in the low and m2 in the high half of each lane.
+template <typename V, typename U>
+ST_SIMD_INLINE void crossFadeLanes(U &out, const U &in, const U &mid,
+                                   const U &weightsLo, const U &weightsHi, int bits)
+{
+    U lo = (in & 0xffff) | (mid << 16);
+    U hi = (in >> 16) | (mid & 0xffff0000);
+    V left = (V)maddPairs<V, U>(lo, weightsLo);
+    V right = (V)maddPairs<V, U>(hi, weightsHi);
+
+    left = ST_DIV_POW2(left, bits);
+    right = ST_DIV_POW2(right, bits);
+    out = ((U)left & 0xffff) | ((U)right << 16);
+}
+
+
+// (input * m1 + mid * m2) / overlapLength for stereo samples, 'overlapLength'
+// being 2^bits
+template <typename V, typename U>
+ST_SIMD_INLINE void overlapStereoKernel(short *output, const short *input,
+                                        const short *mid, int overlapLength, int bits)
+{
+    const int lanes = sizeof(V) / sizeof(int);
+    U m1 = {0};
+    int i = 0;
+
+    for (int k = 0; k < lanes; k ++)
+    {
+        m1[k] = k;
+    }
+    for (; i + lanes <= overlapLength; i += lanes)
+    {
+        U in, md, out;
+        memcpy(&in, input + 2 * i, sizeof(in));
+        memcpy(&md, mid + 2 * i, sizeof(md));
+
+        // both channels of a frame share the weights
+        U weights = m1 | ((overlapLength - m1) << 16);
+        crossFadeLanes<V, U>(out, in, md, weights, weights, bits);
+        memcpy(output + 2 * i, &out, sizeof(out));
+        m1 += lanes;
+    }
+    for (; i < overlapLength; i ++)
+    {
+        short temp = (short)(overlapLength - i);
+        int cnt2 = 2 * i;
+        output[cnt2] = (input[cnt2] * i + mid[cnt2] * temp) / overlapLength;
+        output[cnt2 + 1] = (input[cnt2 + 1] * i + mid[cnt2 + 1] * temp) / overlapLength;
+    }
+}
+
+
+// mono version of the above, a lane holds two consecutive samples
+template <typename V, typename U>
+ST_SIMD_INLINE void overlapMonoKernel(short *output, const short *input,
+                                      const short *mid, int overlapLength, int bits)
+{
+    const int lanes = sizeof(V) / sizeof(int);
+    U m1lo = {0};
+    U m1hi = {0};
+    int i = 0;
+
+    for (int k = 0; k < lanes; k ++)
+    {
+        m1lo[k] = 2 * k;
+        m1hi[k] = 2 * k + 1;
+    }
+    for (; i + 2 * lanes <= overlapLength; i += 2 * lanes)
+    {
+        U in, md, out;
+        memcpy(&in, input + i, sizeof(in));
+        memcpy(&md, mid + i, sizeof(md));
+
+        U weightsLo = m1lo | ((overlapLength - m1lo) << 16);
+        U weightsHi = m1hi | ((overlapLength - m1hi) << 16);
+        crossFadeLanes<V, U>(out, in, md, weightsLo, weightsHi, bits);
+        memcpy(output + i, &out, sizeof(out));
+        m1lo += 2 * lanes;
+        m1hi += 2 * lanes;
+    }
+    for (; i < overlapLength; i ++)
+    {
+        output[i] = (input[i] * i + mid[i] * (overlapLength - i)) / overlapLength;
+    }
+}
+
+
+// saturates to 16 bit integer limits
+static inline short _saturate16(long value)
+{
+    return (short)((value < -32768) ? -32768 : (value > 32767) ? 32767 : value);
+}
+
+
+// stereo FIR, taps run across the lanes and the two channels are picked by
+// the zero halves of 'left' and 'right' coefficients
+template <typename V, typename U>
+ST_SIMD_INLINE void firStereoKernel(short *dest, const short *src, int end,
+                                    const short *coeffs, const uint *left,
+                                    const uint *right, int length, int divFactor)
+{
+    const int lanes = sizeof(V) / sizeof(int);
+
+    for (int j = 0; j < end; j ++)
+    {
+        const short *ptr = src + 2 * j;
+        V suml = {0};
+        V sumr = {0};
+        long l = 0;
+        long r = 0;
+        int i = 0;
+
+        for (; i + lanes <= length; i += lanes)
+        {
+            U x, cl, cr;
+            memcpy(&x, ptr + 2 * i, sizeof(x));
+            memcpy(&cl, left + i, sizeof(cl));
+            memcpy(&cr, right + i, sizeof(cr));
+            suml += (V)maddPairs<V, U>(x, cl);
+            sumr += (V)maddPairs<V, U>(x, cr);
+        }
+        for (int k = 0; k < lanes; k ++)
+        {
+            l += suml[k];
+            r += sumr[k];
+        }
+        for (; i < length; i ++)
+        {
+            l += ptr[2 * i] * coeffs[i];
+            r += ptr[2 * i + 1] * coeffs[i];
+        }
+        dest[2 * j] = _saturate16(l >> divFactor);
+        dest[2 * j + 1] = _saturate16(r >> divFactor);
+    }
+}
+
+
+// mono FIR, each lane takes an even and an odd tap
+template <typename V, typename U>
+ST_SIMD_INLINE void firMonoKernel(short *dest, const short *src, int end,
+                                  const short *coeffs, const uint *pairs,
+                                  int length, int divFactor)
+{
+    const int lanes = sizeof(V) / sizeof(int);
+
+    for (int j = 0; j < end; j ++)
+    {
+        const short *ptr = src + j;
+        V sum = {0};
+        long s = 0;
+        int i = 0;
+
+        for (; i + 2 * lanes <= length; i += 2 * lanes)
+        {
+            U x, c;
+            memcpy(&x, ptr + i, sizeof(x));
+            memcpy(&c, pairs + i / 2, sizeof(c));
+            sum += (V)maddPairs<V, U>(x, c);
+        }
+        for (int k = 0; k < lanes; k ++)
+        {
+            s += sum[k];
+        }
+        for (; i < length; i ++)
+        {
+            s += ptr[i] * coeffs[i];
+        }
+        dest[j] = _saturate16(s >> divFactor);
+    }
+}
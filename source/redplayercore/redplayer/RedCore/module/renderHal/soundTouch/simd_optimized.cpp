@@ -0,0 +1,376 @@
+////////////////////////////////////////////////////////////////////////////////
+///
+/// Portable SIMD optimized routines for 16bit integer samples. All of them have
+/// been gathered into this single source code file, like the MMX and SSE ones.
+///
+/// The routines are written with GCC / Clang vector extensions instead of
+/// intrinsics. The 128bit variant compiles to SSE2 on x86_64 and to NEON on
+/// ARM, the 256bit variant is compiled for AVX2 only and picked at runtime
+/// through detectCPUextensions().
+///
+/// Every 32bit lane holds a pair of adjacent 16bit samples, the low half being
+/// the first one, and all products are pairwise multiply-adds of such lanes.
+/// Products, shifts and divisions follow the plain C routines, so the results
+/// are bit exact with them.
+///
+////////////////////////////////////////////////////////////////////////////////
+//
+// License :
+//
+//  SoundTouch audio processing library
+//  Copyright (c) Olli Parviainen
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "STTypes.h"
+
+#ifdef SOUNDTOUCH_ALLOW_SIMD
+// SIMD routines available only with integer sample type
+
+using namespace soundtouch;
+
+#include "TDStretch.h"
+#include "FIRFilter.h"
+#include <string.h>
+#include <math.h>
+
+typedef int v4si __attribute__((vector_size(16)));
+typedef unsigned int v4su __attribute__((vector_size(16)));
+
+#if defined(__x86_64__)
+    #define ST_SIMD_AVX2    1
+    typedef int v8si __attribute__((vector_size(32)));
+    typedef unsigned int v8su __attribute__((vector_size(32)));
+    typedef short v8hi __attribute__((vector_size(16)));
+    typedef short v16hi __attribute__((vector_size(32)));
+#endif
+
+// The kernels take no vectors by value, so that no 256bit vector ever crosses
+// a call boundary that is not compiled for AVX2.
+#define ST_SIMD_INLINE  static inline __attribute__((always_inline))
+
+// first and second 16bit sample of each lane, sign extended
+#define ST_LO16(V, x)   ((V)((x) << 16) >> 16)
+#define ST_HI16(V, x)   ((V)(x) >> 16)
+
+// division by 2^bits that rounds toward zero, like the C '/' operator
+#define ST_DIV_POW2(x, bits)    (((x) + (((x) >> 31) & ((1 << (bits)) - 1))) >> (bits))
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// vector kernels, 128bit wide
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "simd_kernels.h"
+
+#ifdef ST_SIMD_AVX2
+// SSE2 has no 32bit lane multiply, but pmaddwd is exactly maddPairs
+template <>
+inline __attribute__((always_inline)) v4su maddPairs<v4si, v4su>(const v4su &a, const v4su &b)
+{
+    return (v4su)__builtin_ia32_pmaddwd128((v8hi)a, (v8hi)b);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// the same kernels 256bit wide, every function up to the pop below is
+// compiled for AVX2 and only called when detectCPUextensions() reports it
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#if defined(__clang__)
+    #pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#else
+    #pragma GCC push_options
+    #pragma GCC target("avx2")
+#endif
+
+namespace avx2
+{
+
+#include "simd_kernels.h"
+
+template <>
+inline __attribute__((always_inline)) v8su maddPairs<v8si, v8su>(const v8su &a, const v8su &b)
+{
+    return (v8su)__builtin_ia32_pmaddwd256((v16hi)a, (v16hi)b);
+}
+
+}
+
+static void crossCorrAvx2(const short *pV1, const short *pV2, int count,
+                          int shift, bool withNorm, long &corr, long &norm)
+{
+    avx2::crossCorrKernel<v8si, v8su>(pV1, pV2, count, shift, withNorm, corr, norm);
+}
+
+static void overlapStereoAvx2(short *output, const short *input,
+                              const short *mid, int overlapLength, int bits)
+{
+    avx2::overlapStereoKernel<v8si, v8su>(output, input, mid, overlapLength, bits);
+}
+
+static void overlapMonoAvx2(short *output, const short *input,
+                            const short *mid, int overlapLength, int bits)
+{
+    avx2::overlapMonoKernel<v8si, v8su>(output, input, mid, overlapLength, bits);
+}
+
+static void firStereoAvx2(short *dest, const short *src, int end,
+                          const short *coeffs, const uint *left,
+                          const uint *right, int length, int divFactor)
+{
+    avx2::firStereoKernel<v8si, v8su>(dest, src, end, coeffs, left, right, length, divFactor);
+}
+
+static void firMonoAvx2(short *dest, const short *src, int end,
+                        const short *coeffs, const uint *pairs,
+                        int length, int divFactor)
+{
+    avx2::firMonoKernel<v8si, v8su>(dest, src, end, coeffs, pairs, length, divFactor);
+}
+
+#if defined(__clang__)
+    #pragma clang attribute pop
+#else
+    #pragma GCC pop_options
+#endif
+
+#endif // ST_SIMD_AVX2
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// runtime dispatch, 256bit wide on AVX2 CPUs and 128bit wide elsewhere
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static void crossCorr(bool useAvx2, const short *pV1, const short *pV2, int count,
+                      int shift, bool withNorm, long &corr, long &norm)
+{
+#ifdef ST_SIMD_AVX2
+    if (useAvx2)
+    {
+        crossCorrAvx2(pV1, pV2, count, shift, withNorm, corr, norm);
+        return;
+    }
+#endif
+    crossCorrKernel<v4si, v4su>(pV1, pV2, count, shift, withNorm, corr, norm);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of SIMD optimized functions of class 'TDStretchSIMD'
+//
+//////////////////////////////////////////////////////////////////////////////
+
+TDStretchSIMD::TDStretchSIMD(bool avx2) : TDStretch()
+{
+    bAvx2 = avx2;
+}
+
+
+// Calculates cross correlation of two buffers
+double TDStretchSIMD::calcCrossCorr(const short *pV1, const short *pV2, double &dnorm)
+{
+    long corr = 0;
+    long lnorm = 0;
+
+    crossCorr(bAvx2, pV1, pV2, channels * overlapLength, overlapDividerBitsNorm,
+              true, corr, lnorm);
+
+    if ((unsigned long)lnorm > maxnorm)
+    {
+        maxnorm = lnorm;
+    }
+
+    // Normalize result by dividing by sqrt(norm) - this step is easiest
+    // done using floating point operation
+    dnorm = (double)(unsigned long)lnorm;
+    return (double)corr / sqrt((dnorm < 1e-9) ? 1.0 : dnorm);
+}
+
+
+/// Update cross-correlation by accumulating "norm" coefficient by previously calculated value
+double TDStretchSIMD::calcCrossCorrAccumulate(const short *pV1, const short *pV2, double &dnorm)
+{
+    long corr = 0;
+    long unused = 0;
+    unsigned long lnorm = 0;
+    int count = channels * overlapLength;
+    int i;
+
+    // cancel first normalizer tap from previous round
+    for (i = 1; i <= channels; i ++)
+    {
+        lnorm -= (pV1[-i] * pV1[-i]) >> overlapDividerBitsNorm;
+    }
+
+    crossCorr(bAvx2, pV1, pV2, count, overlapDividerBitsNorm, false, corr, unused);
+
+    // update normalizer with last samples of this round
+    for (i = 1; i <= channels; i ++)
+    {
+        lnorm += (pV1[count - i] * pV1[count - i]) >> overlapDividerBitsNorm;
+    }
+
+    dnorm += (double)lnorm;
+    if (dnorm > maxnorm)
+    {
+        maxnorm = (unsigned long)dnorm;
+    }
+
+    // Normalize result by dividing by sqrt(norm) - this step is easiest
+    // done using floating point operation
+    return (double)corr / sqrt((dnorm < 1e-9) ? 1.0 : dnorm);
+}
+
+
+// SIMD-optimized version of the function overlapStereo
+void TDStretchSIMD::overlapStereo(short *output, const short *input) const
+{
+    int bits = overlapDividerBitsPure + 1;
+
+    // the shift needs the power of 2 overlap that calculateOverlapLength sets
+    if (overlapLength != (1 << bits))
+    {
+        TDStretch::overlapStereo(output, input);
+        return;
+    }
+#ifdef ST_SIMD_AVX2
+    if (bAvx2)
+    {
+        overlapStereoAvx2(output, input, pMidBuffer, overlapLength, bits);
+        return;
+    }
+#endif
+    overlapStereoKernel<v4si, v4su>(output, input, pMidBuffer, overlapLength, bits);
+}
+
+
+// SIMD-optimized version of the function overlapMono
+void TDStretchSIMD::overlapMono(short *output, const short *input) const
+{
+    int bits = overlapDividerBitsPure + 1;
+
+    if (overlapLength != (1 << bits))
+    {
+        TDStretch::overlapMono(output, input);
+        return;
+    }
+#ifdef ST_SIMD_AVX2
+    if (bAvx2)
+    {
+        overlapMonoAvx2(output, input, pMidBuffer, overlapLength, bits);
+        return;
+    }
+#endif
+    overlapMonoKernel<v4si, v4su>(output, input, pMidBuffer, overlapLength, bits);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// implementation of SIMD optimized functions of class 'FIRFilterSIMD'
+//
+//////////////////////////////////////////////////////////////////////////////
+
+FIRFilterSIMD::FIRFilterSIMD(bool avx2) : FIRFilter()
+{
+    bAvx2 = avx2;
+    filterCoeffsLeft = NULL;
+    filterCoeffsRight = NULL;
+    filterCoeffsPairs = NULL;
+}
+
+
+FIRFilterSIMD::~FIRFilterSIMD()
+{
+    delete[] filterCoeffsLeft;
+    delete[] filterCoeffsRight;
+    delete[] filterCoeffsPairs;
+}
+
+
+// (overloaded) Calculates filter coefficients for SIMD routine
+void FIRFilterSIMD::setCoefficients(const short *coeffs, uint newLength, uint uResultDivFactor)
+{
+    uint i;
+    FIRFilter::setCoefficients(coeffs, newLength, uResultDivFactor);
+
+    delete[] filterCoeffsLeft;
+    delete[] filterCoeffsRight;
+    delete[] filterCoeffsPairs;
+    filterCoeffsLeft = new uint[length];
+    filterCoeffsRight = new uint[length];
+    filterCoeffsPairs = new uint[length / 2];
+
+    // length is a multiple of 8, see FIRFilter::setCoefficients
+    for (i = 0; i < length; i ++)
+    {
+        filterCoeffsLeft[i] = (unsigned short)coeffs[i];
+        filterCoeffsRight[i] = (uint)(unsigned short)coeffs[i] << 16;
+    }
+    for (i = 0; i < length / 2; i ++)
+    {
+        filterCoeffsPairs[i] = (unsigned short)coeffs[2 * i] | ((uint)(unsigned short)coeffs[2 * i + 1] << 16);
+    }
+}
+
+
+// SIMD-optimized version of the filter routine for stereo sound
+uint FIRFilterSIMD::evaluateFilterStereo(short *dest, const short *src, uint numSamples) const
+{
+    int end = (int)(numSamples - length);
+
+#ifdef ST_SIMD_AVX2
+    if (bAvx2)
+    {
+        firStereoAvx2(dest, src, end, filterCoeffs, filterCoeffsLeft, filterCoeffsRight,
+                      length, resultDivFactor);
+        return numSamples - length;
+    }
+#endif
+    firStereoKernel<v4si, v4su>(dest, src, end, filterCoeffs, filterCoeffsLeft,
+                                filterCoeffsRight, length, resultDivFactor);
+    return numSamples - length;
+}
+
+
+// SIMD-optimized version of the filter routine for mono sound
+uint FIRFilterSIMD::evaluateFilterMono(short *dest, const short *src, uint numSamples) const
+{
+    int end = (int)(numSamples - length);
+
+#ifdef ST_SIMD_AVX2
+    if (bAvx2)
+    {
+        firMonoAvx2(dest, src, end, filterCoeffs, filterCoeffsPairs, length,
+                    resultDivFactor);
+        return end;
+    }
+#endif
+    firMonoKernel<v4si, v4su>(dest, src, end, filterCoeffs, filterCoeffsPairs, length,
+                              resultDivFactor);
+    return end;
+}
+
+#endif  // SOUNDTOUCH_ALLOW_SIMD
@@ -9,16 +9,59 @@
 #include "RedError.h"
 #include "RedMsg.h"
 #include "RedProp.h"
+#include "RedTrace.h"
 #include "base/RedConfig.h"
 #include "wrapper/reddownload_datasource_wrapper.h"
 
 #define TAG "RedSourceController"
+#define AUDIO_MIN_CACHED_BYTES 64000
+#define VIDEO_MIN_CACHED_BYTES 256000
+#define LOW_WATER_BYTES_DIVISOR 16
+#define LOW_WATER_MAX_WAIT_MS 1000
+#define SWITCH_CHECK_INTERVAL_MS 1000
+#define SWITCH_MIN_INTERVAL_MS 5000
+#define SWITCH_SPLICE_TOLERANCE_US 20000
+#define SWITCH_SPLICE_MAX_GAP_US 5000000
+#define SWITCH_SPLICE_MAX_PENDING 2048
+#define SWITCH_PREPARE_LEAD_US 3000000
+#define SWITCH_RETRY_MS 10000
+#define SWITCH_RETRY_MAX_MS 160000
 
 REDPLAYER_NS_BEGIN;
 
 constexpr int kMinBufferingNotifyStep = 10;
 constexpr int kMaxRetryCount = 3;
 
+enum {
+  FORMAT_SAME = 0,
+  FORMAT_CHANGED,      // the decoders are set up again for the new one
+  FORMAT_INCOMPATIBLE, // decoders and renderers were picked for the old one
+};
+
+/*what it takes for a decoder opened for a to go on with packets of b*/
+static int compareFormat(const TrackInfo &a, const TrackInfo &b) {
+  if (a.codec_id != b.codec_id) {
+    return FORMAT_INCOMPATIBLE;
+  }
+  if (a.stream_type == TYPE_VIDEO) {
+    if (a.pixel_format != b.pixel_format) {
+      return FORMAT_INCOMPATIBLE;
+    }
+    if (a.width != b.width || a.height != b.height) {
+      return FORMAT_CHANGED;
+    }
+  } else if (a.sample_rate != b.sample_rate || a.channels != b.channels ||
+             a.sample_fmt != b.sample_fmt) {
+    return FORMAT_INCOMPATIBLE;
+  }
+  if (a.extra_data_size != b.extra_data_size ||
+      (a.extra_data_size > 0 &&
+       memcmp(a.extra_data, b.extra_data, a.extra_data_size) != 0)) {
+    return FORMAT_CHANGED;
+  }
+  return FORMAT_SAME;
+}
+
 CRedSourceController::CRedSourceController(int id, const sp<VideoState> &state,
                                            NotifyCallback notify_cb)
     : mID(id), mVideoState(state), mNotifyCb(notify_cb) {}
@@ -37,7 +80,12 @@ void CRedSourceController::setPrepareCb(PrepareCallBack cb) {
 
 void CRedSourceController::release() {
   AV_LOGD_ID(TAG, mID, "%s start\n", __func__);
-  mAbort = true;
+  {
+    // the read thread sleeps on mCond once completed, like stop()
+    std::unique_lock<std::mutex> lck(mLock);
+    mAbort = true;
+    mCond.notify_all();
+  }
   {
     std::unique_lock<std::mutex> lck(mThreadLock);
     if (mReleased) {
@@ -71,6 +119,15 @@ RED_ERR CRedSourceController::getPacket(std::unique_ptr<RedAvPacket> &pkt,
   }
   RED_ERR ret = pktqueue->getPkt(pkt, block);
   updateCacheStatistic();
+  // polling read thread, the moment it could refill is when the buffer
+  // stops being full
+  if (mSleepingFull && mRefillDueUs == 0 &&
+      mVideoState->pipeline.enabled() &&
+      !mGeneralConfig->playerConfig->get()->low_water_wakeup &&
+      !isBufferFull()) {
+    int64_t expected = 0;
+    mRefillDueUs.compare_exchange_strong(expected, CurrentTimeUs());
+  }
   return ret;
 }
 
@@ -125,6 +182,9 @@ RED_ERR CRedSourceController::PerformStop() {
   if (mRedSource) {
     mRedSource->setInterrupt();
   }
+  if (mSwitchSource) {
+    mSwitchSource->setInterrupt();
+  }
   for (auto iter = mPktQueueMap.begin(); iter != mPktQueueMap.end(); ++iter) {
     iter->second->abort();
   }
@@ -134,7 +194,7 @@ RED_ERR CRedSourceController::PerformStop() {
 }
 
 RED_ERR CRedSourceController::PerformFlush() {
-  ++mSerial;
+  mSeekSerial = ++mSerial;
   if (mPktQueueMap.empty())
     return OK;
   for (auto iter = mPktQueueMap.begin(); iter != mPktQueueMap.end(); ++iter) {
@@ -151,9 +211,9 @@ bool CRedSourceController::isBufferFull() {
            mVideoState->stat.audio_cache.bytes +
                    mVideoState->stat.video_cache.bytes >
                mMaxBufferSize &&
-           (mVideoState->stat.audio_cache.bytes > 64000 ||
+           (mVideoState->stat.audio_cache.bytes > AUDIO_MIN_CACHED_BYTES ||
             mMetaData->audio_index < 0) &&
-           (mVideoState->stat.video_cache.bytes > 256000 ||
+           (mVideoState->stat.video_cache.bytes > VIDEO_MIN_CACHED_BYTES ||
             mMetaData->video_index < 0)) ||
           ((mVideoState->stat.audio_cache.packets >= DEFAULT_MIN_FRAMES ||
             mMetaData->audio_index < 0) &&
@@ -161,6 +221,57 @@ bool CRedSourceController::isBufferFull() {
             mMetaData->video_index < 0)));
 }
 
+// refill once a queue drained 1/16 of the buffer, or holds both less than
+// the last high water mark and a next high water mark less of playback
+void CRedSourceController::armLowWater(int stream_type, int index,
+                                       int64_t min_bytes) {
+  sp<PktQueue> pktqueue = pktQueue(stream_type);
+  if (!pktqueue || index < 0) {
+    return;
+  }
+  PlayerConfig *player_config = mGeneralConfig->playerConfig->get();
+  int64_t drain = mMaxBufferSize / LOW_WATER_BYTES_DIVISOR;
+  int64_t bytes = std::max(min_bytes, pktqueue->bytes() - drain);
+  int64_t duration = -1;
+  TrackInfo track_info = mMetaData->track_info[index];
+  if (track_info.time_base_num > 0 && track_info.time_base_den > 0) {
+    int64_t tb_per_s = track_info.time_base_num * 1000LL;
+    int64_t last = av_rescale(player_config->dcc.last_high_water_mark_in_ms,
+                              track_info.time_base_den, tb_per_s);
+    int64_t next = av_rescale(player_config->dcc.next_high_water_mark_in_ms,
+                              track_info.time_base_den, tb_per_s);
+    duration = std::min(last, pktqueue->duration() - next);
+  }
+  pktqueue->armLowWater(bytes, duration, [this] { onLowWater(); });
+}
+
+void CRedSourceController::onLowWater() {
+  std::unique_lock<std::mutex> lck(mLock);
+  mLowWater = true;
+  int64_t expected = 0;
+  mRefillDueUs.compare_exchange_strong(expected, CurrentTimeUs());
+  mCond.notify_one();
+}
+
+void CRedSourceController::waitForLowWater() {
+  {
+    std::unique_lock<std::mutex> lck(mLock);
+    mLowWater = false;
+  }
+  armLowWater(TYPE_AUDIO, mAudioIndex, AUDIO_MIN_CACHED_BYTES);
+  armLowWater(TYPE_VIDEO, mVideoIndex, VIDEO_MIN_CACHED_BYTES);
+  {
+    std::unique_lock<std::mutex> lck(mLock);
+    mCond.wait_for(lck, std::chrono::milliseconds(LOW_WATER_MAX_WAIT_MS),
+                   [this] {
+                     return mLowWater || mAbort || mVideoState->seek_req;
+                   });
+  }
+  for (auto iter = mPktQueueMap.begin(); iter != mPktQueueMap.end(); ++iter) {
+    iter->second->disarmLowWater();
+  }
+}
+
 void CRedSourceController::toggleBuffering(bool buffering) {
   std::unique_lock<std::mutex> lck(mLock);
   PlayerConfig *player_config = mGeneralConfig->playerConfig->get();
@@ -200,9 +311,17 @@ bool CRedSourceController::isBuffering() {
   return mBuffering && !mEOF;
 }
 
+/*of the last seek, clocks at it or after it play the seeked position*/
 int CRedSourceController::getSerial() {
   std::unique_lock<std::mutex> lck(mLock);
-  return mSerial;
+  return mSeekSerial;
+}
+
+void CRedSourceController::setAdaptiveStrategy(
+    const sp<AdaptiveStrategy> &strategy, int index) {
+  std::unique_lock<std::mutex> lck(mLock);
+  mAdaptiveStrategy = strategy;
+  mRepresentation = index;
 }
 
 void CRedSourceController::checkBuffering() {
@@ -449,6 +568,19 @@ RED_ERR CRedSourceController::SetMetaData() {
   }
   mMetaData->audio_index = mAudioIndex;
   mMetaData->video_index = mVideoIndex;
+  PlayerConfig *player_config = mGeneralConfig->playerConfig->get();
+  if (player_config->seek_back_buffer_ms > 0) {
+    for (auto iter = mPktQueueMap.begin(); iter != mPktQueueMap.end();
+         ++iter) {
+      int index = iter->first == TYPE_AUDIO ? mAudioIndex : mVideoIndex;
+      auto track_info = mMetaData->track_info[index];
+      iter->second->setBackBuffer(
+          player_config->seek_back_buffer_ms * 1000LL,
+          player_config->seek_back_buffer_bytes,
+          (AVRational){track_info.time_base_num, track_info.time_base_den},
+          mVideoState->pools.packets, mVideoState->pools.av_packets);
+    }
+  }
   lck.unlock();
   std::unique_lock<std::mutex> lck1(mPreparedCbLock);
   if (mPrepareCb) {
@@ -481,6 +613,425 @@ RED_ERR CRedSourceController::putEofPacket() {
   return OK;
 }
 
+bool CRedSourceController::seekInBuffer(int64_t pos_us) {
+  PlayerConfig *player_config = mGeneralConfig->playerConfig->get();
+  if (player_config->seek_back_buffer_ms <= 0 || mPktQueueMap.empty()) {
+    return false;
+  }
+  int64_t target_us = pos_us;
+  if (mMetaData->start_time > 0) {
+    target_us += mMetaData->start_time;
+  }
+  for (auto iter = mPktQueueMap.begin(); iter != mPktQueueMap.end(); ++iter) {
+    if (!iter->second->canSeekInBuffer(target_us)) {
+      return false;
+    }
+  }
+  mSeekSerial = ++mSerial;
+  bool hit = true;
+  for (auto iter = mPktQueueMap.begin(); iter != mPktQueueMap.end(); ++iter) {
+    if (iter->second->seekInBuffer(target_us, mSerial) != OK) {
+      hit = false;
+    }
+  }
+  if (!hit) {
+    // trimmed by the reader meanwhile, the queues that did rewind must not
+    // replay old packets next to the demuxer seek
+    PerformFlush();
+    putFlushPacket();
+    return false;
+  }
+  updateCacheStatistic();
+  return true;
+}
+
+void CRedSourceController::queuePacket(AVPacket *pkt) {
+  PlayerPools &pools = mVideoState->pools;
+  if (pkt->stream_index == mAudioIndex) {
+    if (mAdaptiveStrategy) {
+      // audio of a representation overlaps the one before it at a splice
+      int64_t time_us = packetTimeUs(pkt);
+      if (time_us != AV_NOPTS_VALUE && mLastAudioUs != AV_NOPTS_VALUE &&
+          time_us <= mLastAudioUs) {
+        return;
+      }
+      mLastAudioUs = time_us != AV_NOPTS_VALUE ? time_us : mLastAudioUs;
+    }
+    std::unique_ptr<RedAvPacket> avpkt(new (pools.packets)
+                                           RedAvPacket(pkt, mSerial,
+                                                       pools.av_packets));
+    putPacket(avpkt, TYPE_AUDIO);
+  } else if (pkt->stream_index == mVideoIndex && !checkDropNonRefFrame(pkt)) {
+    if (mAdaptiveStrategy) {
+      // the furthest read, pts of reordered frames go back
+      int64_t time_us = packetTimeUs(pkt);
+      if (time_us != AV_NOPTS_VALUE &&
+          (mLastVideoUs == AV_NOPTS_VALUE || time_us > mLastVideoUs)) {
+        mLastVideoUs = time_us;
+      }
+    }
+    RED_TRACE_SCOPE(RED_TRACE_DEMUX, "queue_video_packet", mID);
+    RED_TRACE_FLOW_BEGIN(RED_TRACE_DEMUX, "video_frame", mID,
+                         RedTraceFlowId(mID, mSerial, pkt->pts));
+    std::unique_ptr<RedAvPacket> avpkt(new (pools.packets)
+                                           RedAvPacket(pkt, mSerial,
+                                                       pools.av_packets));
+    putPacket(avpkt, TYPE_VIDEO);
+    if (!mFirstVideoPktInPktQueue) {
+      mFirstVideoPktInPktQueue = true;
+    }
+  }
+}
+
+/*from the start of the stream, in the streams of the first representation*/
+int64_t CRedSourceController::packetTimeUs(const AVPacket *pkt) {
+  int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+  if (ts == AV_NOPTS_VALUE || pkt->stream_index < 0 ||
+      pkt->stream_index >= static_cast<int>(mMetaData->track_info.size())) {
+    return AV_NOPTS_VALUE;
+  }
+  const TrackInfo &track = mMetaData->track_info[pkt->stream_index];
+  if (track.time_base_num <= 0 || track.time_base_den <= 0) {
+    return AV_NOPTS_VALUE;
+  }
+  int64_t time_us = av_rescale_q(
+      ts, (AVRational){track.time_base_num, track.time_base_den},
+      AV_TIME_BASE_Q);
+  return mMetaData->start_time > 0 ? time_us - mMetaData->start_time
+                                   : time_us;
+}
+
+void CRedSourceController::checkSwitch() {
+  if (!mAdaptiveStrategy || mSwitch || mEOF || mVideoIndex < 0 ||
+      mLastVideoUs == AV_NOPTS_VALUE ||
+      mVideoState->first_video_frame_rendered != 1) {
+    return;
+  }
+  int64_t now_ms = CurrentTimeMs();
+  if (now_ms - mSwitchCheckMs < SWITCH_CHECK_INTERVAL_MS ||
+      now_ms - mLastSwitchMs < SWITCH_MIN_INTERVAL_MS) {
+    return;
+  }
+  mSwitchCheckMs = now_ms;
+  int64_t buffer_ms = mVideoState->stat.video_cache.duration;
+  if (mAudioIndex >= 0) {
+    buffer_ms = std::min(buffer_ms, mVideoState->stat.audio_cache.duration);
+  }
+  int target = mAdaptiveStrategy->getNextRepresentation(mRepresentation,
+                                                        buffer_ms);
+  auto retry = mSwitchRetry.find(target);
+  if (target == mRepresentation ||
+      (retry != mSwitchRetry.end() && now_ms < retry->second.at_ms)) {
+    return;
+  }
+  std::string url = mAdaptiveStrategy->getInitialUrlList(target);
+  if (url.empty()) {
+    return;
+  }
+  const std::string reddownloadPrefix = "httpreddownload:";
+  if (mUrl.compare(0, reddownloadPrefix.size(), reddownloadPrefix) == 0) {
+    url = reddownloadPrefix + url;
+  }
+
+  // errors of the new source are not the player's, it reports none
+  sp<SwitchPrepare> prepare = std::make_shared<SwitchPrepare>();
+  prepare->target = target;
+  prepare->start_us = mLastVideoUs + SWITCH_PREPARE_LEAD_US;
+  prepare->source = std::make_shared<CRedSource>(mID, nullptr);
+  {
+    std::unique_lock<std::mutex> lck(mLock);
+    if (mAbort) {
+      return;
+    }
+    mSwitchSource = prepare->source;
+  }
+  AV_LOGI_ID(TAG, mID,
+             "switch %d -> %d from %" PRId64 "us, buffer %" PRId64 "ms\n",
+             mRepresentation, target, prepare->start_us, buffer_ms);
+  mLastSwitchMs = now_ms;
+  mSwitch = prepare;
+  mSwitchThread =
+      std::thread(&CRedSourceController::prepareSwitch, this, prepare, url);
+}
+
+/*on its own thread, so the read thread goes on with the representation
+ * playing while the next one is opened*/
+void CRedSourceController::prepareSwitch(sp<SwitchPrepare> prepare,
+                                         std::string url) {
+  sp<CRedSource> source = prepare->source;
+  sp<MetaData> metadata = std::make_shared<MetaData>();
+  redsource::FFMpegOpt opt{0};
+  av_dict_copy(&opt.format_opts, mGeneralConfig->formatConfig, 0);
+  av_dict_copy(&opt.codec_opts, mGeneralConfig->codecConfig, 0);
+  int ret = source->open(url, opt, metadata);
+  av_dict_free(&opt.format_opts);
+  av_dict_free(&opt.codec_opts);
+  if (ret == OK && !buildRemap(metadata, prepare->remap, prepare->format)) {
+    prepare->incompatible = true;
+  }
+  if (ret == OK && !prepare->incompatible) {
+    ret = source->seek(prepare->start_us);
+  }
+
+  // the first keyframe at or after start_us, audio is kept from the seek
+  // point on and trimmed against what is queued once spliced
+  AVPacket *pkt = av_packet_alloc();
+  while (ret >= 0 && !prepare->incompatible && pkt && !prepare->cancel &&
+         !mAbort && prepare->pending.size() < SWITCH_SPLICE_MAX_PENDING) {
+    if ((ret = source->readPacket(pkt)) != OK) {
+      break;
+    }
+    remapPacket(prepare->remap, pkt);
+    int64_t time_us = packetTimeUs(pkt);
+    if (pkt->stream_index == mAudioIndex) {
+      AVPacket *audio = av_packet_alloc();
+      if (audio) {
+        av_packet_move_ref(audio, pkt);
+        prepare->pending.push_back(audio);
+      }
+    } else if (pkt->stream_index == mVideoIndex &&
+               time_us != AV_NOPTS_VALUE) {
+      if (time_us > prepare->start_us + SWITCH_SPLICE_MAX_GAP_US) {
+        break;
+      }
+      if ((pkt->flags & AV_PKT_FLAG_KEY) &&
+          time_us >= prepare->start_us - SWITCH_SPLICE_TOLERANCE_US) {
+        prepare->splice_us = time_us;
+        prepare->splice = pkt;
+        pkt = nullptr;
+        break;
+      }
+    }
+    av_packet_unref(pkt);
+  }
+  av_packet_free(&pkt);
+  if (prepare->splice_us == AV_NOPTS_VALUE) {
+    AV_LOGW_ID(TAG, mID, "switch to %d failed, %s %d\n", prepare->target,
+               prepare->incompatible ? "incompatible" : "no keyframe", ret);
+  }
+  prepare->done = true;
+}
+
+/*with the prepared representation done, the read thread splices it in at
+ * the first video packet of the one playing that reaches its keyframe. On
+ * return pkt holds the packet to queue next*/
+void CRedSourceController::spliceSwitch(AVPacket *pkt) {
+  sp<SwitchPrepare> prepare = mSwitch;
+  int target = prepare->target;
+  if (prepare->splice_us == AV_NOPTS_VALUE ||
+      (mLastVideoUs != AV_NOPTS_VALUE &&
+       mLastVideoUs >= prepare->splice_us - SWITCH_SPLICE_TOLERANCE_US)) {
+    if (prepare->incompatible) {
+      mAdaptiveStrategy->disableRepresentation(target);
+    } else {
+      if (prepare->splice_us != AV_NOPTS_VALUE) {
+        AV_LOGW_ID(TAG, mID, "switch to %d too late, read up to %" PRId64
+                   "us\n", target, mLastVideoUs);
+      }
+      retrySwitchLater(target);
+    }
+    endSwitch();
+    return;
+  }
+  int64_t time_us = packetTimeUs(pkt);
+  if (pkt->stream_index != mVideoIndex || time_us == AV_NOPTS_VALUE ||
+      time_us < prepare->splice_us - SWITCH_SPLICE_TOLERANCE_US) {
+    return;
+  }
+
+  sp<CRedSource> old_source;
+  {
+    std::unique_lock<std::mutex> lck(mLock);
+    old_source = mRedSource;
+    mRedSource = prepare->source;
+    mSwitchSource.reset();
+  }
+  prepare->source.reset();
+  old_source->close();
+  mStreamRemap = prepare->remap;
+  if (prepare->format) {
+    // the decoders move to the new format, frames they hold of the old one
+    // are dropped with the serial
+    ++mSerial;
+    for (auto iter = mPktQueueMap.begin(); iter != mPktQueueMap.end();
+         ++iter) {
+      std::unique_ptr<RedAvPacket> avpkt(
+          new RedAvPacket(PKT_TYPE_FLUSH, prepare->format));
+      iter->second->putPkt(avpkt);
+    }
+  }
+  for (AVPacket *&audio : prepare->pending) {
+    queuePacket(audio);
+    av_packet_free(&audio);
+  }
+  prepare->pending.clear();
+  av_packet_unref(pkt);
+  av_packet_move_ref(pkt, prepare->splice);
+  AV_LOGI_ID(TAG, mID,
+             "switched %d -> %d at %" PRId64 "us%s, serial %d\n",
+             mRepresentation, target, prepare->splice_us,
+             prepare->format ? " with a new format" : "", mSerial);
+  notifyListener(RED_MSG_REPRESENTATION_CHANGED, mRepresentation, target);
+  mRepresentation = target;
+  mSwitchRetry.erase(target);
+  mLastSwitchMs = CurrentTimeMs();
+  endSwitch();
+}
+
+/*drops a switch not spliced in yet, its source is closed*/
+void CRedSourceController::endSwitch() {
+  sp<SwitchPrepare> prepare = mSwitch;
+  if (!prepare) {
+    return;
+  }
+  prepare->cancel = true;
+  {
+    std::unique_lock<std::mutex> lck(mLock);
+    if (mSwitchSource) {
+      mSwitchSource->setInterrupt();
+      mSwitchSource.reset();
+    }
+  }
+  if (mSwitchThread.joinable()) {
+    mSwitchThread.join();
+  }
+  for (AVPacket *&audio : prepare->pending) {
+    av_packet_free(&audio);
+  }
+  av_packet_free(&prepare->splice);
+  if (prepare->source) {
+    prepare->source->close();
+  }
+  mSwitch.reset();
+}
+
+/*a representation that failed is tried again later, less often each time*/
+void CRedSourceController::retrySwitchLater(int target) {
+  SwitchRetry &retry = mSwitchRetry[target];
+  retry.backoff_ms =
+      retry.backoff_ms > 0
+          ? std::min<int64_t>(retry.backoff_ms * 2, SWITCH_RETRY_MAX_MS)
+          : SWITCH_RETRY_MS;
+  retry.at_ms = CurrentTimeMs() + retry.backoff_ms;
+  AV_LOGI_ID(TAG, mID, "switch to %d again in %" PRId64 "ms\n", target,
+             retry.backoff_ms);
+}
+
+/*streams of metadata mapped onto the first representation, false if its
+ * packets can not go to the decoders. format is set when the decoders have to
+ * be set up again for them*/
+bool CRedSourceController::buildRemap(const sp<MetaData> &metadata,
+                                      std::vector<StreamRemap> &remap,
+                                      sp<MetaData> &format) {
+  bool audio = false, video = false, changed = false;
+  int64_t from_start = metadata->start_time > 0 ? metadata->start_time : 0;
+  int64_t to_start = mMetaData->start_time > 0 ? mMetaData->start_time : 0;
+  remap.assign(metadata->track_info.size(), StreamRemap());
+  format.reset();
+  for (const TrackInfo &track : metadata->track_info) {
+    int index = -1;
+    if (track.stream_type == TYPE_AUDIO && !audio) {
+      audio = true;
+      index = mAudioIndex;
+    } else if (track.stream_type == TYPE_VIDEO && !video) {
+      video = true;
+      index = mVideoIndex;
+    }
+    if (index < 0 || track.stream_index < 0 ||
+        track.stream_index >= static_cast<int>(remap.size())) {
+      continue;
+    }
+    const TrackInfo &to = mMetaData->track_info[index];
+    int compare = compareFormat(to, track);
+    if (compare == FORMAT_INCOMPATIBLE || track.time_base_num <= 0 ||
+        track.time_base_den <= 0) {
+      return false;
+    }
+    changed = changed || compare == FORMAT_CHANGED;
+    StreamRemap &r = remap[track.stream_index];
+    r.index = index;
+    r.from = (AVRational){track.time_base_num, track.time_base_den};
+    r.to = (AVRational){to.time_base_num, to.time_base_den};
+    r.offset = av_rescale_q(to_start - from_start, AV_TIME_BASE_Q, r.to);
+  }
+  if (!(audio || mAudioIndex < 0) || !(video || mVideoIndex < 0)) {
+    return false;
+  }
+  if (!changed) {
+    return true;
+  }
+
+  // the processers look tracks up by the indexes of the first representation
+  format = std::make_shared<MetaData>();
+  format->audio_index = mAudioIndex;
+  format->video_index = mVideoIndex;
+  format->track_info.resize(mMetaData->track_info.size());
+  for (const TrackInfo &track : metadata->track_info) {
+    if (track.stream_index < 0 ||
+        track.stream_index >= static_cast<int>(remap.size()) ||
+        remap[track.stream_index].index < 0) {
+      continue;
+    }
+    const StreamRemap &r = remap[track.stream_index];
+    TrackInfo &info = format->track_info[r.index];
+    info = track;
+    info.stream_index = r.index;
+    info.time_base_num = r.to.num;
+    info.time_base_den = r.to.den;
+    // owned by metadata, which goes with the source
+    info.extra_data = nullptr;
+    info.extra_data_size = 0;
+    if (track.extra_data && track.extra_data_size > 0) {
+      info.extra_data = new uint8_t[track.extra_data_size];
+      memcpy(info.extra_data, track.extra_data, track.extra_data_size);
+      info.extra_data_size = track.extra_data_size;
+    }
+  }
+  return true;
+}
+
+void CRedSourceController::remapPacket(const std::vector<StreamRemap> &remap,
+                                       AVPacket *pkt) {
+  if (remap.empty()) {
+    return;
+  }
+  if (pkt->stream_index < 0 ||
+      pkt->stream_index >= static_cast<int>(remap.size()) ||
+      remap[pkt->stream_index].index < 0) {
+    pkt->stream_index = -1;
+    return;
+  }
+  const StreamRemap &r = remap[pkt->stream_index];
+  av_packet_rescale_ts(pkt, r.from, r.to);
+  if (pkt->pts != AV_NOPTS_VALUE) {
+    pkt->pts += r.offset;
+  }
+  if (pkt->dts != AV_NOPTS_VALUE) {
+    pkt->dts += r.offset;
+  }
+  pkt->stream_index = r.index;
+}
+
+/*only entries of the download cache keep an index, it goes when they go*/
+std::string CRedSourceController::keyframeIndexPath() {
+  const std::string reddownloadPrefix = "httpreddownload:";
+  if (mUrl.compare(0, reddownloadPrefix.size(), reddownloadPrefix) != 0) {
+    return "";
+  }
+  AVDictionaryEntry *dir = av_dict_get(mGeneralConfig->formatConfig,
+                                       "cache_file_dir", nullptr, 0);
+  char *path = nullptr;
+  if (!dir || !dir->value || dir->value[0] == '\0' ||
+      reddownload_get_keyframe_index_path(
+          dir->value, mUrl.c_str() + reddownloadPrefix.size(), &path) != 0 ||
+      !path) {
+    return "";
+  }
+  std::string index_path(path);
+  free(path);
+  return index_path;
+}
+
 // base method
 void CRedSourceController::ThreadFunc() {
   AVPacket *pkt = av_packet_alloc();
@@ -495,7 +1046,8 @@ void CRedSourceController::ThreadFunc() {
   bool completed = false;
 #if defined(__APPLE__)
   pthread_setname_np("readthread");
-#elif defined(__ANDROID__) || defined(__HARMONY__)
+#elif defined(__ANDROID__) || defined(__HARMONY__) ||                          \
+    defined(__HEADLESS__)
   pthread_setname_np(pthread_self(), "readthread");
 #endif
   AV_LOGI_ID(TAG, mID, "RedSource thread Start.");
@@ -506,11 +1058,27 @@ void CRedSourceController::ThreadFunc() {
 
   notifyListener(RED_MSG_BPREPARED);
 
+  // any source is indexed for the seeks of this session, only those backed
+  // by a download cache entry keep it for later ones
+  if (player_config->keyframe_index) {
+    mKeyframeIndexPath = keyframeIndexPath();
+    mKeyframeIndex = std::make_shared<redsource::KeyframeIndex>();
+  }
+  if (!mKeyframeIndexPath.empty()) {
+    if (mKeyframeIndex->load(mKeyframeIndexPath) == OK) {
+      AV_LOGI_ID(TAG, mID, "keyframe index loaded, %zu entries\n",
+                 mKeyframeIndex->size());
+    }
+  }
+
   do {
     {
       std::unique_lock<std::mutex> lck(mNotifyCbLock);
       mRedSource = std::make_shared<CRedSource>(mID, mNotifyCb);
     }
+    if (mRedSource && mKeyframeIndex) {
+      mRedSource->setKeyframeIndex(mKeyframeIndex);
+    }
     mMetaData = std::make_shared<MetaData>();
     if (!mRedSource || !mMetaData) {
       AV_LOGE_ID(TAG, mID, "[%s][%d]create redsource failed \n", __FUNCTION__,
@@ -550,23 +1118,39 @@ void CRedSourceController::ThreadFunc() {
 
   while (!mAbort) {
     if (mVideoState->seek_req) {
-      mEOF = false;
-      toggleBuffering(true);
-      notifyListener(RED_MSG_BUFFERING_UPDATE, 0, 0);
-      int ret = mRedSource->seek(mVideoState->seek_pos);
-      if (ret < 0) {
-        AV_LOGE_ID(TAG, mID, "%s Error while seeking\n", mUrl.c_str());
-      } else {
-        AV_LOGD_ID(TAG, mID, "%s seek to %" PRId64 " success\n", mUrl.c_str(),
+      mVideoState->latest_seek_start_at = CurrentTimeUs();
+      endSwitch();
+      mLastAudioUs = AV_NOPTS_VALUE;
+      mLastVideoUs = AV_NOPTS_VALUE;
+      bool in_buffer = seekInBuffer(mVideoState->seek_pos);
+      mVideoState->latest_seek_in_buffer = in_buffer;
+      mVideoState->pipeline.countSeek(in_buffer);
+      if (in_buffer) {
+        AV_LOGI_ID(TAG, mID, "seek to %" PRId64 " served from buffer\n",
                    mVideoState->seek_pos);
-        {
-          PerformFlush();
-          putFlushPacket();
-        }
         mVideoState->latest_video_seek_load_serial = mSerial;
         mVideoState->latest_audio_seek_load_serial = mSerial;
         mVideoState->latest_seek_load_start_at = CurrentTimeUs();
         setMasterClockAvaliable(mVideoState, false);
+      } else {
+        mEOF = false;
+        toggleBuffering(true);
+        notifyListener(RED_MSG_BUFFERING_UPDATE, 0, 0);
+        int ret = mRedSource->seek(mVideoState->seek_pos);
+        if (ret < 0) {
+          AV_LOGE_ID(TAG, mID, "%s Error while seeking\n", mUrl.c_str());
+        } else {
+          AV_LOGD_ID(TAG, mID, "%s seek to %" PRId64 " success\n",
+                     mUrl.c_str(), mVideoState->seek_pos);
+          {
+            PerformFlush();
+            putFlushPacket();
+          }
+          mVideoState->latest_video_seek_load_serial = mSerial;
+          mVideoState->latest_audio_seek_load_serial = mSerial;
+          mVideoState->latest_seek_load_start_at = CurrentTimeUs();
+          setMasterClockAvaliable(mVideoState, false);
+        }
       }
       mVideoState->seek_req = false;
       player_config->dcc.current_high_water_mark_in_ms =
@@ -590,7 +1174,9 @@ void CRedSourceController::ThreadFunc() {
       }
       notifyListener(RED_MSG_SEEK_COMPLETE, mVideoState->seek_pos / 1000);
       completed = false;
-      toggleBuffering(true);
+      if (!in_buffer) {
+        toggleBuffering(true);
+      }
       continue;
     }
 
@@ -598,16 +1184,24 @@ void CRedSourceController::ThreadFunc() {
 
     if (isBufferFull()) {
       toggleBuffering(false);
-      usleep(10 * 1000);
+      mSleepingFull = true;
+      if (player_config->low_water_wakeup) {
+        waitForLowWater();
+      } else {
+        usleep(10 * 1000);
+      }
+      mVideoState->pipeline.countDemuxWakeup();
       continue;
     }
+    mSleepingFull = false;
     if ((!mVideoState->paused || completed) &&
         (mMetaData->audio_index < 0 || mVideoState->auddec_finished) &&
         (mMetaData->video_index < 0 || mVideoState->viddec_finished)) {
       if (completed) {
         std::unique_lock<std::mutex> lck(mLock);
+        // seek() and stop() signal under mLock
         while (!mAbort && !mVideoState->seek_req) {
-          mCond.wait_for(lck, std::chrono::milliseconds(100));
+          mCond.wait(lck);
         }
         if (!mAbort) {
           continue;
@@ -624,7 +1218,11 @@ void CRedSourceController::ThreadFunc() {
         }
       }
     }
-    RED_ERR ret = mRedSource->readPacket(pkt);
+    RED_ERR ret = OK;
+    {
+      RED_TRACE_SCOPE(RED_TRACE_DEMUX, "read_packet", mID);
+      ret = mRedSource->readPacket(pkt);
+    }
     if (ret != OK || !pkt) {
       if (ret == AVERROR_EOF || ret == AVERROR_EXIT ||
           mRedSource->getPbError()) {
@@ -671,18 +1269,18 @@ void CRedSourceController::ThreadFunc() {
     } else {
       mVideoState->error = 0;
       mEOF = false;
-    }
-    if (pkt->stream_index == mAudioIndex) {
-      std::unique_ptr<RedAvPacket> avpkt(new RedAvPacket(pkt, mSerial));
-      putPacket(avpkt, TYPE_AUDIO);
-    } else if (pkt->stream_index == mVideoIndex && !checkDropNonRefFrame(pkt)) {
-      std::unique_ptr<RedAvPacket> avpkt(new RedAvPacket(pkt, mSerial));
-      putPacket(avpkt, TYPE_VIDEO);
-      if (!mFirstVideoPktInPktQueue) {
-        mFirstVideoPktInPktQueue = true;
+      int64_t refill_due_us = mRefillDueUs.exchange(0);
+      if (refill_due_us > 0) {
+        mVideoState->pipeline.recordSince(STAGE_DEMUX_REFILL, refill_due_us);
       }
     }
+    remapPacket(mStreamRemap, pkt);
+    if (mSwitch && mSwitch->done) {
+      spliceSwitch(pkt);
+    }
+    queuePacket(pkt);
     updateCacheStatistic();
+    checkSwitch();
     buffer_check_time = CurrentTimeMs();
     if ((mVideoState->first_video_frame_rendered != 1 &&
          mMetaData->video_index >= 0) ||
@@ -704,6 +1302,11 @@ void CRedSourceController::ThreadFunc() {
   if (pkt) {
     av_packet_free(&pkt);
   }
+  if (mKeyframeIndex && !mKeyframeIndexPath.empty() &&
+      mKeyframeIndex->dirty() && mKeyframeIndex->size() > 0) {
+    mKeyframeIndex->save(mKeyframeIndexPath);
+  }
+  endSwitch();
   if (mRedSource) {
     mRedSource->close();
   }
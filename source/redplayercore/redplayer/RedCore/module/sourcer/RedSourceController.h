@@ -10,6 +10,7 @@
 #include "base/RedConfig.h"
 #include "base/RedPacket.h"
 #include "base/RedQueue.h"
+#include "strategy/RedAdaptiveStrategy.h"
 
 #include <iostream>
 #include <stdint.h>
@@ -36,6 +37,7 @@ REDPLAYER_NS_BEGIN;
 using PrepareCallBack = std::function<void(sp<MetaData> &)>;
 
 using CRedSource = redsource::RedSource;
+using AdaptiveStrategy = redstrategycenter::strategy::RedAdaptiveStrategy;
 
 class CRedSourceController : public CRedThreadBase {
 public:
@@ -63,6 +65,37 @@ public:
   void release();
   void toggleBuffering(bool buffering);
   int getSerial();
+  void setAdaptiveStrategy(const sp<AdaptiveStrategy> &strategy, int index);
+
+private:
+  /*packets of a later representation in the streams of the first one*/
+  struct StreamRemap {
+    int index{-1};
+    AVRational from{0, 1};
+    AVRational to{0, 1};
+    int64_t offset{0}; // in to
+  };
+
+  /*a representation opened and read up to its splice keyframe off the read
+   * thread, handed over to the read thread once done*/
+  struct SwitchPrepare {
+    int target{-1};
+    int64_t start_us{AV_NOPTS_VALUE}; // first keyframe from here is spliced
+    sp<CRedSource> source;
+    sp<MetaData> format; // for the decoders, null if they go on as they are
+    std::vector<StreamRemap> remap;
+    std::vector<AVPacket *> pending; // audio read up to the splice keyframe
+    AVPacket *splice{nullptr};
+    int64_t splice_us{AV_NOPTS_VALUE};
+    bool incompatible{false};
+    std::atomic<bool> cancel{false};
+    std::atomic<bool> done{false};
+  };
+
+  struct SwitchRetry {
+    int64_t at_ms{0};
+    int64_t backoff_ms{0};
+  };
 
 private:
   CRedSourceController() = default;
@@ -71,9 +104,24 @@ private:
   RED_ERR SetMetaData();
   RED_ERR putFlushPacket();
   RED_ERR putEofPacket();
+  bool seekInBuffer(int64_t pos_us);
   sp<PktQueue> pktQueue(int stream_type);
   bool isBufferFull();
+  void armLowWater(int stream_type, int index, int64_t min_bytes);
+  void waitForLowWater();
+  void onLowWater();
+  std::string keyframeIndexPath();
   bool checkDropNonRefFrame(AVPacket *pkt);
+  void queuePacket(AVPacket *pkt);
+  int64_t packetTimeUs(const AVPacket *pkt);
+  void checkSwitch();
+  void prepareSwitch(sp<SwitchPrepare> prepare, std::string url);
+  void spliceSwitch(AVPacket *pkt);
+  void endSwitch();
+  void retrySwitchLater(int target);
+  bool buildRemap(const sp<MetaData> &metadata, std::vector<StreamRemap> &remap,
+                  sp<MetaData> &format);
+  void remapPacket(const std::vector<StreamRemap> &remap, AVPacket *pkt);
   int getErrorType(int errorCode);
   void updateCacheStatistic();
   void notifyListener(uint32_t what, int32_t arg1 = 0, int32_t arg2 = 0,
@@ -97,13 +145,30 @@ private:
   bool mSeekBuffering{false};
   bool mFirstVideoPktInPktQueue{false};
   bool mReleased{false};
+  bool mLowWater{false};
+  std::atomic<bool> mSleepingFull{false};
+  std::atomic<int64_t> mRefillDueUs{0}; // when the demuxer should read again
   std::unordered_map<int, sp<PktQueue>> mPktQueueMap;
   sp<CoreGeneralConfig> mGeneralConfig;
   sp<CRedSource> mRedSource;
+  sp<redsource::KeyframeIndex> mKeyframeIndex;
+  std::string mKeyframeIndexPath;
   sp<MetaData> mMetaData;
   sp<VideoState> mVideoState;
   NotifyCallback mNotifyCb;
   int mMaxBufferSize{MAX_QUEUE_SIZE};
   int mBufferingPercent{0};
+  sp<AdaptiveStrategy> mAdaptiveStrategy;
+  sp<CRedSource> mSwitchSource; // being prepared, stop() interrupts it
+  sp<SwitchPrepare> mSwitch;
+  std::thread mSwitchThread;
+  std::unordered_map<int, SwitchRetry> mSwitchRetry;
+  std::vector<StreamRemap> mStreamRemap;
+  int mRepresentation{-1};
+  int mSeekSerial{0}; // a splice moves mSerial on, positions stay valid
+  int64_t mSwitchCheckMs{0};
+  int64_t mLastSwitchMs{0};
+  int64_t mLastAudioUs{AV_NOPTS_VALUE};
+  int64_t mLastVideoUs{AV_NOPTS_VALUE};
 };
 REDPLAYER_NS_END;
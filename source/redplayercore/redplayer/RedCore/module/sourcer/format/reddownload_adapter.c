@@ -37,7 +37,13 @@ typedef struct Context {
 } Context;
 
 static void speedcallback(void *opaque, int64_t size, int64_t speed,
-                          int64_t cur_time) {}
+                          int64_t cur_time) {
+  RedApplicationContext *app_ctx = (RedApplicationContext *)opaque;
+  if (app_ctx && app_ctx->func_on_app_event) {
+    RedIOAppSpeedEvent event = {size, speed, cur_time};
+    app_ctx->func_on_app_event(app_ctx, REDIOAPP_EVENT_DOWNLOAD_SPEED, &event);
+  }
+}
 
 static void callbackwrapper(void *h, int val, void *a1, void *a2) {
   RedApplicationContext *app_ctx = (RedApplicationContext *)h;
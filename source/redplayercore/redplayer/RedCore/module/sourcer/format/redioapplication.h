@@ -15,6 +15,7 @@
 #define REDIOAPP_EVENT_PCDN_SWITCH_INFO 0x1008
 #define REDIOAPP_EVENT_FIRST_CATON_OFFSET 0x1009
 #define REDIOAPP_EVENT_CONTAIN_PCDN_STREAM 0x1010
+#define REDIOAPP_EVENT_DOWNLOAD_SPEED 0x1011
 
 typedef struct RedApplicationContext RedApplicationContext;
 struct RedApplicationContext {
@@ -45,6 +46,12 @@ typedef struct RedCacheEntry {
   int64_t size;
 } RedCacheEntry;
 
+typedef struct RedIOAppSpeedEvent {
+  int64_t size;  // bytes of the sample
+  int64_t speed; // bits/s
+  int64_t cur_time;
+} RedIOAppSpeedEvent;
+
 typedef struct RedIOAppErrorEvent {
   char url[4096];
   int error;
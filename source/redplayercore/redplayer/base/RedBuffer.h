@@ -1,10 +1,11 @@
 #pragma once
 
 #include "RedBase.h"
+#include "RedObjectPool.h"
 
 REDPLAYER_NS_BEGIN;
 
-class CGlobalBuffer {
+class CGlobalBuffer : public RedPooledObject {
 public:
   CGlobalBuffer() = default;
   ~CGlobalBuffer();
@@ -17,7 +18,7 @@ public:
 
   static const int MAX_PALANARS = 8;
 
-  struct MediaCodecBufferContext {
+  struct MediaCodecBufferContext : public RedPooledObject {
     int buffer_index;
     void *media_codec;
     int decoder_serial;
@@ -27,7 +28,7 @@ public:
                                   bool render);
   };
 
-  struct HarmonyMediaBufferContext {
+  struct HarmonyMediaBufferContext : public RedPooledObject {
     int buffer_index;
     void *video_decoder;
     int decoder_serial;
@@ -37,13 +38,13 @@ public:
                                   bool render);
   };
 
-  struct FFmpegBufferContext {
+  struct FFmpegBufferContext : public RedPooledObject {
     void *av_frame;
     void (*release_av_frame)(FFmpegBufferContext *context);
     void *opaque;
   };
 
-  struct VideoToolBufferContext {
+  struct VideoToolBufferContext : public RedPooledObject {
     void *buffer = nullptr;
   };
 
@@ -87,6 +88,12 @@ public:
   int num_channels{0};
   uint8_t *channel[MAX_PALANARS];
   uint64_t channel_layout{0}; // Channel layout of the audio data
+
+  // pipeline stats timestamps, 0 when unknown
+  int64_t demux_time_us{0};
+  int64_t decoded_time_us{0};
+  // trace flow of the frame from demux to render, 0 when not traced
+  int64_t flow_id{0};
 };
 
 REDPLAYER_NS_END;
@@ -68,6 +68,19 @@ struct PlayerConfig {
   int32_t enable_ndkvdec;
   int32_t enable_harmony_vdec;
   int32_t vtb_max_error_count;
+  int32_t pipeline_stats;
+  int32_t seek_back_buffer_ms;
+  int32_t seek_back_buffer_bytes;
+  int32_t low_water_wakeup;
+  int32_t audio_producer;
+  int32_t vdec_thread_type;
+  int32_t vdec_threads;
+  int32_t vdec_low_delay_start;
+  int32_t present_scheduler;
+  int32_t keyframe_index;
+  int32_t vdec_convert_10bit;
+  int32_t headless_free_run;
+  int32_t adaptive_switch;
   FFDemuxCacheControl dcc;
 };
 
@@ -137,6 +150,49 @@ static const RedCfg allCfg[] = {
      CONFIG_INT(0, 0, 1)},
     {"is-input-json", "is input json", CONFIG_OFFSET(is_input_json),
      CONFIG_INT(0, 0, 2)},
+    {"pipeline-stats", "record per stage latency histograms",
+     CONFIG_OFFSET(pipeline_stats), CONFIG_INT(0, 0, 1)},
+    {"seek-back-buffer-ms",
+     "keep played packets for seeks inside the buffered window, 0 disables",
+     CONFIG_OFFSET(seek_back_buffer_ms), CONFIG_INT(0, 0, INT_MAX)},
+    {"seek-back-buffer-bytes",
+     "most bytes of played packets each packet queue keeps for seeks",
+     CONFIG_OFFSET(seek_back_buffer_bytes),
+     CONFIG_INT(MAX_QUEUE_SIZE / 2, 0, INT_MAX)},
+    {"packet-low-water-wakeup",
+     "with a full packet buffer, sleep until a queue drains to its low water "
+     "mark instead of polling every 10ms",
+     CONFIG_OFFSET(low_water_wakeup), CONFIG_INT(1, 0, 1)},
+    {"audio-producer",
+     "resample and time-stretch on a producer thread, the audio callback "
+     "only copies",
+     CONFIG_OFFSET(audio_producer), CONFIG_INT(0, 0, 1)},
+    {"video-decoder-thread-type",
+     "software video decoder threading, 1 frame, 2 slice, 3 both",
+     CONFIG_OFFSET(vdec_thread_type), CONFIG_INT(2, 1, 3)},
+    {"video-decoder-threads",
+     "software video decoder threads, 0 picks from cores and resolution",
+     CONFIG_OFFSET(vdec_threads), CONFIG_INT(0, 0, 16)},
+    {"video-decoder-low-delay-start",
+     "decode slice threaded until the first frame, then use frame threads",
+     CONFIG_OFFSET(vdec_low_delay_start), CONFIG_INT(1, 0, 1)},
+    {"video-present-scheduler",
+     "present video on per frame deadlines from the master clock, dropping "
+     "runs of late frames at once",
+     CONFIG_OFFSET(present_scheduler), CONFIG_INT(0, 0, 1)},
+    {"keyframe-index",
+     "record video keyframes of byte seekable formats like ts and flv while "
+     "demuxing, seeks resume at the right byte offset. mp4 is not indexed. "
+     "kept next to the download cache entry of httpreddownload urls",
+     CONFIG_OFFSET(keyframe_index), CONFIG_INT(0, 0, 1)},
+    {"video-decoder-convert-10bit",
+     "convert 10 bit software decoded frames to 8 bit on the decoder thread "
+     "instead of the render thread",
+     CONFIG_OFFSET(vdec_convert_10bit), CONFIG_INT(0, 0, 1)},
+    {"adaptive-switch",
+     "with a json playlist, move to another representation at a keyframe "
+     "while playing as bandwidth and buffer change",
+     CONFIG_OFFSET(adaptive_switch), CONFIG_INT(0, 0, 1)},
 
     // iOS only options
     {"videotoolbox", "VideoToolbox: enable", CONFIG_OFFSET(videotoolbox),
@@ -154,6 +210,10 @@ static const RedCfg allCfg[] = {
     // Harmony only options
     {"enable-harmony_vdec", "use harmony codec",
      CONFIG_OFFSET(enable_harmony_vdec), CONFIG_INT(1, 0, 1)},
+
+    // Headless only options
+    {"headless-free-run", "render as fast as decoded, without clock pacing",
+     CONFIG_OFFSET(headless_free_run), CONFIG_INT(0, 0, 1)},
     {NULL}};
 
 class RedPlayerConfig {
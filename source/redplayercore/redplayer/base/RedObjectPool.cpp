@@ -0,0 +1,152 @@
+#include "RedObjectPool.h"
+#include "RedLog.h"
+
+#include <inttypes.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#define TAG "RedObjectPool"
+
+REDPLAYER_NS_BEGIN;
+
+namespace {
+struct BlockHeader {
+  RedObjectPool *pool;
+};
+// keep the payload aligned like malloc does
+const size_t kHeaderSize =
+    (sizeof(BlockHeader) + alignof(std::max_align_t) - 1) &
+    ~(alignof(std::max_align_t) - 1);
+
+inline BlockHeader *headerOf(void *ptr) {
+  return reinterpret_cast<BlockHeader *>(static_cast<char *>(ptr) -
+                                         kHeaderSize);
+}
+
+inline void *payloadOf(BlockHeader *header) {
+  return reinterpret_cast<char *>(header) + kHeaderSize;
+}
+
+BlockHeader *heapBlock(size_t size) {
+  void *mem = malloc(kHeaderSize + size);
+  if (!mem) {
+    throw std::bad_alloc();
+  }
+  return static_cast<BlockHeader *>(mem);
+}
+} // namespace
+
+RedObjectPool *RedObjectPool::create(const char *name, size_t block_size,
+                                     int max_cached) {
+  return new RedObjectPool(name, block_size, max_cached);
+}
+
+RedObjectPool::RedObjectPool(const char *name, size_t block_size,
+                             int max_cached)
+    : mName(name), mMaxCached(max_cached) {
+  mBlockSize = block_size < sizeof(FreeBlock) ? sizeof(FreeBlock) : block_size;
+}
+
+RedObjectPool::~RedObjectPool() {
+  while (mFreeList) {
+    FreeBlock *block = mFreeList;
+    mFreeList = block->next;
+    ::free(headerOf(block));
+  }
+  AV_LOGI(TAG, "%s destroyed, %s\n", mName.c_str(), toJson().c_str());
+}
+
+void RedObjectPool::release() { unref(); }
+
+void RedObjectPool::unref() {
+  if (mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete this;
+  }
+}
+
+void *RedObjectPool::alloc() {
+  mRefs.fetch_add(1, std::memory_order_relaxed);
+  int64_t in_use = mInUse.fetch_add(1, std::memory_order_relaxed) + 1;
+  int64_t peak = mPeakInUse.load(std::memory_order_relaxed);
+  while (in_use > peak && !mPeakInUse.compare_exchange_weak(
+                              peak, in_use, std::memory_order_relaxed)) {
+  }
+  {
+    std::unique_lock<std::mutex> lck(mLock);
+    if (mFreeList) {
+      FreeBlock *block = mFreeList;
+      mFreeList = block->next;
+      mCached--;
+      lck.unlock();
+      mReuses.fetch_add(1, std::memory_order_relaxed);
+      return block;
+    }
+  }
+  BlockHeader *header = heapBlock(mBlockSize);
+  header->pool = this;
+  mHeapAllocs.fetch_add(1, std::memory_order_relaxed);
+  return payloadOf(header);
+}
+
+void RedObjectPool::recycle(void *block) {
+  mInUse.fetch_sub(1, std::memory_order_relaxed);
+  {
+    std::unique_lock<std::mutex> lck(mLock);
+    if (mCached < mMaxCached) {
+      FreeBlock *free_block = static_cast<FreeBlock *>(block);
+      free_block->next = mFreeList;
+      mFreeList = free_block;
+      mCached++;
+      block = nullptr;
+    }
+  }
+  if (block) {
+    ::free(headerOf(block));
+    mHeapFrees.fetch_add(1, std::memory_order_relaxed);
+  }
+  unref();
+}
+
+void *RedObjectPool::allocFrom(RedObjectPool *pool, size_t size) {
+  if (pool && size <= pool->mBlockSize) {
+    return pool->alloc();
+  }
+  if (pool) {
+    pool->mOversize.fetch_add(1, std::memory_order_relaxed);
+  }
+  BlockHeader *header = heapBlock(size);
+  header->pool = nullptr;
+  return payloadOf(header);
+}
+
+void RedObjectPool::free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  BlockHeader *header = headerOf(ptr);
+  if (header->pool) {
+    header->pool->recycle(ptr);
+  } else {
+    ::free(header);
+  }
+}
+
+int64_t RedObjectPool::heapAllocs() const {
+  return mHeapAllocs.load(std::memory_order_relaxed);
+}
+
+std::string RedObjectPool::toJson() const {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "{\"block_size\":%zu,\"heap_allocs\":%" PRId64
+           ",\"heap_frees\":%" PRId64 ",\"reuses\":%" PRId64
+           ",\"oversize\":%" PRId64 ",\"in_use\":%" PRId64
+           ",\"peak_in_use\":%" PRId64 "}",
+           mBlockSize, mHeapAllocs.load(), mHeapFrees.load(), mReuses.load(),
+           mOversize.load(), mInUse.load(), mPeakInUse.load());
+  return buf;
+}
+
+REDPLAYER_NS_END;
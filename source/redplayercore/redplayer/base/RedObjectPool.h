@@ -0,0 +1,75 @@
+#pragma once
+
+#include "RedBase.h"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+REDPLAYER_NS_BEGIN;
+
+/*fixed size block pool with a mutex guarded freelist. every block carries a
+ * header pointing back at its pool, so a block can be returned from any
+ * thread without knowing the owner. the owner and every outstanding block
+ * hold a reference, frames still queued somewhere when the player goes away
+ * keep the pool alive until they are deleted*/
+class RedObjectPool {
+public:
+  static RedObjectPool *create(const char *name, size_t block_size,
+                               int max_cached);
+  /*drops the owner reference*/
+  void release();
+
+  /*a block from pool, or a plain heap block when pool is null or size does
+   * not fit; either way it must be given back with free()*/
+  static void *allocFrom(RedObjectPool *pool, size_t size);
+  static void free(void *ptr);
+
+  int64_t heapAllocs() const;
+  std::string toJson() const;
+
+private:
+  RedObjectPool(const char *name, size_t block_size, int max_cached);
+  ~RedObjectPool();
+  void *alloc();
+  void recycle(void *block);
+  void unref();
+
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  std::string mName;
+  size_t mBlockSize{0};
+  int mMaxCached{0};
+  std::mutex mLock;
+  FreeBlock *mFreeList{nullptr};
+  int mCached{0};
+  std::atomic<int> mRefs{1};
+
+  std::atomic<int64_t> mHeapAllocs{0};
+  std::atomic<int64_t> mHeapFrees{0};
+  std::atomic<int64_t> mReuses{0};
+  std::atomic<int64_t> mOversize{0};
+  std::atomic<int64_t> mInUse{0};
+  std::atomic<int64_t> mPeakInUse{0};
+};
+
+/*base for types that may live in a RedObjectPool. new (pool) T() takes a
+ * block from pool, plain new T() a heap block, and delete always puts the
+ * block back where it came from, so unique_ptr and raw delete keep working*/
+struct RedPooledObject {
+  static void *operator new(size_t size) {
+    return RedObjectPool::allocFrom(nullptr, size);
+  }
+  static void *operator new(size_t size, RedObjectPool *pool) {
+    return RedObjectPool::allocFrom(pool, size);
+  }
+  static void operator delete(void *ptr) { RedObjectPool::free(ptr); }
+  static void operator delete(void *ptr, RedObjectPool *pool) {
+    RedObjectPool::free(ptr);
+  }
+};
+
+REDPLAYER_NS_END;
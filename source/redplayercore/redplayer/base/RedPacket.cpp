@@ -1,4 +1,12 @@
 #include "RedPacket.h"
+#include "RedLog.h"
+
+#include <inttypes.h>
+
+#include <cstdio>
+#include <new>
+
+#define TAG "RedAvPacketPool"
 
 REDPLAYER_NS_BEGIN;
 
@@ -21,16 +29,30 @@ RedAvPacket::RedAvPacket(AVPacket *pkt) {
   pkt_ = av_packet_alloc();
   av_init_packet(pkt_);
   av_packet_ref(pkt_, pkt);
+  demux_time_us_ = CurrentTimeUs();
 }
 
 RedAvPacket::RedAvPacket(AVPacket *pkt, int serial) : RedAvPacket(pkt) {
   serial_ = serial;
 }
 
+RedAvPacket::RedAvPacket(AVPacket *pkt, int serial, RedAvPacketPool *pkt_pool)
+    : serial_(serial), pkt_pool_(pkt_pool) {
+  pkt_ = pkt_pool_ ? pkt_pool_->alloc() : av_packet_alloc();
+  av_packet_move_ref(pkt_, pkt);
+  demux_time_us_ = CurrentTimeUs();
+}
+
 RedAvPacket::RedAvPacket(PktType type) : type_(type) {}
 
+RedAvPacket::RedAvPacket(PktType type, const sp<MetaData> &format)
+    : type_(type), format_(format) {}
+
 RedAvPacket::~RedAvPacket() {
-  if (pkt_) {
+  if (pkt_ && pkt_pool_) {
+    pkt_pool_->recycle(pkt_);
+    pkt_ = nullptr;
+  } else if (pkt_) {
     av_packet_free(&pkt_);
   }
 }
@@ -85,4 +107,102 @@ AVPacket *RedAvPacket::GetAVPacket() { return pkt_; }
 
 int RedAvPacket::GetSerial() { return serial_; }
 
+int64_t RedAvPacket::GetDemuxTime() { return demux_time_us_; }
+
+const sp<MetaData> &RedAvPacket::GetFormat() { return format_; }
+
+RedAvPacket *RedAvPacket::Clone(int serial, RedObjectPool *pool,
+                                RedAvPacketPool *pkt_pool) {
+  RedAvPacket *clone = new (pool) RedAvPacket(type_, format_);
+  clone->serial_ = serial;
+  if (pkt_) {
+    clone->pkt_pool_ = pkt_pool;
+    clone->pkt_ = pkt_pool ? pkt_pool->alloc() : av_packet_alloc();
+    av_packet_ref(clone->pkt_, pkt_);
+    clone->demux_time_us_ = CurrentTimeUs();
+  }
+  return clone;
+}
+
+RedAvPacketPool *RedAvPacketPool::create(const char *name, int max_cached) {
+  return new RedAvPacketPool(name, max_cached);
+}
+
+RedAvPacketPool::RedAvPacketPool(const char *name, int max_cached)
+    : mName(name), mMaxCached(max_cached) {}
+
+RedAvPacketPool::~RedAvPacketPool() {
+  for (AVPacket *pkt : mFree) {
+    av_packet_free(&pkt);
+  }
+  AV_LOGI(TAG, "%s destroyed, %s\n", mName.c_str(), toJson().c_str());
+}
+
+void RedAvPacketPool::release() { unref(); }
+
+void RedAvPacketPool::unref() {
+  if (mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete this;
+  }
+}
+
+AVPacket *RedAvPacketPool::alloc() {
+  AVPacket *pkt = nullptr;
+  {
+    std::unique_lock<std::mutex> lck(mLock);
+    if (!mFree.empty()) {
+      pkt = mFree.back();
+      mFree.pop_back();
+    }
+  }
+  if (pkt) {
+    mReuses.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    pkt = av_packet_alloc();
+    if (!pkt) {
+      throw std::bad_alloc();
+    }
+    mHeapAllocs.fetch_add(1, std::memory_order_relaxed);
+  }
+  mRefs.fetch_add(1, std::memory_order_relaxed);
+  int64_t in_use = mInUse.fetch_add(1, std::memory_order_relaxed) + 1;
+  int64_t peak = mPeakInUse.load(std::memory_order_relaxed);
+  while (in_use > peak && !mPeakInUse.compare_exchange_weak(
+                              peak, in_use, std::memory_order_relaxed)) {
+  }
+  return pkt;
+}
+
+void RedAvPacketPool::recycle(AVPacket *pkt) {
+  av_packet_unref(pkt);
+  mInUse.fetch_sub(1, std::memory_order_relaxed);
+  {
+    std::unique_lock<std::mutex> lck(mLock);
+    if (static_cast<int>(mFree.size()) < mMaxCached) {
+      mFree.push_back(pkt);
+      pkt = nullptr;
+    }
+  }
+  if (pkt) {
+    av_packet_free(&pkt);
+    mHeapFrees.fetch_add(1, std::memory_order_relaxed);
+  }
+  unref();
+}
+
+int64_t RedAvPacketPool::heapAllocs() const {
+  return mHeapAllocs.load(std::memory_order_relaxed);
+}
+
+std::string RedAvPacketPool::toJson() const {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "{\"heap_allocs\":%" PRId64 ",\"heap_frees\":%" PRId64
+           ",\"reuses\":%" PRId64 ",\"in_use\":%" PRId64
+           ",\"peak_in_use\":%" PRId64 "}",
+           mHeapAllocs.load(), mHeapFrees.load(), mReuses.load(),
+           mInUse.load(), mPeakInUse.load());
+  return buf;
+}
+
 REDPLAYER_NS_END;
@@ -1,6 +1,13 @@
 #pragma once
 
 #include "RedBase.h"
+#include "RedDef.h"
+#include "RedObjectPool.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #ifdef __cplusplus
 extern "C" {
@@ -81,11 +88,52 @@ enum HEVCNALUnitType {
 
 enum PktType { PKT_TYPE_DEFAULT = 0, PKT_TYPE_FLUSH = 1, PKT_TYPE_EOF = 2 };
 
-class RedAvPacket {
+/*keeps blank AVPackets from av_packet_alloc for reuse, the struct layout is
+ * libavcodec's business so they are never carved from a RedObjectPool.
+ * reference counted by the owner and every packet taken out, like
+ * RedObjectPool*/
+class RedAvPacketPool {
+public:
+  static RedAvPacketPool *create(const char *name, int max_cached);
+  /*drops the owner reference*/
+  void release();
+
+  /*a blank packet, throws std::bad_alloc like RedObjectPool*/
+  AVPacket *alloc();
+  /*unrefs pkt and keeps it, or frees it when enough are kept*/
+  void recycle(AVPacket *pkt);
+
+  int64_t heapAllocs() const;
+  std::string toJson() const;
+
+private:
+  RedAvPacketPool(const char *name, int max_cached);
+  ~RedAvPacketPool();
+  void unref();
+
+  std::string mName;
+  int mMaxCached{0};
+  std::mutex mLock;
+  std::vector<AVPacket *> mFree;
+  std::atomic<int> mRefs{1};
+
+  std::atomic<int64_t> mHeapAllocs{0};
+  std::atomic<int64_t> mHeapFrees{0};
+  std::atomic<int64_t> mReuses{0};
+  std::atomic<int64_t> mInUse{0};
+  std::atomic<int64_t> mPeakInUse{0};
+};
+
+class RedAvPacket : public RedPooledObject {
 public:
   explicit RedAvPacket(AVPacket *pkt);
   explicit RedAvPacket(AVPacket *pkt, int serial);
+  /*takes over the references of pkt and leaves it blank, the AVPacket
+   * struct itself comes from pkt_pool*/
+  RedAvPacket(AVPacket *pkt, int serial, RedAvPacketPool *pkt_pool);
   explicit RedAvPacket(PktType type);
+  /*a flush that also moves the decoders to the stream format in format*/
+  RedAvPacket(PktType type, const sp<MetaData> &format);
   ~RedAvPacket();
   bool IsFlushPacket();
   bool IsEofPacket();
@@ -94,6 +142,11 @@ public:
   bool IsKeyOrIdrPacket(bool is_idr, bool is_hevc);
   AVPacket *GetAVPacket();
   int GetSerial();
+  int64_t GetDemuxTime();
+  const sp<MetaData> &GetFormat();
+  /*a new packet sharing the data of this one, stamped with serial*/
+  RedAvPacket *Clone(int serial, RedObjectPool *pool,
+                     RedAvPacketPool *pkt_pool);
   RedAvPacket(const RedAvPacket &) = delete;
   RedAvPacket &operator=(const RedAvPacket &) = delete;
   RedAvPacket(RedAvPacket &&) = delete;
@@ -103,6 +156,9 @@ private:
   AVPacket *pkt_{nullptr};
   int serial_{0};
   PktType type_{PKT_TYPE_DEFAULT};
+  int64_t demux_time_us_{0};
+  RedAvPacketPool *pkt_pool_{nullptr}; // where pkt_ goes back to
+  sp<MetaData> format_;
 };
 
 REDPLAYER_NS_END;
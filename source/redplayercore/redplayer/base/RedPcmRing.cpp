@@ -0,0 +1,85 @@
+#include "RedPcmRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+REDPLAYER_NS_BEGIN;
+
+bool RedPcmRing::init(int capacity, int max_chunks) {
+  if (capacity <= 0 || max_chunks <= 0) {
+    return false;
+  }
+  mBytes.assign(capacity, 0);
+  mChunks.assign(max_chunks, PcmChunkInfo());
+  mWritePos.store(0);
+  mReadPos.store(0);
+  mChunkTail.store(0);
+  mChunkHead.store(0);
+  mChunkOffset = 0;
+  return true;
+}
+
+int RedPcmRing::capacity() const { return static_cast<int>(mBytes.size()); }
+
+bool RedPcmRing::write(const uint8_t *data, const PcmChunkInfo &info) {
+  uint64_t tail = mChunkTail.load(std::memory_order_relaxed);
+  uint64_t write_pos = mWritePos.load(std::memory_order_relaxed);
+  if (!data || info.size <= 0 ||
+      tail - mChunkHead.load(std::memory_order_acquire) >= mChunks.size() ||
+      write_pos - mReadPos.load(std::memory_order_acquire) + info.size >
+          mBytes.size()) {
+    return false;
+  }
+  size_t start = write_pos % mBytes.size();
+  size_t first =
+      std::min(mBytes.size() - start, static_cast<size_t>(info.size));
+  memcpy(mBytes.data() + start, data, first);
+  memcpy(mBytes.data(), data + first, info.size - first);
+  mChunks[tail % mChunks.size()] = info;
+  mWritePos.store(write_pos + info.size, std::memory_order_relaxed);
+  mChunkTail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+bool RedPcmRing::peek(PcmChunkInfo &info, int &offset) const {
+  uint64_t head = mChunkHead.load(std::memory_order_relaxed);
+  if (head == mChunkTail.load(std::memory_order_acquire)) {
+    return false;
+  }
+  info = mChunks[head % mChunks.size()];
+  offset = mChunkOffset;
+  return true;
+}
+
+int RedPcmRing::read(uint8_t *out, int size) {
+  PcmChunkInfo info;
+  int offset = 0;
+  if (size <= 0 || !peek(info, offset)) {
+    return 0;
+  }
+  int len = std::min(size, info.size - offset);
+  uint64_t read_pos = mReadPos.load(std::memory_order_relaxed);
+  if (out) {
+    size_t start = read_pos % mBytes.size();
+    size_t first = std::min(mBytes.size() - start, static_cast<size_t>(len));
+    memcpy(out, mBytes.data() + start, first);
+    memcpy(out + first, mBytes.data(), len - first);
+  }
+  mReadPos.store(read_pos + len, std::memory_order_release);
+  mChunkOffset += len;
+  if (mChunkOffset == info.size) {
+    mChunkOffset = 0;
+    mChunkHead.fetch_add(1, std::memory_order_release);
+  }
+  return len;
+}
+
+void RedPcmRing::skipChunk() {
+  PcmChunkInfo info;
+  int offset = 0;
+  if (peek(info, offset)) {
+    read(nullptr, info.size - offset);
+  }
+}
+
+REDPLAYER_NS_END;
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "RedBase.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+REDPLAYER_NS_BEGIN;
+
+/*where a run of pcm in the ring came from, pts in ms of its first byte*/
+struct PcmChunkInfo {
+  double pts{0};
+  int serial{-1};
+  int bytes_per_sec{0};
+  int size{0};
+};
+
+/*single producer single consumer pcm ring. bytes and chunk descriptors live
+ * in two rings whose positions only grow, each side owns one of them, so
+ * neither write nor read takes a lock or makes a syscall*/
+class RedPcmRing {
+public:
+  bool init(int capacity, int max_chunks);
+  int capacity() const;
+
+  /*producer side, copies all of data or nothing*/
+  bool write(const uint8_t *data, const PcmChunkInfo &info);
+
+  /*consumer side. peek describes the oldest chunk and how much of it was
+   * already read; read copies up to size bytes of that chunk only, out may be
+   * null to drop them*/
+  bool peek(PcmChunkInfo &info, int &offset) const;
+  int read(uint8_t *out, int size);
+  void skipChunk();
+
+private:
+  std::vector<uint8_t> mBytes;
+  std::vector<PcmChunkInfo> mChunks;
+  std::atomic<uint64_t> mWritePos{0};
+  std::atomic<uint64_t> mReadPos{0};
+  std::atomic<uint64_t> mChunkTail{0};
+  std::atomic<uint64_t> mChunkHead{0};
+  int mChunkOffset{0};
+};
+
+REDPLAYER_NS_END;
@@ -0,0 +1,241 @@
+#include "RedPipelineStats.h"
+
+#include <inttypes.h>
+
+#include <cmath>
+#include <cstdio>
+
+REDPLAYER_NS_BEGIN;
+
+static const char *kStageNames[STAGE_COUNT] = {
+    "video_packet_wait",    "video_decode",      "video_frame_wait",
+    "video_sync_wait",      "video_render",      "video_end_to_end",
+    "video_present_jitter", "audio_packet_wait", "audio_decode",
+    "audio_frame_wait",     "audio_callback",    "demux_refill"};
+
+LatencyHistogram::LatencyHistogram() { reset(); }
+
+int LatencyHistogram::bucketIndex(int64_t us) {
+  if (us < kSubBuckets) {
+    return static_cast<int>(us);
+  }
+  int exp = 63 - __builtin_clzll(static_cast<uint64_t>(us));
+  int sub = static_cast<int>(us >> (exp - kSubBits)) & (kSubBuckets - 1);
+  return (exp - kSubBits + 1) * kSubBuckets + sub;
+}
+
+int64_t LatencyHistogram::bucketUpperBound(int index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  int shift = index / kSubBuckets - 1;
+  int64_t lower = static_cast<int64_t>(kSubBuckets + index % kSubBuckets)
+                  << shift;
+  return lower + (static_cast<int64_t>(1) << shift) - 1;
+}
+
+void LatencyHistogram::add(int64_t us) {
+  if (us < 0) {
+    us = 0;
+  }
+  mBuckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+  mCount.fetch_add(1, std::memory_order_relaxed);
+  mSum.fetch_add(us, std::memory_order_relaxed);
+  int64_t prev = mMax.load(std::memory_order_relaxed);
+  while (us > prev &&
+         !mMax.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::reset() {
+  for (int i = 0; i < kBucketCount; i++) {
+    mBuckets[i].store(0, std::memory_order_relaxed);
+  }
+  mCount.store(0, std::memory_order_relaxed);
+  mSum.store(0, std::memory_order_relaxed);
+  mMax.store(0, std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::count() const {
+  return mCount.load(std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::max() const {
+  return mMax.load(std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::mean() const {
+  int64_t count = mCount.load(std::memory_order_relaxed);
+  return count > 0 ? mSum.load(std::memory_order_relaxed) / count : 0;
+}
+
+int64_t LatencyHistogram::percentile(double p) const {
+  int64_t total = 0;
+  int64_t buckets[kBucketCount];
+  for (int i = 0; i < kBucketCount; i++) {
+    buckets[i] = mBuckets[i].load(std::memory_order_relaxed);
+    total += buckets[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  int64_t target = static_cast<int64_t>(std::ceil(p / 100.0 * total));
+  if (target < 1) {
+    target = 1;
+  }
+  int64_t seen = 0;
+  for (int i = 0; i < kBucketCount; i++) {
+    seen += buckets[i];
+    if (seen >= target) {
+      int64_t bound = bucketUpperBound(i);
+      int64_t max_us = max();
+      return bound < max_us ? bound : max_us;
+    }
+  }
+  return max();
+}
+
+std::string LatencyHistogram::toJson() const {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "{\"count\":%" PRId64 ",\"mean_us\":%" PRId64 ",\"p50_us\":%" PRId64
+           ",\"p90_us\":%" PRId64 ",\"p99_us\":%" PRId64 ",\"max_us\":%" PRId64
+           "}",
+           count(), mean(), percentile(50), percentile(90), percentile(99),
+           max());
+  return buf;
+}
+
+void PipelineStats::setEnabled(bool enabled) { mEnabled.store(enabled); }
+
+bool PipelineStats::enabled() const {
+  return mEnabled.load(std::memory_order_relaxed);
+}
+
+void PipelineStats::reset() {
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    mStages[i].reset();
+  }
+  mSeek.reset();
+  mSeekInBuffer.reset();
+  mSeekReload.reset();
+  mSeekHits = 0;
+  mSeekMisses = 0;
+  mPrepareStartUs = 0;
+  mFirstFrameUs = 0;
+  mRenderedFrames = 0;
+  mDroppedEarly = 0;
+  mDroppedLate = 0;
+  mDemuxWakeups = 0;
+}
+
+void PipelineStats::record(PipelineStage stage, int64_t us) {
+  if (!enabled() || stage < 0 || stage >= STAGE_COUNT) {
+    return;
+  }
+  mStages[stage].add(us);
+}
+
+void PipelineStats::recordSince(PipelineStage stage, int64_t start_us) {
+  if (!enabled() || start_us <= 0) {
+    return;
+  }
+  record(stage, CurrentTimeUs() - start_us);
+}
+
+void PipelineStats::recordSeek(int64_t us, bool in_buffer) {
+  if (!enabled()) {
+    return;
+  }
+  mSeek.add(us);
+  if (in_buffer) {
+    mSeekInBuffer.add(us);
+  } else {
+    mSeekReload.add(us);
+  }
+}
+
+void PipelineStats::countSeek(bool in_buffer) {
+  if (!enabled()) {
+    return;
+  }
+  if (in_buffer) {
+    mSeekHits.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    mSeekMisses.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void PipelineStats::markPrepareStart() {
+  mPrepareStartUs = CurrentTimeUs();
+  mFirstFrameUs = 0;
+}
+
+void PipelineStats::markFirstFrame() {
+  int64_t expected = 0;
+  mFirstFrameUs.compare_exchange_strong(expected, CurrentTimeUs());
+}
+
+void PipelineStats::countRenderedFrame() {
+  if (enabled()) {
+    mRenderedFrames.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void PipelineStats::countDroppedFrame(bool late) {
+  if (!enabled()) {
+    return;
+  }
+  if (late) {
+    mDroppedLate.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    mDroppedEarly.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void PipelineStats::countDemuxWakeup() {
+  if (enabled()) {
+    mDemuxWakeups.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+const char *PipelineStats::stageName(PipelineStage stage) {
+  if (stage < 0 || stage >= STAGE_COUNT) {
+    return "unknown";
+  }
+  return kStageNames[stage];
+}
+
+std::string PipelineStats::toJson() const {
+  int64_t prepare_start = mPrepareStartUs.load();
+  int64_t first_frame = mFirstFrameUs.load();
+  int64_t ttff_us =
+      (prepare_start > 0 && first_frame > 0) ? first_frame - prepare_start : -1;
+  char buf[384];
+  snprintf(buf, sizeof(buf),
+           "{\"enabled\":%s,\"time_to_first_frame_us\":%" PRId64
+           ",\"rendered_frames\":%" PRId64 ",\"dropped_frames_early\":%" PRId64
+           ",\"dropped_frames_late\":%" PRId64
+           ",\"seek_buffer_hits\":%" PRId64 ",\"seek_buffer_misses\":%" PRId64
+           ",\"demux_full_wakeups\":%" PRId64 ",",
+           enabled() ? "true" : "false", ttff_us, mRenderedFrames.load(),
+           mDroppedEarly.load(), mDroppedLate.load(), mSeekHits.load(),
+           mSeekMisses.load(), mDemuxWakeups.load());
+  std::string json = buf;
+  json += "\"seek_to_frame\":" + mSeek.toJson();
+  json += ",\"seek_in_buffer_to_frame\":" + mSeekInBuffer.toJson();
+  json += ",\"seek_reload_to_frame\":" + mSeekReload.toJson();
+  json += ",\"stages\":{";
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    if (i > 0) {
+      json += ",";
+    }
+    json += "\"";
+    json += kStageNames[i];
+    json += "\":" + mStages[i].toJson();
+  }
+  json += "}}";
+  return json;
+}
+
+REDPLAYER_NS_END;
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "RedBase.h"
+
+#include <atomic>
+#include <string>
+
+REDPLAYER_NS_BEGIN;
+
+enum PipelineStage {
+  STAGE_VIDEO_PACKET_WAIT = 0, // demuxed -> taken by the video decoder
+  STAGE_VIDEO_DECODE,          // time spent in one decode call
+  STAGE_VIDEO_FRAME_WAIT,      // decoded -> taken by the render thread
+  STAGE_VIDEO_SYNC_WAIT,       // taken -> presented, a/v sync pacing
+  STAGE_VIDEO_RENDER,          // time spent in one render call
+  STAGE_VIDEO_END_TO_END,      // demuxed -> presented
+  STAGE_VIDEO_PRESENT_JITTER,  // |presented - frame deadline|
+  STAGE_AUDIO_PACKET_WAIT,
+  STAGE_AUDIO_DECODE,
+  STAGE_AUDIO_FRAME_WAIT, // decoded -> pulled by the audio render
+  STAGE_AUDIO_CALLBACK,   // time spent in one device callback
+  STAGE_DEMUX_REFILL,     // buffer below its low water -> demuxer reading
+  STAGE_COUNT
+};
+
+/*log-linear histogram of microsecond latencies, 8 sub buckets per power of
+ * two keep the percentile error below 12.5%. add() is lock free and may be
+ * called from any thread*/
+class LatencyHistogram {
+public:
+  LatencyHistogram();
+  ~LatencyHistogram() = default;
+  void add(int64_t us);
+  void reset();
+  int64_t count() const;
+  int64_t max() const;
+  int64_t mean() const;
+  /*upper bound of the bucket holding the p-th percentile, p in [0, 100]*/
+  int64_t percentile(double p) const;
+  std::string toJson() const;
+
+private:
+  static const int kSubBits = 3;
+  static const int kSubBuckets = 1 << kSubBits;
+  static const int kBucketCount = (64 - kSubBits) * kSubBuckets;
+  static int bucketIndex(int64_t us);
+  static int64_t bucketUpperBound(int index);
+
+  std::atomic<int64_t> mBuckets[kBucketCount];
+  std::atomic<int64_t> mCount{0};
+  std::atomic<int64_t> mSum{0};
+  std::atomic<int64_t> mMax{0};
+};
+
+/*per player latency breakdown of the demux -> decode -> present pipeline,
+ * recorded only while enabled by the "pipeline-stats" option*/
+class PipelineStats {
+public:
+  PipelineStats() = default;
+  ~PipelineStats() = default;
+  void setEnabled(bool enabled);
+  bool enabled() const;
+  void reset();
+
+  void record(PipelineStage stage, int64_t us);
+  void recordSince(PipelineStage stage, int64_t start_us);
+  /*in_buffer: served from the packet back buffer without a demuxer seek*/
+  void recordSeek(int64_t us, bool in_buffer);
+  void countSeek(bool in_buffer);
+  void markPrepareStart();
+  void markFirstFrame();
+  void countRenderedFrame();
+  void countDroppedFrame(bool late);
+  /*the read thread woke up while the packet buffer was full*/
+  void countDemuxWakeup();
+
+  std::string toJson() const;
+  static const char *stageName(PipelineStage stage);
+
+private:
+  std::atomic<bool> mEnabled{false};
+  LatencyHistogram mStages[STAGE_COUNT];
+  LatencyHistogram mSeek;
+  LatencyHistogram mSeekInBuffer;
+  LatencyHistogram mSeekReload;
+  std::atomic<int64_t> mSeekHits{0};
+  std::atomic<int64_t> mSeekMisses{0};
+  std::atomic<int64_t> mPrepareStartUs{0};
+  std::atomic<int64_t> mFirstFrameUs{0};
+  std::atomic<int64_t> mRenderedFrames{0};
+  std::atomic<int64_t> mDroppedEarly{0};
+  std::atomic<int64_t> mDroppedLate{0};
+  std::atomic<int64_t> mDemuxWakeups{0};
+};
+
+REDPLAYER_NS_END;
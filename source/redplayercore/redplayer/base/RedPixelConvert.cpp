@@ -0,0 +1,259 @@
+#include "RedPixelConvert.h"
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include "libavutil/common.h"
+#include "libavutil/pixfmt.h"
+}
+
+#define FRAME_ALIGN 64
+#define FRAME_PADDING 64 // renderers may read a vector past the last pixel
+#define SAMPLE_MAX_10BIT 1020 // the largest sample the dither keeps in 8 bits
+
+#define PIXEL_INLINE static inline __attribute__((always_inline))
+
+typedef uint16_t u16x8 __attribute__((vector_size(16)));
+typedef uint8_t u8x8 __attribute__((vector_size(8)));
+
+#if defined(__x86_64__)
+#define PIXEL_CONVERT_AVX2 1
+typedef uint16_t u16x16 __attribute__((vector_size(32)));
+typedef uint8_t u8x16 __attribute__((vector_size(16)));
+#endif
+
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+typedef size_t PoolBufferSize;
+#else
+typedef int PoolBufferSize;
+#endif
+
+REDPLAYER_NS_BEGIN;
+
+namespace {
+
+// ordered dither, each 2x2 block adds 0..3 once, so the mean of a flat area
+// is kept exactly
+const uint16_t kDither[2][2] = {{0, 2}, {3, 1}};
+
+PIXEL_INLINE void convertRowScalar(const uint16_t *src, uint8_t *dst, int x,
+                                   int width, const uint16_t *dither) {
+  for (; x < width; x++) {
+    uint16_t v = src[x] < SAMPLE_MAX_10BIT ? src[x] : SAMPLE_MAX_10BIT;
+    dst[x] = static_cast<uint8_t>((v + dither[x & 1]) >> 2);
+  }
+}
+
+/*V16 holds the 10 bit samples, V8 the same number of 8 bit ones. Only takes
+ * pointers, so no wide vector crosses a call not compiled for it*/
+template <typename V16, typename V8>
+PIXEL_INLINE void convertPlaneKernel(const uint8_t *src, int src_stride,
+                                     uint8_t *dst, int dst_stride, int width,
+                                     int height) {
+  constexpr int lanes = sizeof(V16) / sizeof(uint16_t);
+  const V16 max_in = V16{} + SAMPLE_MAX_10BIT;
+  for (int y = 0; y < height; y++) {
+    const uint16_t *s = reinterpret_cast<const uint16_t *>(
+        src + static_cast<ptrdiff_t>(y) * src_stride);
+    uint8_t *d = dst + static_cast<ptrdiff_t>(y) * dst_stride;
+    const uint16_t *row_dither = kDither[y & 1];
+    V16 dither;
+    for (int i = 0; i < lanes; i++) {
+      dither[i] = row_dither[i & 1];
+    }
+    int x = 0;
+    for (; x + lanes <= width; x += lanes) {
+      V16 v;
+      memcpy(&v, s + x, sizeof(v));
+      V16 over = (V16)(v > max_in);
+      v = (v & ~over) | (max_in & over);
+      V8 out = __builtin_convertvector((v + dither) >> 2, V8);
+      memcpy(d + x, &out, sizeof(out));
+    }
+    convertRowScalar(s, d, x, width, row_dither);
+  }
+}
+
+void convertPlaneScalar(const uint8_t *src, int src_stride, uint8_t *dst,
+                        int dst_stride, int width, int height) {
+  for (int y = 0; y < height; y++) {
+    convertRowScalar(reinterpret_cast<const uint16_t *>(
+                         src + static_cast<ptrdiff_t>(y) * src_stride),
+                     dst + static_cast<ptrdiff_t>(y) * dst_stride, 0, width,
+                     kDither[y & 1]);
+  }
+}
+
+void convertPlane128(const uint8_t *src, int src_stride, uint8_t *dst,
+                     int dst_stride, int width, int height) {
+  convertPlaneKernel<u16x8, u8x8>(src, src_stride, dst, dst_stride, width,
+                                  height);
+}
+
+#ifdef PIXEL_CONVERT_AVX2
+__attribute__((target("avx2"))) void
+convertPlane256(const uint8_t *src, int src_stride, uint8_t *dst,
+                int dst_stride, int width, int height) {
+  convertPlaneKernel<u16x16, u8x16>(src, src_stride, dst, dst_stride, width,
+                                    height);
+}
+#endif
+
+AVBufferRef *allocBuffer(void *opaque, PoolBufferSize size) {
+  static_cast<std::atomic<int64_t> *>(opaque)->fetch_add(1);
+  return av_buffer_alloc(size);
+}
+
+} // namespace
+
+bool pixelConvertBackendSupported(int backend) {
+  switch (backend) {
+  case PIXEL_CONVERT_SCALAR:
+  case PIXEL_CONVERT_SIMD128:
+    return true;
+  case PIXEL_CONVERT_SIMD256:
+#ifdef PIXEL_CONVERT_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+  default:
+    return false;
+  }
+}
+
+int pixelConvertBestBackend() {
+  static const int best = pixelConvertBackendSupported(PIXEL_CONVERT_SIMD256)
+                              ? PIXEL_CONVERT_SIMD256
+                              : PIXEL_CONVERT_SIMD128;
+  return best;
+}
+
+void convertPlane10To8(int backend, const uint8_t *src, int src_stride,
+                       uint8_t *dst, int dst_stride, int width, int height) {
+  switch (backend) {
+  case PIXEL_CONVERT_SCALAR:
+    convertPlaneScalar(src, src_stride, dst, dst_stride, width, height);
+    return;
+#ifdef PIXEL_CONVERT_AVX2
+  case PIXEL_CONVERT_SIMD256:
+    if (pixelConvertBestBackend() == PIXEL_CONVERT_SIMD256) {
+      convertPlane256(src, src_stride, dst, dst_stride, width, height);
+      return;
+    }
+    break;
+#endif
+  default:
+    break;
+  }
+  convertPlane128(src, src_stride, dst, dst_stride, width, height);
+}
+
+PixelConverter::PixelConverter() : mBackend(pixelConvertBestBackend()) {}
+
+PixelConverter::~PixelConverter() {
+  // buffers still held by frames free the pool when they come back
+  av_buffer_pool_uninit(&mPool);
+}
+
+void PixelConverter::setBackend(int backend) {
+  std::lock_guard<std::mutex> lck(mLock);
+  mBackend = pixelConvertBackendSupported(backend) ? backend
+                                                   : pixelConvertBestBackend();
+}
+
+AVFrame *PixelConverter::convert(const AVFrame *src) {
+  if (!src || src->format != AV_PIX_FMT_YUV420P10LE || src->width <= 0 ||
+      src->height <= 0) {
+    return nullptr;
+  }
+  int width = src->width;
+  int height = src->height;
+  int chroma_width = (width + 1) >> 1;
+  int chroma_height = (height + 1) >> 1;
+  int luma_stride = FFALIGN(width, FRAME_ALIGN);
+  int chroma_stride = FFALIGN(chroma_width, FRAME_ALIGN);
+  size_t luma_size = static_cast<size_t>(luma_stride) * height;
+  size_t chroma_size = static_cast<size_t>(chroma_stride) * chroma_height;
+  size_t size = luma_size + 2 * chroma_size + FRAME_PADDING;
+
+  AVBufferRef *buf = nullptr;
+  int backend = PIXEL_CONVERT_SCALAR;
+  {
+    std::lock_guard<std::mutex> lck(mLock);
+    if (!mPool || mPoolSize != size) {
+      av_buffer_pool_uninit(&mPool);
+      mPool = av_buffer_pool_init2(static_cast<PoolBufferSize>(size),
+                                   &mBufferAllocs, allocBuffer, nullptr);
+      mPoolSize = mPool ? size : 0;
+    }
+    buf = mPool ? av_buffer_pool_get(mPool) : nullptr;
+    backend = mBackend;
+  }
+  AVFrame *dst = buf ? av_frame_alloc() : nullptr;
+  if (!dst) {
+    av_buffer_unref(&buf);
+    return nullptr;
+  }
+  dst->buf[0] = buf;
+  dst->format = AV_PIX_FMT_YUV420P;
+  dst->width = width;
+  dst->height = height;
+  dst->data[0] = buf->data;
+  dst->data[1] = buf->data + luma_size;
+  dst->data[2] = buf->data + luma_size + chroma_size;
+  dst->linesize[0] = luma_stride;
+  dst->linesize[1] = chroma_stride;
+  dst->linesize[2] = chroma_stride;
+  av_frame_copy_props(dst, src);
+
+  convertPlane10To8(backend, src->data[0], src->linesize[0], dst->data[0],
+                    dst->linesize[0], width, height);
+  convertPlane10To8(backend, src->data[1], src->linesize[1], dst->data[1],
+                    dst->linesize[1], chroma_width, chroma_height);
+  convertPlane10To8(backend, src->data[2], src->linesize[2], dst->data[2],
+                    dst->linesize[2], chroma_width, chroma_height);
+  mConverted++;
+  return dst;
+}
+
+RED_ERR PixelConverter::convertBuffer(CGlobalBuffer &buffer) {
+  auto ctx = reinterpret_cast<CGlobalBuffer::FFmpegBufferContext *>(
+      buffer.opaque);
+  if (buffer.pixel_format != CGlobalBuffer::kYUV420P10LE || !ctx) {
+    return ME_ERROR;
+  }
+  AVFrame *src_frame = reinterpret_cast<AVFrame *>(ctx->av_frame);
+  AVFrame *dst_frame = convert(src_frame);
+  if (!dst_frame) {
+    return ME_ERROR;
+  }
+  buffer.pixel_format = CGlobalBuffer::kYUV420;
+  buffer.width = dst_frame->width;
+  buffer.height = dst_frame->height;
+  buffer.yStride = dst_frame->linesize[0];
+  buffer.uStride = dst_frame->linesize[1];
+  buffer.vStride = dst_frame->linesize[2];
+  buffer.yBuffer = dst_frame->data[0];
+  buffer.uBuffer = dst_frame->data[1];
+  buffer.vBuffer = dst_frame->data[2];
+  ctx->av_frame = reinterpret_cast<void *>(dst_frame);
+
+  av_frame_unref(src_frame);
+  av_frame_free(&src_frame);
+  return OK;
+}
+
+std::string PixelConverter::toJson() const {
+  char buf[128];
+  snprintf(buf, sizeof(buf),
+           "{\"backend\":%d,\"converted\":%" PRId64
+           ",\"buffer_allocs\":%" PRId64 "}",
+           mBackend, mConverted.load(), mBufferAllocs.load());
+  return buf;
+}
+
+REDPLAYER_NS_END;
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "RedBase.h"
+#include "RedBuffer.h"
+#include "RedError.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+extern "C" {
+#include "libavutil/buffer.h"
+#include "libavutil/frame.h"
+}
+
+REDPLAYER_NS_BEGIN;
+
+enum {
+  PIXEL_CONVERT_SCALAR = 0,
+  PIXEL_CONVERT_SIMD128, // sse2 on x86_64, neon on arm
+  PIXEL_CONVERT_SIMD256, // avx2, x86_64 only
+};
+
+/*the widest backend this cpu runs*/
+int pixelConvertBestBackend();
+bool pixelConvertBackendSupported(int backend);
+
+/*one plane of 10 bit samples to 8 bit. Samples are rounded with a 2x2
+ * ordered dither, which keeps the mean and breaks up the banding plain
+ * truncation leaves in gradients. Strides are in bytes*/
+void convertPlane10To8(int backend, const uint8_t *src, int src_stride,
+                       uint8_t *dst, int dst_stride, int width, int height);
+
+/*yuv420p10le frames to yuv420p frames. All planes of a frame share one
+ * buffer from an AVBufferPool, freeing the frame hands it back, so steady
+ * playback allocates no picture memory. Safe to call from any thread*/
+class PixelConverter {
+public:
+  PixelConverter();
+  ~PixelConverter();
+  PixelConverter(const PixelConverter &) = delete;
+  PixelConverter &operator=(const PixelConverter &) = delete;
+
+  /*a new frame with the props of src, nullptr on failure*/
+  AVFrame *convert(const AVFrame *src);
+  /*swaps the frame of a software decoded yuv420p10le buffer for a converted
+   * one, the buffer is left as it was on failure*/
+  RED_ERR convertBuffer(CGlobalBuffer &buffer);
+  void setBackend(int backend);
+  int64_t bufferAllocs() const { return mBufferAllocs.load(); }
+  std::string toJson() const;
+
+private:
+  std::mutex mLock;
+  AVBufferPool *mPool{nullptr};
+  size_t mPoolSize{0};
+  int mBackend{PIXEL_CONVERT_SCALAR};
+  std::atomic<int64_t> mConverted{0};
+  std::atomic<int64_t> mBufferAllocs{0};
+};
+
+REDPLAYER_NS_END;
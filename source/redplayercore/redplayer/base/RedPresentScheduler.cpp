@@ -0,0 +1,48 @@
+#include "RedPresentScheduler.h"
+
+#include <cmath>
+
+#define PRESENT_SLEW 0.02
+#define PRESENT_RESYNC_THRESHOLD 0.04
+#define PRESENT_REBASE_THRESHOLD 0.1
+#define MAX_FRAME_DURATION 10.0
+
+REDPLAYER_NS_BEGIN;
+
+void PresentScheduler::reset() { mValid = false; }
+
+double PresentScheduler::schedule(int serial, double pts, double master,
+                                  double now, double rate) {
+  // the anchor is the last frame, a new rate only scales what follows it
+  mRate = rate > 0 ? rate : 1.0;
+  if (!mValid || serial != mSerial ||
+      std::abs(pts - mPts) > MAX_FRAME_DURATION) {
+    mValid = true;
+    mSerial = serial;
+    mPts = pts;
+    mTime = now;
+  }
+  if (!std::isnan(master)) {
+    double error = now + (pts - master) / mRate - deadline(pts);
+    if (std::abs(error) > PRESENT_RESYNC_THRESHOLD) {
+      mTime += error;
+    } else {
+      mTime += error * PRESENT_SLEW;
+    }
+  }
+  return deadline(pts);
+}
+
+double PresentScheduler::deadline(double pts) const {
+  return mTime + (pts - mPts) / mRate;
+}
+
+void PresentScheduler::advance(double pts, double now) {
+  mTime = deadline(pts);
+  mPts = pts;
+  if (now - mTime > PRESENT_REBASE_THRESHOLD) {
+    mTime = now;
+  }
+}
+
+REDPLAYER_NS_END;
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "RedBase.h"
+
+REDPLAYER_NS_BEGIN;
+
+/*turns video pts into wall clock deadlines. Deadlines advance from the last
+ * frame by pts distance over the playback rate and are pulled towards the
+ * master clock: small errors are slewed out, large ones re-anchor at once.
+ * All times are seconds passed in by the caller, so it can run on a
+ * synthetic clock*/
+class PresentScheduler {
+public:
+  PresentScheduler() = default;
+  ~PresentScheduler() = default;
+  void reset();
+
+  /*deadline of the next frame. master is the master clock read at now, NAN
+   * when video is master or the master clock is not running*/
+  double schedule(int serial, double pts, double master, double now,
+                  double rate);
+  /*deadline of a later frame of the same serial, valid after schedule()*/
+  double deadline(double pts) const;
+  /*the frame with pts was presented at now, later frames follow from it.
+   * Presenting far behind its deadline restarts the timeline at now*/
+  void advance(double pts, double now);
+
+private:
+  bool mValid{false};
+  int mSerial{0};
+  double mPts{0.0};
+  double mTime{0.0};
+  double mRate{1.0};
+};
+
+REDPLAYER_NS_END;
@@ -11,6 +11,8 @@
 #include <algorithm>
 
 #define TAG "RedQueue"
+#define PACKET_POOL_MAX_CACHED 4096
+#define BUFFER_POOL_MAX_CACHED 256
 
 REDPLAYER_NS_BEGIN;
 
@@ -35,24 +37,76 @@ void CRedThreadBase::run() {
   }
 }
 
+PlayerPools::PlayerPools() {
+  size_t context_size =
+      std::max({sizeof(CGlobalBuffer::MediaCodecBufferContext),
+                sizeof(CGlobalBuffer::HarmonyMediaBufferContext),
+                sizeof(CGlobalBuffer::FFmpegBufferContext),
+                sizeof(CGlobalBuffer::VideoToolBufferContext)});
+  packets = RedObjectPool::create("packets", sizeof(RedAvPacket),
+                                  PACKET_POOL_MAX_CACHED);
+  av_packets = RedAvPacketPool::create("av_packets", PACKET_POOL_MAX_CACHED);
+  buffers = RedObjectPool::create("buffers", sizeof(CGlobalBuffer),
+                                  BUFFER_POOL_MAX_CACHED);
+  buffer_contexts = RedObjectPool::create("buffer_contexts", context_size,
+                                          BUFFER_POOL_MAX_CACHED);
+}
+
+PlayerPools::~PlayerPools() {
+  packets->release();
+  av_packets->release();
+  buffers->release();
+  buffer_contexts->release();
+}
+
+std::string PlayerPools::toJson() const {
+  return "{\"packets\":" + packets->toJson() +
+         ",\"av_packets\":" + av_packets->toJson() +
+         ",\"buffers\":" + buffers->toJson() +
+         ",\"buffer_contexts\":" + buffer_contexts->toJson() +
+         ",\"pixel_converter\":" + pixel_converter.toJson() + "}";
+}
+
 PktQueue::PktQueue(int type) /*: mType(type)*/ {}
 
+static inline int64_t pktDuration(AVPacket *packet) {
+  return packet ? std::max(packet->duration, (int64_t)MIN_PKT_DURATION) : 0;
+}
+
 RED_ERR PktQueue::putPkt(std::unique_ptr<RedAvPacket> &pkt) {
   std::unique_lock<std::mutex> lck(mLock);
   AVPacket *packet = pkt ? pkt->GetAVPacket() : nullptr;
   mBytes += packet ? packet->size : 0;
-  mDuration +=
-      packet ? std::max(packet->duration, (int64_t)MIN_PKT_DURATION) : 0;
-  mPktQueue.push(std::move(pkt));
+  mDuration += pktDuration(packet);
+  if (pkt && pkt->GetFormat()) {
+    // the decoders can not go back to keyframes of the format before
+    mKeyIndex.clear();
+  }
+  if (mBackBufferUs > 0 && packet) {
+    int64_t pts_us = ptsUs(pkt.get());
+    if (pts_us != AV_NOPTS_VALUE) {
+      if (pkt->IsKeyPacket()) {
+        // timestamps went back, older keyframes can not be found by pts
+        if (!mKeyIndex.empty() && pts_us <= mKeyIndex.back().pts_us) {
+          mKeyIndex.clear();
+        }
+        mKeyIndex.push_back({pts_us, mBaseSeq + mPktQueue.size()});
+      }
+      mEndPtsUs = pts_us + av_rescale_q(packet->duration, mTimeBase,
+                                        AV_TIME_BASE_Q);
+    }
+  }
+  mPktQueue.push_back(std::move(pkt));
   mNotEmptyCond.notify_one();
   return OK;
 }
 
 RED_ERR PktQueue::getPkt(std::unique_ptr<RedAvPacket> &pkt, bool block) {
   std::unique_lock<std::mutex> lck(mLock);
-  if (mPktQueue.empty() && !block)
+  bool empty = mReadPos >= mPktQueue.size() && mPendingFlushes == 0;
+  if (empty && !block)
     return ME_RETRY;
-  while (mPktQueue.empty() && block) {
+  while (empty && block) {
     if (mAbort) {
       return OK;
     }
@@ -60,41 +114,107 @@ RED_ERR PktQueue::getPkt(std::unique_ptr<RedAvPacket> &pkt, bool block) {
         std::cv_status::timeout) {
       AV_LOGV(TAG, "pktqueue[%d] EMPTY for 1s!\n", mType);
     }
+    empty = mReadPos >= mPktQueue.size() && mPendingFlushes == 0;
   }
-  pkt = std::move(mPktQueue.front());
-  AVPacket *packet = pkt ? pkt->GetAVPacket() : nullptr;
+  if (mPendingFlushes > 0) {
+    mPendingFlushes--;
+    pkt.reset(new RedAvPacket(PKT_TYPE_FLUSH, mPendingFormat));
+    mPendingFormat.reset();
+    return OK;
+  }
+  AVPacket *packet = mPktQueue[mReadPos] ? mPktQueue[mReadPos]->GetAVPacket()
+                                         : nullptr;
   mBytes -= packet ? packet->size : 0;
-  mDuration -=
-      packet ? std::max(packet->duration, (int64_t)MIN_PKT_DURATION) : 0;
-  mPktQueue.pop();
+  mDuration -= pktDuration(packet);
+  std::function<void()> low_water = takeLowWater();
+  if (mBackBufferUs <= 0) {
+    pkt = std::move(mPktQueue.front());
+    mPktQueue.pop_front();
+    mBaseSeq++;
+  } else {
+    // the original stays in the back buffer, hand out a reference
+    RedAvPacket *src = mPktQueue[mReadPos].get();
+    pkt.reset(src ? src->Clone(std::max(src->GetSerial(), mSerial), mPool,
+                               mPktPool)
+                  : nullptr);
+    if (packet && ptsUs(src) != AV_NOPTS_VALUE) {
+      mReadPtsUs = ptsUs(src);
+    }
+    mBackBytes += packet ? packet->size : 0;
+    mReadPos++;
+    trimBackBuffer();
+  }
+  lck.unlock();
+  if (low_water) {
+    low_water();
+  }
   return OK;
 }
 
+void PktQueue::armLowWater(int64_t bytes, int64_t duration,
+                           std::function<void()> cb) {
+  std::unique_lock<std::mutex> lck(mLock);
+  mLowWaterBytes = bytes;
+  mLowWaterDuration = duration;
+  mLowWaterCb = std::move(cb);
+}
+
+void PktQueue::disarmLowWater() {
+  std::unique_lock<std::mutex> lck(mLock);
+  mLowWaterCb = nullptr;
+}
+
+std::function<void()> PktQueue::takeLowWater() {
+  std::function<void()> cb;
+  if (mLowWaterCb && ((mLowWaterBytes >= 0 && mBytes <= mLowWaterBytes) ||
+                      (mLowWaterDuration >= 0 &&
+                       mDuration <= mLowWaterDuration))) {
+    cb.swap(mLowWaterCb);
+  }
+  return cb;
+}
+
 bool PktQueue::frontIsFlush() {
   std::unique_lock<std::mutex> lck(mLock);
-  if (mPktQueue.empty()) {
+  if (mPendingFlushes > 0) {
+    return true;
+  }
+  if (mReadPos >= mPktQueue.size()) {
     return false;
   }
-  if (!mPktQueue.front()) {
+  if (!mPktQueue[mReadPos]) {
     return false;
   }
-  return mPktQueue.front()->IsFlushPacket();
+  return mPktQueue[mReadPos]->IsFlushPacket();
 }
 
 void PktQueue::flush() {
   std::unique_lock<std::mutex> lck(mLock);
-  int flush_pkt_count = 0;
-  while (!mPktQueue.empty()) {
-    auto pkt = std::move(mPktQueue.front());
-    if (pkt->IsFlushPacket()) {
+  int flush_pkt_count = mPendingFlushes;
+  // the decoders still have to move to the last format not read yet
+  sp<MetaData> format = mPendingFormat;
+  for (size_t i = mReadPos; i < mPktQueue.size(); i++) {
+    if (mPktQueue[i]->IsFlushPacket()) {
       flush_pkt_count++;
+      if (mPktQueue[i]->GetFormat()) {
+        format = mPktQueue[i]->GetFormat();
+      }
     }
-    mPktQueue.pop();
   }
+  mBaseSeq += mPktQueue.size();
+  mPktQueue.clear();
   for (int i = 0; i < flush_pkt_count; ++i) {
-    std::unique_ptr<RedAvPacket> flush_pkt(new RedAvPacket(PKT_TYPE_FLUSH));
-    mPktQueue.push(std::move(flush_pkt));
+    std::unique_ptr<RedAvPacket> flush_pkt(
+        new RedAvPacket(PKT_TYPE_FLUSH, i == 0 ? format : nullptr));
+    mPktQueue.push_back(std::move(flush_pkt));
   }
+  mReadPos = 0;
+  mPendingFlushes = 0;
+  mPendingFormat.reset();
+  mBackBytes = 0;
+  mKeyIndex.clear();
+  mReadPtsUs = AV_NOPTS_VALUE;
+  mEndPtsUs = AV_NOPTS_VALUE;
   mBytes = 0;
   mDuration = 0;
 }
@@ -107,16 +227,22 @@ void PktQueue::abort() {
 
 void PktQueue::clear() {
   std::unique_lock<std::mutex> lck(mLock);
-  while (!mPktQueue.empty()) {
-    mPktQueue.pop();
-  }
+  mBaseSeq += mPktQueue.size();
+  mPktQueue.clear();
+  mReadPos = 0;
+  mPendingFlushes = 0;
+  mPendingFormat.reset();
+  mBackBytes = 0;
+  mKeyIndex.clear();
+  mReadPtsUs = AV_NOPTS_VALUE;
+  mEndPtsUs = AV_NOPTS_VALUE;
   mBytes = 0;
   mDuration = 0;
 }
 
 size_t PktQueue::size() {
   std::unique_lock<std::mutex> lck(mLock);
-  return mPktQueue.size();
+  return mPktQueue.size() - mReadPos + mPendingFlushes;
 }
 
 int64_t PktQueue::bytes() {
@@ -129,6 +255,110 @@ int64_t PktQueue::duration() {
   return mDuration;
 }
 
+void PktQueue::setBackBuffer(int64_t window_us, int64_t max_bytes,
+                             AVRational time_base, RedObjectPool *pool,
+                             RedAvPacketPool *pkt_pool) {
+  std::unique_lock<std::mutex> lck(mLock);
+  mBackBufferUs = window_us;
+  mBackBufferMaxBytes = max_bytes;
+  mTimeBase = time_base;
+  mPool = pool;
+  mPktPool = pkt_pool;
+}
+
+int64_t PktQueue::ptsUs(RedAvPacket *pkt) {
+  AVPacket *packet = pkt ? pkt->GetAVPacket() : nullptr;
+  if (!packet) {
+    return AV_NOPTS_VALUE;
+  }
+  int64_t ts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+  if (ts == AV_NOPTS_VALUE) {
+    return AV_NOPTS_VALUE;
+  }
+  return av_rescale_q(ts, mTimeBase, AV_TIME_BASE_Q);
+}
+
+bool PktQueue::findKey(int64_t target_us, uint64_t &seq) {
+  if (mBackBufferUs <= 0 || mKeyIndex.empty() ||
+      mEndPtsUs == AV_NOPTS_VALUE || target_us > mEndPtsUs) {
+    return false;
+  }
+  auto it = std::upper_bound(
+      mKeyIndex.begin(), mKeyIndex.end(), target_us,
+      [](int64_t pts_us, const KeyEntry &key) { return pts_us < key.pts_us; });
+  if (it == mKeyIndex.begin()) {
+    return false;
+  }
+  seq = (--it)->seq;
+  return true;
+}
+
+void PktQueue::trimBackBuffer() {
+  while (mReadPos > 0) {
+    RedAvPacket *front = mPktQueue.front().get();
+    int64_t pts_us = ptsUs(front);
+    bool keep = pts_us != AV_NOPTS_VALUE &&
+                (mReadPtsUs == AV_NOPTS_VALUE ||
+                 mReadPtsUs - pts_us <= mBackBufferUs) &&
+                mBackBytes <= mBackBufferMaxBytes && !mKeyIndex.empty() &&
+                mKeyIndex.front().seq == mBaseSeq;
+    // packets of a gop whose keyframe is gone are useless as well
+    if (keep) {
+      break;
+    }
+    AVPacket *packet = front ? front->GetAVPacket() : nullptr;
+    mBackBytes -= packet ? packet->size : 0;
+    mPktQueue.pop_front();
+    mReadPos--;
+    mBaseSeq++;
+    while (!mKeyIndex.empty() && mKeyIndex.front().seq < mBaseSeq) {
+      mKeyIndex.pop_front();
+    }
+  }
+}
+
+bool PktQueue::canSeekInBuffer(int64_t target_us) {
+  std::unique_lock<std::mutex> lck(mLock);
+  uint64_t seq = 0;
+  return findKey(target_us, seq);
+}
+
+RED_ERR PktQueue::seekInBuffer(int64_t target_us, int serial) {
+  std::unique_lock<std::mutex> lck(mLock);
+  uint64_t seq = 0;
+  if (!findKey(target_us, seq)) {
+    return ME_ERROR;
+  }
+  size_t pos = static_cast<size_t>(seq - mBaseSeq);
+  // flush packets not read yet still have to reach the decoder
+  for (size_t i = mReadPos; i < pos; i++) {
+    if (mPktQueue[i]->IsFlushPacket()) {
+      mPendingFlushes++;
+      if (mPktQueue[i]->GetFormat()) {
+        mPendingFormat = mPktQueue[i]->GetFormat();
+      }
+    }
+  }
+  mPendingFlushes++;
+  mReadPos = pos;
+  mSerial = serial;
+  mReadPtsUs = ptsUs(mPktQueue[pos].get());
+  mBytes = 0;
+  mDuration = 0;
+  mBackBytes = 0;
+  for (size_t i = 0; i < mPktQueue.size(); i++) {
+    AVPacket *packet = mPktQueue[i]->GetAVPacket();
+    if (i < mReadPos) {
+      mBackBytes += packet ? packet->size : 0;
+      continue;
+    }
+    mBytes += packet ? packet->size : 0;
+    mDuration += pktDuration(packet);
+  }
+  mNotEmptyCond.notify_one();
+  return OK;
+}
+
 FrameQueue::FrameQueue(size_t capacity, int type)
     : mCapacity(capacity) /*, mType(type)*/ {}
 
@@ -143,7 +373,7 @@ RED_ERR FrameQueue::putFrame(std::unique_ptr<CGlobalBuffer> &frame) {
       AV_LOGV(TAG, "framequeue[%d] FULL for 3s!\n", mType);
     }
   }
-  mFrameQueue.push(std::move(frame));
+  mFrameQueue.push_back(std::move(frame));
   mNotEmptyCond.notify_one();
   return OK;
 }
@@ -164,16 +394,37 @@ RED_ERR FrameQueue::getFrame(std::unique_ptr<CGlobalBuffer> &frame) {
     }
   }
   frame = std::move(mFrameQueue.front());
-  mFrameQueue.pop();
+  mFrameQueue.pop_front();
   mNotFullCond.notify_one();
   return OK;
 }
 
-void FrameQueue::flush() {
+bool FrameQueue::peek(size_t index, double &pts, int &serial) {
+  std::unique_lock<std::mutex> lck(mLock);
+  if (index >= mFrameQueue.size()) {
+    return false;
+  }
+  pts = mFrameQueue[index]->pts;
+  serial = mFrameQueue[index]->serial;
+  return true;
+}
+
+RED_ERR FrameQueue::skipFrames(size_t count,
+                               std::unique_ptr<CGlobalBuffer> &frame) {
   std::unique_lock<std::mutex> lck(mLock);
-  while (!mFrameQueue.empty()) {
-    mFrameQueue.pop();
+  if (mFrameQueue.size() <= count) {
+    return ME_ERROR;
   }
+  mFrameQueue.erase(mFrameQueue.begin(), mFrameQueue.begin() + count);
+  frame = std::move(mFrameQueue.front());
+  mFrameQueue.pop_front();
+  mNotFullCond.notify_one();
+  return OK;
+}
+
+void FrameQueue::flush() {
+  std::unique_lock<std::mutex> lck(mLock);
+  mFrameQueue.clear();
   mNotFullCond.notify_one();
 }
 
@@ -6,7 +6,10 @@
 
 #include "RedBuffer.h"
 #include "RedClock.h"
+#include "RedObjectPool.h"
 #include "RedPacket.h"
+#include "RedPipelineStats.h"
+#include "RedPixelConvert.h"
 #include "RedSampler.h"
 
 #include <iostream>
@@ -14,6 +17,8 @@
 #include <unistd.h>
 
 #include <condition_variable>
+#include <deque>
+#include <functional>
 #include <list>
 #include <mutex>
 #include <pthread.h>
@@ -66,13 +71,57 @@ public:
   int64_t bytes();
   int64_t duration();
 
+  /*keeps window_us and at most max_bytes of already read packets, indexed
+   * by keyframe, so a seek landing inside the buffered window can be served
+   * by seekInBuffer() instead of a demuxer seek. 0 disables*/
+  void setBackBuffer(int64_t window_us, int64_t max_bytes,
+                     AVRational time_base, RedObjectPool *pool,
+                     RedAvPacketPool *pkt_pool);
+  bool canSeekInBuffer(int64_t target_us);
+  /*restarts reading at the last keyframe at or before target_us, the next
+   * packet read is a flush packet*/
+  RED_ERR seekInBuffer(int64_t target_us, int serial);
+
+  /*one shot: the first read leaving bytes or duration (time base units) at
+   * or below its mark calls cb on the reading thread, outside the queue
+   * lock. A negative mark never fires*/
+  void armLowWater(int64_t bytes, int64_t duration, std::function<void()> cb);
+  void disarmLowWater();
+
 private:
+  struct KeyEntry {
+    int64_t pts_us;
+    uint64_t seq;
+  };
+  int64_t ptsUs(RedAvPacket *pkt);
+  bool findKey(int64_t target_us, uint64_t &seq);
+  void trimBackBuffer();
+  std::function<void()> takeLowWater();
+
   std::mutex mLock;
   std::condition_variable mNotEmptyCond;
-  std::queue<std::unique_ptr<RedAvPacket>> mPktQueue;
+  // [0, mReadPos) was read already and kept as back buffer
+  std::deque<std::unique_ptr<RedAvPacket>> mPktQueue;
+  size_t mReadPos{0};
+  uint64_t mBaseSeq{0}; // sequence number of mPktQueue.front()
+  std::deque<KeyEntry> mKeyIndex;
+  int64_t mBackBufferUs{0};
+  int64_t mBackBufferMaxBytes{0};
+  int64_t mBackBytes{0}; // of [0, mReadPos), not part of mBytes
+  AVRational mTimeBase{1, AV_TIME_BASE};
+  int64_t mReadPtsUs{AV_NOPTS_VALUE};
+  int64_t mEndPtsUs{AV_NOPTS_VALUE};
+  int mPendingFlushes{0};
+  sp<MetaData> mPendingFormat; // goes with the next pending flush
+  int mSerial{0};
+  RedObjectPool *mPool{nullptr};
+  RedAvPacketPool *mPktPool{nullptr};
   int64_t mBytes{0};
   int64_t mDuration{0};
   bool mAbort{false};
+  std::function<void()> mLowWaterCb;
+  int64_t mLowWaterBytes{-1};
+  int64_t mLowWaterDuration{-1};
 };
 
 class FrameQueue {
@@ -82,6 +131,11 @@ public:
   ~FrameQueue() = default;
   RED_ERR putFrame(std::unique_ptr<CGlobalBuffer> &frame);
   RED_ERR getFrame(std::unique_ptr<CGlobalBuffer> &frame);
+  /*lookahead without taking, index 0 is the next frame getFrame returns*/
+  bool peek(size_t index, double &pts, int &serial);
+  /*discards count frames and takes the one after them, one lock for a run of
+   * late frames. frame stays empty if the queue holds count frames or less*/
+  RED_ERR skipFrames(size_t count, std::unique_ptr<CGlobalBuffer> &frame);
   void flush();
   void abort();
   void wakeup();
@@ -91,7 +145,7 @@ private:
   std::mutex mLock;
   std::condition_variable mNotEmptyCond;
   std::condition_variable mNotFullCond;
-  std::queue<std::unique_ptr<CGlobalBuffer>> mFrameQueue;
+  std::deque<std::unique_ptr<CGlobalBuffer>> mFrameQueue;
   size_t mCapacity{FRAME_QUEUE_SIZE};
   bool mAbort{false};
   bool mWakeup{false};
@@ -138,8 +192,25 @@ typedef struct FFStatistic {
   int64_t real_cached_size{-1};
 } FFStatistic;
 
+/*per player pools for the packets and frames on the playback path*/
+struct PlayerPools {
+  PlayerPools();
+  ~PlayerPools();
+  PlayerPools(const PlayerPools &) = delete;
+  PlayerPools &operator=(const PlayerPools &) = delete;
+  std::string toJson() const;
+
+  RedObjectPool *packets{nullptr};
+  RedAvPacketPool *av_packets{nullptr};
+  RedObjectPool *buffers{nullptr};
+  RedObjectPool *buffer_contexts{nullptr};
+  PixelConverter pixel_converter; // 10 bit frames to 8 bit
+};
+
 struct VideoState {
   FFStatistic stat;
+  PipelineStats pipeline;
+  PlayerPools pools;
 
   int frame_drops_early{0};
   int continuous_frame_drops_early{0};
@@ -147,6 +218,8 @@ struct VideoState {
   std::atomic<int> latest_video_seek_load_serial{-1};
   std::atomic<int> latest_audio_seek_load_serial{-1};
   volatile int64_t latest_seek_load_start_at{0};
+  volatile int64_t latest_seek_start_at{0};
+  std::atomic<bool> latest_seek_in_buffer{false};
 
   int64_t current_position_ms{0};
   int64_t playable_duration_ms{0};
@@ -155,6 +228,8 @@ struct VideoState {
 
   bool auddec_finished{false};
   bool viddec_finished{false};
+  // the renderer shows yuv420p10le frames as they are
+  std::atomic<bool> video_render_10bit{false};
 
   bool pause_req{false};
   bool paused{false};
@@ -51,6 +51,8 @@ typedef struct {
   NSString *header;               ///< Header
   int64_t cache_max_dir_capacity; ///< Maximum directory capacity for cache
   uint32_t cache_max_entries;     ///< Maximum entries for cache
+  int64_t preloadDurationMs; ///< Preload the mp4 index and this much playback
+                             ///< instead, preloadSize is the fallback
 } RedPreloadParam;
 
 /// Callback for RedPreLoad
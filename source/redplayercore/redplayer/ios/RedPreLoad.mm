@@ -65,6 +65,7 @@ extern "C" {
     reddownload_datasource_wrapper_opt_reset(&opt);
     opt.cache_file_dir = param.cachePath.UTF8String;
     opt.PreDownLoadSize = param.preloadSize;
+    opt.PreDownLoadDurationMs = param.preloadDurationMs;
     if (param.referer != nil)
       opt.referer = param.referer.UTF8String;
     if (param.dnsTimeout > 0)
@@ -123,6 +124,7 @@ extern "C" {
     reddownload_datasource_wrapper_opt_reset(&opt);
     opt.cache_file_dir = param.cachePath.UTF8String;
     opt.PreDownLoadSize = param.preloadSize;
+    opt.PreDownLoadDurationMs = param.preloadDurationMs;
     if (param.referer != nil && param.referer.length > 0)
       opt.referer = param.referer.UTF8String;
     if (param.dnsTimeout > 0)
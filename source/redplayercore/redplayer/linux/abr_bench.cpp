@@ -0,0 +1,550 @@
+#if defined(__HEADLESS__)
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Interface/RedPlayer.h"
+#include "RedLog.h"
+#include "wrapper/reddownload_datasource_wrapper.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+}
+
+#define TAG "AbrBench"
+#define HTTP_CHUNK_SIZE (16 * 1024)
+#define HTTP_HEADER_MAX (8 * 1024)
+#define DEFAULT_SCHEDULE "8000:10,800:15,8000:20"
+
+using redPlayer_ns::cfgTypePlayer;
+using redPlayer_ns::CRedPlayer;
+using redPlayer_ns::globalInit;
+using redPlayer_ns::globalUninit;
+using redPlayer_ns::Message;
+using redPlayer_ns::setLogCallback;
+using redPlayer_ns::setLogCallbackLevel;
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+/*the link runs at kbps for seconds, the last step lasts till the end*/
+struct Step {
+  int64_t kbps;
+  int64_t seconds;
+};
+
+struct Rendition {
+  std::string path;
+  int64_t bitrate{0}; // bits/s
+  int width{0};
+  int height{0};
+};
+
+struct Switch {
+  int64_t ms;
+  int from;
+  int to;
+};
+
+/*what the message thread tells the bench thread*/
+struct RunState {
+  std::mutex mutex;
+  std::condition_variable cond;
+  Clock::time_point start;
+  int64_t first_frame_ms{-1};
+  bool done{false};
+  int error{0};
+  int stalls{0};
+  int64_t stall_ms{0};
+  Clock::time_point stall_start;
+  bool stalled{false};
+  std::vector<Switch> switches;
+};
+
+/*serves the renditions on 127.0.0.1 with byte ranges, all responses share
+ * one link that follows the bandwidth schedule*/
+class HttpServer {
+public:
+  HttpServer(const std::vector<Rendition> &renditions,
+             const std::vector<Step> &schedule)
+      : mRenditions(renditions), mSchedule(schedule) {}
+  ~HttpServer() { stop(); }
+
+  bool start() {
+    mListenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (mListenFd < 0) {
+      return false;
+    }
+    int on = 1;
+    setsockopt(mListenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(mListenFd, reinterpret_cast<sockaddr *>(&addr), len) != 0 ||
+        listen(mListenFd, 16) != 0 ||
+        getsockname(mListenFd, reinterpret_cast<sockaddr *>(&addr), &len) !=
+            0) {
+      close(mListenFd);
+      mListenFd = -1;
+      return false;
+    }
+    mPort = ntohs(addr.sin_port);
+    mStart = Clock::now();
+    mNextSend = mStart;
+    mAcceptThread = std::thread(&HttpServer::acceptLoop, this);
+    return true;
+  }
+
+  void stop() {
+    if (mListenFd < 0) {
+      return;
+    }
+    mStop = true;
+    shutdown(mListenFd, SHUT_RDWR);
+    mAcceptThread.join();
+    close(mListenFd);
+    mListenFd = -1;
+    std::vector<std::thread> threads;
+    {
+      std::unique_lock<std::mutex> lck(mLock);
+      for (int fd : mClients) {
+        shutdown(fd, SHUT_RDWR);
+      }
+      threads.swap(mThreads);
+    }
+    for (std::thread &t : threads) {
+      t.join();
+    }
+  }
+
+  std::string url(size_t index) const {
+    return "http://127.0.0.1:" + std::to_string(mPort) + "/" +
+           std::to_string(index) + ".mp4";
+  }
+  int64_t bytesServed() const { return mBytes.load(); }
+
+private:
+  void acceptLoop() {
+    while (!mStop) {
+      int fd = accept(mListenFd, nullptr, nullptr);
+      if (fd < 0) {
+        if (mStop) {
+          break;
+        }
+        continue;
+      }
+      std::unique_lock<std::mutex> lck(mLock);
+      mClients.insert(fd);
+      mThreads.emplace_back(&HttpServer::serve, this, fd);
+    }
+  }
+
+  int64_t kbpsAt(Clock::time_point t) const {
+    int64_t ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(t - mStart)
+            .count();
+    for (const Step &s : mSchedule) {
+      if (ms < s.seconds * 1000) {
+        return s.kbps;
+      }
+      ms -= s.seconds * 1000;
+    }
+    return mSchedule.back().kbps;
+  }
+
+  /*books the bytes on the shared link and waits for their slot*/
+  void throttle(size_t bytes) {
+    Clock::time_point slot;
+    {
+      std::unique_lock<std::mutex> lck(mLock);
+      slot = std::max(Clock::now(), mNextSend);
+      int64_t us = static_cast<int64_t>(bytes) * 8 * 1000 / kbpsAt(slot);
+      mNextSend = slot + std::chrono::microseconds(us);
+    }
+    std::this_thread::sleep_until(slot);
+  }
+
+  bool sendAll(int fd, const char *data, size_t size) {
+    while (size > 0 && !mStop) {
+      ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+      if (n <= 0) {
+        return false;
+      }
+      data += n;
+      size -= n;
+    }
+    return size == 0;
+  }
+
+  void serve(int fd) {
+    std::string request;
+    char buf[HTTP_CHUNK_SIZE];
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           request.size() < HTTP_HEADER_MAX) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0) {
+        break;
+      }
+      request.append(buf, n);
+    }
+    char method[8] = {0};
+    size_t index = 0;
+    FILE *fp = nullptr;
+    if (sscanf(request.c_str(), "%7s /%zu.mp4", method, &index) == 2 &&
+        index < mRenditions.size()) {
+      fp = fopen(mRenditions[index].path.c_str(), "rb");
+    }
+    if (!fp) {
+      const char *notfound = "HTTP/1.1 404 Not Found\r\n"
+                             "Content-Length: 0\r\nConnection: close\r\n\r\n";
+      sendAll(fd, notfound, strlen(notfound));
+    } else {
+      fseek(fp, 0, SEEK_END);
+      int64_t size = ftell(fp);
+      int64_t first = 0, last = size - 1;
+      const char *range = strstr(request.c_str(), "Range: bytes=");
+      bool partial = range && sscanf(range, "Range: bytes=%" SCNd64, &first) ==
+                                  1;
+      if (partial) {
+        const char *dash = strchr(range, '-');
+        if (dash && dash[1] >= '0' && dash[1] <= '9') {
+          last = std::min<int64_t>(atoll(dash + 1), size - 1);
+        }
+      }
+      first = std::min(first, size);
+      char header[512];
+      int len = snprintf(header, sizeof(header),
+                         "HTTP/1.1 %s\r\nContent-Type: video/mp4\r\n"
+                         "Accept-Ranges: bytes\r\nContent-Length: %" PRId64
+                         "\r\n",
+                         partial ? "206 Partial Content" : "200 OK",
+                         last - first + 1);
+      if (partial) {
+        len += snprintf(header + len, sizeof(header) - len,
+                        "Content-Range: bytes %" PRId64 "-%" PRId64
+                        "/%" PRId64 "\r\n",
+                        first, last, size);
+      }
+      len += snprintf(header + len, sizeof(header) - len,
+                      "Connection: close\r\n\r\n");
+      bool ok = sendAll(fd, header, len);
+      fseek(fp, first, SEEK_SET);
+      int64_t left = strcmp(method, "HEAD") == 0 ? 0 : last - first + 1;
+      while (ok && left > 0) {
+        size_t n = fread(buf, 1, std::min<int64_t>(left, sizeof(buf)), fp);
+        if (n == 0) {
+          break;
+        }
+        throttle(n);
+        ok = sendAll(fd, buf, n);
+        mBytes += ok ? n : 0;
+        left -= n;
+      }
+      fclose(fp);
+    }
+    std::unique_lock<std::mutex> lck(mLock);
+    mClients.erase(fd);
+    close(fd);
+  }
+
+  const std::vector<Rendition> &mRenditions;
+  const std::vector<Step> &mSchedule;
+  int mListenFd{-1};
+  int mPort{0};
+  std::atomic_bool mStop{false};
+  std::atomic<int64_t> mBytes{0};
+  std::thread mAcceptThread;
+  std::mutex mLock;
+  std::set<int> mClients;
+  std::vector<std::thread> mThreads;
+  Clock::time_point mStart;
+  Clock::time_point mNextSend;
+};
+
+void logToStderr(int level, const char *tag, const char *line) {
+  fprintf(stderr, "[%d] %s: %s", level, tag, line);
+}
+
+int64_t msSince(const RunState &state) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() -
+                                                               state.start)
+      .count();
+}
+
+bool parseSchedule(const char *arg, std::vector<Step> &schedule) {
+  schedule.clear();
+  while (arg && *arg) {
+    Step step;
+    int used = 0;
+    if (sscanf(arg, "%" SCNd64 ":%" SCNd64 "%n", &step.kbps, &step.seconds,
+               &used) != 2 ||
+        step.kbps <= 0 || step.seconds <= 0) {
+      return false;
+    }
+    schedule.push_back(step);
+    arg += used;
+    arg += *arg == ',' ? 1 : 0;
+  }
+  return !schedule.empty();
+}
+
+bool probe(Rendition &rendition) {
+  AVFormatContext *ic = nullptr;
+  if (avformat_open_input(&ic, rendition.path.c_str(), nullptr, nullptr) < 0) {
+    return false;
+  }
+  int index = -1;
+  if (avformat_find_stream_info(ic, nullptr) >= 0) {
+    index = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  }
+  if (index >= 0 && ic->duration > 0 && ic->pb) {
+    rendition.width = ic->streams[index]->codecpar->width;
+    rendition.height = ic->streams[index]->codecpar->height;
+    rendition.bitrate = avio_size(ic->pb) * 8 * AV_TIME_BASE / ic->duration;
+  }
+  avformat_close_input(&ic);
+  return rendition.bitrate > 0;
+}
+
+/*best first, as the playlists of the service are*/
+std::string playlist(const std::vector<Rendition> &renditions,
+                     const HttpServer &server) {
+  std::string json = "{\"stream\":{\"h264\":[";
+  for (size_t i = 0; i < renditions.size(); i++) {
+    char buf[160];
+    snprintf(buf, sizeof(buf),
+             "%s{\"master_url\":\"%s\",\"avg_bitrate\":%" PRId64
+             ",\"width\":%d,\"height\":%d}",
+             i > 0 ? "," : "", server.url(i).c_str(), renditions[i].bitrate,
+             renditions[i].width, renditions[i].height);
+    json += buf;
+  }
+  return json + "]}}";
+}
+
+RED_ERR messageLoop(CRedPlayer *mp, RunState *state) {
+  while (1) {
+    sp<Message> msg = mp->getMessage(true);
+    if (!msg)
+      break;
+
+    {
+      std::unique_lock<std::mutex> lck(state->mutex);
+      switch (msg->mWhat) {
+      case RED_MSG_VIDEO_RENDERING_START:
+        state->first_frame_ms = msSince(*state);
+        break;
+      case RED_MSG_BUFFERING_START:
+        if (state->first_frame_ms >= 0 && !state->stalled) {
+          state->stalled = true;
+          state->stalls++;
+          state->stall_start = Clock::now();
+        }
+        break;
+      case RED_MSG_BUFFERING_END:
+        if (state->stalled) {
+          state->stalled = false;
+          state->stall_ms +=
+              std::chrono::duration_cast<std::chrono::milliseconds>(
+                  Clock::now() - state->stall_start)
+                  .count();
+        }
+        break;
+      case RED_MSG_REPRESENTATION_CHANGED:
+        state->switches.push_back({msSince(*state), msg->mArg1, msg->mArg2});
+        break;
+      case RED_MSG_COMPLETED:
+        state->done = true;
+        break;
+      case RED_MSG_ERROR:
+        AV_LOGE_ID(TAG, mp->id(), "RED_MSG_ERROR: (%d, %d)\n", msg->mArg1,
+                   msg->mArg2);
+        state->done = true;
+        state->error = msg->mArg1 != 0 ? msg->mArg1 : -1;
+        break;
+      default:
+        break;
+      }
+      state->cond.notify_all();
+    }
+    mp->recycleMessage(msg);
+  }
+  return OK;
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <mp4>...\n"
+          "  plays the renditions as one json playlist from a local http\n"
+          "  server, they need the same codec and audio format to be\n"
+          "  switched, sizes may differ\n"
+          "  -s <steps> bandwidth schedule kbps:seconds,..., default\n"
+          "             " DEFAULT_SCHEDULE "\n"
+          "  -n         stay on the initial representation, the baseline\n"
+          "  -t <sec>   time limit, default 90\n"
+          "  -o <file>  write the json line to file instead of stdout\n"
+          "  -c <dir>   download cache dir, default /tmp/abr_bench\n"
+          "  -l <lvl>   log level 2(verbose)..8(silent), default 6\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::vector<Step> schedule;
+  std::string schedule_arg = DEFAULT_SCHEDULE;
+  parseSchedule(DEFAULT_SCHEDULE, schedule);
+  bool adaptive = true;
+  int time_limit_s = 90;
+  int log_level = RED_LOG_ERROR;
+  const char *out_path = nullptr;
+  std::string cache_dir = "/tmp/abr_bench";
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:nt:o:c:l:h")) != -1) {
+    switch (opt) {
+    case 's':
+      schedule_arg = optarg;
+      if (!parseSchedule(optarg, schedule)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'n':
+      adaptive = false;
+      break;
+    case 't':
+      time_limit_s = atoi(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    case 'c':
+      cache_dir = optarg;
+      break;
+    case 'l':
+      log_level = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc || time_limit_s <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<Rendition> renditions;
+  for (int i = optind; i < argc; i++) {
+    Rendition rendition;
+    rendition.path = argv[i];
+    if (!probe(rendition)) {
+      fprintf(stderr, "probe %s failed\n", argv[i]);
+      return 1;
+    }
+    renditions.push_back(rendition);
+  }
+  std::stable_sort(renditions.begin(), renditions.end(),
+                   [](const Rendition &a, const Rendition &b) {
+                     return a.bitrate > b.bitrate;
+                   });
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "open %s failed\n", out_path);
+    return 1;
+  }
+
+  globalInit();
+  setLogCallbackLevel(log_level);
+  setLogCallback(logToStderr);
+
+  DownLoadOptWrapper dl_opt;
+  reddownload_datasource_wrapper_opt_reset(&dl_opt);
+  dl_opt.cache_file_dir = cache_dir.c_str();
+  reddownload_datasource_wrapper_init(&dl_opt);
+
+  HttpServer server(renditions, schedule);
+  if (!server.start()) {
+    fprintf(stderr, "http server failed\n");
+    return 1;
+  }
+
+  RunState state;
+  sp<CRedPlayer> mp = CRedPlayer::Create(
+      1, [&state](CRedPlayer *mp) { return messageLoop(mp, &state); });
+  if (!mp) {
+    fprintf(stderr, "create failed\n");
+    return 1;
+  }
+  mp->setConfig(cfgTypePlayer, "is-input-json", 1);
+  mp->setConfig(cfgTypePlayer, "adaptive-switch", adaptive ? 1 : 0);
+  state.start = Clock::now();
+  RED_ERR ret = mp->setDataSource(playlist(renditions, server));
+  if (ret == OK)
+    ret = mp->prepareAsync();
+
+  bool timed_out = false;
+  std::unique_lock<std::mutex> lck(state.mutex);
+  if (ret != OK) {
+    state.error = ret;
+  } else {
+    timed_out = !state.cond.wait_for(lck, std::chrono::seconds(time_limit_s),
+                                     [&state] { return state.done; });
+  }
+  int64_t wall_ms = msSince(state);
+  lck.unlock();
+  mp->stop();
+  mp->release();
+  server.stop();
+
+  std::string bitrates, switches;
+  for (const Rendition &r : renditions) {
+    bitrates += (bitrates.empty() ? "" : ",") + std::to_string(r.bitrate);
+  }
+  for (const Switch &s : state.switches) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "%s{\"ms\":%" PRId64 ",\"from\":%d,\"to\":%d}",
+             switches.empty() ? "" : ",", s.ms, s.from, s.to);
+    switches += buf;
+  }
+  const char *result = state.error != 0 ? "error"
+                       : timed_out      ? "time_limit"
+                                        : "completed";
+  fprintf(out,
+          "{\"result\":\"%s\",\"error\":%d,\"adaptive\":%s,\"schedule\":\"%s\""
+          ",\"bitrates\":[%s],\"wall_ms\":%" PRId64
+          ",\"first_frame_ms\":%" PRId64 ",\"stalls\":%d,\"stall_ms\":%" PRId64
+          ",\"bytes\":%" PRId64 ",\"switches\":[%s]}\n",
+          result, state.error, adaptive ? "true" : "false",
+          schedule_arg.c_str(), bitrates.c_str(), wall_ms,
+          state.first_frame_ms, state.stalls, state.stall_ms,
+          server.bytesServed(), switches.c_str());
+
+  if (out != stdout)
+    fclose(out);
+  globalUninit();
+  return state.error != 0 ? 1 : 0;
+}
+
+#endif
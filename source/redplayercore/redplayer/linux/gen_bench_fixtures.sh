@@ -0,0 +1,59 @@
+#!/bin/sh
+# Generates the local media fixtures for redplayer_bench, needs an ffmpeg
+# binary with libx264, libx265 and the native aac encoder.
+# usage: gen_bench_fixtures.sh [out_dir] [seconds]
+out=${1:-./bench_fixtures}
+secs=${2:-30}
+ffmpeg=${FFMPEG:-ffmpeg}
+
+mkdir -p "$out"
+
+video() { # name codec size bitrate [movflags]
+  "$ffmpeg" -y -loglevel error \
+    -f lavfi -i "testsrc2=size=$3:rate=30" \
+    -f lavfi -i "sine=frequency=440:sample_rate=48000" \
+    -t "$secs" -c:v "$2" -b:v "$4" -g 60 -pix_fmt yuv420p \
+    -c:a aac -b:a 128k -movflags "${5:-+faststart}" "$out/$1.mp4"
+}
+
+video h264_540p_1m libx264 960x540 1M
+video h264_1080p_4m libx264 1920x1080 4M
+video h264_1080p_12m libx264 1920x1080 12M
+video hevc_1080p_2m libx265 1920x1080 2M
+video hevc_2160p_8m libx265 3840x2160 8M
+# moov at the end, for preload_bench
+video h264_1080p_4m_tail libx264 1920x1080 4M -faststart
+
+ladder() { # name size bitrate, a real ladder for abr_bench: own sps/pps
+  # per rung, keyframes aligned
+  "$ffmpeg" -y -loglevel error \
+    -f lavfi -i "testsrc2=size=$2:rate=30" \
+    -f lavfi -i "sine=frequency=440:sample_rate=48000" \
+    -t "$secs" -c:v libx264 -profile:v high -b:v "$3" \
+    -maxrate "$3" -bufsize "$3" -g 60 -keyint_min 60 -sc_threshold 0 \
+    -pix_fmt yuv420p -c:a aac -b:a 128k -movflags +faststart "$out/$1.mp4"
+}
+
+ladder h264_ladder_360p_800k 640x360 800k
+ladder h264_ladder_720p_2m 1280x720 2M
+ladder h264_ladder_1080p_5m 1920x1080 5M
+
+stream() { # name format, byte seekable containers for seek_bench
+  "$ffmpeg" -y -loglevel error \
+    -f lavfi -i "testsrc2=size=1280x720:rate=30" \
+    -f lavfi -i "sine=frequency=440:sample_rate=48000" \
+    -t "$secs" -c:v libx264 -b:v 2M -g 60 -pix_fmt yuv420p \
+    -c:a aac -b:a 128k -f "$2" "$out/$1"
+}
+
+stream h264_720p_2m.ts mpegts
+stream h264_720p_2m.flv flv
+
+"$ffmpeg" -y -loglevel error \
+  -f lavfi -i "sine=frequency=440:sample_rate=44100" \
+  -t "$secs" -c:a aac -b:a 64k "$out/aac_64k.m4a"
+"$ffmpeg" -y -loglevel error \
+  -f lavfi -i "sine=frequency=440:sample_rate=48000" \
+  -t "$secs" -c:a aac -b:a 256k "$out/aac_256k.m4a"
+
+ls "$out"
@@ -0,0 +1,233 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "RedDef.h"
+#include "base/RedPacket.h"
+#include "base/RedQueue.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+
+using redPlayer_ns::PktQueue;
+using redPlayer_ns::RedAvPacket;
+
+namespace {
+
+// the read thread's marks, see RedSourceController.cpp
+#define AUDIO_MIN_CACHED_BYTES 64000
+#define VIDEO_MIN_CACHED_BYTES 256000
+#define LOW_WATER_BYTES_DIVISOR 16
+#define LOW_WATER_MAX_WAIT_MS 1000
+#define POLL_US (10 * 1000)
+
+#define VIDEO_TIME_BASE 90000
+#define AUDIO_TIME_BASE 44100
+#define AUDIO_FRAME_SAMPLES 1024
+#define AUDIO_PACKET_BYTES 372 // 128 kbps aac
+
+/*one synthetic track: packets of a fixed duration and size demuxed as fast
+ * as the queue takes them and played in real time*/
+struct Track {
+  PktQueue queue;
+  int time_base;
+  int64_t duration; // time base units per packet
+  int size;
+  int keyframe_every;
+  int64_t next_pts{0};
+  int64_t min_bytes;
+
+  double seconds(int64_t pts) const {
+    return static_cast<double>(pts) / time_base;
+  }
+  void put() {
+    AVPacket *pkt = av_packet_alloc();
+    av_new_packet(pkt, size);
+    pkt->pts = pkt->dts = next_pts;
+    pkt->duration = duration;
+    if (next_pts / duration % keyframe_every == 0) {
+      pkt->flags |= AV_PKT_FLAG_KEY;
+    }
+    std::unique_ptr<RedAvPacket> avpkt(new RedAvPacket(pkt, 0, nullptr));
+    av_packet_free(&pkt);
+    queue.putPkt(avpkt);
+    next_pts += duration;
+  }
+};
+
+struct Result {
+  int64_t wakeups{0};
+  int64_t demux_cpu_us{0};
+  int64_t underruns{0};
+};
+
+int64_t threadCpuUs() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/*the read thread with a full buffer: sleep 10ms and look again, or arm
+ * both queues and sleep until one drains to its mark*/
+void demux(Track &audio, Track &video, int64_t max_bytes, bool low_water,
+           const std::atomic<bool> &running, Result &result) {
+  std::mutex lock;
+  std::condition_variable cond;
+  bool drained = false;
+  int64_t start_cpu = threadCpuUs();
+  while (running) {
+    int64_t abytes = audio.queue.bytes();
+    int64_t vbytes = video.queue.bytes();
+    if (abytes + vbytes <= max_bytes || abytes <= audio.min_bytes ||
+        vbytes <= video.min_bytes) {
+      Track &next = audio.seconds(audio.next_pts) <= video.seconds(
+                                                        video.next_pts)
+                        ? audio
+                        : video;
+      next.put();
+      continue;
+    }
+    result.wakeups++;
+    if (!low_water) {
+      std::this_thread::sleep_for(std::chrono::microseconds(POLL_US));
+      continue;
+    }
+    {
+      std::unique_lock<std::mutex> lck(lock);
+      drained = false;
+    }
+    for (Track *track : {&audio, &video}) {
+      int64_t tb_per_ms = track->time_base / 1000;
+      int64_t bytes = std::max(track->min_bytes,
+                               track->queue.bytes() -
+                                   max_bytes / LOW_WATER_BYTES_DIVISOR);
+      int64_t duration =
+          std::min(DEFAULT_LAST_HIGH_WATER_MARK_IN_MS * tb_per_ms,
+                   track->queue.duration() -
+                       DEFAULT_NEXT_HIGH_WATER_MARK_IN_MS * tb_per_ms);
+      track->queue.armLowWater(bytes, duration, [&] {
+        std::unique_lock<std::mutex> lck(lock);
+        drained = true;
+        cond.notify_one();
+      });
+    }
+    {
+      std::unique_lock<std::mutex> lck(lock);
+      cond.wait_for(lck, std::chrono::milliseconds(LOW_WATER_MAX_WAIT_MS),
+                    [&] { return drained || !running; });
+    }
+    audio.queue.disarmLowWater();
+    video.queue.disarmLowWater();
+  }
+  result.demux_cpu_us = threadCpuUs() - start_cpu;
+}
+
+/*a decoder taking each packet when playback reaches it*/
+void play(Track &track, const std::atomic<bool> &running,
+          std::atomic<int64_t> &underruns) {
+  auto start = std::chrono::steady_clock::now();
+  for (int64_t pts = 0; running; pts += track.duration) {
+    std::this_thread::sleep_until(
+        start + std::chrono::microseconds(static_cast<int64_t>(
+                    track.seconds(pts) * 1000000)));
+    std::unique_ptr<RedAvPacket> pkt;
+    while (running && track.queue.getPkt(pkt, false) != OK) {
+      underruns++;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+Result runCase(bool low_water, int duration_ms, int64_t max_bytes,
+               int video_kbps) {
+  Track audio{{}, AUDIO_TIME_BASE, AUDIO_FRAME_SAMPLES, AUDIO_PACKET_BYTES, 1};
+  audio.min_bytes = AUDIO_MIN_CACHED_BYTES;
+  Track video{{}, VIDEO_TIME_BASE, VIDEO_TIME_BASE / 30,
+              video_kbps * 1000 / 8 / 30, 60};
+  video.min_bytes = VIDEO_MIN_CACHED_BYTES;
+
+  Result result;
+  std::atomic<bool> running{true};
+  std::atomic<int64_t> underruns{0};
+  std::thread demuxer(demux, std::ref(audio), std::ref(video), max_bytes,
+                      low_water, std::cref(running), std::ref(result));
+  std::thread audio_player(play, std::ref(audio), std::cref(running),
+                           std::ref(underruns));
+  std::thread video_player(play, std::ref(video), std::cref(running),
+                           std::ref(underruns));
+  std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+  running = false;
+  audio.queue.abort();
+  video.queue.abort();
+  demuxer.join();
+  audio_player.join();
+  video_player.join();
+  result.underruns = underruns;
+  return result;
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  the read thread against a full packet buffer, polling every\n"
+          "  10ms and sleeping until a queue reaches its low water mark:\n"
+          "  wakeups and cpu of the read thread, underruns of the players\n"
+          "  -t <ms>   playback per case, default 10000\n"
+          "  -B <kb>   max buffer size, default 15360\n"
+          "  -v <kbps> video bitrate, default 2000\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int duration_ms = 10000;
+  int64_t max_bytes = MAX_QUEUE_SIZE;
+  int video_kbps = 2000;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:B:v:h")) != -1) {
+    switch (opt) {
+    case 't':
+      duration_ms = atoi(optarg);
+      break;
+    case 'B':
+      max_bytes = atoll(optarg) * 1024;
+      break;
+    case 'v':
+      video_kbps = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (duration_ms <= 0 || max_bytes <= 0 || video_kbps <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  for (bool low_water : {false, true}) {
+    Result r = runCase(low_water, duration_ms, max_bytes, video_kbps);
+    printf("{\"mode\":\"%s\",\"wakeups\":%" PRId64
+           ",\"wakeups_per_s\":%.1f,\"demux_cpu_ms\":%.1f,"
+           "\"underruns\":%" PRId64 "}\n",
+           low_water ? "low_water" : "poll", r.wakeups,
+           r.wakeups * 1000.0 / duration_ms, r.demux_cpu_us / 1000.0,
+           r.underruns);
+  }
+  return 0;
+}
+
+#endif
@@ -0,0 +1,291 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "REDFileCache.h"
+#include "REDMp4Index.h"
+
+typedef REDMp4Index::Range Range;
+
+namespace {
+
+struct BenchOptions {
+  int64_t preload_bytes{512 * 1024};
+  int64_t duration_ms{3000};
+  int shard_size{DOWNLOAD_SHARD_SIZE};
+};
+
+/*the file cache of reddownload, each shard holds a prefix of itself and a
+ * download always goes on from the prefix of the shard it starts in*/
+class ShardCache {
+public:
+  ShardCache(const std::vector<uint8_t> &file, int shard_size)
+      : mFile(file), mShardSize(shard_size),
+        mPrefix((file.size() + shard_size - 1) / shard_size, 0) {}
+
+  int read(int64_t offset, uint8_t *buf, int size) const {
+    int done = 0;
+    while (done < size) {
+      int64_t pos = offset + done;
+      if (pos >= mSize) {
+        break;
+      }
+      int64_t shard = pos / mShardSize;
+      int64_t cached = shard * mShardSize + mPrefix[shard];
+      if (pos >= cached) {
+        break;
+      }
+      int len = static_cast<int>(std::min<int64_t>(cached - pos, size - done));
+      memcpy(buf + done, mFile.data() + pos, len);
+      done += len;
+    }
+    return done;
+  }
+
+  int64_t hole(int64_t offset) const {
+    while (offset < mSize) {
+      int64_t shard = offset / mShardSize;
+      int64_t cached = shard * mShardSize + mPrefix[shard];
+      if (offset >= cached) {
+        return offset;
+      }
+      if (mPrefix[shard] < mShardSize) {
+        return cached;
+      }
+      offset = cached;
+    }
+    return offset;
+  }
+
+  /*what RedDownloadCache::PreLoad fetches for the range, returns the bytes*/
+  int64_t fetch(const Range &range) {
+    int64_t shard = range.first / mShardSize;
+    int64_t pos = shard * mShardSize + mPrefix[shard];
+    int64_t end = std::min<int64_t>(range.second, mSize);
+    int64_t bytes = 0;
+    while (pos < end) {
+      shard = pos / mShardSize;
+      int64_t shard_end =
+          std::min<int64_t>((shard + 1) * mShardSize, mSize);
+      int64_t to = std::min(end, shard_end);
+      bytes += to - pos;
+      mPrefix[shard] = static_cast<int>(to - shard * mShardSize);
+      pos = to;
+    }
+    mRequests++;
+    return bytes;
+  }
+
+  bool covered(const Range &range) const {
+    return range.second <= range.first || hole(range.first) >= range.second;
+  }
+  int requests() const { return mRequests; }
+
+private:
+  const std::vector<uint8_t> &mFile;
+  int mShardSize;
+  std::vector<int> mPrefix;
+  int64_t mSize{static_cast<int64_t>(mFile.size())};
+  int mRequests{0};
+};
+
+struct Result {
+  int64_t bytes{0};
+  int requests{0};
+  bool first_frame{false};
+  bool duration{false};
+};
+
+struct Summary {
+  int fixtures{0};
+  int64_t bytes{0};
+  int first_frame{0};
+  int duration{0};
+};
+
+bool loadFile(const char *path, std::vector<uint8_t> &data) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    return false;
+  }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  data.resize(size > 0 ? size : 0);
+  bool ok = size > 0 && fread(data.data(), 1, size, fp) == data.size();
+  fclose(fp);
+  return ok;
+}
+
+/*judges a finished preload against what playback of the file needs*/
+void judge(const ShardCache &cache, const REDMp4Index &truth,
+           Result &result) {
+  result.requests = cache.requests();
+  result.first_frame = cache.covered({0, 8}) && cache.covered(truth.moov()) &&
+                       cache.covered(truth.firstsample());
+  result.duration = result.first_frame;
+  for (const Range &r : truth.ranges()) {
+    result.duration = result.duration && cache.covered(r);
+  }
+}
+
+Result runBytes(const std::vector<uint8_t> &file, const REDMp4Index &truth,
+                const BenchOptions &opts) {
+  ShardCache cache(file, opts.shard_size);
+  Result result;
+  result.bytes = cache.fetch({cache.hole(0), opts.preload_bytes});
+  judge(cache, truth, result);
+  return result;
+}
+
+Result runDuration(const std::vector<uint8_t> &file, const REDMp4Index &truth,
+                   const BenchOptions &opts) {
+  ShardCache cache(file, opts.shard_size);
+  REDMp4Index index(opts.duration_ms);
+  auto read = [&cache](int64_t offset, uint8_t *buf, int size) {
+    return cache.read(offset, buf, size);
+  };
+  auto hole = [&cache](int64_t offset) { return cache.hole(offset); };
+  Result result;
+  Range range{0, 0}, last{-1, -1};
+  // the file size is known once the first response came in
+  int64_t filesize = 0;
+  while (index.nextrange(read, hole, filesize, opts.preload_bytes, range) &&
+         range != last) {
+    result.bytes += cache.fetch(range);
+    filesize = static_cast<int64_t>(file.size());
+    last = range;
+  }
+  judge(cache, truth, result);
+  return result;
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <mp4>...\n"
+          "  -b <bytes> byte count preload, default 524288\n"
+          "  -d <ms>    duration preload, default 3000\n"
+          "  -s <bytes> cache shard size, default %d\n"
+          "  -o <file>  write the json lines to file instead of stdout\n",
+          name, DOWNLOAD_SHARD_SIZE);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  BenchOptions opts;
+  const char *out_path = nullptr;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "b:d:s:o:h")) != -1) {
+    switch (opt) {
+    case 'b':
+      opts.preload_bytes = atoll(optarg);
+      break;
+    case 'd':
+      opts.duration_ms = atoll(optarg);
+      break;
+    case 's':
+      opts.shard_size = atoi(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc || opts.preload_bytes <= 0 || opts.duration_ms <= 0 ||
+      opts.shard_size <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "open %s failed\n", out_path);
+    return 1;
+  }
+
+  int failures = 0;
+  Summary bytes_sum, duration_sum;
+  for (int i = optind; i < argc; i++) {
+    std::vector<uint8_t> file;
+    if (!loadFile(argv[i], file)) {
+      fprintf(out, "{\"fixture\":\"%s\",\"result\":\"open failed\"}\n",
+              argv[i]);
+      failures++;
+      continue;
+    }
+    REDMp4Index truth(opts.duration_ms);
+    bool parsed = truth.parse(
+        [&file](int64_t offset, uint8_t *buf, int size) {
+          int64_t len = std::min<int64_t>(
+              size, std::max<int64_t>(0, file.size() - offset));
+          memcpy(buf, file.data() + offset, len);
+          return static_cast<int>(len);
+        },
+        file.size());
+    if (!parsed) {
+      fprintf(out, "{\"fixture\":\"%s\",\"result\":\"no progressive mp4\"}\n",
+              argv[i]);
+      continue;
+    }
+    Result by_bytes = runBytes(file, truth, opts);
+    Result by_duration = runDuration(file, truth, opts);
+    const struct {
+      const char *name;
+      const Result &r;
+      Summary &sum;
+    } modes[] = {{"bytes", by_bytes, bytes_sum},
+                 {"duration", by_duration, duration_sum}};
+    for (const auto &m : modes) {
+      fprintf(out,
+              "{\"fixture\":\"%s\",\"size\":%zu,\"moov_at_end\":%s"
+              ",\"mode\":\"%s\",\"preload_bytes\":%" PRId64
+              ",\"requests\":%d,\"first_frame_hit\":%s"
+              ",\"duration_hit\":%s}\n",
+              argv[i], file.size(),
+              truth.moov().first > truth.firstsample().first ? "true"
+                                                             : "false",
+              m.name, m.r.bytes, m.r.requests,
+              m.r.first_frame ? "true" : "false",
+              m.r.duration ? "true" : "false");
+      m.sum.fixtures++;
+      m.sum.bytes += m.r.bytes;
+      m.sum.first_frame += m.r.first_frame ? 1 : 0;
+      m.sum.duration += m.r.duration ? 1 : 0;
+    }
+    // the duration mode has to cover what it was asked for
+    failures += by_duration.duration ? 0 : 1;
+    fflush(out);
+  }
+
+  const struct {
+    const char *name;
+    const Summary &sum;
+  } sums[] = {{"bytes", bytes_sum}, {"duration", duration_sum}};
+  for (const auto &s : sums) {
+    int n = s.sum.fixtures > 0 ? s.sum.fixtures : 1;
+    fprintf(out,
+            "{\"summary\":\"%s\",\"fixtures\":%d,\"preload_bytes\":%" PRId64
+            ",\"first_frame_hit_rate\":%.3f,\"duration_hit_rate\":%.3f}\n",
+            s.name, s.sum.fixtures, s.sum.bytes,
+            static_cast<double>(s.sum.first_frame) / n,
+            static_cast<double>(s.sum.duration) / n);
+  }
+
+  if (out != stdout)
+    fclose(out);
+  return failures > 0 ? 1 : 0;
+}
+
+#endif
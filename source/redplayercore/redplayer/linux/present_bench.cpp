@@ -0,0 +1,310 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "base/RedPipelineStats.h"
+#include "base/RedPresentScheduler.h"
+
+using redPlayer_ns::LatencyHistogram;
+using redPlayer_ns::PresentScheduler;
+
+namespace {
+
+#define WAKE_SLACK_US 500
+#define RENDER_COST 0.002
+#define REFRESH_RATE 0.01
+#define PRESENT_MAX_WAIT 0.1
+#define AV_SYNC_THRESHOLD_MIN 0.04
+#define AV_SYNC_THRESHOLD_MAX 0.1
+#define AV_SYNC_FRAMEDUP_THRESHOLD 0.15
+
+/*one synthetic playback, nothing here sleeps, time is a variable. Frames
+ * are dropped like framedrop=1 does, only against an audio master*/
+struct Scenario {
+  const char *name;
+  double fps;
+  bool audio_master;
+  double rate;
+  int stall_every;      // frames between render stalls, 0 for none
+  double stall;         // seconds one stall takes
+  double audio_step;    // the audio clock is set once per callback
+  double audio_jitter;  // +- error of each set
+  double audio_drift;   // audio device against the system clock
+};
+
+const Scenario kScenarios[] = {
+    {"30fps_audio", 30, true, 1.0, 0, 0, 0.023, 0.002, 0},
+    {"30fps_audio_drift", 30, true, 1.0, 0, 0, 0.023, 0.002, 0.0002},
+    {"60fps_audio_stalls", 60, true, 1.0, 120, 0.12, 0.023, 0.002, 0},
+    {"24fps_video_stalls", 24, false, 1.0, 100, 0.08, 0, 0, 0},
+    {"30fps_audio_x2_stalls", 30, true, 2.0, 90, 0.1, 0.023, 0.002, 0},
+    {"60fps_audio_jittery_clock", 60, true, 1.0, 0, 0, 0.046, 0.008, 0},
+};
+
+struct Result {
+  int64_t presented{0};
+  int64_t dropped{0};
+  int64_t drop_runs{0};
+  int64_t wakeups{0};
+  bool in_order{true};
+  LatencyHistogram sync_error;     // |presented - audio playing pts|
+  LatencyHistogram interval_error; // |interval - pts distance / rate|
+};
+
+class SyntheticClocks {
+public:
+  explicit SyntheticClocks(const Scenario &s) : mScenario(s) {}
+
+  /*the pts the audio device really plays at now*/
+  double audio(double now) const {
+    return now * mScenario.rate * (1 + mScenario.audio_drift);
+  }
+  /*the master clock as RedClock reports it, off by the error of its last
+   * set*/
+  double master(double now) const {
+    if (!mScenario.audio_master) {
+      return NAN;
+    }
+    if (mScenario.audio_step <= 0) {
+      return audio(now);
+    }
+    int64_t step = static_cast<int64_t>(now / mScenario.audio_step);
+    // murmur3 finalizer, independent noise per step
+    uint32_t h = static_cast<uint32_t>(step) + 0x9e3779b9u;
+    h = (h ^ (h >> 16)) * 0x85ebca6bu;
+    h = (h ^ (h >> 13)) * 0xc2b2ae35u;
+    h ^= h >> 16;
+    double error = ((h >> 8) / 16777216.0 * 2 - 1) * mScenario.audio_jitter;
+    return audio(now) + error;
+  }
+  /*timers fire a little late, never early*/
+  double wake(double at) {
+    mSeed = mSeed * 1664525 + 1013904223;
+    return at + (mSeed >> 16) % WAKE_SLACK_US / 1000000.0;
+  }
+  double renderCost(int64_t frame) const {
+    if (mScenario.stall_every > 0 && frame > 0 &&
+        frame % mScenario.stall_every == 0) {
+      return mScenario.stall;
+    }
+    return RENDER_COST;
+  }
+
+private:
+  const Scenario &mScenario;
+  uint32_t mSeed{1};
+};
+
+void present(Result &result, const Scenario &s, const SyntheticClocks &clocks,
+             double now, double pts, double &prev_now, double &prev_pts) {
+  if (s.audio_master) {
+    result.sync_error.add(static_cast<int64_t>(
+        std::abs(clocks.audio(now) - pts) / s.rate * 1000000));
+  }
+  if (result.presented > 0) {
+    if (pts <= prev_pts) {
+      result.in_order = false;
+    }
+    double expected = (pts - prev_pts) / s.rate;
+    result.interval_error.add(
+        static_cast<int64_t>(std::abs(now - prev_now - expected) * 1000000));
+  }
+  result.presented++;
+  prev_now = now;
+  prev_pts = pts;
+}
+
+/*the loop CRedRenderVideoHal::ThreadFunc ran before the scheduler: frame
+ * timer plus delay, polled in REFRESH_RATE steps, drops one frame at a time*/
+void runLegacy(const Scenario &s, int64_t frames, Result &result) {
+  SyntheticClocks clocks(s);
+  double now = 0, frame_timer = 0;
+  double tick_pts = 0, tick_duration = 0;
+  double vclock_pts = 0, vclock_time = 0;
+  double prev_now = 0, prev_pts = 0;
+  bool dropping = false;
+  for (int64_t i = 0; i < frames; i++) {
+    double pts = i / s.fps;
+    double duration = 0;
+    if (i > 0) {
+      duration = pts - tick_pts;
+      if (duration <= 0 || duration > 10.0) {
+        duration = tick_duration;
+      }
+    }
+    double delay = 0;
+    while (true) {
+      delay = duration;
+      if (s.audio_master && i > 0) {
+        double diff = vclock_pts + (now - vclock_time) * s.rate -
+                      clocks.master(now);
+        double threshold = std::max(AV_SYNC_THRESHOLD_MIN,
+                                    std::min(AV_SYNC_THRESHOLD_MAX, delay));
+        if (diff <= -threshold) {
+          delay = std::max(0.0, delay + diff);
+        } else if (diff >= threshold && delay > AV_SYNC_FRAMEDUP_THRESHOLD) {
+          delay = delay + diff;
+        } else if (diff >= threshold) {
+          delay *= 2;
+        }
+      }
+      delay /= s.rate;
+      if (i == 0) {
+        frame_timer = now;
+      }
+      if (now >= frame_timer + delay) {
+        break;
+      }
+      double wait = std::min(frame_timer + delay - now, REFRESH_RATE);
+      now = clocks.wake(now + wait);
+      result.wakeups++;
+    }
+    frame_timer += delay;
+    if (delay > 0 && now - frame_timer > AV_SYNC_THRESHOLD_MAX) {
+      frame_timer = now;
+    }
+    tick_pts = pts;
+    tick_duration = duration;
+    vclock_pts = pts;
+    vclock_time = now;
+    if (s.audio_master && i + 1 < frames && now > frame_timer + duration) {
+      result.dropped++;
+      result.drop_runs += dropping ? 0 : 1;
+      dropping = true;
+      continue;
+    }
+    dropping = false;
+    present(result, s, clocks, now, pts, prev_now, prev_pts);
+    now += clocks.renderCost(i);
+  }
+}
+
+/*what WaitForDeadline does: sleep to the deadline, then skip every queued
+ * frame whose successor is due as well*/
+void runScheduler(const Scenario &s, int64_t frames, int lookahead,
+                  Result &result) {
+  SyntheticClocks clocks(s);
+  PresentScheduler scheduler;
+  double now = 0;
+  double prev_now = 0, prev_pts = 0;
+  for (int64_t i = 0; i < frames; i++) {
+    double pts = i / s.fps;
+    double due = 0;
+    while (true) {
+      due = scheduler.schedule(0, pts, clocks.master(now), now, s.rate);
+      if (now >= due) {
+        break;
+      }
+      now = clocks.wake(now + std::min(due - now, PRESENT_MAX_WAIT));
+      result.wakeups++;
+    }
+    int64_t late = 0;
+    while (s.audio_master && now > due && late < lookahead &&
+           i + 1 + late < frames &&
+           scheduler.deadline((i + 1 + late) / s.fps) <= now) {
+      late++;
+    }
+    if (late > 0) {
+      i += late;
+      pts = i / s.fps;
+      result.dropped += late;
+      result.drop_runs++;
+    }
+    present(result, s, clocks, now, pts, prev_now, prev_pts);
+    scheduler.advance(pts, now);
+    now += clocks.renderCost(i);
+  }
+}
+
+std::string toJson(const Result &r) {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "{\"presented\":%" PRId64 ",\"dropped\":%" PRId64
+           ",\"drop_runs\":%" PRId64 ",\"wakeups_per_frame\":%.2f"
+           ",\"in_order\":%s,\"sync_error\":",
+           r.presented, r.dropped, r.drop_runs,
+           r.presented > 0 ? static_cast<double>(r.wakeups) / r.presented : 0,
+           r.in_order ? "true" : "false");
+  return buf + r.sync_error.toJson() +
+         ",\"interval_error\":" + r.interval_error.toJson() + "}";
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -s <sec>  seconds of video per scenario, default 120\n"
+          "  -q <num>  frames the scheduler can look ahead, default 3\n"
+          "  -o <file> write the json lines to file instead of stdout\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int seconds = 120;
+  int lookahead = 3;
+  const char *out_path = nullptr;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:q:o:h")) != -1) {
+    switch (opt) {
+    case 's':
+      seconds = atoi(optarg);
+      break;
+    case 'q':
+      lookahead = atoi(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "open %s failed\n", out_path);
+    return 1;
+  }
+
+  int failures = 0;
+  for (const Scenario &s : kScenarios) {
+    int64_t frames = static_cast<int64_t>(seconds * s.fps);
+    Result legacy;
+    Result scheduler;
+    runLegacy(s, frames, legacy);
+    runScheduler(s, frames, lookahead, scheduler);
+    // falling behind the polling loop by more than a quarter frame, which
+    // stays invisible, is a regression
+    const LatencyHistogram &a =
+        s.audio_master ? scheduler.sync_error : scheduler.interval_error;
+    const LatencyHistogram &b =
+        s.audio_master ? legacy.sync_error : legacy.interval_error;
+    int64_t tolerance_us = static_cast<int64_t>(250000 / s.fps);
+    bool ok = scheduler.in_order &&
+              a.percentile(99) <= b.percentile(99) + tolerance_us &&
+              scheduler.wakeups <= legacy.wakeups;
+    failures += ok ? 0 : 1;
+    fprintf(out,
+            "{\"scenario\":\"%s\",\"frames\":%" PRId64
+            ",\"ok\":%s,\"legacy\":%s,\"scheduler\":%s}\n",
+            s.name, frames, ok ? "true" : "false", toJson(legacy).c_str(),
+            toJson(scheduler).c_str());
+    fflush(out);
+  }
+
+  if (out != stdout)
+    fclose(out);
+  return failures > 0 ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,382 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Interface/RedPlayer.h"
+#include "RedLog.h"
+#include "RedTrace.h"
+#include "wrapper/reddownload_datasource_wrapper.h"
+
+#define TAG "RedPlayerBench"
+#define SEEK_TIMEOUT_MS 5000
+
+using redPlayer_ns::cfgTypePlayer;
+using redPlayer_ns::CRedPlayer;
+using redPlayer_ns::globalInit;
+using redPlayer_ns::globalUninit;
+using redPlayer_ns::Message;
+using redPlayer_ns::setLogCallback;
+using redPlayer_ns::setLogCallbackLevel;
+
+namespace {
+
+struct BenchOptions {
+  bool free_run{false};
+  int seeks{0};
+  int back_buffer_ms{0};
+  int rewind_ms{0};
+  bool audio_producer{false};
+  bool present_scheduler{false};
+  bool poll_full_buffer{false};
+  bool convert_10bit{false};
+  float playback_rate{1.0f};
+  int time_limit_s{0};
+};
+
+/*what the message thread tells the bench thread about one fixture*/
+struct RunState {
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool first_frame{false};
+  bool seek_done{false};
+  bool done{false};
+  int error{0};
+  int error_extra{0};
+};
+
+void logToStderr(int level, const char *tag, const char *line) {
+  fprintf(stderr, "[%d] %s: %s", level, tag, line);
+}
+
+std::string jsonEscape(const std::string &in) {
+  std::string out;
+  for (char c : in) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        out += buf;
+      } else {
+        out += c;
+      }
+      break;
+    }
+  }
+  return out;
+}
+
+RED_ERR messageLoop(CRedPlayer *mp, RunState *state) {
+  while (1) {
+    sp<Message> msg = mp->getMessage(true);
+    if (!msg)
+      break;
+
+    {
+      std::unique_lock<std::mutex> lck(state->mutex);
+      switch (msg->mWhat) {
+      case RED_MSG_VIDEO_RENDERING_START:
+      case RED_MSG_AUDIO_RENDERING_START:
+        state->first_frame = true;
+        break;
+      case RED_MSG_VIDEO_SEEK_RENDERING_START:
+      case RED_MSG_AUDIO_SEEK_RENDERING_START:
+        state->seek_done = true;
+        break;
+      case RED_MSG_COMPLETED:
+        state->done = true;
+        break;
+      case RED_MSG_ERROR:
+        AV_LOGE_ID(TAG, mp->id(), "RED_MSG_ERROR: (%d, %d)\n", msg->mArg1,
+                   msg->mArg2);
+        state->done = true;
+        state->error = msg->mArg1 != 0 ? msg->mArg1 : -1;
+        state->error_extra = msg->mArg2;
+        break;
+      default:
+        break;
+      }
+      state->cond.notify_all();
+    }
+    mp->recycleMessage(msg);
+  }
+  return OK;
+}
+
+/*plays one fixture and returns its result as a single line of json*/
+std::string runFixture(int id, const std::string &url,
+                       const BenchOptions &opts) {
+  RunState state;
+  sp<CRedPlayer> mp = CRedPlayer::Create(
+      id, [&state](CRedPlayer *mp) { return messageLoop(mp, &state); });
+  if (!mp) {
+    return "{\"fixture\":\"" + jsonEscape(url) +
+           "\",\"result\":\"create failed\"}";
+  }
+  mp->setConfig(cfgTypePlayer, "pipeline-stats", 1);
+  mp->setConfig(cfgTypePlayer, "headless-free-run", opts.free_run ? 1 : 0);
+  mp->setConfig(cfgTypePlayer, "seek-back-buffer-ms", opts.back_buffer_ms);
+  mp->setConfig(cfgTypePlayer, "audio-producer", opts.audio_producer ? 1 : 0);
+  mp->setConfig(cfgTypePlayer, "video-present-scheduler",
+                opts.present_scheduler ? 1 : 0);
+  mp->setConfig(cfgTypePlayer, "video-decoder-convert-10bit",
+                opts.convert_10bit ? 1 : 0);
+  mp->setConfig(cfgTypePlayer, "packet-low-water-wakeup",
+                opts.poll_full_buffer ? 0 : 1);
+
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = opts.time_limit_s > 0
+                      ? start + std::chrono::seconds(opts.time_limit_s)
+                      : std::chrono::steady_clock::time_point::max();
+  RED_ERR ret = mp->setDataSource(url);
+  if (ret == OK)
+    ret = mp->prepareAsync();
+  if (ret == OK && opts.playback_rate != 1.0f)
+    mp->setProp(RED_PROP_FLOAT_PLAYBACK_RATE, opts.playback_rate);
+  if (ret != OK) {
+    mp->release();
+    return "{\"fixture\":\"" + jsonEscape(url) +
+           "\",\"result\":\"open failed\"}";
+  }
+
+  bool timed_out = false;
+  std::unique_lock<std::mutex> lck(state.mutex);
+  timed_out = !state.cond.wait_until(
+      lck, deadline, [&state] { return state.first_frame || state.done; });
+
+  int64_t duration_ms = 0;
+  std::string pools_at_first_frame;
+  lck.unlock();
+  mp->getDuration(duration_ms);
+  // heap_allocs stop growing once the packet queues reach their water mark
+  mp->getPoolStats(pools_at_first_frame);
+  lck.lock();
+  int seeks_done = 0;
+  // returns false once the fixture is over
+  auto seek = [&](int64_t pos_ms) {
+    state.seek_done = false;
+    lck.unlock();
+    mp->seekTo(pos_ms);
+    lck.lock();
+    auto seek_deadline = std::min(
+        deadline, std::chrono::steady_clock::now() +
+                      std::chrono::milliseconds(SEEK_TIMEOUT_MS));
+    if (state.cond.wait_until(lck, seek_deadline, [&state] {
+          return state.seek_done || state.done;
+        })) {
+      seeks_done += state.seek_done ? 1 : 0;
+    } else if (std::chrono::steady_clock::now() >= deadline) {
+      timed_out = true;
+    }
+    return !timed_out && !state.done;
+  };
+  for (int i = 1; i <= opts.seeks && duration_ms > 0; i++) {
+    if (timed_out || state.done) {
+      break;
+    }
+    int64_t pos_ms = duration_ms * i / (opts.seeks + 1);
+    if (!seek(pos_ms) || opts.rewind_ms <= 0) {
+      continue;
+    }
+    if (state.cond.wait_for(lck, std::chrono::seconds(1),
+                            [&state] { return state.done; })) {
+      break;
+    }
+    seek(std::max<int64_t>(pos_ms + 1000 - opts.rewind_ms, 0));
+  }
+  if (!timed_out) {
+    timed_out = !state.cond.wait_until(lck, deadline,
+                                       [&state] { return state.done; });
+  }
+  lck.unlock();
+  int64_t wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+
+  std::string pipeline;
+  std::string pools;
+  std::string video_codec;
+  std::string audio_codec;
+  mp->getPipelineStats(pipeline);
+  mp->getPoolStats(pools);
+  mp->getVideoCodecInfo(video_codec);
+  mp->getAudioCodecInfo(audio_codec);
+  mp->stop();
+  mp->release();
+
+  const char *result = timed_out         ? "time_limit"
+                       : state.error != 0 ? "error"
+                                          : "completed";
+  char buf[320];
+  snprintf(buf, sizeof(buf),
+           "\",\"result\":\"%s\",\"error\":[%d,%d],\"free_run\":%s"
+           ",\"wall_ms\":%" PRId64 ",\"duration_ms\":%" PRId64
+           ",\"seeks\":%d,\"audio_producer\":%s,\"present_scheduler\":%s"
+           ",\"convert_10bit\":%s,\"playback_rate\":%.2f,\"video_codec\":\"",
+           result, state.error, state.error_extra,
+           opts.free_run ? "true" : "false", wall_ms, duration_ms, seeks_done,
+           opts.audio_producer ? "true" : "false",
+           opts.present_scheduler ? "true" : "false",
+           opts.convert_10bit ? "true" : "false", opts.playback_rate);
+  return "{\"fixture\":\"" + jsonEscape(url) + buf + jsonEscape(video_codec) +
+         "\",\"audio_codec\":\"" + jsonEscape(audio_codec) +
+         "\",\"pipeline\":" + pipeline + ",\"pools_at_first_frame\":" +
+         pools_at_first_frame + ",\"pools\":" + pools + "}";
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <fixture>...\n"
+          "  -f        free run, decode and render as fast as possible\n"
+          "  -s <n>    seek n times, evenly over the duration\n"
+          "  -b <ms>   packet back buffer for seeks, default 0(off)\n"
+          "  -r <ms>   after each seek, play 1s and seek back by ms\n"
+          "  -p        convert audio on a producer thread, the callback\n"
+          "            only copies; compare audio_callback max_us without -f\n"
+          "  -d        present video on deadlines from the master clock,\n"
+          "            compare video_present_jitter without -f\n"
+          "  -w        poll a full packet buffer every 10ms instead of\n"
+          "            waking at low water, compare demux_full_wakeups and\n"
+          "            demux_refill\n"
+          "  -y        convert 10 bit frames on the decoder thread instead\n"
+          "            of the render thread\n"
+          "  -x <rate> playback rate, != 1 time-stretches the audio\n"
+          "  -t <sec>  time limit per fixture\n"
+          "  -o <file> write the json lines to file instead of stdout\n"
+          "  -T <file> write a chrome trace of all fixtures to file, needs\n"
+          "            a build with -DRED_TRACE=ON\n"
+          "  -c <dir>  download cache dir, default /tmp/redplayer_bench\n"
+          "  -l <lvl>  log level 2(verbose)..8(silent), default 6\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  BenchOptions opts;
+  int log_level = RED_LOG_ERROR;
+  const char *out_path = nullptr;
+  const char *trace_path = nullptr;
+  std::string cache_dir = "/tmp/redplayer_bench";
+
+  int opt;
+  while ((opt = getopt(argc, argv, "fs:b:r:pdwyx:t:o:T:c:l:h")) != -1) {
+    switch (opt) {
+    case 'f':
+      opts.free_run = true;
+      break;
+    case 's':
+      opts.seeks = atoi(optarg);
+      break;
+    case 'b':
+      opts.back_buffer_ms = atoi(optarg);
+      break;
+    case 'r':
+      opts.rewind_ms = atoi(optarg);
+      break;
+    case 'p':
+      opts.audio_producer = true;
+      break;
+    case 'd':
+      opts.present_scheduler = true;
+      break;
+    case 'w':
+      opts.poll_full_buffer = true;
+      break;
+    case 'y':
+      opts.convert_10bit = true;
+      break;
+    case 'x':
+      opts.playback_rate = static_cast<float>(atof(optarg));
+      break;
+    case 't':
+      opts.time_limit_s = atoi(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    case 'T':
+      trace_path = optarg;
+      break;
+    case 'c':
+      cache_dir = optarg;
+      break;
+    case 'l':
+      log_level = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (trace_path && RedTraceStart(0) != 0) {
+    fprintf(stderr, "tracing is compiled out, rebuild with -DRED_TRACE=ON\n");
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "open %s failed\n", out_path);
+    return 1;
+  }
+
+  globalInit();
+  setLogCallbackLevel(log_level);
+  setLogCallback(logToStderr);
+
+  DownLoadOptWrapper dl_opt;
+  reddownload_datasource_wrapper_opt_reset(&dl_opt);
+  dl_opt.cache_file_dir = cache_dir.c_str();
+  reddownload_datasource_wrapper_init(&dl_opt);
+
+  int failures = 0;
+  for (int i = optind; i < argc; i++) {
+    std::string line = runFixture(i, argv[i], opts);
+    fprintf(out, "%s\n", line.c_str());
+    fflush(out);
+    if (line.find("\"result\":\"completed\"") == std::string::npos &&
+        line.find("\"result\":\"time_limit\"") == std::string::npos) {
+      failures++;
+    }
+  }
+
+  if (trace_path) {
+    RedTraceStop();
+    if (RedTraceExport(trace_path) != 0) {
+      fprintf(stderr, "write trace %s failed\n", trace_path);
+      failures++;
+    }
+  }
+
+  if (out != stdout)
+    fclose(out);
+  globalUninit();
+  return failures > 0 ? 1 : 0;
+}
+
+#endif
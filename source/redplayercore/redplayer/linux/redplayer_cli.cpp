@@ -0,0 +1,231 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+
+#include "Interface/RedPlayer.h"
+#include "RedLog.h"
+#include "wrapper/reddownload_datasource_wrapper.h"
+
+#define TAG "RedPlayerCli"
+
+using redPlayer_ns::cfgTypePlayer;
+using redPlayer_ns::CRedPlayer;
+using redPlayer_ns::globalInit;
+using redPlayer_ns::globalUninit;
+using redPlayer_ns::Message;
+using redPlayer_ns::setLogCallback;
+using redPlayer_ns::setLogCallbackLevel;
+
+namespace {
+
+struct CliState {
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool done{false};
+  int error{0};
+  int error_extra{0};
+  // set on the message thread
+  std::atomic<int64_t> prepared_us{0};
+  std::atomic<int64_t> first_video_us{0};
+  std::atomic<int64_t> first_audio_us{0};
+};
+
+CliState g_state;
+
+int64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void finish(int error, int extra) {
+  std::unique_lock<std::mutex> lck(g_state.mutex);
+  if (!g_state.done) {
+    g_state.done = true;
+    g_state.error = error;
+    g_state.error_extra = extra;
+  }
+  g_state.cond.notify_all();
+}
+
+RED_ERR messageLoop(CRedPlayer *mp) {
+  while (1) {
+    sp<Message> msg = mp->getMessage(true);
+    if (!msg)
+      break;
+
+    switch (msg->mWhat) {
+    case RED_MSG_PREPARED:
+      g_state.prepared_us = nowUs();
+      break;
+    case RED_MSG_VIDEO_RENDERING_START:
+      g_state.first_video_us = nowUs();
+      break;
+    case RED_MSG_AUDIO_RENDERING_START:
+      g_state.first_audio_us = nowUs();
+      break;
+    case RED_MSG_COMPLETED:
+      finish(0, 0);
+      break;
+    case RED_MSG_ERROR:
+      AV_LOGE_ID(TAG, mp->id(), "RED_MSG_ERROR: (%d, %d)\n", msg->mArg1,
+                 msg->mArg2);
+      finish(msg->mArg1 != 0 ? msg->mArg1 : -1, msg->mArg2);
+      break;
+    default:
+      break;
+    }
+    mp->recycleMessage(msg);
+  }
+  return OK;
+}
+
+void logToStderr(int level, const char *tag, const char *line) {
+  fprintf(stderr, "[%d] %s: %s", level, tag, line);
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <url|file>\n"
+          "  -f        free run, decode and render as fast as possible\n"
+          "  -a        disable audio\n"
+          "  -v        disable video\n"
+          "  -t <sec>  stop after sec seconds of wall time\n"
+          "  -c <dir>  download cache dir, default /tmp/redplayer_cli\n"
+          "  -l <lvl>  log level 2(verbose)..8(silent), default 5\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  bool free_run = false;
+  bool audio_disable = false;
+  bool video_disable = false;
+  int time_limit_s = 0;
+  int log_level = RED_LOG_WARN;
+  std::string cache_dir = "/tmp/redplayer_cli";
+
+  int opt;
+  while ((opt = getopt(argc, argv, "favt:c:l:h")) != -1) {
+    switch (opt) {
+    case 'f':
+      free_run = true;
+      break;
+    case 'a':
+      audio_disable = true;
+      break;
+    case 'v':
+      video_disable = true;
+      break;
+    case 't':
+      time_limit_s = atoi(optarg);
+      break;
+    case 'c':
+      cache_dir = optarg;
+      break;
+    case 'l':
+      log_level = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+    return 1;
+  }
+  std::string url = argv[optind];
+
+  globalInit();
+  setLogCallbackLevel(log_level);
+  setLogCallback(logToStderr);
+
+  DownLoadOptWrapper dl_opt;
+  reddownload_datasource_wrapper_opt_reset(&dl_opt);
+  dl_opt.cache_file_dir = cache_dir.c_str();
+  reddownload_datasource_wrapper_init(&dl_opt);
+
+  sp<CRedPlayer> mp = CRedPlayer::Create(getpid(), messageLoop);
+  if (!mp) {
+    fprintf(stderr, "create player failed\n");
+    return 1;
+  }
+  mp->setConfig(cfgTypePlayer, "headless-free-run", free_run ? 1 : 0);
+  mp->setConfig(cfgTypePlayer, "an", audio_disable ? 1 : 0);
+  mp->setConfig(cfgTypePlayer, "vn", video_disable ? 1 : 0);
+
+  int64_t start_us = nowUs();
+  RED_ERR ret = mp->setDataSource(url);
+  if (ret == OK)
+    ret = mp->prepareAsync();
+  if (ret != OK) {
+    fprintf(stderr, "open %s failed: %d\n", url.c_str(), ret);
+    mp->release();
+    return 1;
+  }
+
+  bool timed_out = false;
+  {
+    std::unique_lock<std::mutex> lck(g_state.mutex);
+    if (time_limit_s > 0) {
+      timed_out = !g_state.cond.wait_for(
+          lck, std::chrono::seconds(time_limit_s), [] { return g_state.done; });
+    } else {
+      g_state.cond.wait(lck, [] { return g_state.done; });
+    }
+  }
+  int64_t wall_us = nowUs() - start_us;
+
+  int64_t position_ms = 0;
+  int64_t duration_ms = 0;
+  std::string video_codec;
+  std::string audio_codec;
+  mp->getCurrentPosition(position_ms);
+  mp->getDuration(duration_ms);
+  mp->getVideoCodecInfo(video_codec);
+  mp->getAudioCodecInfo(audio_codec);
+  mp->stop();
+  mp->release();
+
+  auto since_start_ms = [start_us](int64_t us) {
+    return us > 0 ? (us - start_us) / 1000 : -1;
+  };
+  // on completion the position may already be reset, count the whole media
+  int64_t played_ms =
+      (g_state.done && g_state.error == 0) ? duration_ms : position_ms;
+  printf("url:          %s\n", url.c_str());
+  printf("result:       %s\n", timed_out         ? "time limit"
+                               : g_state.error != 0 ? "error"
+                                                    : "completed");
+  if (g_state.error != 0)
+    printf("error:        %d, %d\n", g_state.error, g_state.error_extra);
+  printf("video codec:  %s\n", video_codec.c_str());
+  printf("audio codec:  %s\n", audio_codec.c_str());
+  printf("prepared:     %" PRId64 " ms\n", since_start_ms(g_state.prepared_us));
+  printf("first video:  %" PRId64 " ms\n",
+         since_start_ms(g_state.first_video_us));
+  printf("first audio:  %" PRId64 " ms\n",
+         since_start_ms(g_state.first_audio_us));
+  printf("media played: %" PRId64 " ms of %" PRId64 " ms\n", played_ms,
+         duration_ms);
+  printf("wall time:    %" PRId64 " ms\n", wall_us / 1000);
+  if (wall_us > 0)
+    printf("speed:        %.2fx\n", played_ms * 1000.0 / wall_us);
+
+  globalUninit();
+  return g_state.error != 0 ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,312 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Interface/RedPlayer.h"
+#include "RedKeyframeIndex.h"
+#include "RedSource.h"
+#include "base/RedPipelineStats.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+
+using redPlayer_ns::LatencyHistogram;
+using redPlayer_ns::setLogCallbackLevel;
+using redsource::KeyframeIndex;
+using redsource::RedSource;
+
+namespace {
+
+#define MAX_PACKETS_PER_SEEK 20000
+
+struct BenchOptions {
+  int seeks{50};
+  std::string index_path{"/tmp/seek_bench-kfi"};
+};
+
+struct Result {
+  int64_t seeks{0};
+  int64_t failed{0};
+  int64_t packets{0}; // video packets decoded to reach the targets
+  LatencyHistogram latency;
+  std::vector<int64_t> landed; // pts of the first frame at or after target
+};
+
+/*a source opened on the fixture plus a decoder for its video track*/
+class Session {
+public:
+  ~Session() {
+    avcodec_free_context(&mCodec);
+    av_frame_free(&mFrame);
+    av_packet_free(&mPkt);
+    if (mSource) {
+      mSource->close();
+    }
+  }
+
+  bool open(const std::string &url, std::shared_ptr<KeyframeIndex> index) {
+    mSource = std::make_unique<RedSource>();
+    if (index) {
+      mSource->setKeyframeIndex(index);
+    }
+    redsource::FFMpegOpt opt{nullptr, nullptr};
+    auto metadata = std::make_shared<MetaData>();
+    if (mSource->open(url, opt, metadata) != 0) {
+      return false;
+    }
+    mStartTime = metadata->start_time > 0 ? metadata->start_time : 0;
+    mDuration = metadata->duration;
+    for (const TrackInfo &info : metadata->track_info) {
+      if (info.stream_type == AVMEDIA_TYPE_VIDEO) {
+        mVideoIndex = info.stream_index;
+        mTimeBase = {info.time_base_num, info.time_base_den};
+        return openDecoder(info);
+      }
+    }
+    return false;
+  }
+
+  /*reads to the end, which is what fills the index*/
+  int64_t readAll() {
+    int64_t packets = 0;
+    while (mSource->readPacket(mPkt) >= 0) {
+      packets++;
+      av_packet_unref(mPkt);
+    }
+    return packets;
+  }
+
+  /*seeks and decodes until a frame at or after target_us comes out*/
+  bool seekToFrame(int64_t target_us, int64_t &landed_us, int64_t &packets) {
+    if (mSource->seek(target_us) < 0) {
+      return false;
+    }
+    avcodec_flush_buffers(mCodec);
+    packets = 0;
+    while (packets < MAX_PACKETS_PER_SEEK) {
+      if (mSource->readPacket(mPkt) < 0) {
+        return false;
+      }
+      if (mPkt->stream_index != mVideoIndex) {
+        av_packet_unref(mPkt);
+        continue;
+      }
+      packets++;
+      int ret = avcodec_send_packet(mCodec, mPkt);
+      av_packet_unref(mPkt);
+      if (ret < 0 && ret != AVERROR(EAGAIN)) {
+        continue;
+      }
+      while (avcodec_receive_frame(mCodec, mFrame) >= 0) {
+        int64_t pts = mFrame->best_effort_timestamp;
+        av_frame_unref(mFrame);
+        if (pts == AV_NOPTS_VALUE) {
+          continue;
+        }
+        int64_t pts_us = av_rescale_q(pts, mTimeBase, AV_TIME_BASE_Q);
+        if (pts_us - mStartTime >= target_us) {
+          landed_us = pts_us - mStartTime;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  int64_t duration() const { return mDuration; }
+
+private:
+  bool openDecoder(const TrackInfo &info) {
+    const AVCodec *codec =
+        avcodec_find_decoder(static_cast<AVCodecID>(info.codec_id));
+    if (!codec || !(mCodec = avcodec_alloc_context3(codec))) {
+      return false;
+    }
+    mCodec->width = info.width;
+    mCodec->height = info.height;
+    if (info.extra_data && info.extra_data_size > 0) {
+      mCodec->extradata = static_cast<uint8_t *>(
+          av_mallocz(info.extra_data_size + AV_INPUT_BUFFER_PADDING_SIZE));
+      memcpy(mCodec->extradata, info.extra_data, info.extra_data_size);
+      mCodec->extradata_size = info.extra_data_size;
+    }
+    return avcodec_open2(mCodec, codec, nullptr) >= 0;
+  }
+
+  std::unique_ptr<RedSource> mSource;
+  AVCodecContext *mCodec{nullptr};
+  AVFrame *mFrame{av_frame_alloc()};
+  AVPacket *mPkt{av_packet_alloc()};
+  int mVideoIndex{-1};
+  AVRational mTimeBase{1, AV_TIME_BASE};
+  int64_t mStartTime{0};
+  int64_t mDuration{0};
+};
+
+/*targets spread over the duration, visited from both ends in turn so every
+ * seek jumps far from where the previous one stopped*/
+std::vector<int64_t> makeTargets(int64_t duration, int seeks) {
+  std::vector<int64_t> targets;
+  for (int i = 0; i < seeks; i++) {
+    int k = i % 2 == 0 ? i / 2 : seeks - 1 - i / 2;
+    targets.push_back(duration * (2 * k + 1) / (2 * seeks));
+  }
+  return targets;
+}
+
+void runSeeks(const std::string &url, std::shared_ptr<KeyframeIndex> index,
+              const std::vector<int64_t> &targets, Result &result) {
+  Session session;
+  if (!session.open(url, index)) {
+    result.failed = static_cast<int64_t>(targets.size());
+    return;
+  }
+  for (int64_t target : targets) {
+    int64_t landed = -1;
+    int64_t packets = 0;
+    auto start = std::chrono::steady_clock::now();
+    bool ok = session.seekToFrame(target, landed, packets);
+    auto end = std::chrono::steady_clock::now();
+    result.seeks++;
+    result.landed.push_back(landed);
+    if (!ok) {
+      result.failed++;
+      continue;
+    }
+    result.packets += packets;
+    result.latency.add(
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+            .count());
+  }
+}
+
+std::string toJson(const Result &r) {
+  char buf[192];
+  snprintf(buf, sizeof(buf),
+           "{\"seeks\":%" PRId64 ",\"failed\":%" PRId64
+           ",\"packets_per_seek\":%.1f,\"latency\":",
+           r.seeks, r.failed,
+           r.seeks > r.failed
+               ? static_cast<double>(r.packets) / (r.seeks - r.failed)
+               : 0);
+  return buf + r.latency.toJson() + "}";
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <fixture>...\n"
+          "  fixtures that seek by byte (ts, flv) are indexed, mp4 ones run\n"
+          "  without an index in both modes\n"
+          "  -s <n>    seeks per fixture and mode, default 50\n"
+          "  -i <file> where the keyframe index is kept between the runs,\n"
+          "            default /tmp/seek_bench-kfi\n"
+          "  -o <file> write the json lines to file instead of stdout\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  BenchOptions opts;
+  const char *out_path = nullptr;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:i:o:h")) != -1) {
+    switch (opt) {
+    case 's':
+      opts.seeks = atoi(optarg);
+      break;
+    case 'i':
+      opts.index_path = optarg;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc || opts.seeks <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "open %s failed\n", out_path);
+    return 1;
+  }
+  setLogCallbackLevel(RED_LOG_ERROR);
+
+  int failures = 0;
+  for (int i = optind; i < argc; i++) {
+    std::string url = argv[i];
+    // one session reads the whole file and persists the index, like a
+    // first playback would
+    auto built = std::make_shared<KeyframeIndex>();
+    int64_t duration = 0;
+    auto build_start = std::chrono::steady_clock::now();
+    {
+      Session session;
+      if (!session.open(url, built) || session.duration() <= 0) {
+        fprintf(out, "{\"fixture\":\"%s\",\"result\":\"open failed\"}\n",
+                argv[i]);
+        failures++;
+        continue;
+      }
+      session.readAll();
+      duration = session.duration();
+    }
+    double build_ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - build_start)
+                          .count();
+    size_t entries = built->size();
+    if (entries > 0 && built->save(opts.index_path) != 0) {
+      entries = 0;
+    }
+
+    std::vector<int64_t> targets = makeTargets(duration, opts.seeks);
+    Result plain;
+    Result indexed;
+    runSeeks(url, nullptr, targets, plain);
+    auto loaded = std::make_shared<KeyframeIndex>();
+    if (entries > 0) {
+      loaded->load(opts.index_path);
+    }
+    runSeeks(url, entries > 0 ? loaded : nullptr, targets, indexed);
+
+    // the index lands on the keyframe before the target, so it must never
+    // reach a later frame than the demuxer seek
+    int64_t later = 0;
+    for (size_t k = 0; k < plain.landed.size() && k < indexed.landed.size();
+         k++) {
+      later += plain.landed[k] >= 0 && indexed.landed[k] > plain.landed[k];
+    }
+    bool ok = indexed.failed <= plain.failed && later == 0;
+    failures += ok ? 0 : 1;
+    fprintf(out,
+            "{\"fixture\":\"%s\",\"ok\":%s,\"index_entries\":%zu"
+            ",\"index_build_ms\":%.1f,\"landed_later\":%" PRId64
+            ",\"plain\":%s,\"indexed\":%s}\n",
+            argv[i], ok ? "true" : "false", entries, build_ms, later,
+            toJson(plain).c_str(), toJson(indexed).c_str());
+    fflush(out);
+  }
+
+  if (out != stdout)
+    fclose(out);
+  return failures > 0 ? 1 : 0;
+}
+
+#endif
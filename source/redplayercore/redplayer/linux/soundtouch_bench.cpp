@@ -0,0 +1,320 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "RedCore/module/renderHal/soundTouch/FIRFilter.h"
+#include "RedCore/module/renderHal/soundTouch/SoundTouch.h"
+#include "RedCore/module/renderHal/soundTouch/TDStretch.h"
+#include "RedCore/module/renderHal/soundTouch/cpu_detect.h"
+
+using soundtouch::FIRFilter;
+using soundtouch::SoundTouch;
+using soundtouch::TDStretch;
+
+namespace {
+
+#define SAMPLE_RATE 44100
+#define FIR_LENGTH 64
+#define FIR_DIV_FACTOR 14
+#define BLOCK_FRAMES 4096
+
+/*newInstance() picks the widest backend left after masking the others*/
+struct Backend {
+  const char *name;
+  uint disable;
+  uint need; // any of these, 0 for always available
+  bool bit_exact;
+};
+
+/*the mmx routines round differently, so they only report exact:false*/
+const Backend kBackends[] = {
+    {"scalar", 0xffffffff, 0, true},
+    {"mmx", ~static_cast<uint>(SUPPORT_MMX), SUPPORT_MMX, false},
+    {"simd128", SUPPORT_AVX2, SUPPORT_SSE2 | SUPPORT_NEON, true},
+    {"simd256", 0, SUPPORT_AVX2, true},
+};
+
+/*reaches the protected kernels through a derived class, the calls still
+ * dispatch to the subclass newInstance() picked*/
+struct TDStretchProbe : public TDStretch {
+  static double crossCorr(TDStretch *t, const short *a, const short *b,
+                          double &norm) {
+    return (t->*&TDStretchProbe::calcCrossCorr)(a, b, norm);
+  }
+  static double crossCorrAccumulate(TDStretch *t, const short *a,
+                                    const short *b, double &norm) {
+    return (t->*&TDStretchProbe::calcCrossCorrAccumulate)(a, b, norm);
+  }
+  static void overlap(TDStretch *t, short *out, const short *in, int ch) {
+    if (ch == 1) {
+      (t->*&TDStretchProbe::overlapMono)(out, in);
+    } else {
+      (t->*&TDStretchProbe::overlapStereo)(out, in);
+    }
+  }
+  static short *midBuffer(TDStretch *t) {
+    return t->*&TDStretchProbe::pMidBuffer;
+  }
+  static int overlapFrames(TDStretch *t) {
+    return t->*&TDStretchProbe::overlapLength;
+  }
+  static int seekFrames(TDStretch *t) {
+    return t->*&TDStretchProbe::seekLength;
+  }
+};
+
+struct Result {
+  double samples_per_sec{0};
+  uint64_t hash{0};
+};
+
+uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ p[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+/*a tone with some noise, so correlation peaks are not trivial*/
+std::vector<short> makeSignal(size_t samples, int channels) {
+  std::vector<short> out(samples);
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < samples; i++) {
+    seed = seed * 1664525 + 1013904223;
+    double t = static_cast<double>(i / channels) / SAMPLE_RATE;
+    double v = 12000 * sin(2 * M_PI * 440 * t) +
+               4000 * sin(2 * M_PI * 1250 * t + i % channels) +
+               static_cast<int>(seed >> 20) - 2048;
+    out[i] = static_cast<short>(v);
+  }
+  return out;
+}
+
+/*calls fn, which handles samples per call, until min_us passed*/
+template <typename F> double measure(F fn, int64_t samples, int64_t min_us) {
+  auto start = std::chrono::steady_clock::now();
+  int64_t calls = 0;
+  int64_t elapsed_us = 0;
+  do {
+    fn();
+    calls++;
+    elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  } while (elapsed_us < min_us);
+  return static_cast<double>(calls) * samples * 1e6 / elapsed_us;
+}
+
+/*the scan seekBestOverlapPositionFull does, without picking the peak*/
+Result benchCrossCorr(int channels, bool accumulate, int64_t min_us) {
+  TDStretch *t = TDStretch::newInstance();
+  t->setChannels(channels);
+  t->setParameters(SAMPLE_RATE);
+  int ovl = TDStretchProbe::overlapFrames(t);
+  int seek = TDStretchProbe::seekFrames(t);
+  std::vector<short> ref = makeSignal(channels * ovl, channels);
+  std::vector<short> mixing = makeSignal(channels * (ovl + seek), channels);
+
+  Result result;
+  auto scan = [&](bool hash) {
+    double norm = 0;
+    double corr = TDStretchProbe::crossCorr(t, mixing.data(), ref.data(), norm);
+    for (int i = 1; i < seek; i++) {
+      const short *pos = mixing.data() + channels * i;
+      corr = accumulate
+                 ? TDStretchProbe::crossCorrAccumulate(t, pos, ref.data(), norm)
+                 : TDStretchProbe::crossCorr(t, pos, ref.data(), norm);
+      if (hash) {
+        result.hash = fnv1a(result.hash, &corr, sizeof(corr));
+      }
+    }
+  };
+  scan(true);
+  result.samples_per_sec =
+      measure([&] { scan(false); },
+              static_cast<int64_t>(seek) * channels * ovl, min_us);
+  delete t;
+  return result;
+}
+
+Result benchOverlap(int channels, int64_t min_us) {
+  TDStretch *t = TDStretch::newInstance();
+  t->setChannels(channels);
+  t->setParameters(SAMPLE_RATE);
+  int ovl = TDStretchProbe::overlapFrames(t);
+  std::vector<short> mid = makeSignal(channels * ovl, channels);
+  std::vector<short> in = makeSignal(channels * ovl * 2, channels);
+  std::vector<short> out(channels * ovl);
+  memcpy(TDStretchProbe::midBuffer(t), mid.data(), mid.size() * sizeof(short));
+
+  Result result;
+  TDStretchProbe::overlap(t, out.data(), in.data() + channels * ovl, channels);
+  result.hash = fnv1a(0, out.data(), out.size() * sizeof(short));
+  result.samples_per_sec = measure(
+      [&] {
+        TDStretchProbe::overlap(t, out.data(), in.data() + channels * ovl,
+                                channels);
+      },
+      channels * ovl, min_us);
+  delete t;
+  return result;
+}
+
+/*windowed sinc low pass at a quarter of the band, like AAFilter builds*/
+Result benchFir(int channels, int64_t min_us) {
+  short coeffs[FIR_LENGTH];
+  for (int i = 0; i < FIR_LENGTH; i++) {
+    double x = i - (FIR_LENGTH - 1) / 2.0;
+    double sinc = sin(M_PI * x / 4) / (M_PI * x / 4);
+    double window = 0.54 + 0.46 * cos(2 * M_PI * x / FIR_LENGTH);
+    coeffs[i] = static_cast<short>(
+        lround((1 << FIR_DIV_FACTOR) * 0.25 * sinc * window));
+  }
+  FIRFilter *fir = FIRFilter::newInstance();
+  fir->setCoefficients(coeffs, FIR_LENGTH, FIR_DIV_FACTOR);
+  std::vector<short> src =
+      makeSignal(channels * (BLOCK_FRAMES + FIR_LENGTH), channels);
+  std::vector<short> dest(channels * BLOCK_FRAMES);
+
+  Result result;
+  uint frames = fir->evaluate(dest.data(), src.data(),
+                              BLOCK_FRAMES + FIR_LENGTH, channels);
+  result.hash = fnv1a(0, dest.data(), frames * channels * sizeof(short));
+  result.samples_per_sec = measure(
+      [&] {
+        fir->evaluate(dest.data(), src.data(), BLOCK_FRAMES + FIR_LENGTH,
+                      channels);
+      },
+      static_cast<int64_t>(frames) * channels, min_us);
+  delete fir;
+  return result;
+}
+
+/*what SoundTouchHal does for a speed change: rate x, pitch 1/x*/
+Result benchSoundTouch(float speed, int64_t min_us) {
+  const int channels = 2;
+  std::vector<short> in = makeSignal(channels * BLOCK_FRAMES, channels);
+  std::vector<short> out(channels * SAMPLE_RATE);
+  SoundTouch st;
+  st.setSampleRate(SAMPLE_RATE);
+  st.setChannels(channels);
+  st.setRate(speed);
+  st.setPitch(1.0f / speed);
+
+  Result result;
+  auto run = [&](bool hash) {
+    st.putSamples(in.data(), BLOCK_FRAMES);
+    uint n;
+    while ((n = st.receiveSamples(out.data(), SAMPLE_RATE)) != 0) {
+      if (hash) {
+        result.hash = fnv1a(result.hash, out.data(), n * channels * 2);
+      }
+    }
+  };
+  for (int i = 0; i < 8; i++) {
+    run(true);
+  }
+  result.samples_per_sec =
+      measure([&] { run(false); }, channels * BLOCK_FRAMES, min_us);
+  return result;
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -t <ms>   time per kernel and backend, default 300\n"
+          "  -o <file> write the json lines to file instead of stdout\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int64_t min_us = 300000;
+  const char *out_path = nullptr;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:o:h")) != -1) {
+    switch (opt) {
+    case 't':
+      min_us = atoi(optarg) * 1000LL;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "open %s failed\n", out_path);
+    return 1;
+  }
+
+  disableExtensions(0);
+  uint cpu = detectCPUextensions();
+
+  struct Kernel {
+    const char *name;
+    Result (*run)(int64_t min_us);
+  };
+  const Kernel kernels[] = {
+      {"cross_corr_stereo",
+       [](int64_t us) { return benchCrossCorr(2, false, us); }},
+      {"cross_corr_accumulate_stereo",
+       [](int64_t us) { return benchCrossCorr(2, true, us); }},
+      {"cross_corr_mono",
+       [](int64_t us) { return benchCrossCorr(1, false, us); }},
+      {"overlap_stereo", [](int64_t us) { return benchOverlap(2, us); }},
+      {"overlap_mono", [](int64_t us) { return benchOverlap(1, us); }},
+      {"fir_stereo", [](int64_t us) { return benchFir(2, us); }},
+      {"fir_mono", [](int64_t us) { return benchFir(1, us); }},
+      {"soundtouch_x0.5", [](int64_t us) { return benchSoundTouch(0.5f, us); }},
+      {"soundtouch_x1.5", [](int64_t us) { return benchSoundTouch(1.5f, us); }},
+      {"soundtouch_x3", [](int64_t us) { return benchSoundTouch(3.0f, us); }},
+  };
+
+  int mismatches = 0;
+  for (const Kernel &kernel : kernels) {
+    Result scalar;
+    for (const Backend &backend : kBackends) {
+      if (backend.need && !(cpu & backend.need)) {
+        continue;
+      }
+      disableExtensions(backend.disable);
+      Result result = kernel.run(min_us);
+      if (backend.disable == 0xffffffff) {
+        scalar = result;
+      }
+      bool exact = result.hash == scalar.hash;
+      mismatches += exact || !backend.bit_exact ? 0 : 1;
+      fprintf(out,
+              "{\"kernel\":\"%s\",\"backend\":\"%s\",\"samples_per_sec\":%.0f"
+              ",\"speedup\":%.2f,\"exact\":%s}\n",
+              kernel.name, backend.name, result.samples_per_sec,
+              result.samples_per_sec / scalar.samples_per_sec,
+              exact ? "true" : "false");
+      fflush(out);
+    }
+  }
+  disableExtensions(0);
+
+  if (out != stdout)
+    fclose(out);
+  return mismatches > 0 ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,267 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Interface/RedPlayer.h"
+#include "reddecoder/video/video_decoder/ffmpeg_video_decoder.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+}
+
+using redPlayer_ns::setLogCallbackLevel;
+
+namespace {
+
+struct BenchOptions {
+  std::vector<int> thread_types{2, 1, 3};
+  std::vector<int> thread_counts{1, 2, 4, 8, 0};
+  bool low_delay_start{false};
+  int max_packets{600};
+};
+
+/*counts frames and gives them straight back to the decoder*/
+class FrameSink : public reddecoder::VideoDecodedCallback {
+public:
+  reddecoder::VideoCodecError
+  on_decoded_frame(std::unique_ptr<reddecoder::Buffer> frame) override {
+    if (frames == 0) {
+      first_frame_time = std::chrono::steady_clock::now();
+      first_frame_packets = packets_sent;
+    }
+    frames++;
+    auto ctx = reinterpret_cast<reddecoder::FFmpegBufferContext *>(
+        frame->get_video_frame_meta()->buffer_context);
+    if (ctx) {
+      ctx->release_av_frame(ctx);
+      delete ctx;
+    }
+    return reddecoder::VideoCodecError::kNoError;
+  }
+  void on_decode_error(reddecoder::VideoCodecError error,
+                       int internal_error_code) override {}
+
+  int frames{0};
+  int packets_sent{0};
+  int first_frame_packets{0};
+  std::chrono::steady_clock::time_point first_frame_time;
+};
+
+/*the first max_packets video packets of a fixture, decoded once per policy*/
+struct Fixture {
+  ~Fixture() {
+    for (AVPacket *pkt : packets) {
+      av_packet_free(&pkt);
+    }
+    avcodec_parameters_free(&par);
+  }
+  AVCodecParameters *par{nullptr};
+  std::vector<AVPacket *> packets;
+};
+
+bool loadFixture(const std::string &url, int max_packets, Fixture &fixture) {
+  AVFormatContext *ic = nullptr;
+  if (avformat_open_input(&ic, url.c_str(), nullptr, nullptr) < 0) {
+    return false;
+  }
+  int index = -1;
+  if (avformat_find_stream_info(ic, nullptr) >= 0) {
+    index = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  }
+  if (index >= 0) {
+    fixture.par = avcodec_parameters_alloc();
+    avcodec_parameters_copy(fixture.par, ic->streams[index]->codecpar);
+    AVPacket *pkt = av_packet_alloc();
+    while (static_cast<int>(fixture.packets.size()) < max_packets &&
+           av_read_frame(ic, pkt) >= 0) {
+      if (pkt->stream_index == index) {
+        fixture.packets.push_back(av_packet_clone(pkt));
+      }
+      av_packet_unref(pkt);
+    }
+    av_packet_free(&pkt);
+  }
+  avformat_close_input(&ic);
+  return index >= 0 && !fixture.packets.empty();
+}
+
+/*decodes every packet of the fixture and returns one line of json*/
+std::string runPolicy(const std::string &url, const Fixture &fixture,
+                      int thread_type, int thread_count,
+                      bool low_delay_start) {
+  reddecoder::VideoCodecName name = reddecoder::VideoCodecName::kFFMPEGID;
+  if (fixture.par->codec_id == AV_CODEC_ID_H264) {
+    name = reddecoder::VideoCodecName::kH264;
+  } else if (fixture.par->codec_id == AV_CODEC_ID_HEVC) {
+    name = reddecoder::VideoCodecName::kH265;
+  }
+  reddecoder::VideoCodecInfo codec_info(
+      name, reddecoder::VideoCodecImplementationType::kSoftware);
+  codec_info.ffmpeg_codec_id = fixture.par->codec_id;
+  reddecoder::FFmpegVideoDecoder decoder(codec_info);
+  FrameSink sink;
+  decoder.register_decode_complete_callback(&sink);
+  if (decoder.init(nullptr) != reddecoder::VideoCodecError::kNoError) {
+    return "";
+  }
+
+  reddecoder::Buffer desc(reddecoder::BufferType::kVideoFormatDesc,
+                          fixture.par->extradata, fixture.par->extradata_size,
+                          false);
+  auto desc_meta = desc.get_video_format_desc_meta();
+  desc_meta->width = fixture.par->width;
+  desc_meta->height = fixture.par->height;
+  desc_meta->items.push_back(
+      {0, 0, reddecoder::VideoFormatDescType::kExtraData});
+  desc_meta->thread_type =
+      static_cast<reddecoder::VideoThreadType>(thread_type);
+  desc_meta->thread_count = thread_count;
+  desc_meta->low_delay_start = low_delay_start;
+
+  auto start = std::chrono::steady_clock::now();
+  if (decoder.set_video_format_description(&desc) !=
+      reddecoder::VideoCodecError::kNoError) {
+    return "";
+  }
+  int threads_used = decoder.codec_context_->thread_count;
+  for (AVPacket *pkt : fixture.packets) {
+    reddecoder::Buffer buffer(reddecoder::BufferType::kVideoPacket, pkt->data,
+                              pkt->size, false);
+    auto meta = buffer.get_video_packet_meta();
+    meta->pts_ms = pkt->pts;
+    meta->dts_ms = pkt->dts;
+    meta->format = reddecoder::VideoPacketFormat::kFollowExtradataFormat;
+    if (pkt->flags & AV_PKT_FLAG_KEY) {
+      meta->decode_flags |=
+          static_cast<uint32_t>(reddecoder::DecodeFlag::kKeyFrame);
+    }
+    sink.packets_sent++;
+    while (decoder.decode(&buffer) == reddecoder::VideoCodecError::kTryAgain) {
+    }
+  }
+  decoder.get_delayed_frames();
+  auto end = std::chrono::steady_clock::now();
+
+  double wall_s = std::chrono::duration<double>(end - start).count();
+  double first_frame_ms =
+      sink.frames > 0 ? std::chrono::duration<double, std::milli>(
+                            sink.first_frame_time - start)
+                            .count()
+                      : -1;
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+           "{\"fixture\":\"%s\",\"codec\":\"%s\",\"width\":%d,\"height\":%d"
+           ",\"thread_type\":%d,\"threads\":%d,\"threads_used\":%d"
+           ",\"low_delay_start\":%s,\"frames\":%d,\"fps\":%.1f"
+           ",\"first_frame_ms\":%.1f,\"first_frame_packets\":%d}",
+           url.c_str(), avcodec_get_name(fixture.par->codec_id),
+           fixture.par->width, fixture.par->height, thread_type, thread_count,
+           threads_used, low_delay_start ? "true" : "false", sink.frames,
+           wall_s > 0 ? sink.frames / wall_s : 0, first_frame_ms,
+           sink.first_frame_packets);
+  return buf;
+}
+
+std::vector<int> parseList(const char *arg) {
+  std::vector<int> out;
+  std::stringstream ss(arg);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    out.push_back(atoi(item.c_str()));
+  }
+  return out;
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <fixture>...\n"
+          "  -y <list> thread types, 1 frame 2 slice 3 both, default 2,1,3\n"
+          "  -j <list> thread counts, 0 picks from cores and resolution,\n"
+          "            default 1,2,4,8,0\n"
+          "  -d        low delay start, frame threads after the first frame\n"
+          "  -n <num>  video packets per fixture, default 600\n"
+          "  -o <file> write the json lines to file instead of stdout\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  BenchOptions opts;
+  const char *out_path = nullptr;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "y:j:dn:o:h")) != -1) {
+    switch (opt) {
+    case 'y':
+      opts.thread_types = parseList(optarg);
+      break;
+    case 'j':
+      opts.thread_counts = parseList(optarg);
+      break;
+    case 'd':
+      opts.low_delay_start = true;
+      break;
+    case 'n':
+      opts.max_packets = atoi(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "open %s failed\n", out_path);
+    return 1;
+  }
+  setLogCallbackLevel(RED_LOG_ERROR);
+
+  int failures = 0;
+  for (int i = optind; i < argc; i++) {
+    Fixture fixture;
+    if (!loadFixture(argv[i], opts.max_packets, fixture)) {
+      fprintf(out, "{\"fixture\":\"%s\",\"result\":\"open failed\"}\n",
+              argv[i]);
+      failures++;
+      continue;
+    }
+    for (int type : opts.thread_types) {
+      for (int count : opts.thread_counts) {
+        std::string line =
+            runPolicy(argv[i], fixture, type, count, opts.low_delay_start);
+        if (line.empty()) {
+          fprintf(out, "{\"fixture\":\"%s\",\"result\":\"decoder failed\"}\n",
+                  argv[i]);
+          failures++;
+          continue;
+        }
+        fprintf(out, "%s\n", line.c_str());
+        fflush(out);
+      }
+    }
+  }
+
+  if (out != stdout)
+    fclose(out);
+  return failures > 0 ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,262 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "base/RedPipelineStats.h"
+#include "base/RedPixelConvert.h"
+
+extern "C" {
+#include "libavutil/frame.h"
+#include "libswscale/swscale.h"
+}
+
+using redPlayer_ns::LatencyHistogram;
+using redPlayer_ns::PixelConverter;
+
+namespace {
+
+struct Size {
+  const char *name;
+  int width;
+  int height;
+};
+
+const Size kSizes[] = {{"1080p", 1920, 1080}, {"4k", 3840, 2160}};
+
+const struct {
+  const char *name;
+  int backend;
+} kBackends[] = {{"scalar", redPlayer_ns::PIXEL_CONVERT_SCALAR},
+                 {"simd128", redPlayer_ns::PIXEL_CONVERT_SIMD128},
+                 {"simd256", redPlayer_ns::PIXEL_CONVERT_SIMD256}};
+
+struct Result {
+  LatencyHistogram latency;
+  double total_us{0};
+  int64_t frames{0};
+  int64_t buffer_allocs{0};
+};
+
+/*gradients with some noise, the content banding shows up on*/
+AVFrame *makeSource(int width, int height) {
+  AVFrame *frame = av_frame_alloc();
+  frame->format = AV_PIX_FMT_YUV420P10LE;
+  frame->width = width;
+  frame->height = height;
+  if (av_frame_get_buffer(frame, 32) < 0) {
+    av_frame_free(&frame);
+    return nullptr;
+  }
+  uint32_t seed = 1;
+  for (int p = 0; p < 3; p++) {
+    int w = p == 0 ? width : (width + 1) / 2;
+    int h = p == 0 ? height : (height + 1) / 2;
+    for (int y = 0; y < h; y++) {
+      uint16_t *row =
+          reinterpret_cast<uint16_t *>(frame->data[p] + y * frame->linesize[p]);
+      for (int x = 0; x < w; x++) {
+        seed = seed * 1664525 + 1013904223;
+        int v = (x * 1023 / w + y * 256 / h) % 1024 + (seed >> 29) - 4;
+        row[x] = static_cast<uint16_t>(v < 0 ? 0 : (v > 1023 ? 1023 : v));
+      }
+    }
+  }
+  return frame;
+}
+
+/*what ConvertPixelFormat did before the converter, a new frame and a
+ * bicubic swscale pass per picture*/
+AVFrame *convertSws(SwsContext *&sws, const AVFrame *src) {
+  AVFrame *dst = av_frame_alloc();
+  dst->format = AV_PIX_FMT_YUV420P;
+  dst->width = src->width;
+  dst->height = src->height;
+  av_frame_get_buffer(dst, 32);
+  sws = sws_getCachedContext(sws, src->width, src->height,
+                             (AVPixelFormat)src->format, dst->width,
+                             dst->height, (AVPixelFormat)dst->format,
+                             SWS_BICUBIC, NULL, NULL, NULL);
+  if (!sws || !sws_scale(sws, src->data, src->linesize, 0, src->height,
+                         dst->data, dst->linesize)) {
+    av_frame_free(&dst);
+  }
+  return dst;
+}
+
+template <typename Convert>
+void run(const AVFrame *src, int frames, Convert convert, Result &result,
+         AVFrame *&last) {
+  for (int i = 0; i < frames; i++) {
+    auto start = std::chrono::steady_clock::now();
+    AVFrame *dst = convert(src);
+    auto end = std::chrono::steady_clock::now();
+    if (!dst) {
+      return;
+    }
+    int64_t us =
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+            .count();
+    result.latency.add(us);
+    result.total_us += us;
+    result.frames++;
+    av_frame_free(&last);
+    last = dst;
+  }
+}
+
+/*largest and mean absolute difference over all three planes*/
+void compare(const AVFrame *a, const AVFrame *b, int &max_diff,
+             double &mean_diff) {
+  max_diff = 0;
+  int64_t sum = 0, count = 0;
+  for (int p = 0; p < 3; p++) {
+    int w = p == 0 ? a->width : (a->width + 1) / 2;
+    int h = p == 0 ? a->height : (a->height + 1) / 2;
+    for (int y = 0; y < h; y++) {
+      const uint8_t *ra = a->data[p] + y * a->linesize[p];
+      const uint8_t *rb = b->data[p] + y * b->linesize[p];
+      for (int x = 0; x < w; x++) {
+        int d = std::abs(ra[x] - rb[x]);
+        max_diff = d > max_diff ? d : max_diff;
+        sum += d;
+        count++;
+      }
+    }
+  }
+  mean_diff = count > 0 ? static_cast<double>(sum) / count : 0;
+}
+
+std::string toJson(const Result &r, double baseline_us) {
+  double per_frame = r.frames > 0 ? r.total_us / r.frames : 0;
+  char buf[192];
+  snprintf(buf, sizeof(buf),
+           "{\"frames\":%" PRId64 ",\"fps\":%.1f,\"speedup\":%.2f"
+           ",\"buffer_allocs\":%" PRId64 ",\"latency\":",
+           r.frames, per_frame > 0 ? 1000000 / per_frame : 0,
+           per_frame > 0 ? baseline_us / per_frame : 0, r.buffer_allocs);
+  return buf + r.latency.toJson() + "}";
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -n <num>  frames per size and converter, default 120\n"
+          "  -o <file> write the json lines to file instead of stdout\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int frames = 120;
+  const char *out_path = nullptr;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:o:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      frames = atoi(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (frames <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "open %s failed\n", out_path);
+    return 1;
+  }
+
+  int failures = 0;
+  for (const Size &size : kSizes) {
+    AVFrame *src = makeSource(size.width, size.height);
+    if (!src) {
+      fprintf(out, "{\"size\":\"%s\",\"result\":\"alloc failed\"}\n",
+              size.name);
+      failures++;
+      continue;
+    }
+
+    SwsContext *sws = nullptr;
+    Result sws_result;
+    AVFrame *sws_frame = nullptr;
+    run(src, frames,
+        [&sws](const AVFrame *f) { return convertSws(sws, f); }, sws_result,
+        sws_frame);
+    sws_freeContext(sws);
+    double baseline_us =
+        sws_result.frames > 0 ? sws_result.total_us / sws_result.frames : 0;
+    fprintf(out,
+            "{\"size\":\"%s\",\"converter\":\"sws_bicubic\",\"ok\":%s"
+            ",\"result\":%s}\n",
+            size.name, sws_frame ? "true" : "false",
+            toJson(sws_result, baseline_us).c_str());
+    failures += sws_frame ? 0 : 1;
+
+    AVFrame *scalar_frame = nullptr;
+    for (const auto &b : kBackends) {
+      if (!redPlayer_ns::pixelConvertBackendSupported(b.backend)) {
+        continue;
+      }
+      PixelConverter converter;
+      converter.setBackend(b.backend);
+      Result result;
+      AVFrame *frame = nullptr;
+      run(src, frames,
+          [&converter](const AVFrame *f) { return converter.convert(f); },
+          result, frame);
+      result.buffer_allocs = converter.bufferAllocs();
+
+      // every backend must match the scalar one bit for bit, and the
+      // dither may move a pixel by one step against swscale
+      int max_scalar = 0, max_sws = -1;
+      double mean_scalar = 0, mean_sws = -1;
+      if (frame && scalar_frame) {
+        compare(frame, scalar_frame, max_scalar, mean_scalar);
+      }
+      if (frame && sws_frame) {
+        compare(frame, sws_frame, max_sws, mean_sws);
+      }
+      bool ok = frame && max_scalar == 0 && result.buffer_allocs <= 2 &&
+                (!sws_frame || mean_sws < 1.0);
+      failures += ok ? 0 : 1;
+      fprintf(out,
+              "{\"size\":\"%s\",\"converter\":\"%s\",\"ok\":%s"
+              ",\"max_diff_sws\":%d,\"mean_diff_sws\":%.3f,\"result\":%s}\n",
+              size.name, b.name, ok ? "true" : "false", max_sws, mean_sws,
+              toJson(result, baseline_us).c_str());
+      fflush(out);
+      if (!scalar_frame) {
+        scalar_frame = frame;
+      } else {
+        av_frame_free(&frame);
+      }
+    }
+    av_frame_free(&scalar_frame);
+    av_frame_free(&sws_frame);
+    av_frame_free(&src);
+  }
+
+  if (out != stdout)
+    fclose(out);
+  return failures > 0 ? 1 : 0;
+}
+
+#endif
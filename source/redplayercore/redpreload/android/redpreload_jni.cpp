@@ -320,6 +320,8 @@ static jstring Reddownload_open(JNIEnv *env, jclass clazz, jstring jurl,
   jlong capacity = JniAndroidOsBundleGetLongCatchAll(env, jbundle, "capacity");
   jlong cache_max_entries =
       JniAndroidOsBundleGetLongCatchAll(env, jbundle, "cache_max_entries");
+  jlong preload_duration_ms =
+      JniAndroidOsBundleGetLongCatchAll(env, jbundle, "preload_duration_ms");
 
   jint use_https =
       JniAndroidOsBundleGetIntCatchAll(env, jbundle, "use_https", 0);
@@ -337,6 +339,9 @@ static jstring Reddownload_open(JNIEnv *env, jclass clazz, jstring jurl,
   }
   opt.cache_file_dir = path.c_str();
   opt.PreDownLoadSize = jdownsize;
+  if (preload_duration_ms > 0) {
+    opt.PreDownLoadDurationMs = preload_duration_ms;
+  }
   if (!referer.empty()) {
     opt.referer = referer.c_str();
   }
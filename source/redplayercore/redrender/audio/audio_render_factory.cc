@@ -8,6 +8,9 @@
 #ifdef __HARMONY__
 #include "harmony/harmony_audio_render.h"
 #endif
+#ifdef __HEADLESS__
+#include "null/null_audio_render.h"
+#endif
 
 USING_NS_REDRENDER_AUDIO
 std::unique_ptr<IAudioRender>
@@ -20,6 +23,9 @@ AudioRenderFactory::CreateAudioRender(const int &session_id) {
 #endif
 #ifdef __HARMONY__
   return std::unique_ptr<IAudioRender>(new HarmonyAudioRender(session_id));
+#endif
+#ifdef __HEADLESS__
+  return std::unique_ptr<IAudioRender>(new NullAudioRender(session_id));
 #endif
   return nullptr;
 }
@@ -0,0 +1,143 @@
+#if defined(__HEADLESS__)
+
+#include "./null_audio_render.h"
+
+#include <pthread.h>
+
+#include <chrono>
+
+#include "../audio_common.h"
+
+USING_NS_REDRENDER_AUDIO
+
+NullAudioRender::NullAudioRender() : NullAudioRender(0) {}
+
+NullAudioRender::NullAudioRender(const int &session_id)
+    : IAudioRender(session_id) {}
+
+NullAudioRender::~NullAudioRender() {
+  CloseAudio();
+  WaitClose();
+  AV_LOGD_ID(AUDIO_LOG_TAG, session_id_,
+             "[%s:%d] NullAudioRender Deconstruct.\n", __FUNCTION__,
+             __LINE__);
+}
+
+void NullAudioRender::AdjustAudioInfo(const AudioInfo &desired,
+                                      AudioInfo &obtained) {
+  obtained = desired;
+  if (desired.sample_rate < 4000 || desired.sample_rate > 48000) {
+    obtained.sample_rate = 44100;
+  }
+  if (desired.channels > 2) {
+    obtained.channels = 2;
+  }
+  if (obtained.format != AudioFormat::kAudioS16Sys) {
+    obtained.format = AudioFormat::kAudioS16Sys;
+  }
+  obtained.size = obtained.samples * obtained.channels * 2;
+}
+
+int NullAudioRender::OpenAudio(const AudioInfo &desired, AudioInfo &obtained,
+                               std::unique_ptr<AudioCallback> &audio_callback) {
+  AdjustAudioInfo(desired, obtained);
+  if (obtained.size == 0) {
+    AV_LOGE_ID(AUDIO_LOG_TAG, session_id_, "[%s:%d] invalid buffer size\n",
+               __FUNCTION__, __LINE__);
+    return -1;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (thread_.joinable()) {
+    AV_LOGE_ID(AUDIO_LOG_TAG, session_id_, "[%s:%d] already opened\n",
+               __FUNCTION__, __LINE__);
+    return -1;
+  }
+  buffer_.resize(obtained.size);
+  bytes_per_sec_ = obtained.sample_rate * obtained.channels * 2;
+  audio_callback_ = std::move(audio_callback);
+  is_aborted_ = false;
+  thread_ = std::thread(&NullAudioRender::AudioLoop, this);
+  return 0;
+}
+
+void NullAudioRender::AudioLoop() {
+  pthread_setname_np(pthread_self(), "nullaudio");
+  auto next = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!is_aborted_) {
+    if (is_paused_) {
+      cond_.wait(lock, [this] { return !is_paused_ || is_aborted_; });
+      next = std::chrono::steady_clock::now();
+      continue;
+    }
+    lock.unlock();
+    if (audio_callback_) {
+      audio_callback_->GetBuffer(buffer_.data(),
+                                 static_cast<int>(buffer_.size()));
+    }
+    lock.lock();
+    written_bytes_ += buffer_.size();
+    if (free_run_) {
+      continue;
+    }
+    // the time a device needs to play out what was just pulled
+    next += std::chrono::microseconds(
+        static_cast<int64_t>(buffer_.size()) * 1000000 / bytes_per_sec_);
+    cond_.wait_until(lock, next, [this] { return is_aborted_; });
+  }
+}
+
+void NullAudioRender::PauseAudio(int pause_on) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  is_paused_ = pause_on != 0;
+  cond_.notify_all();
+}
+
+void NullAudioRender::FlushAudio() {}
+
+void NullAudioRender::SetStereoVolume(float left_volume, float right_volume) {}
+
+void NullAudioRender::CloseAudio() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  is_aborted_ = true;
+  cond_.notify_all();
+}
+
+void NullAudioRender::WaitClose() {
+  if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id()) {
+    thread_.join();
+    AV_LOGI_ID(AUDIO_LOG_TAG, session_id_,
+               "[%s:%d] pulled %" PRId64 " bytes\n", __FUNCTION__, __LINE__,
+               written_bytes_);
+  }
+}
+
+double NullAudioRender::GetLatencySeconds() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // nothing is queued ahead when the pcm is dropped as fast as it comes
+  return free_run_ ? 0 : minimal_latency_seconds_;
+}
+
+double NullAudioRender::GetAudiotrackLatencySeconds() { return 0.f; }
+
+void NullAudioRender::SetDefaultLatencySeconds(double latency) {
+  minimal_latency_seconds_ = latency;
+}
+
+int NullAudioRender::GetAudioPerSecondCallBacks() {
+  return KAudioMaxCallbacksPerSec;
+}
+
+// optional
+void NullAudioRender::SetPlaybackRate(float playbackRate) {}
+
+void NullAudioRender::SetPlaybackVolume(float volume) {}
+
+int NullAudioRender::GetAudioSessionId() { return 0; }
+
+void NullAudioRender::SetFreeRun(bool free_run) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  free_run_ = free_run;
+  cond_.notify_all();
+}
+#endif
@@ -0,0 +1,61 @@
+#if defined(__HEADLESS__)
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../audio_render_interface.h"
+
+NS_REDRENDER_AUDIO_BEGIN
+
+// pulls the pcm from its own thread and drops it, at the pace of a real
+// device or, in free run, as fast as the player produces it
+class NullAudioRender : public IAudioRender {
+public:
+  NullAudioRender();
+  explicit NullAudioRender(const int &session_id);
+  ~NullAudioRender();
+
+  int OpenAudio(const AudioInfo &desired, AudioInfo &obtained,
+                std::unique_ptr<AudioCallback> &audio_callback) override;
+  void PauseAudio(int pause_on) override;
+  void FlushAudio() override;
+  void SetStereoVolume(float left_volume, float right_volume) override;
+  void CloseAudio() override;
+  void WaitClose() override;
+
+  double GetLatencySeconds() override;
+  double GetAudiotrackLatencySeconds() override;
+  void SetDefaultLatencySeconds(double latency) override;
+  int GetAudioPerSecondCallBacks() override;
+
+  // optional
+  void SetPlaybackRate(float playbackRate) override;
+  void SetPlaybackVolume(float volume) override;
+
+  // android only
+  int GetAudioSessionId() override;
+
+  void SetFreeRun(bool free_run);
+
+private:
+  void AdjustAudioInfo(const AudioInfo &desired, AudioInfo &obtained);
+  void AudioLoop();
+
+private:
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::vector<uint8_t> buffer_;
+  int bytes_per_sec_{0};
+  double minimal_latency_seconds_{0};
+  int64_t written_bytes_{0};
+  bool is_paused_{true};
+  bool is_aborted_{false};
+  bool free_run_{false};
+};
+NS_REDRENDER_AUDIO_END
+
+#endif
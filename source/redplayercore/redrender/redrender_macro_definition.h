@@ -7,6 +7,7 @@
 #define REDRENDER_PLATFORM_ANDROID 1
 #define REDRENDER_PLATFORM_IOS 2
 #define REDRENDER_PLATFORM_HARMONY 5
+#define REDRENDER_PLATFORM_HEADLESS 6
 
 #define REDRENDER_PLATFORM REDRENDER_PLATFORM_UNKNOWN
 #if defined(PLATFORM_ANDROID) || defined(__ANDROID__) || defined(ANDROID)
@@ -18,6 +19,9 @@
 #elif defined(__HARMONY__)
 #undef REDRENDER_PLATFORM
 #define REDRENDER_PLATFORM REDRENDER_PLATFORM_HARMONY
+#elif defined(__HEADLESS__)
+#undef REDRENDER_PLATFORM
+#define REDRENDER_PLATFORM REDRENDER_PLATFORM_HEADLESS
 #endif
 
 #define NS_REDRENDER_BEGIN namespace RedRender {
@@ -0,0 +1,50 @@
+/*
+ * null_video_renderer.cpp
+ * RedRender
+ *
+ * This file is part of RedRender.
+ */
+#if defined(__HEADLESS__)
+#include "./null_video_renderer.h"
+
+NS_REDRENDER_BEGIN
+
+NullVideoRenderer::NullVideoRenderer(const int &sessionID)
+    : VideoRenderer(sessionID) {
+  AV_LOGV_ID(LOG_TAG, _sessionID, "[%s:%d] .\n", __FUNCTION__, __LINE__);
+}
+
+NullVideoRenderer::~NullVideoRenderer() {
+  AV_LOGV_ID(LOG_TAG, _sessionID, "[%s:%d] .\n", __FUNCTION__, __LINE__);
+}
+
+VRError NullVideoRenderer::onInputFrame(VideoFrameMetaData *inputFrameMetaData) {
+  if (nullptr == inputFrameMetaData ||
+      nullptr == inputFrameMetaData->pitches[0]) {
+    AV_LOGE_ID(LOG_TAG, _sessionID, "[%s:%d] empty frame.\n", __FUNCTION__,
+               __LINE__);
+    return VRError::VRErrorInputFrame;
+  }
+  _inputFrames++;
+  _frameReady = true;
+  return VRError::VRErrorNone;
+}
+
+VRError NullVideoRenderer::onRender() {
+  if (!_frameReady) {
+    return VRError::VRErrorOnRender;
+  }
+  _frameReady = false;
+  _renderedFrames++;
+  return VRError::VRErrorNone;
+}
+
+void NullVideoRenderer::close() {
+  AV_LOGI_ID(LOG_TAG, _sessionID,
+             "[%s:%d] input frames %" PRId64 ", rendered frames %" PRId64
+             ".\n",
+             __FUNCTION__, __LINE__, _inputFrames, _renderedFrames);
+}
+
+NS_REDRENDER_END
+#endif
@@ -0,0 +1,30 @@
+#if defined(__HEADLESS__)
+#pragma once
+
+#include <cstdint>
+
+#include "../video_filter.h"
+#include "../video_inc_internal.h"
+#include "../video_renderer.h"
+#include "../video_renderer_info.h"
+
+NS_REDRENDER_BEGIN
+
+// accepts the frames without drawing them, the render thread keeps its A/V
+// sync timing so the pipeline runs as it does on a device
+class NullVideoRenderer : public VideoRenderer {
+public:
+  NullVideoRenderer(const int &sessionID);
+  ~NullVideoRenderer() override;
+  VRError onInputFrame(VideoFrameMetaData *inputFrameMetaData) override;
+  VRError onRender() override;
+  void close() override;
+
+private:
+  int64_t _inputFrames{0};
+  int64_t _renderedFrames{0};
+  bool _frameReady{false};
+};
+
+NS_REDRENDER_END
+#endif
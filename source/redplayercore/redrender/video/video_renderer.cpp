@@ -63,6 +63,12 @@ UIView *VideoRenderer::getRedRenderView() {
   AV_LOGV_ID(LOG_TAG, _sessionID, "[%s:%d] .\n", __FUNCTION__, __LINE__);
   return nullptr;
 }
+
+#elif REDRENDER_PLATFORM == REDRENDER_PLATFORM_HEADLESS
+VRError VideoRenderer::init() {
+  AV_LOGV_ID(LOG_TAG, _sessionID, "[%s:%d] .\n", __FUNCTION__, __LINE__);
+  return VRError::VRErrorNone;
+}
 #endif
 
 VRError VideoRenderer::attachFilter(
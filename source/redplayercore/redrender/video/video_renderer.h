@@ -8,7 +8,9 @@
 #include "./video_filter.h"
 #include "./video_inc_internal.h"
 #include "./video_renderer_info.h"
+#if REDRENDER_PLATFORM != REDRENDER_PLATFORM_HEADLESS
 #include "opengl/filter/opengl_filter_base.h"
+#endif
 #include <memory>
 
 NS_REDRENDER_BEGIN
@@ -30,6 +32,8 @@ public:
   virtual VRError init();
   virtual VRError initWithFrame(CGRect cgrect = {{0, 0}, {0, 0}});
   virtual UIView *getRedRenderView();
+#elif REDRENDER_PLATFORM == REDRENDER_PLATFORM_HEADLESS
+  virtual VRError init();
 #endif
   virtual VRError attachFilter(VideoFilterType videoFilterType,
                                VideoFrameMetaData *inputFrameMetaData = nullptr,
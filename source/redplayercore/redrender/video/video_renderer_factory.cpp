@@ -9,6 +9,8 @@
  */
 #include "./video_renderer_factory.h"
 
+#include <algorithm>
+
 #include "avsbdl/avsbdl_video_renderer.h"
 #if REDRENDER_PLATFORM == REDRENDER_PLATFORM_ANDROID
 #include "mediacodec/mediacodec_video_renderer.h"
@@ -17,7 +19,11 @@
 #include "harmony/harmony_video_renderer.h"
 #endif
 #include "metal/metal_video_renderer.h"
+#if REDRENDER_PLATFORM == REDRENDER_PLATFORM_HEADLESS
+#include "null/null_video_renderer.h"
+#else
 #include "opengl/opengl_video_renderer.h"
+#endif
 
 NS_REDRENDER_BEGIN
 
@@ -29,6 +35,7 @@ VideoRendererFactory::VideoRendererFactory() {
       VideoRendererInfo(VRClusterType::VRClusterTypeMediaCodec),
       VideoRendererInfo(VRClusterType::VRClusterTypeAVSBDL),
       VideoRendererInfo(VRClusterType::VRClusterTypeHarmonyVideoDecoder),
+      VideoRendererInfo(VRClusterType::VRClusterTypeNull),
   };
 }
 
@@ -48,7 +55,9 @@ std::unique_ptr<VideoRenderer> VideoRendererFactory::createVideoRenderer(
 
   switch (videoRendererInfo._videoRendererClusterType) {
   case VRClusterTypeOpenGL:
+#if REDRENDER_PLATFORM != REDRENDER_PLATFORM_HEADLESS
     renderer = std::make_unique<OpenGLVideoRenderer>(sessionID);
+#endif
     break;
   case VRClusterTypeMetal:
 #if REDRENDER_PLATFORM == REDRENDER_PLATFORM_IOS
@@ -68,6 +77,11 @@ std::unique_ptr<VideoRenderer> VideoRendererFactory::createVideoRenderer(
   case VRClusterTypeAVSBDL:
 #if REDRENDER_PLATFORM == REDRENDER_PLATFORM_IOS
     renderer = std::make_unique<AVSBDLVideoRenderer>(sessionID);
+#endif
+    break;
+  case VRClusterTypeNull:
+#if REDRENDER_PLATFORM == REDRENDER_PLATFORM_HEADLESS
+    renderer = std::make_unique<NullVideoRenderer>(sessionID);
 #endif
     break;
   case VRClusterTypeUnknown:
@@ -11,6 +11,7 @@ typedef enum VRClusterType {
   VRClusterTypeMediaCodec = 3,
   VRClusterTypeAVSBDL = 5, // AVSampleBufferDisplayLayer
   VRClusterTypeHarmonyVideoDecoder = 6,
+  VRClusterTypeNull = 7, // no output, headless builds
 } VRClusterType;
 
 struct VideoRendererInfo {
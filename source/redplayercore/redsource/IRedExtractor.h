@@ -1,5 +1,6 @@
 #pragma once
 #include "RedDef.h"
+#include "RedKeyframeIndex.h"
 #include "RedSourceCommon.h"
 #include <algorithm>
 #include <memory>
@@ -24,6 +25,9 @@ public:
   virtual int getPbError() = 0;
   virtual int getStreamType(int stream_index) = 0;
   virtual void close() = 0;
+  /*record keyframes into index while reading and seek with it, set before
+   * open*/
+  virtual void setKeyframeIndex(std::shared_ptr<KeyframeIndex> index) {}
   virtual ~IRedExtractor() = default;
 };
 REDSOURCE_NS_END
@@ -2,6 +2,7 @@
 #include "RedFFUtil.h"
 #include "RedLog.h"
 #include "RedMsg.h"
+#include <cinttypes>
 #include <iostream>
 REDSOURCE_NS_BEGIN
 RedFFExtractor::RedFFExtractor(const int &session_id, NotifyCallback notify_cb)
@@ -14,6 +15,14 @@ RedFFExtractor::RedFFExtractor(const int &session_id, NotifyCallback notify_cb)
 RedFFExtractor::RedFFExtractor() : RedFFExtractor(0, nullptr) {}
 
 int RedFFExtractor::seek(int64_t timestamp, int64_t rel, int seek_flags) {
+  if (index_) {
+    index_->breakRun();
+    KeyframeEntry keyframe;
+    if (rel == 0 && !(seek_flags & AVSEEK_FLAG_BYTE) &&
+        index_->lookup(timestamp, keyframe) && seekKeyframe(keyframe) >= 0) {
+      return 0;
+    }
+  }
   if (ic_->start_time != AV_NOPTS_VALUE) {
     timestamp += ic_->start_time;
   }
@@ -161,6 +170,25 @@ int RedFFExtractor::open(const std::string &url, FFMpegOpt &opt,
     metadata->track_info.emplace_back(info);
   }
 
+  if (index_) {
+    int64_t source_size = ic_->pb ? avio_size(ic_->pb) : -1;
+    index_stream_ =
+        av_find_best_stream(ic_, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (source_size <= 0 || index_stream_ < 0 || !ic_->iformat ||
+        (ic_->iformat->flags & AVFMT_NO_BYTE_SEEK)) {
+      // live or audio only, or mov/mp4, fragmented or not: it seeks through
+      // its sample tables and sidx, which already give it the offsets
+      AV_LOGI_ID(SOURCE_LOG_TAG, session_id_,
+                 "[%s:%d] %s not indexed, size %" PRId64 "\n", __FUNCTION__,
+                 __LINE__, ic_->iformat ? ic_->iformat->name : "unknown",
+                 source_size);
+      index_.reset();
+      index_stream_ = -1;
+    } else {
+      index_->bind(source_size, ic_->duration);
+    }
+  }
+
   return 0;
 }
 
@@ -185,6 +213,46 @@ int RedFFExtractor::readPacket(AVPacket *pkt) {
   if (ic_) {
     ret = av_read_frame(ic_, pkt);
   }
+  if (ret >= 0 && index_) {
+    indexPacket(pkt);
+  }
+  return ret;
+}
+
+void RedFFExtractor::setKeyframeIndex(std::shared_ptr<KeyframeIndex> index) {
+  index_ = index;
+}
+
+void RedFFExtractor::indexPacket(const AVPacket *pkt) {
+  if (pkt->stream_index != index_stream_ || !(pkt->flags & AV_PKT_FLAG_KEY) ||
+      pkt->pos < 0) {
+    return;
+  }
+  int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+  if (ts == AV_NOPTS_VALUE) {
+    return;
+  }
+  int64_t pts_us = av_rescale_q(ts, ic_->streams[index_stream_]->time_base,
+                                AV_TIME_BASE_Q);
+  if (ic_->start_time != AV_NOPTS_VALUE) {
+    pts_us -= ic_->start_time;
+  }
+  index_->add(pts_us, pkt->pos, pkt->size);
+}
+
+int RedFFExtractor::seekKeyframe(const KeyframeEntry &keyframe) {
+  // reading resumes at the keyframe itself, the demuxer does not search and
+  // the decoder does not start mid GOP
+  int ret = av_seek_frame(ic_, -1, keyframe.pos, AVSEEK_FLAG_BYTE);
+  if (ret < 0) {
+    AV_LOGW_ID(SOURCE_LOG_TAG, session_id_,
+               "[%s:%d] byte seek to %" PRId64 " failed %d\n", __FUNCTION__,
+               __LINE__, keyframe.pos, ret);
+  } else {
+    AV_LOGD_ID(SOURCE_LOG_TAG, session_id_,
+               "[%s:%d] keyframe %" PRId64 "us at byte %" PRId64 "\n",
+               __FUNCTION__, __LINE__, keyframe.pts_us, keyframe.pos);
+  }
   return ret;
 }
 
@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include "IRedExtractor.h"
 #ifdef __cplusplus
 extern "C" {
@@ -20,6 +21,7 @@ public:
   int getPbError() override;
   int getStreamType(int stream_index) override;
   void close() override;
+  void setKeyframeIndex(std::shared_ptr<KeyframeIndex> index) override;
   ~RedFFExtractor();
 
 private:
@@ -27,11 +29,15 @@ private:
   void notifyListener(uint32_t what, int32_t arg1 = 0, int32_t arg2 = 0,
                       void *obj1 = nullptr, void *obj2 = nullptr,
                       int obj1_len = 0, int obj2_len = 0);
+  void indexPacket(const AVPacket *pkt);
+  int seekKeyframe(const KeyframeEntry &keyframe);
 
 private:
   AVFormatContext *ic_{nullptr};
   std::atomic_bool interrupted_{false};
   const int session_id_{0};
   NotifyCallback notify_cb_;
+  std::shared_ptr<KeyframeIndex> index_;
+  int index_stream_{-1};
 };
 REDSOURCE_NS_END
@@ -0,0 +1,160 @@
+#include "RedKeyframeIndex.h"
+#include "RedLog.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+#define KEYFRAME_INDEX_MAGIC 0x49464b52 // "RKFI"
+#define KEYFRAME_INDEX_VERSION 1
+#define KEYFRAME_INDEX_MAX_ENTRIES (1 << 20)
+#define KEYFRAME_LINKED_BIT 0x80000000u
+
+REDSOURCE_NS_BEGIN
+namespace {
+/*the file is a header and 20 bytes per entry, in host byte order, the magic
+ * rejects a file written with the other one*/
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  int64_t source_size;
+  int64_t duration;
+  uint32_t count;
+  uint32_t reserved;
+};
+
+struct FileEntry {
+  int64_t pts_us;
+  int64_t pos;
+  uint32_t size; // the top bit is the linked flag
+} __attribute__((packed));
+static_assert(sizeof(FileEntry) == 20, "keyframe index entry layout");
+
+bool comparePts(const KeyframeEntry &entry, int64_t pts_us) {
+  return entry.pts_us < pts_us;
+}
+} // namespace
+
+void KeyframeIndex::bind(int64_t source_size, int64_t duration) {
+  if (source_size != source_size_ || duration != duration_) {
+    if (!entries_.empty()) {
+      AV_LOGI(SOURCE_LOG_TAG, "keyframe index stale, drop %zu entries\n",
+              entries_.size());
+    }
+    entries_.clear();
+    source_size_ = source_size;
+    duration_ = duration;
+    dirty_ = true;
+  }
+  run_ = false;
+}
+
+void KeyframeIndex::add(int64_t pts_us, int64_t pos, int32_t size) {
+  auto it =
+      std::lower_bound(entries_.begin(), entries_.end(), pts_us, comparePts);
+  bool follows =
+      run_ && it != entries_.begin() && std::prev(it)->pts_us == last_pts_us_;
+  run_ = true;
+  last_pts_us_ = pts_us;
+  if (it != entries_.end() && it->pts_us == pts_us) {
+    if (follows && !it->linked) {
+      it->linked = true;
+      dirty_ = true;
+    }
+    return;
+  }
+  it = entries_.insert(it, {pts_us, pos, size, follows});
+  if (++it != entries_.end()) {
+    // a keyframe turned up between the next one and its predecessor
+    it->linked = false;
+  }
+  dirty_ = true;
+}
+
+void KeyframeIndex::breakRun() { run_ = false; }
+
+bool KeyframeIndex::lookup(int64_t target_us, KeyframeEntry &entry) const {
+  auto it = std::upper_bound(
+      entries_.begin(), entries_.end(), target_us,
+      [](int64_t pts_us, const KeyframeEntry &e) { return pts_us < e.pts_us; });
+  if (it == entries_.begin() || it == entries_.end() || !it->linked) {
+    return false;
+  }
+  entry = *std::prev(it);
+  return true;
+}
+
+int KeyframeIndex::load(const std::string &path) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    return -1;
+  }
+  FileHeader header;
+  std::vector<FileEntry> buf;
+  bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+            header.magic == KEYFRAME_INDEX_MAGIC &&
+            header.version == KEYFRAME_INDEX_VERSION &&
+            header.count <= KEYFRAME_INDEX_MAX_ENTRIES;
+  if (ok) {
+    buf.resize(header.count);
+    ok = fread(buf.data(), sizeof(FileEntry), buf.size(), fp) == buf.size();
+  }
+  fclose(fp);
+  if (!ok) {
+    AV_LOGW(SOURCE_LOG_TAG, "keyframe index %s invalid\n", path.c_str());
+    return -1;
+  }
+  entries_.clear();
+  entries_.reserve(buf.size());
+  for (const FileEntry &e : buf) {
+    if (!entries_.empty() && e.pts_us <= entries_.back().pts_us) {
+      entries_.clear();
+      return -1;
+    }
+    entries_.push_back({e.pts_us, e.pos,
+                        static_cast<int32_t>(e.size & ~KEYFRAME_LINKED_BIT),
+                        (e.size & KEYFRAME_LINKED_BIT) != 0});
+  }
+  source_size_ = header.source_size;
+  duration_ = header.duration;
+  run_ = false;
+  dirty_ = false;
+  return 0;
+}
+
+int KeyframeIndex::save(const std::string &path) {
+  std::vector<FileEntry> buf;
+  buf.reserve(entries_.size());
+  for (const KeyframeEntry &e : entries_) {
+    uint32_t size = static_cast<uint32_t>(e.size) & ~KEYFRAME_LINKED_BIT;
+    if (e.linked) {
+      size |= KEYFRAME_LINKED_BIT;
+    }
+    buf.push_back({e.pts_us, e.pos, size});
+  }
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = KEYFRAME_INDEX_MAGIC;
+  header.version = KEYFRAME_INDEX_VERSION;
+  header.source_size = source_size_;
+  header.duration = duration_;
+  header.count = static_cast<uint32_t>(buf.size());
+
+  // a reader never sees half a file
+  std::string tmp_path = path + ".tmp";
+  FILE *fp = fopen(tmp_path.c_str(), "wb");
+  if (!fp) {
+    return -1;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(buf.data(), sizeof(FileEntry), buf.size(), fp) == buf.size();
+  ok = fclose(fp) == 0 && ok;
+  if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    AV_LOGW(SOURCE_LOG_TAG, "keyframe index %s save failed\n", path.c_str());
+    remove(tmp_path.c_str());
+    return -1;
+  }
+  dirty_ = false;
+  return 0;
+}
+REDSOURCE_NS_END
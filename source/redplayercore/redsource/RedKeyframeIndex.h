@@ -0,0 +1,42 @@
+#pragma once
+#include "RedSourceCommon.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+REDSOURCE_NS_BEGIN
+struct KeyframeEntry {
+  int64_t pts_us{0}; // from the start of the media, like seek positions
+  int64_t pos{0};    // byte offset of the packet in the source
+  int32_t size{0};
+  bool linked{false}; // read straight on from the entry before it
+};
+
+/*keyframes of one stream in pts order, filled while demuxing formats that
+ * can seek by byte (ts, flv, ...), mov/mp4 never get one. Entries read one
+ * after another without a seek in between are linked, only a linked
+ * successor proves there is no unseen keyframe between two entries. Used
+ * from the read thread only*/
+class KeyframeIndex {
+public:
+  /*entries built from another version of the source are dropped*/
+  void bind(int64_t source_size, int64_t duration);
+  void add(int64_t pts_us, int64_t pos, int32_t size);
+  /*the next add() does not follow the last one, call on every seek*/
+  void breakRun();
+  /*the last keyframe at or before target_us, when the index covers it*/
+  bool lookup(int64_t target_us, KeyframeEntry &entry) const;
+
+  int load(const std::string &path);
+  int save(const std::string &path);
+  size_t size() const { return entries_.size(); }
+  bool dirty() const { return dirty_; }
+
+private:
+  std::vector<KeyframeEntry> entries_;
+  int64_t source_size_{-1};
+  int64_t duration_{-1};
+  int64_t last_pts_us_{0};
+  bool run_{false};
+  bool dirty_{false};
+};
+REDSOURCE_NS_END
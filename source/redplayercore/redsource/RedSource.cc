@@ -70,6 +70,12 @@ int RedSource::getPbError() {
   return ret;
 }
 
+void RedSource::setKeyframeIndex(std::shared_ptr<KeyframeIndex> index) {
+  if (extractor_) {
+    extractor_->setKeyframeIndex(index);
+  }
+}
+
 int RedSource::getStreamType(int stream_index) {
   int ret = -1;
   if (extractor_) {
@@ -19,6 +19,7 @@ public:
   int getPbError();
   int getStreamType(int stream_index);
   void close();
+  void setKeyframeIndex(std::shared_ptr<KeyframeIndex> index);
 
 private:
   const int session_id_{0};
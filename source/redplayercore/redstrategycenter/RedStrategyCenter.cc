@@ -21,18 +21,23 @@ RedStrategyCenter::~RedStrategyCenter() { samples_.clear(); }
 
 void RedStrategyCenter::updateDownloadRate(int64_t size, int64_t speed,
                                            int64_t cur_time) {
-  std::lock_guard<std::mutex> lock(samples_mutex_);
   if (size > 0 && speed > 0 && cur_time > 0) {
     int64_t weight = (int64_t)sqrt(size);
+    bandwidth_estimator_.update(
+        weight, speed, cur_time,
+        adaptive::config::RedAdaptiveConfig::getInstance()
+            ->getShortVideoConfigExpiresTime());
+    std::lock_guard<std::mutex> lock(samples_mutex_);
     struct Sample newSample(weight, speed, cur_time);
     samples_.push_back(newSample);
     while (samples_.size() > DEFAULT_MAX_SAMPLES) {
-      samples_.erase(samples_.begin());
+      samples_.pop_front();
     }
   }
 }
 
 void RedStrategyCenter::notifyNetworkTypeChanged() {
+  bandwidth_estimator_.reset();
   std::lock_guard<std::mutex> lock(samples_mutex_);
   samples_.clear();
 }
@@ -41,12 +46,25 @@ std::vector<Sample> RedStrategyCenter::getSamples() {
   std::lock_guard<std::mutex> lock(samples_mutex_);
   int64_t expires_time = adaptive::config::RedAdaptiveConfig::getInstance()
                              ->getShortVideoConfigExpiresTime();
-  int64_t cur_time = CurrentTimeUs();
+  int64_t cur_time = now();
   while (!samples_.empty() && cur_time > samples_.begin()->time &&
          cur_time - samples_.begin()->time > expires_time) {
-    samples_.erase(samples_.begin());
+    samples_.pop_front();
   }
-  return samples_;
+  return std::vector<Sample>(samples_.begin(), samples_.end());
+}
+
+void RedStrategyCenter::setClock(int64_t (*clock)()) { clock_ = clock; }
+
+int64_t RedStrategyCenter::now() {
+  int64_t (*clock)() = clock_.load();
+  return clock ? clock() : CurrentTimeUs();
+}
+
+void RedStrategyCenter::reset() {
+  bandwidth_estimator_.reset();
+  std::lock_guard<std::mutex> lock(samples_mutex_);
+  samples_.clear();
 }
 
 } // namespace redstrategycenter
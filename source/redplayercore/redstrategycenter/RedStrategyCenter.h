@@ -1,7 +1,10 @@
 #pragma once
 
 #include "RedStrategyCenterCommon.h"
+#include "evaluate/BandwidthEstimator.h"
 #include "observer/IDownloadObserver.h"
+#include <atomic>
+#include <deque>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -21,8 +24,18 @@ public:
   static RedStrategyCenter *GetInstance();
   void updateDownloadRate(int64_t size, int64_t speed,
                           int64_t cur_time) override;
+  /*starts over from no samples*/
   void notifyNetworkTypeChanged();
   std::vector<Sample> getSamples();
+  const evaluate::BandwidthEstimator &getBandwidthEstimator() const {
+    return bandwidth_estimator_;
+  }
+  /*time the samples expire against, CurrentTimeUs unless an offline run
+   * sets its own clock*/
+  void setClock(int64_t (*clock)());
+  int64_t now();
+  /*drops all samples and estimates, not to race with readers*/
+  void reset();
 
 private:
   RedStrategyCenter();
@@ -32,7 +45,9 @@ private:
 
 private:
   static RedStrategyCenter *instance_;
-  std::vector<Sample> samples_;
+  std::deque<Sample> samples_;
   std::mutex samples_mutex_;
+  evaluate::BandwidthEstimator bandwidth_estimator_;
+  std::atomic<int64_t (*)()> clock_{nullptr};
 };
 } // namespace redstrategycenter
@@ -6,6 +6,10 @@
 #define SHORT_VIDEO_CONFIG_EXPIRES_TIME_DEFAULT 300000000
 #define SHORT_VIDEO_CONFIG_NE_SCALE_FACTOR_DEFAULT 1.0
 #define SHORT_VIDEO_CONFIG_NE_PERCENTILE_DEFAULT 0.5
+#define SHORT_VIDEO_CONFIG_NE_TYPE_DEFAULT 0
+#define SHORT_VIDEO_CONFIG_SWITCH_DOWN_BUFFER_MS_DEFAULT 4000
+#define SHORT_VIDEO_CONFIG_SWITCH_UP_BUFFER_MS_DEFAULT 12000
+#define SHORT_VIDEO_CONFIG_SWITCH_UP_HEADROOM_DEFAULT 1.3
 
 namespace redstrategycenter {
 namespace adaptive {
@@ -15,6 +19,10 @@ ShortVideoConfig::ShortVideoConfig() {
   expires_time = SHORT_VIDEO_CONFIG_EXPIRES_TIME_DEFAULT;
   ne_scale_factor = SHORT_VIDEO_CONFIG_NE_SCALE_FACTOR_DEFAULT;
   ne_percentile = SHORT_VIDEO_CONFIG_NE_PERCENTILE_DEFAULT;
+  ne_type = SHORT_VIDEO_CONFIG_NE_TYPE_DEFAULT;
+  switch_down_buffer_ms = SHORT_VIDEO_CONFIG_SWITCH_DOWN_BUFFER_MS_DEFAULT;
+  switch_up_buffer_ms = SHORT_VIDEO_CONFIG_SWITCH_UP_BUFFER_MS_DEFAULT;
+  switch_up_headroom = SHORT_VIDEO_CONFIG_SWITCH_UP_HEADROOM_DEFAULT;
 }
 
 RedAdaptiveConfig *RedAdaptiveConfig::instance_;
@@ -41,6 +49,17 @@ int RedAdaptiveConfig::setShortVideoConfig(const std::string &str) {
         j.value("ne_scale_factor", SHORT_VIDEO_CONFIG_NE_SCALE_FACTOR_DEFAULT));
     short_video_config_->ne_percentile = static_cast<float>(
         j.value("ne_percentile", SHORT_VIDEO_CONFIG_NE_PERCENTILE_DEFAULT));
+    short_video_config_->ne_type = static_cast<int>(
+        j.value("ne_type", SHORT_VIDEO_CONFIG_NE_TYPE_DEFAULT));
+    short_video_config_->switch_down_buffer_ms = static_cast<int64_t>(
+        j.value("switch_down_buffer_ms",
+                SHORT_VIDEO_CONFIG_SWITCH_DOWN_BUFFER_MS_DEFAULT));
+    short_video_config_->switch_up_buffer_ms = static_cast<int64_t>(
+        j.value("switch_up_buffer_ms",
+                SHORT_VIDEO_CONFIG_SWITCH_UP_BUFFER_MS_DEFAULT));
+    short_video_config_->switch_up_headroom = static_cast<float>(
+        j.value("switch_up_headroom",
+                SHORT_VIDEO_CONFIG_SWITCH_UP_HEADROOM_DEFAULT));
     return 0;
   } catch (nlohmann::json::exception &e) {
     return -1;
@@ -64,6 +83,26 @@ float RedAdaptiveConfig::getShortVideoConfigNePercentile() {
   return short_video_config_->ne_percentile;
 }
 
+int RedAdaptiveConfig::getShortVideoConfigNeType() {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return short_video_config_->ne_type;
+}
+
+int64_t RedAdaptiveConfig::getShortVideoConfigSwitchDownBufferMs() {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return short_video_config_->switch_down_buffer_ms;
+}
+
+int64_t RedAdaptiveConfig::getShortVideoConfigSwitchUpBufferMs() {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return short_video_config_->switch_up_buffer_ms;
+}
+
+float RedAdaptiveConfig::getShortVideoConfigSwitchUpHeadroom() {
+  std::lock_guard<std::mutex> lock(config_mutex_);
+  return short_video_config_->switch_up_headroom;
+}
+
 } // namespace config
 } // namespace adaptive
 } // namespace redstrategycenter
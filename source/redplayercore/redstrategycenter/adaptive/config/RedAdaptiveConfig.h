@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -13,6 +14,10 @@ typedef struct ShortVideoConfig {
   int64_t expires_time;
   float ne_scale_factor;
   float ne_percentile;
+  int ne_type; // evaluate::NetworkEvaluate::Type
+  int64_t switch_down_buffer_ms;
+  int64_t switch_up_buffer_ms;
+  float switch_up_headroom;
 } ShortVideoConfig;
 
 class RedAdaptiveConfig {
@@ -22,6 +27,10 @@ public:
   int64_t getShortVideoConfigExpiresTime();
   float getShortVideoConfigNeScaleFactor();
   float getShortVideoConfigNePercentile();
+  int getShortVideoConfigNeType();
+  int64_t getShortVideoConfigSwitchDownBufferMs();
+  int64_t getShortVideoConfigSwitchUpBufferMs();
+  float getShortVideoConfigSwitchUpHeadroom();
 
 private:
   RedAdaptiveConfig();
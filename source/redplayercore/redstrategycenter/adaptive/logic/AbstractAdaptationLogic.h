@@ -2,6 +2,7 @@
 
 #include "adaptive/playlist/RedPlaylist.h"
 #include "adaptive/playlist/RedPlaylistParser.h"
+#include <memory>
 
 namespace redstrategycenter {
 namespace adaptive {
@@ -19,6 +20,14 @@ public:
   virtual int
   getInitialRepresentation(const std::unique_ptr<playlist::PlayList> &p,
                            const int speed) = 0;
+  /*representation to move to during playback, current to stay. speed is
+   * the estimated bandwidth, buffer_ms what the player holds*/
+  virtual int
+  getNextRepresentation(const std::unique_ptr<playlist::PlayList> &p,
+                        const int current, const int speed,
+                        const int64_t buffer_ms) {
+    return current;
+  }
   virtual int setReddownloadUrlCachedFunc(int64_t (*func)(const char *url)) {
     return 0;
   }
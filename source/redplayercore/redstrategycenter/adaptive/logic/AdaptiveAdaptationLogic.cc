@@ -59,6 +59,53 @@ int AdaptiveAdaptationLogic::getInitialRepresentation(
   return ret < 0 ? 0 : ret;
 }
 
+// below the low buffer mark take the best one the speed holds, above the
+// high mark move up only with headroom, in between stay. the playlist is
+// ordered by weight and resolution, so candidates go by avg_bitrate
+int AdaptiveAdaptationLogic::getNextRepresentation(
+    const std::unique_ptr<playlist::PlayList> &p, const int current,
+    const int speed, const int64_t buffer_ms) {
+  if (p == nullptr || p->adaptation_set == nullptr || speed <= 0) {
+    return current;
+  }
+  auto &representations = p->adaptation_set->representations;
+  int count = static_cast<int>(representations.size());
+  if (count < 2 || current < 0 || current >= count) {
+    return current;
+  }
+  config::RedAdaptiveConfig *config = config::RedAdaptiveConfig::getInstance();
+  int current_bitrate = representations[current]->avg_bitrate;
+  int best = -1;
+  if (buffer_ms < config->getShortVideoConfigSwitchDownBufferMs()) {
+    if (current_bitrate <= speed) {
+      return current;
+    }
+    int lowest = current;
+    for (int i = 0; i < count; i++) {
+      int bitrate = representations[i]->avg_bitrate;
+      if (bitrate < representations[lowest]->avg_bitrate) {
+        lowest = i;
+      }
+      if (bitrate <= speed &&
+          (best < 0 || bitrate > representations[best]->avg_bitrate)) {
+        best = i;
+      }
+    }
+    return best < 0 ? lowest : best;
+  }
+  if (buffer_ms >= config->getShortVideoConfigSwitchUpBufferMs()) {
+    float headroom = config->getShortVideoConfigSwitchUpHeadroom();
+    for (int i = 0; i < count; i++) {
+      int bitrate = representations[i]->avg_bitrate;
+      if (bitrate > current_bitrate && bitrate * headroom <= speed &&
+          (best < 0 || bitrate > representations[best]->avg_bitrate)) {
+        best = i;
+      }
+    }
+  }
+  return best < 0 ? current : best;
+}
+
 int AdaptiveAdaptationLogic::setReddownloadUrlCachedFunc(
     int64_t (*func)(const char *url)) {
   if (func != nullptr) {
@@ -11,6 +11,9 @@ public:
   ~AdaptiveAdaptationLogic() = default;
   int getInitialRepresentation(const std::unique_ptr<playlist::PlayList> &p,
                                const int speed) override;
+  int getNextRepresentation(const std::unique_ptr<playlist::PlayList> &p,
+                            const int current, const int speed,
+                            const int64_t buffer_ms) override;
   int setReddownloadUrlCachedFunc(int64_t (*func)(const char *url)) override;
 };
 } // namespace logic
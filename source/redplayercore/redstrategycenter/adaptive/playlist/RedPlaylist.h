@@ -1,6 +1,7 @@
 #pragma once
 
 #include "RedStrategyCenterCommon.h"
+#include <memory>
 #include <string>
 #include <vector>
 namespace redstrategycenter {
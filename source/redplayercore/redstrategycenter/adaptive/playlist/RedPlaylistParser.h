@@ -2,6 +2,7 @@
 
 #include "adaptive/playlist/RedPlaylist.h"
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 namespace redstrategycenter {
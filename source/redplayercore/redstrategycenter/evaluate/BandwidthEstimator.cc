@@ -0,0 +1,161 @@
+#include "evaluate/BandwidthEstimator.h"
+#include <math.h>
+
+namespace redstrategycenter {
+namespace evaluate {
+
+void BandwidthEwma::add(int64_t weight, int64_t value, int64_t time,
+                        int64_t half_life) {
+  if (weight_ > 0 && time > time_ && half_life > 0) {
+    double decay = exp2(-static_cast<double>(time - time_) / half_life);
+    sum_ *= decay;
+    weight_ *= decay;
+  }
+  sum_ += static_cast<double>(weight) * value;
+  weight_ += weight;
+  time_ = time > time_ ? time : time_;
+  value_.store(static_cast<int64_t>(sum_ / weight_), std::memory_order_relaxed);
+}
+
+void BandwidthEwma::reset() {
+  sum_ = 0;
+  weight_ = 0;
+  time_ = 0;
+  value_.store(-1, std::memory_order_relaxed);
+}
+
+int BandwidthSketch::bucketOf(int64_t value) {
+  if (value <= BANDWIDTH_SKETCH_MIN_SPEED) {
+    return 0;
+  }
+  int bucket = static_cast<int>(
+      log2(static_cast<double>(value) / BANDWIDTH_SKETCH_MIN_SPEED) *
+      BANDWIDTH_SKETCH_BUCKETS_PER_OCTAVE);
+  return bucket < BANDWIDTH_SKETCH_BUCKETS ? bucket
+                                           : BANDWIDTH_SKETCH_BUCKETS - 1;
+}
+
+double BandwidthSketch::bucketLow(int bucket) {
+  double octaves =
+      static_cast<double>(bucket) / BANDWIDTH_SKETCH_BUCKETS_PER_OCTAVE;
+  return BANDWIDTH_SKETCH_MIN_SPEED * exp2(octaves);
+}
+
+// writers are serialized by the estimator
+void BandwidthSketch::take(Slot &slot, int64_t start) {
+  uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+  slot.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.start.store(start, std::memory_order_relaxed);
+  for (std::atomic<int64_t> &w : slot.weights) {
+    w.store(0, std::memory_order_relaxed);
+  }
+  slot.seq.store(seq + 2, std::memory_order_release);
+}
+
+bool BandwidthSketch::read(const Slot &slot, int64_t oldest, int64_t now,
+                           int64_t *weights) {
+  for (int i = 0; i < BANDWIDTH_SKETCH_READ_RETRIES; i++) {
+    uint32_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq & 1) {
+      continue;
+    }
+    int64_t start = slot.start.load(std::memory_order_relaxed);
+    if (start < 0 || start < oldest || start > now) {
+      return false;
+    }
+    for (int j = 0; j < BANDWIDTH_SKETCH_BUCKETS; j++) {
+      weights[j] = slot.weights[j].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) == seq) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void BandwidthSketch::add(int64_t weight, int64_t value, int64_t time,
+                          int64_t window) {
+  int64_t span = window / BANDWIDTH_SKETCH_SLOTS;
+  span = span > 0 ? span : 1;
+  int64_t start = time - time % span;
+  Slot &slot = slots_[(time / span) % BANDWIDTH_SKETCH_SLOTS];
+  if (slot.start.load(std::memory_order_relaxed) != start) {
+    take(slot, start); // out of the window, refill it
+  }
+  // a single bucket, a reader sees the sample or not
+  slot.weights[bucketOf(value)].fetch_add(weight, std::memory_order_relaxed);
+}
+
+int64_t BandwidthSketch::quantile(float percentile, int64_t now,
+                                  int64_t window) const {
+  int64_t span = window / BANDWIDTH_SKETCH_SLOTS;
+  span = span > 0 ? span : 1;
+  // the slot now is in and the ones before it that still overlap the window
+  int64_t oldest = now - now % span - (BANDWIDTH_SKETCH_SLOTS - 1) * span;
+  int64_t weights[BANDWIDTH_SKETCH_BUCKETS] = {0};
+  int64_t slot_weights[BANDWIDTH_SKETCH_BUCKETS];
+  int64_t total = 0;
+  for (const Slot &slot : slots_) {
+    if (!read(slot, oldest, now, slot_weights)) {
+      continue;
+    }
+    for (int i = 0; i < BANDWIDTH_SKETCH_BUCKETS; i++) {
+      weights[i] += slot_weights[i];
+      total += slot_weights[i];
+    }
+  }
+  if (total <= 0) {
+    return -1;
+  }
+  double desired = percentile * total;
+  int64_t accumulated = 0;
+  for (int i = 0; i < BANDWIDTH_SKETCH_BUCKETS; i++) {
+    if (weights[i] > 0 && accumulated + weights[i] >= desired) {
+      // spread the weight of the bucket evenly over its log scale width
+      double fraction = (desired - accumulated) / weights[i];
+      fraction = fraction < 0 ? 0 : fraction;
+      return static_cast<int64_t>(
+          bucketLow(i) * exp2(fraction / BANDWIDTH_SKETCH_BUCKETS_PER_OCTAVE));
+    }
+    accumulated += weights[i];
+  }
+  return static_cast<int64_t>(bucketLow(BANDWIDTH_SKETCH_BUCKETS));
+}
+
+void BandwidthSketch::reset() {
+  for (Slot &slot : slots_) {
+    take(slot, -1);
+  }
+}
+
+void BandwidthEstimator::update(int64_t weight, int64_t speed, int64_t time,
+                                int64_t window) {
+  if (weight <= 0 || speed <= 0 || time <= 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  fast_.add(weight, speed, time, BANDWIDTH_EWMA_FAST_HALF_LIFE_US);
+  slow_.add(weight, speed, time, BANDWIDTH_EWMA_SLOW_HALF_LIFE_US);
+  sketch_.add(weight, speed, time, window);
+}
+
+void BandwidthEstimator::reset() {
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  fast_.reset();
+  slow_.reset();
+  sketch_.reset();
+}
+
+int64_t BandwidthEstimator::getEwmaFast() const { return fast_.get(); }
+
+int64_t BandwidthEstimator::getEwmaSlow() const { return slow_.get(); }
+
+int64_t BandwidthEstimator::getQuantile(float percentile, int64_t now,
+                                        int64_t window) const {
+  return sketch_.quantile(percentile, now, window);
+}
+
+} // namespace evaluate
+} // namespace redstrategycenter
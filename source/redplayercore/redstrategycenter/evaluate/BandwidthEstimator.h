@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+
+#define BANDWIDTH_SKETCH_SLOTS 4
+#define BANDWIDTH_SKETCH_BUCKETS_PER_OCTAVE 8
+#define BANDWIDTH_SKETCH_BUCKETS 160 // 8 kb/s .. 8 Gb/s
+#define BANDWIDTH_SKETCH_MIN_SPEED 8000
+#define BANDWIDTH_SKETCH_READ_RETRIES 4
+#define BANDWIDTH_EWMA_FAST_HALF_LIFE_US 2000000
+#define BANDWIDTH_EWMA_SLOW_HALF_LIFE_US 20000000
+
+namespace redstrategycenter {
+namespace evaluate {
+
+/*average of the samples with weights halving every half life of sample
+ * time*/
+class BandwidthEwma {
+public:
+  void add(int64_t weight, int64_t value, int64_t time, int64_t half_life);
+  int64_t get() const { return value_.load(std::memory_order_relaxed); }
+  void reset();
+
+private:
+  std::atomic<int64_t> value_{-1};
+  double sum_{0};
+  double weight_{0};
+  int64_t time_{0};
+};
+
+/*weighted log scale histogram of the samples over a sliding time window. The
+ * window is kept as slots that get reused once they fall out of it, so an
+ * add costs a constant and a query reads a fixed number of buckets. A slot
+ * carries a sequence that is odd while it is refilled, a query copying it
+ * meanwhile tries again and leaves it out after a few tries*/
+class BandwidthSketch {
+public:
+  void add(int64_t weight, int64_t value, int64_t time, int64_t window);
+  int64_t quantile(float percentile, int64_t now, int64_t window) const;
+  void reset();
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> seq{0};
+    std::atomic<int64_t> start{-1}; // weights are set when it is taken
+    std::atomic<int64_t> weights[BANDWIDTH_SKETCH_BUCKETS];
+  };
+  static int bucketOf(int64_t value);
+  static double bucketLow(int bucket);
+  static void take(Slot &slot, int64_t start);
+  /*false when the slot kept changing or is not in [oldest, now]*/
+  static bool read(const Slot &slot, int64_t oldest, int64_t now,
+                   int64_t *weights);
+
+  Slot slots_[BANDWIDTH_SKETCH_SLOTS];
+};
+
+/*the speed samples of all downloads. Updates are serialized and cost a
+ * constant, reads take no lock: one racing an update may see the
+ * averages with the sample and the histogram without it, or the other way
+ * round. A histogram slot being refilled holds only that sample, so leaving
+ * it out also misses just that sample*/
+class BandwidthEstimator {
+public:
+  void update(int64_t weight, int64_t speed, int64_t time, int64_t window);
+  /*forgets all samples, for a network change*/
+  void reset();
+
+  int64_t getEwmaFast() const;
+  int64_t getEwmaSlow() const;
+  /*-1 without samples in the window*/
+  int64_t getQuantile(float percentile, int64_t now, int64_t window) const;
+
+private:
+  BandwidthEwma fast_;
+  BandwidthEwma slow_;
+  BandwidthSketch sketch_;
+  std::mutex update_mutex_;
+};
+
+} // namespace evaluate
+} // namespace redstrategycenter
@@ -1,5 +1,6 @@
 #include "RedLog.h"
 #include "evaluate/NetworkEvaluateV1.h"
+#include <algorithm>
 #include <iostream>
 
 #define SORT_ORDER_NONE (-1)
@@ -18,6 +19,11 @@ bool NetworkEvaluateV1::valueComparator(const Sample &a, const Sample &b) {
   return (a.value < b.value);
 }
 
+int64_t NetworkEvaluateV1::getSpeed(float percentile) {
+  std::vector<Sample> samples = RedStrategyCenter::GetInstance()->getSamples();
+  return getSpeed(percentile, samples);
+}
+
 int64_t NetworkEvaluateV1::getSpeed(float percentile,
                                     std::vector<Sample> &samples) {
   int index = 0;
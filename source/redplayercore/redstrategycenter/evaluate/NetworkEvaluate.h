@@ -7,8 +7,16 @@ namespace redstrategycenter {
 namespace evaluate {
 class NetworkEvaluate {
 public:
+  enum class Type {
+    SortedSamples = 0, // NetworkEvaluateV1
+    Quantile = 1,
+    EwmaFast = 2,
+    EwmaSlow = 3,
+    EwmaMin = 4, // the lower of fast and slow
+  };
   virtual ~NetworkEvaluate() {}
-  virtual int64_t getSpeed(float percentile, std::vector<Sample> &samples) = 0;
+  /*bits/s of the current network, -1 without samples*/
+  virtual int64_t getSpeed(float percentile) = 0;
 };
 } // namespace evaluate
 } // namespace redstrategycenter
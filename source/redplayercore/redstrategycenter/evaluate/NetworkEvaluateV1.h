@@ -14,7 +14,8 @@ class NetworkEvaluateV1 : public NetworkEvaluate {
 public:
   NetworkEvaluateV1(int64_t maxWeight);
   ~NetworkEvaluateV1();
-  int64_t getSpeed(float percentile, std::vector<Sample> &samples) override;
+  int64_t getSpeed(float percentile) override;
+  int64_t getSpeed(float percentile, std::vector<Sample> &samples);
 
 private:
   static bool valueComparator(const Sample &a, const Sample &b);
@@ -0,0 +1,43 @@
+#include "evaluate/NetworkEvaluateV2.h"
+#include "RedLog.h"
+#include "adaptive/config/RedAdaptiveConfig.h"
+#include "evaluate/NetworkEvaluateV1.h"
+
+namespace redstrategycenter {
+namespace evaluate {
+
+NetworkEvaluateV2::NetworkEvaluateV2(Type type) : mType(type) {}
+
+NetworkEvaluateV2::~NetworkEvaluateV2() {}
+
+int64_t NetworkEvaluateV2::getSpeed(float percentile) {
+  RedStrategyCenter *center = RedStrategyCenter::GetInstance();
+  const BandwidthEstimator &estimator = center->getBandwidthEstimator();
+  switch (mType) {
+  case Type::EwmaFast:
+    return estimator.getEwmaFast();
+  case Type::EwmaSlow:
+    return estimator.getEwmaSlow();
+  case Type::EwmaMin: {
+    int64_t fast = estimator.getEwmaFast();
+    int64_t slow = estimator.getEwmaSlow();
+    return fast < slow ? fast : slow;
+  }
+  case Type::Quantile:
+  default:
+    break;
+  }
+  if (percentile <= 0 || percentile >= 1) {
+    AV_LOGW(RED_STRATEGY_CENTER_TAG,
+            "[%s:%d] invalid percentile %f, use default\n", __FUNCTION__,
+            __LINE__, percentile);
+    percentile = DEFAULT_PERCENTILE;
+  }
+  return estimator.getQuantile(
+      percentile, center->now(),
+      adaptive::config::RedAdaptiveConfig::getInstance()
+          ->getShortVideoConfigExpiresTime());
+}
+
+} // namespace evaluate
+} // namespace redstrategycenter
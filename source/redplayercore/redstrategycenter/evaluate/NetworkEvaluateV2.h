@@ -0,0 +1,20 @@
+#pragma once
+
+#include "evaluate/NetworkEvaluate.h"
+#include <stdint.h>
+
+namespace redstrategycenter {
+namespace evaluate {
+/*reads the incremental estimates RedStrategyCenter keeps, no samples get
+ * copied or sorted*/
+class NetworkEvaluateV2 : public NetworkEvaluate {
+public:
+  NetworkEvaluateV2(Type type);
+  ~NetworkEvaluateV2();
+  int64_t getSpeed(float percentile) override;
+
+private:
+  Type mType;
+};
+} // namespace evaluate
+} // namespace redstrategycenter
@@ -0,0 +1,902 @@
+#if defined(__HEADLESS__)
+
+#include <getopt.h>
+#include <math.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "RedLog.h"
+#include "RedStrategyCenter.h"
+#include "adaptive/config/RedAdaptiveConfig.h"
+#include "json.hpp"
+#include "strategy/RedAdaptiveStrategy.h"
+
+#define SIM_START_US 1000000000000LL // like CurrentTimeUs, never 0
+#define SIM_MAX_SESSION_US (6 * 3600 * 1000000LL)
+// what the player does, see RedCurl and RedSourceController
+#define PLAYBACK_SAMPLE_BYTES (512 * 1024)
+#define PLAYBACK_SAMPLE_MIN_US 200000
+#define SWITCH_CHECK_INTERVAL_US 1000000
+#define SWITCH_MIN_INTERVAL_US 5000000
+#define PRELOAD_MIN_BUFFER_MS 5000
+
+using redstrategycenter::RedStrategyCenter;
+using redstrategycenter::adaptive::config::RedAdaptiveConfig;
+using redstrategycenter::strategy::RedAdaptiveStrategy;
+typedef redstrategycenter::adaptive::logic::AbstractAdaptationLogic::LogicType
+    LogicType;
+
+namespace {
+
+struct SimOptions {
+  int preload_count{1};
+  bool adaptive_switch{false};
+  int64_t watch_ms{0};
+  int64_t duration_ms{30000};
+  int64_t rtt_ms{80};
+  int64_t max_buffer_ms{15000};
+  int64_t refill_ms{1000};
+  int64_t start_buffer_ms{500};
+  int64_t rebuffer_ms{1000};
+  int64_t step_ms{50};
+  int repeats{1};
+  bool verbose{false};
+  int jobs{1};
+};
+
+/*the link runs at bps from time_us on*/
+struct TracePoint {
+  int64_t time_us;
+  int64_t bps;
+  int64_t rtt_us;
+};
+
+struct Trace {
+  std::string name;
+  std::vector<TracePoint> points;
+  int64_t length_us{0};
+
+  const TracePoint &at(int64_t time_us) const {
+    time_us %= length_us;
+    auto it = std::upper_bound(
+        points.begin(), points.end(), time_us,
+        [](int64_t t, const TracePoint &p) { return t < p.time_us; });
+    return it == points.begin() ? points.front() : *(it - 1);
+  }
+};
+
+struct Video {
+  std::string playlist;
+  int64_t duration_ms;
+  std::unique_ptr<RedAdaptiveStrategy> strategy;
+  std::vector<std::string> urls;
+  std::vector<int64_t> bitrates;
+};
+
+struct Transfer {
+  bool active{false};
+  int video{-1};
+  int rep{-1};
+  int64_t wait_us{0}; // round trip of the request left
+  int64_t bytes{0};
+  int64_t target{0};
+  int64_t start_us{0};
+  int64_t sample_bytes{0};
+  int64_t sample_us{0};
+};
+
+struct Segment {
+  double from_ms;
+  int64_t bps;
+};
+
+struct Result {
+  int sessions{0};
+  int videos{0};
+  int stalls{0};
+  int64_t stall_ms{0};
+  int64_t startup_ms{0};
+  int64_t first_startup_ms{0};
+  int64_t played_ms{0};
+  double bitrate_ms{0}; // bits/s times ms played at it
+  int switches{0};
+  int64_t bytes{0};
+  int64_t preload_bytes{0};
+  int64_t wasted_preload_bytes{0};
+  int timeouts{0};
+
+  void add(const Result &r) {
+    sessions += r.sessions;
+    videos += r.videos;
+    stalls += r.stalls;
+    stall_ms += r.stall_ms;
+    startup_ms += r.startup_ms;
+    first_startup_ms += r.first_startup_ms;
+    played_ms += r.played_ms;
+    bitrate_ms += r.bitrate_ms;
+    switches += r.switches;
+    bytes += r.bytes;
+    preload_bytes += r.preload_bytes;
+    wasted_preload_bytes += r.wasted_preload_bytes;
+    timeouts += r.timeouts;
+  }
+};
+
+int64_t gNowUs = SIM_START_US;
+std::map<std::string, int64_t> *gCache = nullptr;
+
+int64_t simClock() { return gNowUs; }
+
+/*what reddownload has cached of the url, the adaptive logic prefers it*/
+int64_t cachedSize(const char *url) {
+  if (!gCache) {
+    return 0;
+  }
+  auto it = gCache->find(url);
+  return it == gCache->end() ? 0 : it->second;
+}
+
+/*one user scrolling through the feed on one trace*/
+class Session {
+public:
+  Session(const SimOptions &opts, const Trace &trace, int64_t offset_us,
+          std::vector<Video> &feed, int64_t preload_bytes)
+      : mOpts(opts), mTrace(trace), mOffsetUs(offset_us), mFeed(feed),
+        mPreloadBytes(preload_bytes), mPreloaded(feed.size(), false) {}
+
+  Result run() {
+    RedStrategyCenter::GetInstance()->reset();
+    gNowUs = SIM_START_US;
+    gCache = &mCache;
+    mResult.sessions = 1;
+    startVideo(0);
+    int64_t step_us = mOpts.step_ms * 1000;
+    while (mVideo < static_cast<int>(mFeed.size())) {
+      if (gNowUs - SIM_START_US > SIM_MAX_SESSION_US) {
+        mResult.timeouts++;
+        break;
+      }
+      int64_t quiet = quietSteps();
+      if (quiet > 0) {
+        mPlayedMs += quiet * mOpts.step_ms;
+        gNowUs += quiet * step_us;
+      } else {
+        step(step_us);
+        gNowUs += step_us;
+      }
+      if (mPlayedMs >= mWatchMs) {
+        finishVideo();
+        startVideo(mVideo + 1);
+      }
+    }
+    // a session cut short never reaches the videos it preloaded ahead
+    if (mVideo < static_cast<int>(mFeed.size())) {
+      mResult.wasted_preload_bytes += wastedPreload();
+      for (int i = mVideo + 1; i < static_cast<int>(mFeed.size()); i++) {
+        for (const std::string &url : mFeed[i].urls) {
+          mResult.wasted_preload_bytes += cachedSize(url.c_str());
+        }
+      }
+    }
+    gCache = nullptr;
+    return mResult;
+  }
+
+private:
+  const TracePoint &link() const {
+    return mTrace.at(mOffsetUs + gNowUs - SIM_START_US);
+  }
+
+  double bufferMs() const { return mDownloadedMs - mPlayedMs; }
+
+  void startVideo(int index) {
+    mVideo = index;
+    if (index >= static_cast<int>(mFeed.size())) {
+      return;
+    }
+    Video &video = mFeed[index];
+    if (mPreload.active && mPreload.video == index) {
+      // the player takes over what the preload has got so far
+      mPreload.active = false;
+    }
+    mRep = std::max(video.strategy->getInitialRepresentation(), 0);
+    mStartUs = gNowUs;
+    mStarted = false;
+    mPlaying = false;
+    mPaused = false;
+    mPlayedMs = 0;
+    mLastCheckUs = gNowUs;
+    mLastSwitchUs = gNowUs;
+    mWatchMs = mOpts.watch_ms > 0 ? std::min(mOpts.watch_ms, video.duration_ms)
+                                  : video.duration_ms;
+    int64_t cached = cachedSize(video.urls[mRep].c_str());
+    mCachedBytes = cached;
+    mDownloadedMs = std::min<double>(
+        video.duration_ms, cached * 8000.0 / video.bitrates[mRep]);
+    mSegments.assign(1, {0, video.bitrates[mRep]});
+    mTransfer = Transfer();
+    startTransfer(mTransfer, index, mRep);
+  }
+
+  void finishVideo() {
+    Video &video = mFeed[mVideo];
+    mResult.videos++;
+    int64_t startup_ms = (mStartedUs - mStartUs) / 1000;
+    mResult.startup_ms += startup_ms;
+    if (mVideo == 0) {
+      mResult.first_startup_ms = startup_ms;
+    }
+    mResult.played_ms += static_cast<int64_t>(mPlayedMs);
+    for (size_t i = 0; i < mSegments.size(); i++) {
+      double to = i + 1 < mSegments.size() ? mSegments[i + 1].from_ms
+                                           : video.duration_ms;
+      double ms = std::min(to, mPlayedMs) - mSegments[i].from_ms;
+      mResult.bitrate_ms += ms > 0 ? ms * mSegments[i].bps : 0;
+    }
+    mResult.wasted_preload_bytes += wastedPreload();
+    if (mPreload.active) {
+      mPreload.active = false;
+    }
+  }
+
+  /*preloaded bytes of the current video count as used as far as they got
+   * played*/
+  int64_t wastedPreload() const {
+    const Video &video = mFeed[mVideo];
+    int64_t preloaded = 0;
+    for (const std::string &url : video.urls) {
+      preloaded += cachedSize(url.c_str());
+    }
+    double first_to = mSegments.size() > 1 ? mSegments[1].from_ms
+                                           : video.duration_ms;
+    int64_t played = static_cast<int64_t>(std::min(first_to, mPlayedMs) *
+                                          mSegments[0].bps / 8000);
+    return preloaded - std::min(mCachedBytes, std::max<int64_t>(played, 0));
+  }
+
+  bool preloadPending() const {
+    int last = std::min<int>(mVideo + mOpts.preload_count,
+                             static_cast<int>(mFeed.size()) - 1);
+    for (int i = mVideo + 1; i <= last && mPreloadBytes > 0; i++) {
+      if (!mPreloaded[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /*steps ahead in which only playback moves, they are skipped in one go*/
+  int64_t quietSteps() const {
+    const Video &video = mFeed[mVideo];
+    bool complete = mDownloadedMs >= video.duration_ms;
+    if (!mStarted || !mPlaying || !(mPaused || complete) || mPreload.active ||
+        preloadPending()) {
+      return 0;
+    }
+    double ms = mWatchMs - mPlayedMs;
+    if (!complete) {
+      ms = std::min(ms, bufferMs() - mOpts.max_buffer_ms + mOpts.refill_ms);
+      if (mOpts.adaptive_switch) {
+        int64_t check_us = std::max(mLastCheckUs + SWITCH_CHECK_INTERVAL_US,
+                                    mLastSwitchUs + SWITCH_MIN_INTERVAL_US);
+        ms = std::min(ms, (check_us - gNowUs) / 1000.0);
+      }
+    }
+    return std::max<int64_t>(static_cast<int64_t>(ms / mOpts.step_ms) - 1, 0);
+  }
+
+  void startTransfer(Transfer &t, int video, int rep) {
+    t.active = true;
+    t.video = video;
+    t.rep = rep;
+    t.wait_us = link().rtt_us;
+    t.bytes = 0;
+    t.start_us = gNowUs;
+    t.sample_bytes = 0;
+    t.sample_us = 0;
+  }
+
+  /*preloads the next videos one after the other once playback has enough
+   * buffer*/
+  void schedulePreload(bool playback_idle) {
+    if (mPreload.active || mPreloadBytes <= 0 ||
+        (!playback_idle && bufferMs() < PRELOAD_MIN_BUFFER_MS)) {
+      return;
+    }
+    int last = std::min<int>(mVideo + mOpts.preload_count,
+                             static_cast<int>(mFeed.size()) - 1);
+    for (int i = mVideo + 1; i <= last; i++) {
+      if (mPreloaded[i]) {
+        continue;
+      }
+      mPreloaded[i] = true;
+      Video &video = mFeed[i];
+      int rep = std::max(video.strategy->getInitialRepresentation(), 0);
+      int64_t size = video.bitrates[rep] * video.duration_ms / 8000;
+      startTransfer(mPreload, i, rep);
+      mPreload.target = std::min(mPreloadBytes, size);
+      return;
+    }
+  }
+
+  void step(int64_t step_us) {
+    Video &video = mFeed[mVideo];
+    if (bufferMs() >= mOpts.max_buffer_ms) {
+      mPaused = true;
+    } else if (bufferMs() < mOpts.max_buffer_ms - mOpts.refill_ms) {
+      mPaused = false;
+    }
+    bool downloading = mDownloadedMs < video.duration_ms && !mPaused;
+    schedulePreload(!downloading);
+
+    // round trips first, the bandwidth is shared by what is left
+    int64_t play_us = 0, preload_us = 0;
+    if (downloading) {
+      int64_t wait = std::min(mTransfer.wait_us, step_us);
+      mTransfer.wait_us -= wait;
+      play_us = step_us - wait;
+    }
+    if (mPreload.active) {
+      int64_t wait = std::min(mPreload.wait_us, step_us);
+      mPreload.wait_us -= wait;
+      preload_us = step_us - wait;
+    }
+    int sharing = (play_us > 0 ? 1 : 0) + (preload_us > 0 ? 1 : 0);
+    double bps = sharing > 0 ? static_cast<double>(link().bps) / sharing : 0;
+
+    if (play_us > 0) {
+      int64_t bitrate = video.bitrates[mRep];
+      double room_ms = std::min<double>(video.duration_ms - mDownloadedMs,
+                                        mOpts.max_buffer_ms - bufferMs());
+      int64_t bytes = static_cast<int64_t>(
+          std::min(bps * play_us / 8e6, room_ms * bitrate / 8000));
+      bytes = std::max<int64_t>(bytes, 0);
+      mDownloadedMs += bytes * 8000.0 / bitrate;
+      if (video.duration_ms - mDownloadedMs < 1) {
+        mDownloadedMs = video.duration_ms; // bytes are whole, ms are not
+      }
+      mResult.bytes += bytes;
+      mTransfer.sample_bytes += bytes;
+      mTransfer.sample_us += play_us;
+      if (mTransfer.sample_bytes >= PLAYBACK_SAMPLE_BYTES &&
+          mTransfer.sample_us >= PLAYBACK_SAMPLE_MIN_US) {
+        RedStrategyCenter::GetInstance()->updateDownloadRate(
+            mTransfer.sample_bytes,
+            mTransfer.sample_bytes * 8000000 / mTransfer.sample_us, gNowUs);
+        mTransfer.sample_bytes = 0;
+        mTransfer.sample_us = 0;
+      }
+    }
+    if (preload_us > 0) {
+      int64_t bytes = static_cast<int64_t>(
+          std::min<double>(bps * preload_us / 8e6,
+                           mPreload.target - mPreload.bytes));
+      mPreload.bytes += bytes;
+      mResult.bytes += bytes;
+      mResult.preload_bytes += bytes;
+      mCache[mFeed[mPreload.video].urls[mPreload.rep]] += bytes;
+      if (mPreload.bytes >= mPreload.target) {
+        // preload reports once its transfer is done
+        int64_t duration = gNowUs + step_us - mPreload.start_us;
+        RedStrategyCenter::GetInstance()->updateDownloadRate(
+            mPreload.bytes, mPreload.bytes * 8000000 / duration,
+            gNowUs + step_us);
+        mPreload.active = false;
+      }
+    }
+
+    play(step_us / 1000.0);
+    checkSwitch();
+  }
+
+  void play(double ms) {
+    Video &video = mFeed[mVideo];
+    bool complete = mDownloadedMs >= video.duration_ms;
+    if (!mStarted) {
+      if (bufferMs() >= mOpts.start_buffer_ms || complete) {
+        mStarted = true;
+        mPlaying = true;
+        mStartedUs = gNowUs;
+      }
+      return;
+    }
+    if (!mPlaying) {
+      mResult.stall_ms += static_cast<int64_t>(ms);
+      if (bufferMs() >= mOpts.rebuffer_ms || complete) {
+        mPlaying = true;
+      }
+      return;
+    }
+    mPlayedMs = std::min(mPlayedMs + ms, mDownloadedMs);
+    if (bufferMs() <= 0 && !complete && mPlayedMs < mWatchMs) {
+      mPlaying = false;
+      mResult.stalls++;
+    }
+  }
+
+  void checkSwitch() {
+    Video &video = mFeed[mVideo];
+    if (!mOpts.adaptive_switch || !mStarted ||
+        mDownloadedMs >= video.duration_ms ||
+        gNowUs - mLastCheckUs < SWITCH_CHECK_INTERVAL_US ||
+        gNowUs - mLastSwitchUs < SWITCH_MIN_INTERVAL_US) {
+      return;
+    }
+    mLastCheckUs = gNowUs;
+    int target = video.strategy->getNextRepresentation(
+        mRep, static_cast<int64_t>(bufferMs()));
+    if (target == mRep || target < 0 ||
+        target >= static_cast<int>(video.bitrates.size())) {
+      return;
+    }
+    mSegments.push_back({mDownloadedMs, video.bitrates[target]});
+    mRep = target;
+    mLastSwitchUs = gNowUs;
+    mResult.switches++;
+    startTransfer(mTransfer, mVideo, mRep);
+  }
+
+  const SimOptions &mOpts;
+  const Trace &mTrace;
+  int64_t mOffsetUs;
+  std::vector<Video> &mFeed;
+  int64_t mPreloadBytes;
+  std::vector<bool> mPreloaded;
+  std::map<std::string, int64_t> mCache;
+  Result mResult;
+
+  int mVideo{0};
+  int mRep{0};
+  int64_t mStartUs{0};
+  int64_t mStartedUs{0};
+  bool mStarted{false};
+  bool mPlaying{false};
+  bool mPaused{false};
+  double mDownloadedMs{0};
+  double mPlayedMs{0};
+  int64_t mWatchMs{0};
+  int64_t mCachedBytes{0};
+  int64_t mLastCheckUs{0};
+  int64_t mLastSwitchUs{0};
+  std::vector<Segment> mSegments;
+  Transfer mTransfer;
+  Transfer mPreload;
+};
+
+/*time_s bandwidth_mbps [rtt_ms] per line, the cooked trace format*/
+bool loadTrace(const char *path, int64_t rtt_ms, Trace &trace) {
+  std::ifstream in(path);
+  std::string line;
+  trace.name = path;
+  while (std::getline(in, line)) {
+    double time_s = 0, mbps = 0, rtt = static_cast<double>(rtt_ms);
+    if (sscanf(line.c_str(), "%lf %lf %lf", &time_s, &mbps, &rtt) < 2) {
+      continue;
+    }
+    trace.points.push_back({static_cast<int64_t>(time_s * 1e6),
+                            static_cast<int64_t>(mbps * 1e6),
+                            static_cast<int64_t>(rtt * 1000)});
+  }
+  if (trace.points.empty()) {
+    return false;
+  }
+  int64_t base = trace.points.front().time_us;
+  for (TracePoint &p : trace.points) {
+    p.time_us -= base;
+  }
+  size_t n = trace.points.size();
+  int64_t last = n > 1 ? trace.points[n - 1].time_us -
+                             trace.points[n - 2].time_us
+                       : 1000000;
+  trace.length_us = trace.points.back().time_us + std::max<int64_t>(last, 1);
+  return true;
+}
+
+/*log bandwidth random walk between 300 kb/s and 20 Mb/s with jumps*/
+Trace syntheticTrace(int index) {
+  std::mt19937 rng(index + 1);
+  std::normal_distribution<double> walk(0, 0.25);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  const double low = log(0.3e6), high = log(20e6);
+  double x = low + (high - low) * uniform(rng);
+  int64_t rtt_us = static_cast<int64_t>(40000 + 160000 * uniform(rng));
+  Trace trace;
+  trace.name = "synthetic_" + std::to_string(index);
+  for (int s = 0; s < 600; s++) {
+    x = uniform(rng) < 0.02 ? low + (high - low) * uniform(rng) : x + walk(rng);
+    x = std::min(std::max(x, low), high);
+    trace.points.push_back(
+        {s * 1000000LL, static_cast<int64_t>(exp(x)), rtt_us});
+  }
+  trace.length_us = 600 * 1000000LL;
+  return trace;
+}
+
+/*one playlist json per line, as the player gets it, with an optional
+ * top level duration_ms*/
+bool loadFeed(const char *path, int64_t duration_ms,
+              std::vector<std::string> &lines,
+              std::vector<int64_t> &durations) {
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    try {
+      nlohmann::json j = nlohmann::json::parse(line);
+      durations.push_back(j.value("duration_ms", duration_ms));
+    } catch (...) {
+      return false;
+    }
+    lines.push_back(line);
+  }
+  return !lines.empty();
+}
+
+/*a 4 step ladder for each of 20 videos*/
+void builtinFeed(int64_t duration_ms, std::vector<std::string> &lines,
+                 std::vector<int64_t> &durations) {
+  const struct {
+    int bitrate, width, height;
+  } ladder[] = {{4000000, 1920, 1080},
+                {2000000, 1280, 720},
+                {1000000, 960, 540},
+                {500000, 640, 360}};
+  for (int v = 0; v < 20; v++) {
+    nlohmann::json h264 = nlohmann::json::array();
+    for (const auto &r : ladder) {
+      h264.push_back({{"master_url", "http://sim/" + std::to_string(v) + "/" +
+                                         std::to_string(r.bitrate) + ".mp4"},
+                      {"avg_bitrate", r.bitrate},
+                      {"width", r.width},
+                      {"height", r.height}});
+    }
+    nlohmann::json j = {{"stream", {{"h264", h264}}}};
+    lines.push_back(j.dump());
+    durations.push_back(duration_ms);
+  }
+}
+
+bool parseList(const char *arg, std::vector<int64_t> &values) {
+  values.clear();
+  std::stringstream ss(arg);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    char *end = nullptr;
+    int64_t v = strtoll(item.c_str(), &end, 10);
+    if (item.empty() || *end != '\0' || v < 0) {
+      return false;
+    }
+    values.push_back(v);
+  }
+  return !values.empty();
+}
+
+std::string readConfig(const char *arg) {
+  if (arg[0] == '{') {
+    return arg;
+  }
+  std::ifstream in(arg);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+void printResult(FILE *out, const char *what, const std::string &label,
+                 const std::string &trace, int logic, int64_t preload_bytes,
+                 const Result &r, double wall_s) {
+  int sessions = std::max(r.sessions, 1);
+  int videos = std::max(r.videos, 1);
+  fprintf(out,
+          "{\"%s\":%s,\"config\":%s,\"logic\":%d,\"preload_bytes\":%" PRId64
+          ",\"sessions\":%d,\"videos\":%d,\"stalls_per_session\":%.3f"
+          ",\"stall_ms_per_session\":%.1f,\"stall_ratio\":%.4f"
+          ",\"startup_ms\":%.1f,\"first_startup_ms\":%.1f"
+          ",\"avg_bitrate\":%.0f,\"switches_per_session\":%.3f"
+          ",\"bytes_per_session\":%.0f,\"preload_bytes_per_session\":%.0f"
+          ",\"wasted_preload_bytes_per_session\":%.0f,\"timeouts\":%d",
+          what, nlohmann::json(trace).dump().c_str(),
+          nlohmann::json(label).dump().c_str(), logic, preload_bytes,
+          r.sessions, r.videos, static_cast<double>(r.stalls) / sessions,
+          static_cast<double>(r.stall_ms) / sessions,
+          r.played_ms > 0 ? static_cast<double>(r.stall_ms) /
+                                (r.played_ms + r.stall_ms)
+                          : 0,
+          static_cast<double>(r.startup_ms) / videos,
+          static_cast<double>(r.first_startup_ms) / sessions,
+          r.played_ms > 0 ? r.bitrate_ms / r.played_ms : 0,
+          static_cast<double>(r.switches) / sessions,
+          static_cast<double>(r.bytes) / sessions,
+          static_cast<double>(r.preload_bytes) / sessions,
+          static_cast<double>(r.wasted_preload_bytes) / sessions, r.timeouts);
+  if (wall_s > 0) {
+    fprintf(out, ",\"sessions_per_s\":%.0f", r.sessions / wall_s);
+  }
+  fprintf(out, "}\n");
+}
+
+/*sessions on every jobs th trace from first on*/
+Result runTraces(const SimOptions &opts, const std::vector<Trace> &traces,
+                 size_t first, std::vector<Video> &feed, int64_t preload_bytes,
+                 FILE *out, const std::string &label, int logic) {
+  Result total;
+  for (size_t t = first; t < traces.size(); t += opts.jobs) {
+    const Trace &trace = traces[t];
+    Result per_trace;
+    for (int i = 0; i < opts.repeats; i++) {
+      int64_t offset = trace.length_us / opts.repeats * i;
+      Session session(opts, trace, offset, feed, preload_bytes);
+      per_trace.add(session.run());
+    }
+    if (opts.verbose) {
+      printResult(out, "trace", label, trace.name, logic, preload_bytes,
+                  per_trace, 0);
+      fflush(out);
+    }
+    total.add(per_trace);
+  }
+  return total;
+}
+
+/*the strategy center is a singleton, so jobs are processes that each send
+ * back their sum*/
+bool runJobs(const SimOptions &opts, const std::vector<Trace> &traces,
+             std::vector<Video> &feed, int64_t preload_bytes, FILE *out,
+             const std::string &label, int logic, Result &total) {
+  if (opts.jobs <= 1) {
+    total = runTraces(opts, traces, 0, feed, preload_bytes, out, label, logic);
+    return true;
+  }
+  fflush(out);
+  bool ok = true;
+  std::vector<int> fds;
+  for (int k = 0; k < opts.jobs; k++) {
+    int fd[2];
+    if (pipe(fd) != 0) {
+      ok = false;
+      break;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(fd[0]);
+      Result r = runTraces(opts, traces, k, feed, preload_bytes, out, label,
+                           logic);
+      ssize_t n = write(fd[1], &r, sizeof(r));
+      _exit(n == sizeof(r) ? 0 : 1);
+    }
+    close(fd[1]);
+    if (pid < 0) {
+      close(fd[0]);
+      ok = false;
+      break;
+    }
+    fds.push_back(fd[0]);
+  }
+  for (int fd : fds) {
+    Result r;
+    if (read(fd, &r, sizeof(r)) == sizeof(r)) {
+      total.add(r);
+    } else {
+      ok = false;
+    }
+    close(fd);
+  }
+  while (wait(nullptr) > 0) {
+  }
+  return ok;
+}
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <trace>...\n"
+          "  replays bandwidth traces, time_s mbps [rtt_ms] per line,\n"
+          "  against a model of playback and preload driven by the real\n"
+          "  strategy center, network evaluate and adaptation logic\n"
+          "  -f <file>  feed, one playlist json per line, duration_ms per\n"
+          "             line optional. default 20 videos of a 4 step ladder\n"
+          "  -g <n>     add n synthetic traces\n"
+          "  -c <json>  short video config, inline or a file. repeat to\n"
+          "             sweep, default the built in values\n"
+          "  -L <list>  adaptation logic, 0 adaptive 1 best 2 lowest,\n"
+          "             comma separated to sweep, default 0\n"
+          "  -p <list>  preload bytes per video, comma separated to sweep,\n"
+          "             default 524288\n"
+          "  -n <n>     videos preloaded ahead, default 1\n"
+          "  -a         switch representations during playback\n"
+          "  -w <ms>    watch time per video, default the whole video\n"
+          "  -d <ms>    duration of videos without one, default 30000\n"
+          "  -r <ms>    rtt of traces without one, default 80\n"
+          "  -b <ms>    max buffer, default 15000\n"
+          "  -s <ms>    simulation step, default 50\n"
+          "  -R <n>     replay each trace n times from spread out starts\n"
+          "  -j <n>     run in n processes\n"
+          "  -v         also print every trace\n"
+          "  -o <file>  write the json lines to file instead of stdout\n",
+          name);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  SimOptions opts;
+  const char *feed_path = nullptr;
+  const char *out_path = nullptr;
+  int synthetic = 0;
+  std::vector<std::string> configs;
+  std::vector<int64_t> logics = {0};
+  std::vector<int64_t> preloads = {512 * 1024};
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:g:c:L:p:n:aw:d:r:b:s:R:j:vo:h")) != -1) {
+    switch (opt) {
+    case 'f':
+      feed_path = optarg;
+      break;
+    case 'g':
+      synthetic = atoi(optarg);
+      break;
+    case 'c':
+      configs.push_back(optarg);
+      break;
+    case 'L':
+      if (!parseList(optarg, logics)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'p':
+      if (!parseList(optarg, preloads)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'n':
+      opts.preload_count = atoi(optarg);
+      break;
+    case 'a':
+      opts.adaptive_switch = true;
+      break;
+    case 'w':
+      opts.watch_ms = atoll(optarg);
+      break;
+    case 'd':
+      opts.duration_ms = atoll(optarg);
+      break;
+    case 'r':
+      opts.rtt_ms = atoll(optarg);
+      break;
+    case 'b':
+      opts.max_buffer_ms = atoll(optarg);
+      break;
+    case 's':
+      opts.step_ms = atoll(optarg);
+      break;
+    case 'R':
+      opts.repeats = atoi(optarg);
+      break;
+    case 'j':
+      opts.jobs = atoi(optarg);
+      break;
+    case 'v':
+      opts.verbose = true;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if ((optind >= argc && synthetic <= 0) || opts.step_ms <= 0 ||
+      opts.repeats <= 0 || opts.jobs <= 0 || opts.duration_ms <= 0 ||
+      opts.max_buffer_ms <= opts.refill_ms) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<Trace> traces;
+  for (int i = optind; i < argc; i++) {
+    Trace trace;
+    if (!loadTrace(argv[i], opts.rtt_ms, trace)) {
+      fprintf(stderr, "load trace %s failed\n", argv[i]);
+      return 1;
+    }
+    traces.push_back(trace);
+  }
+  for (int i = 0; i < synthetic; i++) {
+    traces.push_back(syntheticTrace(i));
+  }
+
+  std::vector<std::string> lines;
+  std::vector<int64_t> durations;
+  if (feed_path) {
+    if (!loadFeed(feed_path, opts.duration_ms, lines, durations)) {
+      fprintf(stderr, "load feed %s failed\n", feed_path);
+      return 1;
+    }
+  } else {
+    builtinFeed(opts.duration_ms, lines, durations);
+  }
+  if (configs.empty()) {
+    configs.push_back("{}");
+  }
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "open %s failed\n", out_path);
+    return 1;
+  }
+
+  RedLogSetLevel(AV_LEVEL_ERROR);
+  RedStrategyCenter::GetInstance()->setClock(simClock);
+  int failures = 0;
+  for (const std::string &label : configs) {
+    std::string config = readConfig(label.c_str());
+    if (RedAdaptiveConfig::getInstance()->setShortVideoConfig(config) != 0) {
+      fprintf(stderr, "bad config %s\n", label.c_str());
+      failures++;
+      continue;
+    }
+    for (int64_t logic : logics) {
+      // strategies pick up the config when they are made
+      std::vector<Video> feed(lines.size());
+      bool usable = true;
+      for (size_t i = 0; i < lines.size(); i++) {
+        Video &video = feed[i];
+        video.playlist = lines[i];
+        video.duration_ms = durations[i];
+        video.strategy = std::make_unique<RedAdaptiveStrategy>(
+            static_cast<LogicType>(logic));
+        video.strategy->setPlaylist(lines[i]);
+        video.strategy->setReddownloadUrlCachedFunc(cachedSize);
+        for (int r = 0; r < video.strategy->getRepresentationCount(); r++) {
+          video.urls.push_back(video.strategy->getInitialUrl(r));
+          video.bitrates.push_back(video.strategy->getRepresentationBitrate(r));
+          usable = usable && video.bitrates.back() > 0;
+        }
+        usable = usable && !video.urls.empty();
+      }
+      if (!usable) {
+        fprintf(stderr, "feed has a video without a usable representation\n");
+        failures++;
+        break;
+      }
+      for (int64_t preload_bytes : preloads) {
+        auto start = std::chrono::steady_clock::now();
+        Result total;
+        if (!runJobs(opts, traces, feed, preload_bytes, out, label,
+                     static_cast<int>(logic), total)) {
+          failures++;
+        }
+        double wall_s = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+        printResult(out, "summary", label, "all", static_cast<int>(logic),
+                    preload_bytes, total, wall_s);
+        fflush(out);
+      }
+    }
+  }
+
+  RedStrategyCenter::GetInstance()->setClock(nullptr);
+  if (out != stdout)
+    fclose(out);
+  return failures > 0 ? 1 : 0;
+}
+
+#endif
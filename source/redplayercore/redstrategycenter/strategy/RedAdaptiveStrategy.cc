@@ -6,13 +6,16 @@
 #include "adaptive/logic/AlwaysLowestAdaptationLogic.h"
 #include "adaptive/playlist/RedPlaylistJsonParser.h"
 #include "json.hpp"
+#include <inttypes.h>
 
 namespace redstrategycenter {
 namespace strategy {
 
 RedAdaptiveStrategy::RedAdaptiveStrategy(
     adaptive::logic::AbstractAdaptationLogic::LogicType logicType) {
-  network_evaluate_.reset(new evaluate::NetworkEvaluateV1(DEFAULT_MAX_WEIGHT));
+  setNetworkEvaluateType(static_cast<evaluate::NetworkEvaluate::Type>(
+      adaptive::config::RedAdaptiveConfig::getInstance()
+          ->getShortVideoConfigNeType()));
   playlist_parser_.reset(new adaptive::playlist::RedPlaylistJsonParser());
   switch (logicType) {
   case adaptive::logic::AbstractAdaptationLogic::LogicType::AlwaysBest:
@@ -43,13 +46,31 @@ int RedAdaptiveStrategy::setReddownloadUrlCachedFunc(
   return -1;
 }
 
+void RedAdaptiveStrategy::setNetworkEvaluateType(
+    evaluate::NetworkEvaluate::Type type) {
+  switch (type) {
+  case evaluate::NetworkEvaluate::Type::SortedSamples:
+    network_evaluate_.reset(
+        new evaluate::NetworkEvaluateV1(DEFAULT_MAX_WEIGHT));
+    break;
+  case evaluate::NetworkEvaluate::Type::EwmaFast:
+  case evaluate::NetworkEvaluate::Type::EwmaSlow:
+  case evaluate::NetworkEvaluate::Type::EwmaMin:
+    network_evaluate_.reset(new evaluate::NetworkEvaluateV2(type));
+    break;
+  case evaluate::NetworkEvaluate::Type::Quantile:
+  default:
+    network_evaluate_.reset(new evaluate::NetworkEvaluateV2(
+        evaluate::NetworkEvaluate::Type::Quantile));
+    break;
+  }
+}
+
 int RedAdaptiveStrategy::getCurBandWidth() {
   int ret = -1;
-  std::vector<Sample> samples = RedStrategyCenter::GetInstance()->getSamples();
   ret = network_evaluate_->getSpeed(
       adaptive::config::RedAdaptiveConfig::getInstance()
-          ->getShortVideoConfigNePercentile(),
-      samples);
+          ->getShortVideoConfigNePercentile());
   ret =
       static_cast<int>(ret * adaptive::config::RedAdaptiveConfig::getInstance()
                                  ->getShortVideoConfigNeScaleFactor());
@@ -70,6 +91,46 @@ int RedAdaptiveStrategy::getInitialRepresentation() {
   return ret;
 }
 
+int RedAdaptiveStrategy::getNextRepresentation(int current,
+                                               int64_t buffer_ms) {
+  if (playlist_ == nullptr || adaptation_logic_ == nullptr) {
+    return current;
+  }
+  int speed = getCurBandWidth();
+  int ret = adaptation_logic_->getNextRepresentation(playlist_, current, speed,
+                                                     buffer_ms);
+  if (ret < 0 ||
+      ret >= static_cast<int>(
+                 playlist_->adaptation_set->representations.size()) ||
+      disabled_representations_.count(ret) > 0) {
+    return current;
+  }
+  if (ret != current) {
+    AV_LOGI(RED_STRATEGY_CENTER_TAG,
+            "[%s:%d] %d -> %d, speed %d, buffer %" PRId64 "ms\n", __FUNCTION__,
+            __LINE__, current, ret, speed, buffer_ms);
+  }
+  return ret;
+}
+
+int RedAdaptiveStrategy::getRepresentationCount() {
+  if (playlist_ == nullptr || playlist_->adaptation_set == nullptr) {
+    return 0;
+  }
+  return static_cast<int>(playlist_->adaptation_set->representations.size());
+}
+
+int RedAdaptiveStrategy::getRepresentationBitrate(int index) {
+  if (index < 0 || index >= getRepresentationCount()) {
+    return -1;
+  }
+  return playlist_->adaptation_set->representations[index]->avg_bitrate;
+}
+
+void RedAdaptiveStrategy::disableRepresentation(int index) {
+  disabled_representations_.insert(index);
+}
+
 std::string RedAdaptiveStrategy::getInitialUrl(int index) {
   std::string ret;
   index = index < 0 ? 0 : index;
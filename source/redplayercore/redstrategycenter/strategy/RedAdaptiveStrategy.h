@@ -6,6 +6,8 @@
 #include "adaptive/playlist/RedPlaylistParser.h"
 #include "evaluate/NetworkEvaluate.h"
 #include "evaluate/NetworkEvaluateV1.h"
+#include "evaluate/NetworkEvaluateV2.h"
+#include <set>
 
 namespace redstrategycenter {
 namespace strategy {
@@ -18,7 +20,16 @@ public:
   int getInitialRepresentation();
   std::string getInitialUrl(int index);
   std::string getInitialUrlList(int index);
+  int getRepresentationCount();
+  /*avg_bitrate of the playlist, -1 for no such representation*/
+  int getRepresentationBitrate(int index);
   int getCurBandWidth();
+  /*the config's ne_type is used until one is set*/
+  void setNetworkEvaluateType(evaluate::NetworkEvaluate::Type type);
+  /*representation to move to during playback, current to stay*/
+  int getNextRepresentation(int current, int64_t buffer_ms);
+  /*one the decoders playing can not move to is not picked again*/
+  void disableRepresentation(int index);
   RedAdaptiveStrategy(const RedAdaptiveStrategy &) = delete;
   RedAdaptiveStrategy &operator=(const RedAdaptiveStrategy &) = delete;
   RedAdaptiveStrategy(RedAdaptiveStrategy &&) = delete;
@@ -29,6 +40,7 @@ private:
   std::unique_ptr<adaptive::playlist::PlayList> playlist_;
   std::unique_ptr<evaluate::NetworkEvaluate> network_evaluate_;
   std::unique_ptr<adaptive::logic::AbstractAdaptationLogic> adaptation_logic_;
+  std::set<int> disabled_representations_;
 };
 } // namespace strategy
 } // namespace redstrategycenter